@@ -0,0 +1,133 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "model.hpp"
+#include "model_loader.hpp"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace k3::graphics {
+
+    struct K3AssetCacheStatistics {
+        uint32_t assetCount = 0;
+        uint32_t loadingCount = 0;
+        // Assets held by something other than the cache, these are never evicted.
+        uint32_t referencedCount = 0;
+        uint64_t deviceBytes = 0;
+        uint64_t hostBytes = 0;
+        uint64_t budgetBytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    /**
+     * Registry of loaded models keyed by normalised path and by content hash, so the same mesh
+     * is only kept once however it is named. The hash is the first step of the load task, so a
+     * copy under a new name is handed the existing model instead of being parsed and uploaded
+     * again, and is folded into the existing asset once it resolves. Once the device and host
+     * bytes of the cached models pass the budget, the least recently requested ones nobody else
+     * holds are evicted.
+     */
+    class K3AssetCache {
+
+        public:
+
+            // Keep the CPU K3Builder in the model after upload. Part of the cache key.
+            static constexpr uint32_t KEEP_BUILDER = 1u << 0;
+
+            static constexpr uint64_t DEFAULT_BUDGET = 256ull << 20;
+
+            K3AssetCache(std::shared_ptr<K3ModelLoader> loader, uint64_t budgetBytes = DEFAULT_BUDGET);
+
+            // Waits for the loads it started, their tasks look up the cache.
+            ~K3AssetCache();
+
+            K3AssetCache(const K3AssetCache &) = delete;
+            K3AssetCache &operator=(const K3AssetCache &) = delete;
+
+            K3ModelHandle loadModel(const std::string &filePath, uint32_t vertexFormat = K3VertexFormat::COMPACT, uint32_t flags = 0);
+
+            // Call once per frame after it was submitted. Picks up finished loads, evicts down to
+            // the budget and destroys models evicted MAX_FRAMES_IN_FLIGHT frames ago.
+            void update();
+
+            void setBudget(uint64_t budgetBytes);
+
+            uint64_t getBudget() const;
+
+            K3AssetCacheStatistics getStatistics() const;
+
+            static std::string normalisePath(const std::string &filePath);
+
+            // FNV-1a over the file contents, 0 if it can't be read.
+            static uint64_t hashFile(const std::string &filePath);
+
+        private:
+
+            struct K3Asset {
+                std::vector<std::string> pathKeys{};
+                // Set by the load task once the file is hashed, empty for good if it couldn't be read.
+                std::string contentKey{};
+                // Set instead of contentKey when the load task was handed another asset's model.
+                std::string duplicateKey{};
+                uint32_t vertexFormat = 0;
+                uint32_t flags = 0;
+                // Valid until the load finishes, then model takes over.
+                K3ModelHandle handle{};
+                std::shared_ptr<K3Model> model = nullptr;
+                uint64_t deviceBytes = 0;
+                uint64_t hostBytes = 0;
+            };
+
+            using K3AssetList = std::list<K3Asset>;
+
+            static std::string makeKey(const std::string &name, uint32_t vertexFormat, uint32_t flags);
+
+            void touch(K3AssetList::iterator asset);
+
+            // Runs in the load task of pathKey before anything is parsed. Hashes the file and returns
+            // the handle of an asset with the same content, or registers the content key.
+            K3ModelHandle findContent(const std::string &pathKey, const std::string &filePath);
+
+            // Folds a loaded duplicate into the asset it shares its model with. Returns false if the
+            // asset was folded and is gone.
+            bool resolveDuplicate(K3AssetList::iterator asset);
+
+            void evict(K3AssetList::iterator asset);
+
+            std::shared_ptr<K3ModelLoader> m_loader = nullptr;
+
+            uint64_t m_budgetBytes = DEFAULT_BUDGET;
+
+            // Most recently requested first.
+            K3AssetList m_assets{};
+
+            std::unordered_map<std::string, K3AssetList::iterator> m_assetsByPath{};
+
+            std::unordered_map<std::string, K3AssetList::iterator> m_assetsByContent{};
+
+            // Evicted models with the frame they were evicted in, kept until the GPU is done with them.
+            std::vector<std::pair<uint64_t, std::shared_ptr<K3Model>>> m_retired{};
+
+            uint64_t m_frame = 0;
+
+            uint64_t m_hits = 0;
+
+            uint64_t m_misses = 0;
+
+            uint64_t m_evictions = 0;
+
+            mutable std::mutex m_mutex;
+
+    };
+
+}
@@ -18,7 +18,8 @@ namespace k3::graphics {
                 uint32_t instanceCount,
                 VkBufferUsageFlags usageFlags,
                 VkMemoryPropertyFlags memoryPropertyFlags,
-                VkDeviceSize minOffsetAlignment = 1);
+                VkDeviceSize minOffsetAlignment = 1,
+                K3MemoryCategory category = K3MemoryCategory::OTHER);
 
             ~K3Buffer();
     
@@ -61,6 +62,12 @@ namespace k3::graphics {
 
             VkDeviceSize getBufferSize() const { return m_vk_bufferSize; }
 
+            const K3Allocation &getAllocation() const { return m_allocation; }
+
+            // Takes over a copy of this buffer made by the defragmenter, which keeps the old
+            // buffer and memory alive until the frames using them are done.
+            void relocate(VkBuffer buffer, const K3Allocation &allocation);
+
         private:
 
             static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
@@ -71,7 +78,7 @@ namespace k3::graphics {
 
             VkBuffer m_vk_buffer = VK_NULL_HANDLE;
 
-            VkDeviceMemory m_vk_memory = VK_NULL_HANDLE;
+            K3Allocation m_allocation{};
 
             VkDeviceSize m_vk_bufferSize;
 
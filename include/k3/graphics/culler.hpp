@@ -0,0 +1,185 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "descriptors.hpp"
+#include "device.hpp"
+#include "frame_allocator.hpp"
+#include "pipeline.hpp"
+#include "swapchain.hpp"
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace k3::graphics {
+
+    // Per object input of the cull pass, std430 compatible. Object i owns instance i.
+    struct K3CullObject {
+        // World space bounding sphere, radius in w.
+        glm::vec4 sphere{0.f};
+        // Draw list commands the object's instances are counted into, none for objects drawn
+        // directly, which pass through untested.
+        uint32_t firstCommand = 0;
+        uint32_t commandCount = 0;
+        uint32_t pad0 = 0;
+        uint32_t pad1 = 0;
+    };
+
+    struct K3CullStatistics {
+        uint32_t visible = 0;
+        uint32_t frustumCulled = 0;
+        uint32_t occlusionCulled = 0;
+    };
+
+    /**
+     * GPU visibility for draw list instances. A compute pass tests each object's bounding
+     * sphere against the frustum planes of the camera and, once a frame has been drawn, against
+     * a Hi-Z pyramid of that frame's depth. Survivors are compacted into the instance slices of
+     * their draw commands, whose instance counts the pass fills in. Counts of the results come
+     * back through a host visible buffer once the frame's fence has been waited on, so reading
+     * them never stalls.
+     *
+     * Occlusion uses the current camera against the previous frame's depth, so objects moving
+     * out from behind an occluder can show a frame late.
+     */
+    class K3Culler {
+
+        public:
+
+            static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+            static constexpr uint32_t HIZ_WORKGROUP_SIZE = 8;
+
+            K3Culler(std::shared_ptr<K3Device> device);
+
+            // The device must be idle.
+            ~K3Culler();
+
+            K3Culler(const K3Culler &) = delete;
+            K3Culler &operator=(const K3Culler &) = delete;
+
+            // Rebuilds the Hi-Z pyramid from depthImage, outside a render pass. The image is
+            // expected in DEPTH_STENCIL_ATTACHMENT_OPTIMAL and is left there.
+            void buildHiZ(VkCommandBuffer commandBuffer, int frameIndex, VkImage depthImage, VkImageView depthImageView, VkExtent2D extent);
+
+            // Records the cull pass outside a render pass. Reads objectCount objects and
+            // instances, writes the visible ones to visibleInstances and their counts into
+            // commands, which must start at zero instances. False when the frame is out of memory
+            // and nothing was recorded, leaving the commands as they were.
+            bool cull(VkCommandBuffer commandBuffer, int frameIndex, K3FrameAllocator &frameAllocator, const glm::mat4 &projectionView,
+                const K3FrameAllocation &objects, const K3FrameAllocation &instances, const K3FrameAllocation &visibleInstances,
+                const K3FrameAllocation &commands, uint32_t objectCount);
+
+            // Frustum planes (xyz normal pointing inwards, w distance) of a projection * view matrix.
+            static std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4 &projectionView);
+
+            void setOcclusion(bool occlusion) { m_occlusion = occlusion; }
+
+            bool isOcclusion() const { return m_occlusion; }
+
+            // Results of the most recent frame that has finished on the GPU.
+            const K3CullStatistics &getStatistics() const { return m_statistics; }
+
+        private:
+
+            // Matches CullParams in cull.comp, std140.
+            struct K3CullParams {
+                glm::mat4 projectionView{1.f};
+                glm::vec4 planes[6]{};
+                glm::vec2 hizSize{0.f};
+                uint32_t objectCount = 0;
+                uint32_t occlusion = 0;
+                uint32_t hizLevels = 0;
+                uint32_t pad[3]{};
+            };
+
+            struct K3HiZPush {
+                glm::ivec2 sourceSize{0};
+                glm::ivec2 destinationSize{0};
+                uint32_t copy = 0;
+            };
+
+            // Releases everything created so far, safe on a partly constructed culler.
+            void destroy();
+
+            void createPipelines();
+
+            void createStatisticsBuffer();
+
+            // (Re)creates the pyramid for extent, waiting for the device when one exists.
+            void createHiZ(VkExtent2D extent);
+
+            void destroyHiZ();
+
+            std::shared_ptr<K3Device> m_device = nullptr;
+
+            std::unique_ptr<K3DescriptorSetLayout> m_cullSetLayout = nullptr;
+
+            std::unique_ptr<K3DescriptorSetLayout> m_hizSetLayout = nullptr;
+
+            std::unique_ptr<K3DescriptorPool> m_cullPool = nullptr;
+
+            std::unique_ptr<K3DescriptorPool> m_hizPool = nullptr;
+
+            VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+
+            VkPipelineLayout m_hizPipelineLayout = VK_NULL_HANDLE;
+
+            std::unique_ptr<K3Pipeline> m_cullPipeline = nullptr;
+
+            std::unique_ptr<K3Pipeline> m_hizPipeline = nullptr;
+
+            // One per frame in flight, rewritten as the frame is recorded.
+            std::vector<VkDescriptorSet> m_cullSets{};
+
+            VkSampler m_sampler = VK_NULL_HANDLE;
+
+            VkImage m_hizImage = VK_NULL_HANDLE;
+
+            K3Allocation m_hizAllocation{};
+
+            // Whole pyramid, sampled by the cull pass.
+            VkImageView m_hizView = VK_NULL_HANDLE;
+
+            // One per level, written by the build and read for the next level.
+            std::vector<VkImageView> m_hizLevelViews{};
+
+            // Level 0 reads the frame's depth image, so one per frame in flight.
+            std::vector<VkDescriptorSet> m_hizDepthSets{};
+
+            // Level i reads level i - 1, index 0 unused.
+            std::vector<VkDescriptorSet> m_hizLevelSets{};
+
+            VkExtent2D m_hizExtent{0, 0};
+
+            // Laid out GENERAL, which it never leaves.
+            bool m_hizInitialized = false;
+
+            // Holds the depth of a drawn frame.
+            bool m_hizValid = false;
+
+            bool m_occlusion = true;
+
+            VkBuffer m_statisticsBuffer = VK_NULL_HANDLE;
+
+            K3Allocation m_statisticsAllocation{};
+
+            // Statistics slots are storage buffer offsets, so aligned.
+            VkDeviceSize m_statisticsStride = 0;
+
+            // Slots holding a submitted frame's results.
+            std::array<bool, K3SwapChain::MAX_FRAMES_IN_FLIGHT> m_statisticsPending{};
+
+            K3CullStatistics m_statistics{};
+
+    };
+
+}
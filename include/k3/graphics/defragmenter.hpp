@@ -0,0 +1,88 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "device.hpp"
+#include "swapchain.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+namespace k3::graphics {
+
+    /**
+     * Incrementally empties sparse memory blocks into dense ones so long sessions of loading and
+     * unloading models keep large free ranges. Each frame it copies up to the frame budget of
+     * relocatable buffers (see K3MemoryAllocator::setRelocatable) on the graphics queue, hands
+     * the copies to their owners, and destroys the originals once the frames that may still read
+     * them have finished. Blocks it empties are given back to Vulkan.
+     *
+     * Ranges inside the K3GeometryPool are out of scope: the pool's buffers are not relocatable
+     * and its TLSF ranges are never compacted, holes are only reused by later allocations.
+     * Pooled models therefore register just their meshlet buffers.
+     */
+    class K3Defragmenter {
+
+        public:
+
+            // A few MB copies in well under a millisecond on anything with dedicated VRAM.
+            static constexpr VkDeviceSize FRAME_BUDGET = 4ull << 20;
+
+            // Frames to wait after a block could not be emptied before trying again.
+            static constexpr uint32_t RETRY_FRAMES = 120;
+
+            K3Defragmenter(std::shared_ptr<K3Device> device, VkDeviceSize frameBudget = FRAME_BUDGET);
+
+            // The device must be idle.
+            ~K3Defragmenter();
+
+            K3Defragmenter(const K3Defragmenter &) = delete;
+            K3Defragmenter &operator=(const K3Defragmenter &) = delete;
+
+            // Records this frame's moves into commandBuffer, outside a render pass and before
+            // anything draws. Call once per frame after the frame's fence has been waited on.
+            void update(VkCommandBuffer commandBuffer);
+
+            // Bytes copied per frame at most, 0 pauses defragmentation. Buffers larger than the
+            // budget are never moved.
+            void setFrameBudget(VkDeviceSize bytes) { m_frameBudget = bytes; }
+
+            VkDeviceSize getFrameBudget() const { return m_frameBudget; }
+
+            uint64_t getMovedBytes() const { return m_movedBytes; }
+
+            uint32_t getMoveCount() const { return m_moveCount; }
+
+            // Old buffers waiting for their frames to finish.
+            size_t getRetiredCount() const { return m_retired.size(); }
+
+        private:
+
+            struct K3RetiredBuffer {
+                VkBuffer buffer = VK_NULL_HANDLE;
+                K3Allocation allocation{};
+                uint64_t frame = 0;
+            };
+
+            void releaseRetired(uint64_t frame);
+
+            std::shared_ptr<K3Device> m_device = nullptr;
+
+            VkDeviceSize m_frameBudget = FRAME_BUDGET;
+
+            uint64_t m_frame = 0;
+
+            uint64_t m_retryFrame = 0;
+
+            uint64_t m_movedBytes = 0;
+
+            uint32_t m_moveCount = 0;
+
+            std::deque<K3RetiredBuffer> m_retired{};
+
+    };
+
+}
@@ -3,10 +3,20 @@
 #include "k3/logging/log.hpp"
 
 #include "window.hpp"
+#include "host_allocator.hpp"
+#include "memory_allocator.hpp"
+#include "staging_ring.hpp"
+#include "geometry_pool.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -21,11 +31,32 @@ namespace k3::graphics {
     struct QueueFamilyIndices {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        // A family with transfer but no graphics, set only when the device has one.
+        uint32_t transferFamily;
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
+        bool transferFamilyHasValue = false;
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    // One memory heap as of the last K3Device::updateMemoryBudget.
+    struct K3HeapBudget {
+        VkDeviceSize size = 0;
+        // What the process may use, and uses, of the heap. Estimated from our own allocations
+        // without VK_EXT_memory_budget.
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0;
+        // VkDeviceMemory allocated by the engine, see K3MemoryAllocator::getHeapBytes.
+        VkDeviceSize engineBytes = 0;
+        bool deviceLocal = false;
+        // Usage above K3Device::BUDGET_WARNING_RATIO of budget.
+        bool pressured = false;
+    };
+
+    // Where static geometry is placed. STAGED copies into DEVICE_LOCAL memory through the staging
+    // ring, DIRECT writes straight into memory that is both DEVICE_LOCAL and HOST_VISIBLE.
+    enum class K3GeometryPlacement { STAGED, DIRECT };
+
     class K3Device {
     
         public:
@@ -36,7 +67,14 @@ namespace k3::graphics {
             const bool enableValidationLayers = false;
 #endif
 
-            K3Device(std::shared_ptr<K3Window> window);
+            // Past this share of a heap's budget the device warns and asks caches to evict.
+            static constexpr double BUDGET_WARNING_RATIO = 0.9;
+
+            // geometryPlacement overrides the automatic choice, e.g. to exercise both paths on one
+            // device. It is fixed for the device's lifetime because the geometry pool takes its
+            // memory type from the first allocation. A null window makes a headless device with no
+            // surface, swap chain extension or present queue, which only renders offscreen.
+            K3Device(std::shared_ptr<K3Window> window, std::optional<K3GeometryPlacement> geometryPlacement = std::nullopt);
 
             ~K3Device();
 
@@ -52,6 +90,10 @@ namespace k3::graphics {
                 return m_surface; 
             }
 
+            bool isHeadless() const {
+                return m_window == nullptr;
+            }
+
             uint32_t getGraphicsFamily() {
                 return m_graphicsFamily;
             }
@@ -63,6 +105,19 @@ namespace k3::graphics {
             VkQueue presentQueue() { 
                 return m_presentQueue; 
             }
+
+            // The dedicated transfer queue, or the graphics queue when the device has none.
+            uint32_t getTransferFamily() {
+                return m_transferFamily;
+            }
+
+            VkQueue getTransferQueue() {
+                return m_transferQueue;
+            }
+
+            bool hasDedicatedTransferQueue() {
+                return m_transferFamily != m_graphicsFamily;
+            }
             
             VkDescriptorPool getDescriptorPool() { 
                 return m_descriptorPool; 
@@ -72,6 +127,11 @@ namespace k3::graphics {
                 return m_commandPool; 
             }
 
+            // Held around every vkQueueSubmit and vkQueuePresentKHR, queues may be fed from loader threads.
+            std::mutex &getQueueMutex() {
+                return m_queueMutex;
+            }
+
             VkPhysicalDevice getPhysicalDevice() {
                 return m_physicalDevice;
             }
@@ -86,18 +146,90 @@ namespace k3::graphics {
 
             VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-            void createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory);
+            // Buffers and images are placed in memory sub-allocated by getAllocator().
+            void createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, K3Allocation &imageAllocation,
+                K3MemoryCategory category = K3MemoryCategory::OTHER);
+
+            void destroyImage(VkImage &image, K3Allocation &imageAllocation);
 
             uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
-            void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+            void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, K3Allocation &bufferAllocation,
+                K3MemoryCategory category = K3MemoryCategory::OTHER);
+
+            void destroyBuffer(VkBuffer &buffer, K3Allocation &bufferAllocation);
+
+            K3MemoryAllocator &getAllocator() {
+                return *m_allocator;
+            }
+
+            // Host allocation callbacks for every vkCreate and vkDestroy, pass the type of the
+            // object so its allocations are attributed to it.
+            const VkAllocationCallbacks *getAllocationCallbacks(VkObjectType objectType) {
+                return m_hostAllocator->getCallbacks(objectType);
+            }
+
+            K3HostAllocator &getHostAllocator() {
+                return *m_hostAllocator;
+            }
+
+            // Samples every heap's usage and budget, call once per frame from the render thread.
+            void updateMemoryBudget();
+
+            const std::vector<K3HeapBudget> &getHeapBudgets() const {
+                return m_heapBudgets;
+            }
+
+            bool hasMemoryBudgetExtension() const {
+                return m_hasMemoryBudget;
+            }
+
+            // Indirect draws may carry a firstInstance, and several may go in one call.
+            bool hasMultiDrawIndirect() const {
+                return m_hasMultiDrawIndirect;
+            }
+
+            // vkCmdDrawIndexedIndirectCount is usable (core since 1.2, optional feature).
+            bool hasDrawIndirectCount() const {
+                return m_hasDrawIndirectCount;
+            }
+
+            // Bytes the most pressured DEVICE_LOCAL heap is over BUDGET_WARNING_RATIO of its
+            // budget, 0 when none is. Caches free at least this much.
+            VkDeviceSize getBudgetExcess() const {
+                return m_budgetExcess.load();
+            }
 
+            // Safe to call from any thread. Threads other than the one that created the device
+            // record into their own command pool.
             VkCommandBuffer beginSingleTimeCommands();
 
             void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
             void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
+            // Stages data through the staging ring into dstBuffer, see K3StagingRing::upload.
+            K3UploadToken uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+            K3StagingRing &getStagingRing() {
+                return *m_stagingRing;
+            }
+
+            // Shared vertex and index buffers models are sub-allocated from.
+            K3GeometryPool &getGeometryPool() {
+                return *m_geometryPool;
+            }
+
+            // DIRECT on UMA devices and with resizable BAR, STAGED otherwise. See selectGeometryPlacement.
+            K3GeometryPlacement getGeometryPlacement() const {
+                return m_geometryPlacement;
+            }
+
+            // Memory properties of vertex, index and storage buffers under the current placement.
+            VkMemoryPropertyFlags getGeometryMemoryProperties() const {
+                return m_geometryPlacement == K3GeometryPlacement::DIRECT ? m_directGeometryProperties : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            }
+
             void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
             VkPhysicalDeviceProperties m_vk_properties;
@@ -122,6 +254,8 @@ namespace k3::graphics {
 
             void createLogicalDevice(std::vector<std::string> &requestPhysicalExtensions);
 
+            void selectGeometryPlacement(std::optional<K3GeometryPlacement> requested);
+
             SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
             
             QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
@@ -130,8 +264,15 @@ namespace k3::graphics {
 
             void createCommandPool();
 
+            VkCommandPool createCommandPool(VkCommandPoolCreateFlags flags);
+
+            VkCommandPool getThreadCommandPool();
+
             std::shared_ptr<K3Window> m_window = nullptr;
 
+            // Declared first so it outlives every object created with its callbacks.
+            std::unique_ptr<K3HostAllocator> m_hostAllocator = std::make_unique<K3HostAllocator>();
+
             VkInstance m_instance = nullptr; 
 
             VkDebugUtilsMessengerEXT m_debugMessenger = nullptr;
@@ -146,6 +287,35 @@ namespace k3::graphics {
 
             VkCommandPool m_commandPool = nullptr;
 
+            std::unique_ptr<K3MemoryAllocator> m_allocator = nullptr;
+
+            std::unique_ptr<K3StagingRing> m_stagingRing = nullptr;
+
+            std::unique_ptr<K3GeometryPool> m_geometryPool = nullptr;
+
+            K3GeometryPlacement m_geometryPlacement = K3GeometryPlacement::STAGED;
+
+            bool m_hasMemoryBudget = false;
+
+            bool m_hasMultiDrawIndirect = false;
+
+            bool m_hasDrawIndirectCount = false;
+
+            std::vector<K3HeapBudget> m_heapBudgets{};
+
+            std::atomic<VkDeviceSize> m_budgetExcess{0};
+
+            // 0 when the device has no memory type that is both DEVICE_LOCAL and HOST_VISIBLE.
+            VkMemoryPropertyFlags m_directGeometryProperties = 0;
+
+            std::thread::id m_ownerThread = std::this_thread::get_id();
+
+            std::unordered_map<std::thread::id, VkCommandPool> m_threadCommandPools{};
+
+            std::mutex m_threadCommandPoolMutex;
+
+            std::mutex m_queueMutex;
+
             uint32_t m_graphicsFamily = (uint32_t) -1;
 
             VkQueue m_graphicsQueue = nullptr;
@@ -154,6 +324,10 @@ namespace k3::graphics {
         
             VkQueue m_presentQueue = nullptr;
 
+            uint32_t m_transferFamily = (uint32_t) -1;
+
+            VkQueue m_transferQueue = nullptr;
+
             const std::vector<const char *> m_validationLayers = {"VK_LAYER_KHRONOS_validation"};
     };
 
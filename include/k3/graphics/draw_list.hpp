@@ -0,0 +1,88 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "device.hpp"
+#include "frame_allocator.hpp"
+#include "geometry_pool.hpp"
+#include "model.hpp"
+#include "pipeline.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace k3::graphics {
+
+    /**
+     * Draws of pooled, indexed models collected as VkDrawIndexedIndirectCommand records and
+     * recorded with one indirect call per run of draws sharing a pipeline and index type.
+     * upload writes the commands, then the draw counts, into the frame allocator before the
+     * render pass, where a compute pass may still fill in their instance counts; with
+     * drawIndirectCount the counts are read from there too. Devices without multiDrawIndirect,
+     * or frames out of memory, get the same draws recorded one by one.
+     */
+    class K3DrawList {
+
+        public:
+
+            K3DrawList(std::shared_ptr<K3Device> device);
+
+            K3DrawList(const K3DrawList &) = delete;
+            K3DrawList &operator=(const K3DrawList &) = delete;
+
+            void clear();
+
+            // Appends model's draws at lod for instances firstInstance to firstInstance +
+            // instanceCount. The model must be pooled and indexed. Returns the index of the first
+            // command appended, the rest follow it up to getCommandCount.
+            uint32_t add(K3Pipeline &pipeline, const K3Model &model, uint32_t lod, uint32_t instanceCount, uint32_t firstInstance);
+
+            // Writes the commands to frame memory, with zero instances when clearInstanceCounts is
+            // set for a compute pass to count them. False when they will be recorded directly.
+            bool upload(K3FrameAllocator &frameAllocator, bool clearInstanceCounts = false);
+
+            // The uploaded commands, an array of VkDrawIndexedIndirectCommand.
+            const K3FrameAllocation &getCommandAllocation() const { return m_commandAllocation; }
+
+            // Records everything added since clear, binding the pipelines and the geometry pool.
+            // Returns the number of draw calls recorded.
+            uint32_t record(VkCommandBuffer commandBuffer, K3GeometryPool &geometryPool);
+
+            bool isEmpty() const { return m_commands.empty(); }
+
+            uint32_t getCommandCount() const { return static_cast<uint32_t>(m_commands.size()); }
+
+            uint32_t getBatchCount() const { return static_cast<uint32_t>(m_batches.size()); }
+
+        private:
+
+            // Consecutive commands recorded by a single indirect call.
+            struct K3DrawBatch {
+                K3Pipeline *pipeline = nullptr;
+                VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+                uint32_t firstCommand = 0;
+                uint32_t commandCount = 0;
+            };
+
+            uint32_t recordDirect(VkCommandBuffer commandBuffer, K3GeometryPool &geometryPool);
+
+            std::shared_ptr<K3Device> m_device = nullptr;
+
+            // Draws one indirect call may carry, 1 without multiDrawIndirect.
+            uint32_t m_maxBatchSize = 1;
+
+            std::vector<VkDrawIndexedIndirectCommand> m_commands{};
+
+            std::vector<K3DrawBatch> m_batches{};
+
+            K3FrameAllocation m_commandAllocation{};
+
+            // The batches' draw counts, following the commands.
+            VkDeviceSize m_countOffset = 0;
+
+    };
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "device.hpp"
+#include "swapchain.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace k3::graphics {
+
+    /**
+     * Transient memory handed out by K3FrameAllocator, valid until the same frame index comes
+     * round again. mapped is null when the device ran out of memory.
+     */
+    struct K3FrameAllocation {
+        void *mapped = nullptr;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+
+        VkDescriptorBufferInfo descriptorInfo() const { return {buffer, offset, size}; }
+    };
+
+    /**
+     * Bump allocator for per-frame uniform, storage and indirect draw data. Each frame in flight
+     * owns persistently mapped blocks; the renderer resets a frame's blocks when the frame
+     * begins, by which point the fence of their previous use has been waited on, and flushes
+     * what was written before submitting. A frame that outgrows its block chains a larger one
+     * rather than failing, and the chain is merged into a single block the next time that frame
+     * begins, so the memory settles at what the scene needs.
+     */
+    class K3FrameAllocator {
+
+        public:
+
+            // Initial block size of each frame.
+            static constexpr VkDeviceSize FRAME_SIZE = 4ull << 20;
+
+            K3FrameAllocator(std::shared_ptr<K3Device> device, VkDeviceSize frameSize = FRAME_SIZE, uint32_t frameCount = K3SwapChain::MAX_FRAMES_IN_FLIGHT);
+
+            ~K3FrameAllocator();
+
+            K3FrameAllocator(const K3FrameAllocator &) = delete;
+            K3FrameAllocator &operator=(const K3FrameAllocator &) = delete;
+
+            // Starts handing out frameIndex's memory from its beginning.
+            void beginFrame(uint32_t frameIndex);
+
+            // alignment of 0 uses the larger of the uniform and storage buffer offset alignments.
+            // Safe to call from any thread while recording.
+            K3FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+            // Copies data into a fresh allocation.
+            K3FrameAllocation push(const void *data, VkDeviceSize size, VkDeviceSize alignment = 0);
+
+            // Flushes everything allocated in the current frame, a no-op on coherent memory.
+            void flush();
+
+            // Capacity of the current frame's blocks.
+            VkDeviceSize getFrameSize() const;
+
+            // Bytes used by the current frame and the most any frame has used.
+            VkDeviceSize getUsedBytes() const;
+
+            VkDeviceSize getPeakBytes() const;
+
+        private:
+
+            struct K3FrameBlock {
+                VkBuffer buffer = VK_NULL_HANDLE;
+                K3Allocation allocation{};
+                VkDeviceSize size = 0;
+                VkDeviceSize head = 0;
+                bool coherent = false;
+            };
+
+            // Throws when the device is out of memory.
+            K3FrameBlock createBlock(VkDeviceSize size);
+
+            void destroyBlock(K3FrameBlock &block);
+
+            std::shared_ptr<K3Device> m_device = nullptr;
+
+            uint32_t m_frameCount = 0;
+
+            VkDeviceSize m_defaultAlignment = 1;
+
+            // Blocks are whole multiples of this, so flushes never spill into another block's atoms.
+            VkDeviceSize m_granularity = 1;
+
+            // Per frame, allocations come from the last block.
+            std::vector<std::vector<K3FrameBlock>> m_frames{};
+
+            uint32_t m_frameIndex = 0;
+
+            VkDeviceSize m_peak = 0;
+
+            // Kept between flushes to reuse the allocation.
+            std::vector<VkMappedMemoryRange> m_flushRanges{};
+
+            mutable std::mutex m_mutex;
+
+    };
+
+}
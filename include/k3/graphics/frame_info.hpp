@@ -3,6 +3,7 @@
 #include "k3/logging/log.hpp"
 
 #include "camera.hpp"
+#include "frame_allocator.hpp"
 
 #include <vulkan/vulkan.h>
 
@@ -13,6 +14,11 @@ namespace k3::graphics {
         float frameTime;
         VkCommandBuffer commandBuffer;
         k3::graphics::K3Camera &camera;
+        VkExtent2D extent;
+        K3FrameAllocator &frameAllocator;
+        // Depth of the frame drawn before this one, VK_NULL_HANDLE after a swap chain rebuild.
+        VkImage previousDepthImage;
+        VkImageView previousDepthImageView;
     };
 
 }
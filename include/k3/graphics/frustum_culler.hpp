@@ -0,0 +1,62 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace k3::graphics {
+
+    /**
+     * CPU frustum test for world space bounding spheres. Spheres are kept as separate x, y, z
+     * and radius arrays padded to LANES, so each plane is tested against LANES spheres per
+     * iteration with AVX, SSE2 or NEON, whichever the build targets, and one at a time
+     * otherwise. Every path does the same multiplies and adds in the same order as
+     * isVisible, so they agree exactly. The file is built with -ffp-contract=off, so the compiler
+     * doesn't fuse them into FMAs either.
+     */
+    class K3FrustumCuller {
+
+        public:
+
+#if defined(__AVX__)
+            static constexpr uint32_t LANES = 8;
+#else
+            static constexpr uint32_t LANES = 4;
+#endif
+
+            void clear();
+
+            // Appends a sphere, radius in w, returning its index.
+            uint32_t add(const glm::vec4 &sphere);
+
+            uint32_t size() const { return m_count; }
+
+            // Tests every sphere added since clear against the frustum of projectionView, setting
+            // visibility[i] to 1 for the spheres at least partly inside and 0 for the rest.
+            // Returns the number visible.
+            uint32_t cull(const glm::mat4 &projectionView, std::vector<uint8_t> &visibility) const;
+
+            // Scalar reference for one sphere against planes from K3Culler::extractFrustumPlanes.
+            static bool isVisible(const std::array<glm::vec4, 6> &planes, const glm::vec4 &sphere);
+
+        private:
+
+            std::vector<float> m_x{};
+
+            std::vector<float> m_y{};
+
+            std::vector<float> m_z{};
+
+            std::vector<float> m_radius{};
+
+            uint32_t m_count = 0;
+
+    };
+
+}
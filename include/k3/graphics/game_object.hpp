@@ -3,6 +3,7 @@
 #include "k3/logging/log.hpp"
 
 #include "model.hpp"
+#include "model_loader.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -55,7 +56,8 @@ namespace k3::graphics {
 
             
 
-            std::shared_ptr<K3Model> model;
+            // May still be loading, the render systems skip it until it resolves.
+            K3ModelHandle model;
 
             glm::vec3 color{};
 
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "memory_allocator.hpp"
+#include "tlsf_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace k3::graphics {
+
+    class K3Device;
+    class K3UploadBatch;
+
+    /**
+     * Where a model's geometry sits in the K3GeometryPool. vertexOffset and firstIndex are in
+     * units of the model's vertex stride and index type, ready to add to the draw parameters; a
+     * default range adds nothing, for models with their own buffers.
+     */
+    struct K3GeometryRange {
+        int32_t vertexOffset = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        VkDeviceSize vertexByteOffset = 0;
+        VkDeviceSize vertexBytes = 0;
+        VkDeviceSize indexByteOffset = 0;
+        VkDeviceSize indexBytes = 0;
+        // Offsets handed out by the pools' allocators, to free them again.
+        uint64_t vertexAllocation = K3TlsfAllocator::INVALID_OFFSET;
+        uint64_t indexAllocation = K3TlsfAllocator::INVALID_OFFSET;
+
+        bool isValid() const { return vertexAllocation != K3TlsfAllocator::INVALID_OFFSET; }
+    };
+
+    /**
+     * One vertex buffer and one index buffer shared by every model, so render systems bind them
+     * once and draw with offsets. Ranges are sub-allocated with the TLSF allocator and reused
+     * once freed. Vertex formats of any stride share the vertex buffer, each range starting on
+     * a multiple of its stride; 16 and 32 bit indices share the index buffer, which is rebound
+     * only when the index type changes.
+     *
+     * The buffers are created on first use with the device's geometry placement at that time.
+     * They are not registered with K3MemoryAllocator::setRelocatable and ranges are never moved,
+     * so K3Defragmenter does not compact the pool.
+     */
+    class K3GeometryPool {
+
+        public:
+
+            static constexpr VkDeviceSize VERTEX_POOL_SIZE = 64ull << 20;
+
+            static constexpr VkDeviceSize INDEX_POOL_SIZE = 32ull << 20;
+
+            K3GeometryPool(K3Device &device, VkDeviceSize vertexPoolSize = VERTEX_POOL_SIZE, VkDeviceSize indexPoolSize = INDEX_POOL_SIZE);
+
+            // Every range must have been freed and the device be idle.
+            ~K3GeometryPool();
+
+            K3GeometryPool(const K3GeometryPool &) = delete;
+            K3GeometryPool &operator=(const K3GeometryPool &) = delete;
+
+            // Room for vertexCount vertices of stride bytes and indexCount indices of indexSize
+            // bytes. Returns an invalid range when either buffer is full. Safe from any thread.
+            K3GeometryRange allocate(uint32_t stride, uint32_t vertexCount, uint32_t indexSize, uint32_t indexCount);
+
+            // The range is reused once the frames in flight that may draw from it are done.
+            void free(K3GeometryRange &range);
+
+            // Copies in place when the buffers are host visible, records into batch otherwise.
+            void write(K3UploadBatch &batch, const K3GeometryRange &range, const void *vertices, const void *indices);
+
+            // Makes ranges freed MAX_FRAMES_IN_FLIGHT frames ago available, once per frame.
+            void beginFrame();
+
+            void bindVertexBuffer(VkCommandBuffer commandBuffer);
+
+            void bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType);
+
+            VkBuffer getVertexBuffer() const { return m_vertexBuffer; }
+
+            VkBuffer getIndexBuffer() const { return m_indexBuffer; }
+
+            VkDeviceSize getVertexUsedBytes() const;
+
+            VkDeviceSize getIndexUsedBytes() const;
+
+            VkDeviceSize getVertexPoolSize() const { return m_vertexPoolSize; }
+
+            VkDeviceSize getIndexPoolSize() const { return m_indexPoolSize; }
+
+        private:
+
+            struct K3RetiredRange {
+                uint64_t vertexAllocation = K3TlsfAllocator::INVALID_OFFSET;
+                uint64_t indexAllocation = K3TlsfAllocator::INVALID_OFFSET;
+                uint64_t frame = 0;
+            };
+
+            // Creates the buffers, m_mutex held.
+            void create();
+
+            K3Device &m_device;
+
+            VkDeviceSize m_vertexPoolSize = 0;
+
+            VkDeviceSize m_indexPoolSize = 0;
+
+            VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+
+            K3Allocation m_vertexAllocation{};
+
+            VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+
+            K3Allocation m_indexAllocation{};
+
+            // Both buffers mapped, written with memcpy instead of uploads.
+            bool m_direct = false;
+
+            std::unique_ptr<K3TlsfAllocator> m_vertexRanges = nullptr;
+
+            std::unique_ptr<K3TlsfAllocator> m_indexRanges = nullptr;
+
+            uint64_t m_frame = 0;
+
+            std::deque<K3RetiredRange> m_retired{};
+
+            mutable std::mutex m_mutex;
+
+    };
+
+}
@@ -19,6 +19,7 @@
 #include "renderer.hpp"
 #include "pipeline.hpp"
 #include "model.hpp"
+#include "upload_batch.hpp"
 #include "simple_render_system.hpp"
 #include "camera.hpp"
 #include "game_object.hpp"
@@ -29,6 +30,7 @@
 #include <glm/gtc/constants.hpp>
 
 #include <cassert>
+#include <optional>
 #include <random>
 
 namespace k3::graphics {
@@ -37,7 +39,7 @@ namespace k3::graphics {
 
         public: 
 
-            K3Graphics(std::shared_ptr<logging::LogManger> logManager, std::shared_ptr<K3Window> window);
+            K3Graphics(std::shared_ptr<logging::LogManger> logManager, std::shared_ptr<K3Window> window, std::optional<K3GeometryPlacement> geometryPlacement = std::nullopt);
 
             ~K3Graphics();
 
@@ -67,6 +69,11 @@ namespace k3::graphics {
 
             std::shared_ptr<K3Renderer> m_renderer = nullptr;
 
+            // Font atlas bytes reported to the allocator as K3MemoryCategory::IMGUI.
+            int64_t m_imguiBytes = 0;
+
+            uint32_t m_imguiHeapIndex = 0;
+
             ImGui_ImplVulkanH_Window g_MainWindowData {};
     };
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace k3::graphics {
+
+    struct K3HostAllocationCounters {
+        // Allocations alive now and their bytes.
+        uint64_t liveCount = 0;
+        uint64_t liveBytes = 0;
+        // Every allocation and reallocation since creation, the churn.
+        uint64_t totalCount = 0;
+        uint64_t totalBytes = 0;
+    };
+
+    struct K3HostAllocationStatistics {
+        std::array<K3HostAllocationCounters, 5> scopes{};
+        // Indexed by VkObjectType for the core object types, the last entry holds the rest.
+        std::array<K3HostAllocationCounters, VK_OBJECT_TYPE_COMMAND_POOL + 2> objectTypes{};
+        // Driver allocations it only notified us about, per scope.
+        std::array<uint64_t, 5> internalBytes{};
+        // Allocations served from the pools rather than malloc.
+        uint64_t pooledCount = 0;
+    };
+
+    /**
+     * VkAllocationCallbacks that count every host allocation the driver makes, by allocation
+     * scope and by the object type the callbacks were fetched for. With POOLED small allocations
+     * are recycled through size class free lists instead of going back to malloc.
+     *
+     * Take the callbacks from K3Device::getAllocationCallbacks for the object being created and
+     * pass the same ones when destroying it.
+     */
+    class K3HostAllocator {
+
+        public:
+
+            static constexpr uint32_t POOLED = 1u << 0;
+
+            // Size classes of the pools, header and alignment padding included.
+            static constexpr std::array<size_t, 6> POOL_CLASS_SIZES = {64, 128, 256, 512, 1024, 2048};
+
+            K3HostAllocator(uint32_t flags = POOLED);
+
+            // Frees the pooled blocks. Every object created with the callbacks must be gone.
+            ~K3HostAllocator();
+
+            K3HostAllocator(const K3HostAllocator &) = delete;
+            K3HostAllocator &operator=(const K3HostAllocator &) = delete;
+
+            const VkAllocationCallbacks *getCallbacks(VkObjectType objectType);
+
+            K3HostAllocationStatistics getStatistics() const;
+
+            // Logs the object types that allocated since before was taken, busiest first.
+            static void logChurn(const char *label, const K3HostAllocationStatistics &before, const K3HostAllocationStatistics &after);
+
+            static const char *getScopeName(uint32_t scope);
+
+            static const char *getObjectTypeName(uint32_t objectTypeIndex);
+
+        private:
+
+            struct K3Counters {
+                std::atomic<uint64_t> liveCount{0};
+                std::atomic<uint64_t> liveBytes{0};
+                std::atomic<uint64_t> totalCount{0};
+                std::atomic<uint64_t> totalBytes{0};
+            };
+
+            struct K3CallbackContext {
+                K3HostAllocator *allocator = nullptr;
+                uint32_t objectTypeIndex = 0;
+            };
+
+            static constexpr uint32_t OBJECT_TYPE_COUNT = VK_OBJECT_TYPE_COMMAND_POOL + 2;
+
+            static constexpr uint32_t NOT_POOLED = ~0u;
+
+            static VKAPI_ATTR void *VKAPI_CALL allocate(void *userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+
+            static VKAPI_ATTR void *VKAPI_CALL reallocate(void *userData, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+
+            static VKAPI_ATTR void VKAPI_CALL free(void *userData, void *memory);
+
+            static VKAPI_ATTR void VKAPI_CALL internalAllocation(void *userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+            static VKAPI_ATTR void VKAPI_CALL internalFree(void *userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+            void *allocate(size_t size, size_t alignment, uint32_t scope, uint32_t objectTypeIndex);
+
+            void release(void *memory);
+
+            void count(K3Counters &counters, int64_t bytes, bool allocated);
+
+            uint32_t m_flags = 0;
+
+            std::array<K3CallbackContext, OBJECT_TYPE_COUNT> m_contexts{};
+
+            std::array<VkAllocationCallbacks, OBJECT_TYPE_COUNT> m_callbacks{};
+
+            std::array<K3Counters, 5> m_scopeCounters{};
+
+            std::array<K3Counters, OBJECT_TYPE_COUNT> m_objectTypeCounters{};
+
+            std::array<std::atomic<uint64_t>, 5> m_internalBytes{};
+
+            std::atomic<uint64_t> m_pooledCount{0};
+
+            // Free blocks per size class.
+            std::array<std::vector<void *>, POOL_CLASS_SIZES.size()> m_pools{};
+
+            std::mutex m_poolMutex;
+
+    };
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace k3::graphics {
+
+    /**
+     * Read-only memory mapping of a whole file. The mapping lives as long as the last
+     * shared reference, so views handed out over its bytes stay valid while it is held.
+     */
+    class K3MappedFile {
+
+        public:
+
+            static std::shared_ptr<K3MappedFile> open(const std::string &filePath);
+
+            ~K3MappedFile();
+
+            K3MappedFile(const K3MappedFile &) = delete;
+            K3MappedFile &operator=(const K3MappedFile &) = delete;
+
+            const char *data() const { return m_data; }
+
+            size_t size() const { return m_size; }
+
+            const std::string &getFilePath() const { return m_filePath; }
+
+        private:
+
+            K3MappedFile(const std::string &filePath);
+
+            bool map();
+
+            std::string m_filePath;
+
+            const char *m_data = nullptr;
+
+            size_t m_size = 0;
+
+#if defined(_WIN32)
+            void *m_fileHandle = nullptr;
+
+            void *m_mappingHandle = nullptr;
+#else
+            int m_fileDescriptor = -1;
+#endif
+    };
+
+}
\ No newline at end of file
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "tlsf_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace k3::graphics {
+
+    struct K3MemoryBlock;
+
+    // What an allocation is for, so memory use can be broken down in the budget overlay.
+    enum class K3MemoryCategory : uint32_t { GEOMETRY, STAGING, UNIFORM, DEPTH, IMGUI, OTHER, COUNT };
+
+    /**
+     * A range of device memory handed out by K3MemoryAllocator. Offsets into memory must be
+     * added to offset, mapped already is.
+     */
+    struct K3Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        // Start of the allocation when its memory type is host visible, otherwise null.
+        void *mapped = nullptr;
+        uint32_t memoryTypeIndex = 0;
+        // Null for dedicated allocations.
+        K3MemoryBlock *block = nullptr;
+        K3MemoryCategory category = K3MemoryCategory::OTHER;
+    };
+
+    // Hands a moved buffer to its owner. buffer is bound to allocation and holds a copy of the
+    // contents once the commands recorded in the current frame have run.
+    using K3RelocationCallback = std::function<void(VkBuffer buffer, const K3Allocation &allocation)>;
+
+    // A buffer the defragmenter may move, see K3MemoryAllocator::setRelocatable.
+    struct K3Relocatable {
+        K3Allocation allocation{};
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize bufferSize = 0;
+        VkBufferUsageFlags usage = 0;
+        K3RelocationCallback callback;
+        // Asked before each move, e.g. whether an upload still owns the buffer. Null is always.
+        std::function<bool()> isMovable;
+    };
+
+    struct K3MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+        uint32_t memoryTypeIndex = 0;
+        // Images and buffers live in separate blocks, which keeps them bufferImageGranularity apart.
+        bool linear = true;
+        K3TlsfAllocator allocator;
+        // Registered relocatable allocations by offset.
+        std::unordered_map<uint64_t, K3Relocatable> relocatables{};
+        // Being emptied by the defragmenter: nothing new is placed here and it is released once empty.
+        bool evacuating = false;
+    };
+
+    struct K3MemoryStatistics {
+        uint32_t blockCount = 0;
+        uint32_t dedicatedCount = 0;
+        uint32_t allocationCount = 0;
+        // Bytes taken from Vulkan in blocks and in dedicated allocations.
+        uint64_t blockBytes = 0;
+        uint64_t dedicatedBytes = 0;
+        // Bytes of the blocks handed out to resources.
+        uint64_t usedBytes = 0;
+        // Free bytes outside each block's largest free region over all free bytes.
+        float fragmentation = 0.f;
+    };
+
+    /**
+     * Sub-allocates buffers and images out of large vkAllocateMemory blocks per memory type, so
+     * the engine stays far below maxMemoryAllocationCount and the driver only sees a handful of
+     * allocations. Resources the driver prefers dedicated, or that would take a large share of
+     * a block, get their own VkDeviceMemory. Host visible blocks stay persistently mapped.
+     */
+    class K3MemoryAllocator {
+
+        public:
+
+            // Capped at an eighth of the heap so small heaps (BAR windows, integrated parts) aren't exhausted by one block.
+            static constexpr VkDeviceSize BLOCK_SIZE = 64ull << 20;
+
+            // Resources above BLOCK_SIZE / DEDICATED_FRACTION get a dedicated allocation.
+            static constexpr VkDeviceSize DEDICATED_FRACTION = 2;
+
+            // Blocks using less than this share are emptied into denser ones by the defragmenter.
+            static constexpr double SPARSE_BLOCK_RATIO = 0.5;
+
+            // hostAllocator is passed to vkAllocateMemory and vkFreeMemory.
+            K3MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *hostAllocator = nullptr);
+
+            ~K3MemoryAllocator();
+
+            K3MemoryAllocator(const K3MemoryAllocator &) = delete;
+            K3MemoryAllocator &operator=(const K3MemoryAllocator &) = delete;
+
+            // Allocates and binds memory for buffer. Throws when no memory type or no memory is available.
+            K3Allocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, K3MemoryCategory category = K3MemoryCategory::OTHER);
+
+            K3Allocation allocateForImage(VkImage image, VkMemoryPropertyFlags properties, K3MemoryCategory category = K3MemoryCategory::OTHER);
+
+            void free(K3Allocation &allocation);
+
+            // Flush and invalidate a range relative to the allocation, widened to nonCoherentAtomSize.
+            VkResult flush(const K3Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+            VkResult invalidate(const K3Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+            // The range flush and invalidate pass to Vulkan, for callers batching several into one call.
+            VkMappedMemoryRange getMappedRange(const K3Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const;
+
+            // Flushes every range with a single vkFlushMappedMemoryRanges.
+            VkResult flush(const std::vector<VkMappedMemoryRange> &mappedRanges);
+
+            uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+            const VkPhysicalDeviceMemoryProperties &getMemoryProperties() const { return m_memoryProperties; }
+
+            K3MemoryStatistics getStatistics() const;
+
+            // Accounts for memory allocated behind the allocator's back, such as by ImGui. bytes is
+            // negative when it is released again.
+            void trackExternal(K3MemoryCategory category, uint32_t heapIndex, int64_t bytes);
+
+            // Bytes handed out to resources of category.
+            uint64_t getCategoryBytes(K3MemoryCategory category) const;
+
+            // Bytes of VkDeviceMemory the engine holds in heapIndex, block slack included.
+            uint64_t getHeapBytes(uint32_t heapIndex) const;
+
+            static const char *getCategoryName(K3MemoryCategory category);
+
+            // Lets the defragmenter move buffer, which must be bound to allocation and have
+            // TRANSFER_SRC and TRANSFER_DST usage. Dedicated allocations are never moved. Freeing
+            // the allocation unregisters it. callback and isMovable run without the allocator's lock
+            // held, so they may call back into it.
+            void setRelocatable(const K3Allocation &allocation, VkBuffer buffer, VkDeviceSize bufferSize, VkBufferUsageFlags usage,
+                K3RelocationCallback callback, std::function<bool()> isMovable = nullptr);
+
+            // Call before destroying a relocatable buffer, no callback runs for it afterwards.
+            void clearRelocatable(const K3Allocation &allocation);
+
+            // Movable allocations of at most maxBytes in total from the sparsest block whose
+            // contents fit into the other non empty blocks of its type. That block is evacuating
+            // until it empties or abortDefragmentation is called.
+            std::vector<K3Relocatable> planDefragmentation(VkDeviceSize maxBytes);
+
+            // Allocates and binds memory for buffer in a non empty, non evacuating block of
+            // source's type, never a new block. Returns an empty allocation when nothing fits.
+            K3Allocation allocateForRelocation(VkBuffer buffer, const K3Allocation &source);
+
+            // Runs the owner's callback with buffer and allocation and moves the registration along.
+            // False when source was freed since it was planned.
+            bool commitRelocation(const K3Allocation &source, VkBuffer buffer, const K3Allocation &allocation);
+
+            // Leaves the evacuating block where it is, it takes new allocations again.
+            void abortDefragmentation();
+
+        private:
+
+            K3Allocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated, VkBuffer buffer, VkImage image,
+                K3MemoryCategory category);
+
+            K3Allocation allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image, K3MemoryCategory category);
+
+            K3Allocation makeAllocation(K3MemoryBlock &block, uint64_t offset, VkDeviceSize size, K3MemoryCategory category);
+
+            VkDeviceSize getAlignment(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex) const;
+
+            K3MemoryBlock *selectEvacuation(VkDeviceSize maxBytes) const;
+
+            VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image);
+
+            void freeMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex);
+
+            VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+
+            bool isHostVisible(uint32_t memoryTypeIndex) const;
+
+            VkDevice m_device = VK_NULL_HANDLE;
+
+            const VkAllocationCallbacks *m_hostAllocator = nullptr;
+
+            VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+
+            VkDeviceSize m_nonCoherentAtomSize = 1;
+
+            std::vector<std::unique_ptr<K3MemoryBlock>> m_blocks{};
+
+            K3MemoryBlock *m_evacuating = nullptr;
+
+            uint32_t m_dedicatedCount = 0;
+
+            uint64_t m_dedicatedBytes = 0;
+
+            std::array<uint64_t, static_cast<size_t>(K3MemoryCategory::COUNT)> m_categoryBytes{};
+
+            std::array<uint64_t, VK_MAX_MEMORY_HEAPS> m_heapBytes{};
+
+            mutable std::mutex m_mutex;
+
+    };
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace k3::graphics {
+
+    /**
+     * On-disk layout of a cached mesh. The header is followed by the packed K3Vertex array
+     * at vertexOffset, the uint32_t index array at indexOffset and lodCount K3MeshLod entries
+     * at lodOffset, always at least the full detail level. When encodedStride is non zero the
+     * output of K3Builder::encode follows at encodedOffset, and indexType records what
+     * K3Builder::buildIndices picked: subMeshCount K3SubMesh entries at subMeshOffset and, for
+     * 16-bit indices, the uint16_t copy at shortIndexOffset. The K3MeshletGenerator output
+     * follows as meshletCount K3Meshlet and K3MeshletBounds entries at meshletOffset and
+     * meshletBoundsOffset, with their vertex and triangle arrays at meshletVertexOffset and
+     * meshletTriangleOffset. Every array starts 16 byte aligned.
+     * Bump VERSION whenever the layout or the processing applied before K3MeshCache::store
+     * changes. flags, formatFlags and indexFlags record the K3Builder::optimizeFlags,
+     * vertexFormatFlags and indexFlags the mesh was processed with.
+     */
+    struct K3MeshCacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexStride;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t flags;
+        uint32_t lodCount;
+        uint32_t formatFlags;
+        uint32_t encodedFormat;
+        uint32_t encodedStride;
+        uint32_t indexFlags;
+        uint32_t indexType;
+        uint32_t subMeshCount;
+        uint32_t meshletCount;
+        uint32_t meshletVertexCount;
+        uint32_t meshletTriangleCount;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t lodOffset;
+        uint64_t encodedOffset;
+        uint64_t shortIndexOffset;
+        uint64_t subMeshOffset;
+        uint64_t meshletOffset;
+        uint64_t meshletBoundsOffset;
+        uint64_t meshletVertexOffset;
+        uint64_t meshletTriangleOffset;
+        float boundsMin[3];
+        float boundsMax[3];
+        float dequantizeOffset[3];
+        float dequantizeScale;
+        float uniformColor[3];
+        uint32_t reserved[3];
+    };
+
+    class K3MeshCache {
+
+        public:
+
+            static constexpr char MAGIC[4] = {'K', '3', 'M', 'C'};
+
+            static constexpr uint32_t VERSION = 6;
+
+            static constexpr const char *EXTENSION = ".k3mesh";
+
+            static std::string getCachePath(const std::string &sourcePath);
+
+            // Maps a valid cache for sourcePath into builder. Returns false if it is missing or stale.
+            static bool load(const std::string &sourcePath, K3Builder &builder);
+
+            // Writes builder next to sourcePath. Failure is logged and otherwise ignored.
+            static bool store(const std::string &sourcePath, const K3Builder &builder);
+
+        private:
+
+            static bool querySource(const std::string &sourcePath, uint64_t &sourceSize, int64_t &sourceTime);
+
+            // Checks every level of detail and sub mesh lies inside the index array and every index,
+            // 32 or 16-bit, inside the vertex array. Meshlets are held to the same.
+            static bool isValidGeometry(const K3MeshCacheHeader &header, const char *data);
+
+    };
+
+}
\ No newline at end of file
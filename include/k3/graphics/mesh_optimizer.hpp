@@ -0,0 +1,50 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace k3::graphics {
+
+    struct K3VertexCacheStatistics {
+        // Vertex shader invocations per triangle.
+        float acmr = 0.f;
+        // Vertex shader invocations per referenced vertex.
+        float atvr = 0.f;
+        uint32_t vertexTransforms = 0;
+    };
+
+    /**
+     * CPU only, deterministic index and vertex reordering run on K3Builder output before the
+     * mesh is cached and uploaded.
+     */
+    class K3MeshOptimizer {
+
+        public:
+
+            // FIFO size used both as the Tipsify target and for the ACMR/ATVR simulation.
+            static constexpr uint32_t CACHE_SIZE = 16;
+
+            // Reorders triangles for post-transform cache reuse (Sander et al. "Tipsify").
+            // If clusters is given it receives the first index of every run that starts after a
+            // cache reset, which optimizeOverdraw uses as its sortable units.
+            static void optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount, std::vector<uint32_t> *clusters = nullptr);
+
+            // Sorts the clusters from optimizeVertexCache so outward facing ones draw first. Clusters
+            // are split further as long as ACMR stays within threshold of the cache optimized order.
+            static void optimizeOverdraw(std::vector<uint32_t> &indices, const K3Vertex *vertices, uint32_t vertexCount, const std::vector<uint32_t> &clusters, float threshold = 1.05f);
+
+            // Renumbers vertices in first use order and drops unreferenced ones. Returns the new count.
+            static uint32_t optimizeVertexFetch(std::vector<K3Vertex> &vertices, std::vector<uint32_t> &indices);
+
+            static K3VertexCacheStatistics analyzeVertexCache(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+            // Runs the passes selected by builder.optimizeFlags and logs ACMR/ATVR before and after.
+            static void optimize(K3Builder &builder);
+
+    };
+
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace k3::graphics {
+
+    /**
+     * Quadric error edge collapse simplification (Garland & Heckbert) run on K3Builder output.
+     * Vertices only ever collapse onto other existing vertices, so every level indexes the
+     * original vertex buffer and a LOD chain is nothing more than extra index ranges.
+     */
+    class K3MeshSimplifier {
+
+        public:
+
+            // Levels in a chain, including the full mesh.
+            static constexpr uint32_t LOD_COUNT = 4;
+
+            // Triangle ratio between consecutive levels, giving 100/50/25/12%.
+            static constexpr float LOD_RATIO = 0.5f;
+
+            // Meshes below this many triangles are cheap enough to keep a single level.
+            static constexpr uint32_t MIN_LOD_TRIANGLES = 256;
+
+            // Weight of the normal, uv and color difference of a collapse relative to the mesh extent.
+            static constexpr float ATTRIBUTE_WEIGHT = 0.05f;
+
+            // Writes a simplified copy of indices to destination, stopping at targetIndexCount or when
+            // no more collapses are possible. Open borders and attribute seams are locked in place.
+            // Returns the geometric model space error of the result, attributes only steer the order.
+            static float simplify(const K3Vertex *vertices, uint32_t vertexCount, const uint32_t *indices, size_t indexCount, size_t targetIndexCount, std::vector<uint32_t> &destination);
+
+            // Appends up to LOD_COUNT - 1 simplified levels after builder.indices and fills builder.lods.
+            static void generateLods(K3Builder &builder);
+
+    };
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace k3::graphics {
+
+    struct K3MeshletStatistics {
+        uint32_t meshletCount = 0;
+        float averageVertices = 0.f;
+        float averageTriangles = 0.f;
+        // Fraction of meshlets whose normal cone can ever reject them.
+        float conableRatio = 0.f;
+    };
+
+    /**
+     * CPU only clustering of K3Builder output into meshlets with culling bounds. The generator
+     * and the bounds are plain functions over vertex and index arrays so they can be checked
+     * without a device.
+     */
+    class K3MeshletGenerator {
+
+        public:
+
+            static constexpr uint32_t MAX_VERTICES = 64;
+
+            static constexpr uint32_t MAX_TRIANGLES = 124;
+
+            // Greedily grows each meshlet over shared vertices, preferring triangles that add the
+            // fewest new vertices and sit closest to the meshlet, then falls back to index order.
+            static void build(const K3Vertex *vertices, uint32_t vertexCount, const uint32_t *indices, size_t indexCount,
+                std::vector<K3Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles);
+
+            // Bounding sphere (Ritter) of the meshlet vertices and the normal cone of its triangles.
+            // Cones wider than a hemisphere get a cutoff of 1 and are never back face culled.
+            static K3MeshletBounds computeBounds(const K3Vertex *vertices, const K3Meshlet &meshlet, const uint32_t *meshletVertices, const uint8_t *meshletTriangles);
+
+            static K3MeshletStatistics analyze(const std::vector<K3Meshlet> &meshlets, const std::vector<K3MeshletBounds> &bounds);
+
+            // Builds meshlets for the first LOD of builder and logs their statistics.
+            static void generate(K3Builder &builder);
+
+    };
+
+}
@@ -5,6 +5,7 @@
 #include "vertex.hpp"
 #include "device.hpp"
 #include "buffer.hpp"
+#include "upload_batch.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -16,21 +17,103 @@ namespace k3::graphics {
 
         public:
 
-            K3Model(std::shared_ptr<K3Device> device, const K3Builder &builder);
+            // The builder is only copied in when keepBuilder is set, otherwise the CPU geometry is
+            // dropped once the buffers are uploaded. Uploads are recorded into batch when given,
+            // and whoever submits it passes the token on through setUploadToken; without one the
+            // model submits its own.
+            K3Model(std::shared_ptr<K3Device> device, const K3Builder &builder, bool keepBuilder = false, K3UploadBatch *batch = nullptr);
 
             ~K3Model();
 
-            static std::unique_ptr<K3Model> createModelFromFile(std::shared_ptr<K3Device> device, const std::string &filePath);
+            static std::unique_ptr<K3Model> createModelFromFile(std::shared_ptr<K3Device> device, const std::string &filePath, uint32_t vertexFormat = K3VertexFormat::COMPACT);
 
+            // CPU half of createModelFromFile: load, meshlets and encode. Needs no device and is
+            // safe to run on any thread.
+            static K3Builder prepareBuilder(const std::string &filePath, uint32_t vertexFormat = K3VertexFormat::COMPACT);
+
+            // Token of the model's last upload. Tokens only grow, so it covers all of them.
+            K3UploadToken getUploadToken() const { return m_uploadToken; }
+
+            // Also lets the defragmenter move the buffers once the upload is resident.
+            void setUploadToken(K3UploadToken token);
+
+            // False until the graphics queue owns every buffer, skip drawing until then.
+            bool isResident() const { return m_device->getStagingRing().isAcquired(m_uploadToken); }
+
+            // Binds the geometry pool for pooled models, render systems drawing many models bind
+            // the pool once themselves and only call bind for the others.
             void bind(VkCommandBuffer commandBuffer);
 
-            void draw(VkCommandBuffer commandBuffer);
+            // lod indexes getLod, out of range levels clamp to the coarsest one. Draws with the
+            // pool offsets added, whoever bound the buffers. firstInstance offsets gl_InstanceIndex.
+            void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+            // The indexed draws draw would record, as indirect commands. Indexed models only.
+            void appendDrawCommands(std::vector<VkDrawIndexedIndirectCommand> &commands, uint32_t lod, uint32_t instanceCount, uint32_t firstInstance) const;
+
+            // Vertices and indices live in the device's K3GeometryPool rather than own buffers.
+            bool isPooled() const { return m_geometryRange.isValid(); }
+
+            const K3GeometryRange &getGeometryRange() const { return m_geometryRange; }
+
+            bool hasIndexBuffer() const { return m_hasIndexBuffer; }
+
+            VkIndexType getIndexType() const { return m_indexType; }
+
+            uint32_t getLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+
+            const K3MeshLod &getLod(uint32_t lod) const { return m_lods[lod]; }
+
+            glm::vec3 getBoundsCenter() const { return (m_boundsMin + m_boundsMax) * 0.5f; }
+
+            // Storage buffers for cluster culling, null when the model has no meshlets. Triangles
+            // are packed four local uint8_t indices per uint32_t.
+            uint32_t getMeshletCount() const { return m_meshletCount; }
+
+            K3Buffer *getMeshletBuffer() const { return m_meshletBuffer.get(); }
+
+            K3Buffer *getMeshletBoundsBuffer() const { return m_meshletBoundsBuffer.get(); }
+
+            K3Buffer *getMeshletVertexBuffer() const { return m_meshletVertexBuffer.get(); }
+
+            K3Buffer *getMeshletTriangleBuffer() const { return m_meshletTriangleBuffer.get(); }
+
+            float getBoundsRadius() const { return glm::length(m_boundsMax - m_boundsMin) * 0.5f; }
+
+            // Null unless the model was created with keepBuilder.
+            const K3Builder *getBuilder() const { return m_builder.get(); }
+
+            void releaseBuilder() { m_builder = nullptr; }
+
+            // Bytes of every buffer the model owns.
+            VkDeviceSize getDeviceMemorySize() const;
+
+            // Bytes of the retained builder and the draw tables.
+            size_t getHostMemorySize() const;
+
+            const K3VertexFormat &getVertexFormat() const { return m_vertexFormat; }
+
+            // Maps the stored positions back to model space. Identity unless positions are quantised.
+            const glm::mat4 &getDequantizeMatrix() const { return m_dequantizeMatrix; }
+
+            const glm::vec3 &getUniformColor() const { return m_uniformColor; }
+
+            // Bumped whenever the defragmenter moves one of the buffers, descriptors written with
+            // them need rewriting when it changes.
+            uint32_t getRelocationCount() const { return m_relocationCount; }
 
         private:
 
-            void createVertexBuffers(const std::vector<K3Vertex> &vertices);
+            void createVertexBuffers(K3UploadBatch &batch, const void *vertices, uint32_t vertexSize, uint32_t vertexCount);
+
+            void createIndexBuffers(K3UploadBatch &batch, const void *indices, uint32_t indexSize, uint32_t indexCount);
+
+            void createMeshletBuffers(K3UploadBatch &batch, const K3Builder &builder);
+
+            void registerRelocations();
 
-            void createIndexBuffers(const std::vector<uint32_t> &indices);
+            // Written in place under K3GeometryPlacement::DIRECT, recorded into batch otherwise.
+            std::unique_ptr<K3Buffer> createGeometryBuffer(K3UploadBatch &batch, const void *data, uint32_t elementSize, uint32_t elementCount, VkBufferUsageFlags usage);
 
             std::shared_ptr<K3Device> m_device = nullptr;
 
@@ -38,13 +121,45 @@ namespace k3::graphics {
 
             uint32_t m_vertexCount = -1;
 
+            K3VertexFormat m_vertexFormat{};
+
+            glm::mat4 m_dequantizeMatrix{1.f};
+
+            glm::vec3 m_uniformColor{1.f};
+
             bool m_hasIndexBuffer = false;
 
             std::unique_ptr<K3Buffer> m_indexBuffer;
 
             uint32_t m_indexCount = -1;
 
-            const K3Builder m_builder;
+            VkIndexType m_indexType = VK_INDEX_TYPE_UINT32;
+
+            K3GeometryRange m_geometryRange{};
+
+            std::vector<K3SubMesh> m_subMeshes{};
+
+            std::vector<K3MeshLod> m_lods{};
+
+            K3UploadToken m_uploadToken{};
+
+            uint32_t m_relocationCount = 0;
+
+            uint32_t m_meshletCount = 0;
+
+            std::unique_ptr<K3Buffer> m_meshletBuffer;
+
+            std::unique_ptr<K3Buffer> m_meshletBoundsBuffer;
+
+            std::unique_ptr<K3Buffer> m_meshletVertexBuffer;
+
+            std::unique_ptr<K3Buffer> m_meshletTriangleBuffer;
+
+            glm::vec3 m_boundsMin{};
+
+            glm::vec3 m_boundsMax{};
+
+            std::unique_ptr<const K3Builder> m_builder = nullptr;
 
     };
 
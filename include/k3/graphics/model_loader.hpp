@@ -0,0 +1,109 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "model.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace k3::graphics {
+
+    /**
+     * Reference to a K3Model that may still be loading. Constructible from a loaded model so
+     * synchronous code can keep assigning shared pointers.
+     */
+    class K3ModelHandle {
+
+        public:
+
+            K3ModelHandle() = default;
+
+            K3ModelHandle(std::shared_ptr<K3Model> model) : m_model {std::move(model)} {}
+
+            K3ModelHandle(std::shared_future<std::shared_ptr<K3Model>> future) : m_future {std::move(future)} {}
+
+            // Never blocks. Null until the load has finished, and for good if it failed.
+            std::shared_ptr<K3Model> get();
+
+            // Blocks until the load has finished.
+            std::shared_ptr<K3Model> wait();
+
+            bool isReady() const;
+
+            explicit operator bool() const { return m_model != nullptr || m_future.valid(); }
+
+        private:
+
+            std::shared_ptr<K3Model> resolve();
+
+            std::shared_ptr<K3Model> m_model = nullptr;
+
+            std::shared_future<std::shared_ptr<K3Model>> m_future{};
+
+    };
+
+    /**
+     * Loads models off the calling thread. Parsing, optimisation, LODs and meshlets run on a
+     * pool of workers, the buffer uploads on a single uploader thread. Models that finish parsing
+     * together are uploaded in one K3UploadBatch, so a scene load costs a handful of submits.
+     */
+    class K3ModelLoader {
+
+        public:
+
+            // workerCount of 0 uses one worker per hardware thread.
+            K3ModelLoader(std::shared_ptr<K3Device> device, uint32_t workerCount = 0);
+
+            // Finishes every load already queued.
+            ~K3ModelLoader();
+
+            K3ModelLoader(const K3ModelLoader &) = delete;
+            K3ModelLoader &operator=(const K3ModelLoader &) = delete;
+
+            // Runs first in the load task. A handle it returns is waited on and handed back in place
+            // of loading the file, unless that load failed. It may only return loads queued earlier.
+            using K3Deduplicate = std::function<K3ModelHandle()>;
+
+            // keepBuilder retains the CPU geometry in the model, see K3Model::getBuilder.
+            K3ModelHandle load(const std::string &filePath, uint32_t vertexFormat = K3VertexFormat::COMPACT, bool keepBuilder = false,
+                K3Deduplicate deduplicate = nullptr);
+
+            uint32_t getPendingCount() const { return m_pendingCount.load(); }
+
+            const std::shared_ptr<K3Device> &getDevice() const { return m_device; }
+
+        private:
+
+            struct K3PendingUpload {
+                std::shared_ptr<std::promise<std::shared_ptr<K3Model>>> promise = nullptr;
+                std::shared_ptr<K3Builder> builder = nullptr;
+                std::string filePath{};
+                bool keepBuilder = false;
+            };
+
+            // Runs on m_uploader, creates every model parsed so far in one batch.
+            void uploadReady();
+
+            std::shared_ptr<K3Device> m_device = nullptr;
+
+            std::vector<K3PendingUpload> m_readyUploads{};
+
+            std::mutex m_readyMutex;
+
+            std::atomic<uint32_t> m_pendingCount{0};
+
+            // Declared first so it outlives the workers that feed it.
+            K3ThreadPool m_uploader{1};
+
+            K3ThreadPool m_workers;
+
+    };
+
+}
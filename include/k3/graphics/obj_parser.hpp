@@ -0,0 +1,58 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace k3::graphics {
+
+    // Zero based attribute indices of one triangle corner, -1 where the face omitted the attribute.
+    struct K3ObjCorner {
+        int32_t position;
+        int32_t texcoord;
+        int32_t normal;
+    };
+
+    /**
+     * Flat OBJ attribute streams in the same layout as tinyobj::attrib_t, plus the triangulated
+     * face corners in file order.
+     */
+    struct K3ObjData {
+
+        std::vector<float> positions{};
+
+        std::vector<float> colors{};
+
+        std::vector<float> normals{};
+
+        std::vector<float> texcoords{};
+
+        std::vector<K3ObjCorner> corners{};
+
+    };
+
+    /**
+     * Parallel OBJ reader. The file is memory mapped, split at line boundaries and each chunk is
+     * parsed on the thread pool before the chunks are stitched back together. Numbers are parsed
+     * with the same accumulation tinyobj uses so results match it bit for bit.
+     */
+    class K3ObjParser {
+
+        public:
+
+            static constexpr size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+            // Returns false if the file can't be read or uses something we leave to tinyobj
+            // (polygons with more than four corners, lines, points or out of range indices).
+            static bool parse(const std::string &filePath, K3ObjData &data, K3ThreadPool &pool = K3ThreadPool::shared());
+
+            // tinyobj compatible float parse of [begin, end). Returns false on malformed input.
+            static bool parseDouble(const char *begin, const char *end, double &result);
+
+    };
+
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "device.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+
+namespace k3::graphics {
+
+    /**
+     * A color and depth image with a render pass and framebuffer over them, for rendering without
+     * a window or swap chain. The render pass has the same attachments and subpass as
+     * K3SwapChain's, so render systems built against one draw into the other unchanged.
+     */
+    class K3OffscreenTarget {
+
+        public:
+
+            static constexpr VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+            K3OffscreenTarget(std::shared_ptr<K3Device> device, VkExtent2D extent);
+
+            ~K3OffscreenTarget();
+
+            K3OffscreenTarget(const K3OffscreenTarget &) = delete;
+            K3OffscreenTarget &operator=(const K3OffscreenTarget &) = delete;
+
+            VkRenderPass getRenderPass() const { return m_renderPass; }
+
+            VkFramebuffer getFramebuffer() const { return m_framebuffer; }
+
+            VkExtent2D getExtent() const { return m_extent; }
+
+            VkImage getColorImage() const { return m_colorImage; }
+
+            VkImage getDepthImage() const { return m_depthImage; }
+
+            VkImageView getDepthImageView() const { return m_depthImageView; }
+
+            // Begins the render pass, clearing both attachments, and sets the viewport and scissor
+            // to the whole target the way K3Renderer::beginSwapChainRenderPass does.
+            void beginRenderPass(VkCommandBuffer commandBuffer);
+
+            void endRenderPass(VkCommandBuffer commandBuffer);
+
+        private:
+
+            void createRenderPass();
+
+            void createImages();
+
+            void createFramebuffer();
+
+            VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask);
+
+            std::shared_ptr<K3Device> m_device = nullptr;
+
+            VkExtent2D m_extent{};
+
+            VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+
+            VkRenderPass m_renderPass = VK_NULL_HANDLE;
+
+            VkImage m_colorImage = VK_NULL_HANDLE;
+
+            K3Allocation m_colorAllocation{};
+
+            VkImageView m_colorImageView = VK_NULL_HANDLE;
+
+            VkImage m_depthImage = VK_NULL_HANDLE;
+
+            K3Allocation m_depthAllocation{};
+
+            VkImageView m_depthImageView = VK_NULL_HANDLE;
+
+            VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+    };
+
+}
@@ -14,6 +14,8 @@
 namespace k3::graphics {
 
     struct PipelineConfigInfo {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
         VkPipelineViewportStateCreateInfo viewportInfo;
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
         VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -34,6 +36,9 @@ namespace k3::graphics {
 
             K3Pipeline(std::shared_ptr<K3Device> device, const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& pipelineConfigInfo);
 
+            // Compute pipeline, bind binds it to the compute bind point.
+            K3Pipeline(std::shared_ptr<K3Device> device, const std::string& compFilePath, VkPipelineLayout pipelineLayout);
+
             ~K3Pipeline();
             
             void bind(VkCommandBuffer commandBuffer);
@@ -46,15 +51,21 @@ namespace k3::graphics {
 
             void createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& pipelineConfigInfo);
 
+            void createComputePipeline(const std::string& compFilePath, VkPipelineLayout pipelineLayout);
+
             void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 
             std::shared_ptr<K3Device> m_device = nullptr;
 
-            VkPipeline m_graphicsPipeline;
+            VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+            VkPipelineBindPoint m_bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+            VkShaderModule m_vertexShaderModule = VK_NULL_HANDLE;
 
-            VkShaderModule m_vertexShaderModule;
+            VkShaderModule m_fragmentShaderModule = VK_NULL_HANDLE;
 
-            VkShaderModule m_fragmentShaderModule;
+            VkShaderModule m_computeShaderModule = VK_NULL_HANDLE;
 
     };
 
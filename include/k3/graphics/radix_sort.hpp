@@ -0,0 +1,55 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace k3::graphics {
+
+    // A 64 bit sort key and the index of what it orders.
+    struct K3SortEntry {
+        uint64_t key = 0;
+        uint32_t index = 0;
+    };
+
+    /**
+     * Stable LSD radix sort of K3SortEntry by key, one pass per 8 bit digit. All digit
+     * histograms come from a single read of the keys, and digits every key shares are
+     * skipped, so the passes only cover the bits that actually vary. The scratch array is
+     * kept between calls, so a sorter reused every frame stops allocating once it has seen
+     * the largest frame.
+     */
+    class K3RadixSorter {
+
+        public:
+
+            static constexpr uint32_t DIGIT_BITS = 8;
+
+            static constexpr uint32_t DIGIT_COUNT = 64 / DIGIT_BITS;
+
+            static constexpr uint32_t BUCKET_COUNT = 1u << DIGIT_BITS;
+
+            // Below this many entries an insertion sort beats clearing the histograms.
+            static constexpr size_t INSERTION_THRESHOLD = 64;
+
+            // Sorts entries in place. Its storage may be exchanged with the scratch array's,
+            // neither shrinks.
+            void sort(std::vector<K3SortEntry> &entries);
+
+            // Passes the last sort actually scattered, at most DIGIT_COUNT.
+            uint32_t getPassCount() const { return m_passCount; }
+
+        private:
+
+            std::vector<K3SortEntry> m_scratch{};
+
+            std::array<std::array<uint32_t, BUCKET_COUNT>, DIGIT_COUNT> m_histograms{};
+
+            uint32_t m_passCount = 0;
+
+    };
+
+}
@@ -5,6 +5,8 @@
 #include "window.hpp"
 #include "device.hpp"
 #include "swapchain.hpp"
+#include "frame_allocator.hpp"
+#include "defragmenter.hpp"
 #include "pipeline.hpp"
 
 #include <cassert>
@@ -33,6 +35,8 @@ namespace k3::graphics {
 
             float getAspectRatio() const { return m_swapChain->extentAspectRatio(); }
 
+            VkExtent2D getSwapChainExtent() const { return m_swapChain->getSwapChainExtent(); }
+
             VkCommandBuffer getCurrentCommandBuffer() const {
                 assert(m_isFrameStarted && "Cannot get command buffer when frame not in progress");
                 return m_commandBuffers[m_currentFrameIndex];
@@ -43,6 +47,22 @@ namespace k3::graphics {
                 return m_currentFrameIndex;    
             }
 
+            // Depth the last submitted frame rendered, for occlusion culling against. Null for the
+            // first frame after the swapchain was (re)created.
+            VkImage getPreviousDepthImage() const {
+                return m_hasPreviousDepth ? m_swapChain->getDepthImage(m_previousImageIndex) : VK_NULL_HANDLE;
+            }
+
+            VkImageView getPreviousDepthImageView() const {
+                return m_hasPreviousDepth ? m_swapChain->getDepthImageView(m_previousImageIndex) : VK_NULL_HANDLE;
+            }
+
+            // Per-frame uniform and storage memory, reset by beginFrame and flushed by endFrame.
+            K3FrameAllocator &getFrameAllocator() { return *m_frameAllocator; }
+
+            // Moves geometry out of sparse memory blocks a frame budget at a time from beginFrame.
+            K3Defragmenter &getDefragmenter() { return *m_defragmenter; }
+
             VkCommandBuffer beginFrame();
 
             void endFrame();
@@ -67,12 +87,23 @@ namespace k3::graphics {
 
             std::vector<VkCommandBuffer> m_commandBuffers;
 
+            std::unique_ptr<K3FrameAllocator> m_frameAllocator;
+
+            std::unique_ptr<K3Defragmenter> m_defragmenter;
+
             uint32_t m_currentImageIndex;
 
+            uint32_t m_previousImageIndex = 0;
+
+            bool m_hasPreviousDepth = false;
+
             int m_currentFrameIndex = 0;
 
             bool m_isFrameStarted = false;
 
+            // Staging ring timeline value the frame being recorded waits on.
+            uint64_t m_uploadWaitValue = 0;
+
     };
 
 }
\ No newline at end of file
@@ -2,14 +2,21 @@
 
 #include "k3/logging/log.hpp"
 
+#include "culler.hpp"
 #include "device.hpp"
+#include "descriptors.hpp"
+#include "draw_list.hpp"
+#include "frustum_culler.hpp"
 #include "pipeline.hpp"
+#include "radix_sort.hpp"
+#include "sort_key.hpp"
 #include "camera.hpp"
 #include "game_object.hpp"
 #include "frame_info.hpp"
 
 #include <cassert>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #define GLM_FORCE_RADIANS
@@ -19,25 +26,174 @@
 
 namespace k3::graphics {
 
+    // Per instance data the vertex shader reads with gl_InstanceIndex, std430 compatible.
+    // normalMatrix only uses its upper 3x3; column 3 carries the color for UNIFORM_COLOR formats.
+    struct K3InstanceData {
+        glm::mat4 transform{1.f};
+        glm::mat4 normalMatrix{1.f};
+    };
+
+    /**
+     * Draws game objects grouped by model and LOD, one instanced draw per group. Draws are ordered
+     * by K3SortKey, radix sorted each frame, so groups share state and run front to back. Instance data
+     * for the whole pass goes into a single frame allocation bound as a storage buffer, so draw
+     * calls scale with the unique models in view rather than the number of objects. Pooled,
+     * indexed models go through a K3DrawList, so their draws collapse to a few indirect calls.
+     * Objects outside the camera frustum are dropped on the CPU by a K3FrustumCuller first; with
+     * GPU culling on, a K3Culler pass then decides which draw list instances are drawn. Per object
+     * mode keeps the loop this replaced, for comparison.
+     */
     class K3SimpleRenderSystem {
         public:
 
+            // Screen space error in pixels a LOD may have before a finer level is drawn.
+            static constexpr float LOD_PIXEL_ERROR = 1.f;
+
             K3SimpleRenderSystem(std::shared_ptr<K3Device> device, VkRenderPass renderPass);
 
             ~K3SimpleRenderSystem();
 
-            void renderGameObjects(k3::graphics::K3FrameInfo& frameInfo, std::vector<K3GameObject>& m_gameObjects);
+            // Collects, sorts and uploads the frame's instances and runs the cull pass, so it is
+            // recorded before the render pass begins.
+            void prepareGameObjects(K3FrameInfo &frameInfo, std::vector<K3GameObject> &gameObjects);
+
+            // Draws what the last prepareGameObjects collected, inside the render pass.
+            void renderGameObjects(K3FrameInfo &frameInfo);
+
+            // Off records every group with vkCmdDrawIndexed, to compare against.
+            void setIndirect(bool indirect) { m_indirect = indirect; }
+
+            bool isIndirect() const { return m_indirect; }
+
+            // The draw loop from before instancing, as a baseline: objects unsorted, each with its
+            // own push constants, bind and vkCmdDrawIndexed. Overrides indirect draws and culling.
+            void setPerObject(bool perObject) { m_perObject = perObject; }
+
+            bool isPerObject() const { return m_perObject; }
+
+            // Drops objects outside the frustum before any instance data is written.
+            void setFrustumCulling(bool frustumCulling) { m_frustumCulling = frustumCulling; }
+
+            bool isFrustumCulling() const { return m_frustumCulling; }
+
+            // Objects the last prepareGameObjects kept and dropped on the CPU.
+            uint32_t getFrustumVisibleCount() const { return m_frustumVisibleCount; }
+
+            uint32_t getFrustumCulledCount() const { return m_frustumCulledCount; }
+
+            // Culls indirect draws on the GPU. Needs indirect draws and a device with multiDrawIndirect.
+            void setCulling(bool culling) { m_culling = culling; }
+
+            bool isCulling() const { return m_culling; }
+
+            // Null when the device can't cull on the GPU.
+            K3Culler *getCuller() const { return m_culler.get(); }
+
+            // Draw calls and instances recorded by the last renderGameObjects, before culling.
+            uint32_t getDrawCount() const { return m_drawCount; }
+
+            uint32_t getInstanceCount() const { return m_instanceCount; }
+
+            // CPU time the last prepareGameObjects and renderGameObjects took, in milliseconds.
+            float getRecordTime() const { return m_recordTime; }
+
+            // Part of the record time spent building and sorting the draw keys, in milliseconds.
+            float getSortTime() const { return m_sortTime; }
 
         private:
 
+            struct K3DrawItem {
+                K3Model *model = nullptr;
+                uint32_t lod = 0;
+                uint32_t pipelineKey = 0;
+                K3GameObject *gameObject = nullptr;
+                glm::mat4 modelMatrix{1.f};
+                // World space bounding sphere, radius in w.
+                glm::vec4 sphere{0.f};
+            };
+
+            // Instances firstInstance to firstInstance + instanceCount of a model drawn without
+            // the draw list.
+            struct K3DrawGroup {
+                K3Model *model = nullptr;
+                uint32_t lod = 0;
+                uint32_t firstInstance = 0;
+                uint32_t instanceCount = 0;
+            };
+
+            void createDescriptorSets();
+
+            void collectGameObjects(K3FrameInfo &frameInfo, std::vector<K3GameObject> &gameObjects);
+
             void createPipelineLayout();
 
-            void createPipeline(VkRenderPass renderPass);
+            void renderPerObject(K3FrameInfo &frameInfo);
+
+            // Coarsest level of model, drawn at scale, whose error projects to at most LOD_PIXEL_ERROR.
+            uint32_t selectLod(const K3FrameInfo &frameInfo, const glm::mat4 &modelView, const K3Model &model, const glm::vec3 &scale) const;
+
+            // Vertex input state is baked into the pipeline, so there is one per K3VertexFormat in use,
+            // and one more for per object draws.
+            K3Pipeline &getPipeline(const K3VertexFormat &vertexFormat, bool perObject = false);
 
             std::shared_ptr<K3Device> m_device = nullptr;
 
+            VkRenderPass m_renderPass = nullptr;
+
             VkPipelineLayout m_pipelineLayout;
 
-            std::unique_ptr<K3Pipeline> m_pipeline = nullptr;
+            std::unordered_map<uint32_t, std::unique_ptr<K3Pipeline>> m_pipelines{};
+
+            std::unique_ptr<K3DescriptorSetLayout> m_instanceSetLayout = nullptr;
+
+            std::unique_ptr<K3DescriptorPool> m_descriptorPool = nullptr;
+
+            // One per frame in flight, pointed at that frame's instance data as it is recorded.
+            std::vector<VkDescriptorSet> m_instanceSets{};
+
+            // Kept between frames to reuse the allocations.
+            std::vector<K3DrawItem> m_drawItems{};
+
+            std::vector<K3DrawItem> m_sortedItems{};
+
+            std::vector<K3SortEntry> m_sortEntries{};
+
+            K3RadixSorter m_sorter{};
+
+            // Dense per frame ids for the model field of the sort keys.
+            std::unordered_map<const K3Model *, uint32_t> m_modelIds{};
+
+            std::vector<K3DrawGroup> m_directGroups{};
+
+            K3FrustumCuller m_frustumCuller{};
+
+            std::vector<uint8_t> m_visibility{};
+
+            std::unique_ptr<K3DrawList> m_drawList = nullptr;
+
+            std::unique_ptr<K3Culler> m_culler = nullptr;
+
+            bool m_indirect = true;
+
+            bool m_perObject = false;
+
+            bool m_culling = true;
+
+            bool m_frustumCulling = true;
+
+            uint32_t m_frustumVisibleCount = 0;
+
+            uint32_t m_frustumCulledCount = 0;
+
+            // The frame's instance set points at valid data.
+            bool m_prepared = false;
+
+            float m_recordTime = 0.f;
+
+            float m_sortTime = 0.f;
+
+            uint32_t m_drawCount = 0;
+
+            uint32_t m_instanceCount = 0;
     };
 }
\ No newline at end of file
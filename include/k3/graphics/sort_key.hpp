@@ -0,0 +1,67 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace k3::graphics {
+
+    // Blended draws sort after, and in the opposite depth order to, solid ones.
+    enum class K3DrawPass : uint32_t {
+        SOLID = 0,
+        BLENDED = 1,
+    };
+
+    /**
+     * 64 bit draw sort keys, most significant field first:
+     *
+     *  solid    pass (2) | pipeline (8) | material (10) | model (16) | lod (4) | depth (24)
+     *  blended  pass (2) | far depth (24) | pipeline (8) | material (10) | model (16) | lod (4)
+     *
+     * Solid draws group by state and run front to back within a group for early-Z. Blended
+     * ones must go back to front, so depth takes over from state there. Fields wider than
+     * their bits are clamped, which only costs order, never correctness.
+     */
+    struct K3SortKey {
+
+        static constexpr uint32_t PASS_BITS = 2;
+        static constexpr uint32_t PIPELINE_BITS = 8;
+        static constexpr uint32_t MATERIAL_BITS = 10;
+        static constexpr uint32_t MODEL_BITS = 16;
+        static constexpr uint32_t LOD_BITS = 4;
+        static constexpr uint32_t DEPTH_BITS = 24;
+
+        static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MODEL_BITS + LOD_BITS + DEPTH_BITS == 64);
+
+        static constexpr uint64_t field(uint32_t value, uint32_t bits) {
+            return std::min<uint64_t>(value, (1ull << bits) - 1);
+        }
+
+        // Non-negative floats order like their bit patterns, so the top DEPTH_BITS of the view
+        // depth quantise it without knowing the clip planes. Depths behind the eye count as 0.
+        static uint32_t quantizeDepth(float viewDepth) {
+            const float depth = std::max(viewDepth, 0.f);
+            uint32_t bits;
+            std::memcpy(&bits, &depth, sizeof(bits));
+            return bits >> (32 - DEPTH_BITS);
+        }
+
+        static uint64_t make(K3DrawPass pass, uint32_t pipeline, uint32_t material, uint32_t model, uint32_t lod, float viewDepth) {
+            const uint64_t state = field(pipeline, PIPELINE_BITS) << (MATERIAL_BITS + MODEL_BITS + LOD_BITS)
+                | field(material, MATERIAL_BITS) << (MODEL_BITS + LOD_BITS)
+                | field(model, MODEL_BITS) << LOD_BITS
+                | field(lod, LOD_BITS);
+            const uint64_t depth = quantizeDepth(viewDepth);
+            const uint64_t passBits = static_cast<uint64_t>(pass) << (64 - PASS_BITS);
+            if(pass == K3DrawPass::BLENDED) {
+                const uint64_t farDepth = ((1ull << DEPTH_BITS) - 1) - depth;
+                return passBits | farDepth << (64 - PASS_BITS - DEPTH_BITS) | state;
+            }
+            return passBits | state << DEPTH_BITS | depth;
+        }
+
+    };
+
+}
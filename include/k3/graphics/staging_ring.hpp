@@ -0,0 +1,185 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "memory_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace k3::graphics {
+
+    class K3Device;
+
+    /**
+     * Completion token of an upload: the value the staging ring's timeline semaphore reaches once
+     * the copy has finished. A default token is always complete.
+     */
+    struct K3UploadToken {
+        // Value of a token whose batch has not been submitted yet, never complete.
+        static constexpr uint64_t PENDING = ~0ull;
+
+        uint64_t value = 0;
+    };
+
+    /**
+     * One persistently mapped host buffer that every CPU to GPU upload is staged through. Space
+     * is handed out linearly and wraps around; each submitted batch holds its ranges until the
+     * timeline semaphore passes its value, so upload memory is fixed at RING_SIZE however much is
+     * streamed. Copies are recorded through K3UploadBatch, upload() is a batch of one.
+     *
+     * Copies run on the device's transfer queue. When that is a separate family, each copy
+     * releases its resource to the graphics family and the renderer records the matching acquire
+     * at the start of its next frame through acquireUploads, waiting on the timeline there.
+     */
+    class K3StagingRing {
+
+        public:
+
+            static constexpr VkDeviceSize RING_SIZE = 32ull << 20;
+
+            // Uploads are copied in pieces of at most this, so a large one streams through the
+            // ring while earlier pieces are still being copied.
+            static constexpr VkDeviceSize CHUNK_SIZE = RING_SIZE / 4;
+
+            static constexpr VkDeviceSize ALIGNMENT = 16;
+
+            // Stages of the graphics queue that read uploaded resources, including the
+            // defragmenter's copies and the cull pass.
+            static constexpr VkPipelineStageFlags CONSUMER_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+                | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+            K3StagingRing(K3Device &device, VkDeviceSize size = RING_SIZE);
+
+            // Waits for every copy still in flight.
+            ~K3StagingRing();
+
+            K3StagingRing(const K3StagingRing &) = delete;
+            K3StagingRing &operator=(const K3StagingRing &) = delete;
+
+            // Copies data into the ring and submits a copy into dstBuffer. Returns once the data is
+            // staged; the token says when the copy is done. Safe to call from any thread.
+            K3UploadToken upload(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+            bool isComplete(K3UploadToken token) const;
+
+            void wait(K3UploadToken token) const;
+
+            // True once graphics queue work recorded from now on may read the upload.
+            bool isAcquired(K3UploadToken token) const { return token.value <= m_acquiredValue.load(); }
+
+            // Records the queue family acquires of every upload released so far into a graphics
+            // command buffer. Returns the timeline value its submit must wait on at
+            // CONSUMER_STAGES, 0 for none.
+            uint64_t acquireUploads(VkCommandBuffer commandBuffer);
+
+            VkSemaphore getTimelineSemaphore() const { return m_timeline; }
+
+            // Blocks until every submitted copy has finished.
+            void waitIdle();
+
+            VkDeviceSize getSize() const { return m_size; }
+
+            // Bytes held by copies in flight.
+            VkDeviceSize getPendingBytes() const;
+
+            // Queue submits made since creation.
+            uint64_t getSubmitCount() const { return m_submitCount.load(); }
+
+        private:
+
+            friend class K3UploadBatch;
+
+            struct K3StagingRange {
+                VkDeviceSize begin = 0;
+                VkDeviceSize end = 0;
+                // PENDING while the open batch that staged it is unsubmitted.
+                uint64_t value = K3UploadToken::PENDING;
+            };
+
+            struct K3StagingCommandBuffer {
+                VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+                bool graphics = false;
+                uint64_t value = 0;
+            };
+
+            // Either half of a queue family transfer: a buffer range, or an image with the layout
+            // change the release and the acquire both have to state.
+            struct K3OwnershipTransfer {
+                VkBuffer buffer = VK_NULL_HANDLE;
+                VkDeviceSize offset = 0;
+                VkDeviceSize size = 0;
+                VkImage image = VK_NULL_HANDLE;
+                VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                VkImageSubresourceRange subresourceRange{};
+                uint64_t value = 0;
+            };
+
+            // Reserves size bytes for the open batch. Returns false when only submitting that batch
+            // can make room, waits on older batches otherwise.
+            bool reserve(VkDeviceSize size, VkDeviceSize &offset);
+
+            VkCommandBuffer beginCommandBuffer(bool graphics);
+
+            // Ends and submits commandBuffer, claiming every PENDING range. releases become acquires
+            // for the next frame.
+            uint64_t submit(VkCommandBuffer commandBuffer, bool graphics, std::vector<K3OwnershipTransfer> &releases);
+
+            // Releases finished batches. Called with m_mutex held, so it never waits; callers
+            // that must wait drop the lock around wait() first.
+            void retire();
+
+            static void recordTransfers(VkCommandBuffer commandBuffer, const std::vector<K3OwnershipTransfer> &transfers, uint32_t srcFamily, uint32_t dstFamily,
+                bool release, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages);
+
+            K3Device &m_device;
+
+            VkDeviceSize m_size = 0;
+
+            VkBuffer m_buffer = VK_NULL_HANDLE;
+
+            K3Allocation m_allocation{};
+
+            VkCommandPool m_commandPool = VK_NULL_HANDLE;
+
+            // Separate from m_commandPool only with a dedicated transfer family.
+            VkCommandPool m_graphicsCommandPool = VK_NULL_HANDLE;
+
+            VkSemaphore m_timeline = VK_NULL_HANDLE;
+
+            uint64_t m_nextValue = 1;
+
+            bool m_lastSubmitGraphics = false;
+
+            std::atomic<uint64_t> m_acquiredValue{0};
+
+            std::atomic<uint64_t> m_submitCount{0};
+
+            // Oldest first. The free space runs from m_head to the begin of the front entry.
+            std::deque<K3StagingRange> m_ranges{};
+
+            VkDeviceSize m_head = 0;
+
+            std::deque<K3StagingCommandBuffer> m_commandBuffersInFlight{};
+
+            std::vector<VkCommandBuffer> m_freeCommandBuffers{};
+
+            std::vector<VkCommandBuffer> m_freeGraphicsCommandBuffers{};
+
+            std::vector<K3OwnershipTransfer> m_pendingAcquires{};
+
+            mutable std::mutex m_mutex;
+
+            // Held by the open K3UploadBatch, so one batch records at a time.
+            std::mutex m_batchMutex;
+
+    };
+
+}
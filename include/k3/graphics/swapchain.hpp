@@ -56,13 +56,23 @@ namespace k3::graphics {
                 return m_swapChainFramebuffers[index]; 
             }
 
+            // Left in DEPTH_STENCIL_ATTACHMENT_OPTIMAL by the render pass, contents stored.
+            VkImage getDepthImage(int index) {
+                return m_depthImages[index];
+            }
+
+            VkImageView getDepthImageView(int index) {
+                return m_depthImageViews[index];
+            }
+
             float extentAspectRatio() {
                 return static_cast<float>(m_swapChainExtent.width) / static_cast<float>(m_swapChainExtent.height);
             }
 
             VkResult acquireNextImage(uint32_t *imageIndex);
 
-            VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+            // uploadWaitValue is a staging ring timeline value the frame waits on, 0 for none.
+            VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex, uint64_t uploadWaitValue = 0);
 
             bool compareSwapFormats(const K3SwapChain &swapChain) const {
                 return swapChain.m_swapChainDepthFormat == m_swapChainDepthFormat && swapChain.m_swapChainImageFormat == m_swapChainImageFormat;
@@ -112,7 +122,7 @@ namespace k3::graphics {
             
             std::vector<VkImage> m_depthImages;
 
-            std::vector<VkDeviceMemory> m_depthImageMemorys;
+            std::vector<K3Allocation> m_depthImageAllocations;
 
             std::vector<VkImageView> m_depthImageViews;
 
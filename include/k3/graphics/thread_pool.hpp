@@ -0,0 +1,70 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace k3::graphics {
+
+    /**
+     * Fixed size pool of worker threads draining a FIFO task queue. Tasks must not block on
+     * other tasks queued on the same pool.
+     */
+    class K3ThreadPool {
+
+        public:
+
+            // threadCount of 0 uses one thread per hardware thread.
+            K3ThreadPool(uint32_t threadCount = 0);
+
+            ~K3ThreadPool();
+
+            K3ThreadPool(const K3ThreadPool &) = delete;
+            K3ThreadPool &operator=(const K3ThreadPool &) = delete;
+
+            // Pool used by CPU side asset processing such as OBJ parsing.
+            static K3ThreadPool &shared();
+
+            uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+            template <typename F>
+            auto submit(F &&task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+                using Result = std::invoke_result_t<std::decay_t<F>>;
+                auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+                std::future<Result> future = packagedTask->get_future();
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_tasks.emplace_back([packagedTask]() { (*packagedTask)(); });
+                }
+                m_condition.notify_one();
+                return future;
+            }
+
+            // Runs function(i) for i in [0, count) across the pool and waits for all of them.
+            void parallelFor(uint32_t count, const std::function<void(uint32_t)> &function);
+
+        private:
+
+            void workerLoop();
+
+            std::vector<std::thread> m_workers;
+
+            std::deque<std::function<void()>> m_tasks;
+
+            std::mutex m_mutex;
+
+            std::condition_variable m_condition;
+
+            bool m_stopping = false;
+
+    };
+
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace k3::graphics {
+
+    /**
+     * Two level segregated fit (TLSF) sub-allocator over an abstract range of size bytes. It only
+     * hands out offsets, so it has no Vulkan dependency and backs each K3MemoryAllocator block.
+     * Allocation and free are O(1): free regions sit in lists per size class found with two
+     * bitmap scans, and neighbouring free regions are merged on free.
+     */
+    class K3TlsfAllocator {
+
+        public:
+
+            static constexpr uint64_t INVALID_OFFSET = ~0ull;
+
+            K3TlsfAllocator(uint64_t size);
+
+            K3TlsfAllocator(const K3TlsfAllocator &) = delete;
+            K3TlsfAllocator &operator=(const K3TlsfAllocator &) = delete;
+            K3TlsfAllocator(K3TlsfAllocator &&) = default;
+            K3TlsfAllocator &operator=(K3TlsfAllocator &&) = default;
+
+            // alignment must be a power of two. Returns INVALID_OFFSET when nothing fits.
+            uint64_t allocate(uint64_t size, uint64_t alignment = 1);
+
+            // offset must come from allocate.
+            void free(uint64_t offset);
+
+            uint64_t getSize() const { return m_size; }
+
+            uint64_t getUsedBytes() const { return m_usedBytes; }
+
+            uint64_t getFreeBytes() const { return m_size - m_usedBytes; }
+
+            uint32_t getAllocationCount() const { return static_cast<uint32_t>(m_allocations.size()); }
+
+            uint32_t getFreeRegionCount() const { return m_freeRegionCount; }
+
+            uint64_t getLargestFreeRegion() const;
+
+            // 0 when the free space is one region, towards 1 as it splinters.
+            float getFragmentation() const;
+
+            bool isEmpty() const { return m_allocations.empty(); }
+
+            // Walks every region checking the physical chain, the free lists and the byte counts.
+            bool validate() const;
+
+        private:
+
+            static constexpr uint32_t SECOND_LEVEL_BITS = 4;
+
+            static constexpr uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_BITS;
+
+            static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SECOND_LEVEL_BITS + 1;
+
+            static constexpr uint32_t NONE = ~0u;
+
+            struct K3Region {
+                uint64_t offset = 0;
+                uint64_t size = 0;
+                uint32_t previousPhysical = NONE;
+                uint32_t nextPhysical = NONE;
+                uint32_t previousFree = NONE;
+                uint32_t nextFree = NONE;
+                bool free = false;
+            };
+
+            static void mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel);
+
+            // First free region whose class guarantees at least size bytes, or NONE.
+            uint32_t findFree(uint64_t size) const;
+
+            void insertFree(uint32_t region);
+
+            void removeFree(uint32_t region);
+
+            // Splits size bytes off the front of region, the rest becomes a new free region.
+            void split(uint32_t region, uint64_t size);
+
+            // Folds next into region, both must be physical neighbours.
+            void merge(uint32_t region, uint32_t next);
+
+            uint32_t createRegion();
+
+            void releaseRegion(uint32_t region);
+
+            uint64_t m_size = 0;
+
+            uint64_t m_usedBytes = 0;
+
+            uint32_t m_freeRegionCount = 0;
+
+            std::vector<K3Region> m_regions{};
+
+            std::vector<uint32_t> m_unusedRegions{};
+
+            // Offset handed out by allocate to its region.
+            std::unordered_map<uint64_t, uint32_t> m_allocations{};
+
+            uint64_t m_firstLevelBitmap = 0;
+
+            uint32_t m_secondLevelBitmaps[FIRST_LEVEL_COUNT] = {};
+
+            uint32_t m_freeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+
+    };
+
+}
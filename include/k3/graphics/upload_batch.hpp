@@ -0,0 +1,91 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "staging_ring.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace k3::graphics {
+
+    // One piece of a multi-region upload into a single buffer.
+    struct K3UploadRegion {
+        const void *data = nullptr;
+        VkDeviceSize size = 0;
+        VkDeviceSize dstOffset = 0;
+    };
+
+    /**
+     * Records many buffer and image uploads into one command buffer and submits them together.
+     * Data is staged through the device's K3StagingRing as it is enqueued; should the batch ever
+     * need more than the ring holds, what it has so far is submitted to make room.
+     *
+     * Only one batch is open per ring at a time, others wait in the constructor, so keep a batch
+     * for the length of one load and no longer, and don't call K3StagingRing::upload while
+     * holding one.
+     */
+    class K3UploadBatch {
+
+        public:
+
+            // TRANSFER records for the transfer queue. GRAPHICS records on the graphics queue, for
+            // uploads needing graphics stages such as third party code recording into getCommandBuffer.
+            enum class Queue { TRANSFER, GRAPHICS };
+
+            K3UploadBatch(K3StagingRing &ring, Queue queue = Queue::TRANSFER);
+
+            // Submits anything still queued.
+            ~K3UploadBatch();
+
+            K3UploadBatch(const K3UploadBatch &) = delete;
+            K3UploadBatch &operator=(const K3UploadBatch &) = delete;
+
+            void uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+            // All regions go into dstBuffer with one vkCmdCopyBuffer.
+            void uploadBuffer(VkBuffer dstBuffer, const K3UploadRegion *regions, uint32_t regionCount);
+
+            // Device to device copy, dstBuffer is handed to the graphics queue like an upload.
+            void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy *regions, uint32_t regionCount);
+
+            // Tightly packed texels for every layer of mip 0, at most the ring size. The image ends in finalLayout.
+            void uploadImage(VkImage image, VkImageAspectFlags aspectMask, const void *data, VkDeviceSize size, VkExtent3D extent, uint32_t layerCount,
+                VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+            // For recording other copies straight into the batch.
+            VkCommandBuffer getCommandBuffer();
+
+            // Submits what is queued. The batch stays open and may be filled again.
+            K3UploadToken submit();
+
+            // Token covering everything submitted by this batch so far.
+            K3UploadToken getToken() const { return m_token; }
+
+        private:
+
+            // Copies data into the ring. False when the ring is full of this batch and it has to be submitted first.
+            bool stage(const void *data, VkDeviceSize size, VkDeviceSize &offset);
+
+            void release(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+
+            K3StagingRing &m_ring;
+
+            bool m_graphics = false;
+
+            bool m_transferOwnership = false;
+
+            std::unique_lock<std::mutex> m_lock;
+
+            VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+
+            std::vector<K3StagingRing::K3OwnershipTransfer> m_releases{};
+
+            K3UploadToken m_token{};
+
+    };
+
+}
@@ -4,6 +4,9 @@
 
 #include "utils.hpp"
 
+#include "mapped_file.hpp"
+#include "vertex_format.hpp"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -12,11 +15,17 @@
 
 #include "vulkan/vulkan.h"
 
+#include <memory>
+#include <string>
 #include <vector>
 #include <unordered_map>
 
 namespace k3::graphics {
 
+    struct K3ObjData;
+
+    struct K3ObjCorner;
+
     struct K3Vertex {
 
         glm::vec3 position{};
@@ -37,14 +46,184 @@ namespace k3::graphics {
 
     };
 
+    // A range of the index buffer drawn with its own vertexOffset, so 16-bit indices can
+    // address meshes with more than 64K vertices.
+    struct K3SubMesh {
+
+        uint32_t firstIndex = 0;
+
+        uint32_t indexCount = 0;
+
+        int32_t vertexOffset = 0;
+
+    };
+
+    // One level of detail: a range of the shared index buffer and the model space distance its
+    // surface may deviate from the full mesh.
+    struct K3MeshLod {
+
+        uint32_t firstIndex = 0;
+
+        uint32_t indexCount = 0;
+
+        float error = 0.f;
+
+    };
+
+    // A cluster of at most K3MeshletGenerator::MAX_VERTICES vertices and MAX_TRIANGLES triangles.
+    // Vertices are vertexCount entries of meshletVertices from vertexOffset, triangles are
+    // 3 * triangleCount local uint8_t indices of meshletTriangles from triangleOffset.
+    struct K3Meshlet {
+
+        uint32_t vertexOffset = 0;
+
+        uint32_t triangleOffset = 0;
+
+        uint32_t vertexCount = 0;
+
+        uint32_t triangleCount = 0;
+
+    };
+
+    // std430 layout for the culling storage buffer. The cluster is back facing for a camera at eye
+    // when dot(normalize(coneApex - eye), coneAxis.xyz) >= coneAxis.w.
+    struct K3MeshletBounds {
+
+        glm::vec4 sphere{};
+
+        glm::vec4 coneApex{};
+
+        glm::vec4 coneAxis{0.f, 0.f, 0.f, 1.f};
+
+    };
+
     struct K3Builder {
 
+        // Passes K3MeshOptimizer runs in loadModel before the mesh is cached.
+        static constexpr uint32_t OPTIMIZE_VERTEX_CACHE = 1u << 0;
+
+        static constexpr uint32_t OPTIMIZE_OVERDRAW = 1u << 1;
+
+        static constexpr uint32_t OPTIMIZE_VERTEX_FETCH = 1u << 2;
+
+        // Appends simplified levels from K3MeshSimplifier after the full index list.
+        static constexpr uint32_t GENERATE_LODS = 1u << 3;
+
+        // Runs K3MeshletGenerator::generate so the meshlets are cached with the mesh.
+        static constexpr uint32_t GENERATE_MESHLETS = 1u << 4;
+
+        uint32_t optimizeFlags = OPTIMIZE_VERTEX_CACHE | OPTIMIZE_VERTEX_FETCH | GENERATE_LODS | GENERATE_MESHLETS;
+
+        // Index width selection done by buildIndices.
+        static constexpr uint32_t SHORT_INDICES = 1u << 0;
+
+        static constexpr uint32_t SPLIT_SHORT_INDICES = 1u << 1;
+
+        uint32_t indexFlags = SHORT_INDICES | SPLIT_SHORT_INDICES;
+
         std::vector<K3Vertex> vertices{};
 
         std::vector<uint32_t> indices{};
 
+        // Empty unless GENERATE_LODS ran. lods[0] is the full mesh, later entries index the same vertices.
+        std::vector<K3MeshLod> lods{};
+
+        // Filled by K3MeshletGenerator::generate for the full detail level, see GENERATE_MESHLETS.
+        std::vector<K3Meshlet> meshlets{};
+
+        std::vector<uint32_t> meshletVertices{};
+
+        std::vector<uint8_t> meshletTriangles{};
+
+        std::vector<K3MeshletBounds> meshletBounds{};
+
+        glm::vec3 boundsMin{};
+
+        glm::vec3 boundsMax{};
+
+        // K3VertexFormat flags loadModel encodes to before the mesh is cached, 0 keeps plain K3Vertex.
+        uint32_t vertexFormatFlags = 0;
+
+        // Output of encode(). When isEncoded() K3Model uploads encodedVertexData() in place of vertexData().
+        K3VertexFormat vertexFormat{};
+
+        std::vector<uint8_t> encodedVertices{};
+
+        // Quantised positions decode as dequantizeOffset + dequantizeScale * position.
+        glm::vec3 dequantizeOffset{0.f};
+
+        float dequantizeScale = 1.f;
+
+        glm::vec3 uniformColor{1.f};
+
         void loadModel(const std::string &filePath);
 
+        // Packs the geometry into the requested K3VertexFormat. UNIFORM_COLOR is dropped if the
+        // colors differ and HALF_UV if the uvs don't survive half precision. Round trip error is logged.
+        void encode(uint32_t formatFlags);
+
+        bool isEncoded() const { return m_mappedEncodedVertices != nullptr || !encodedVertices.empty(); }
+
+        // vertexFormat.getStride() * vertexCount() bytes, from the mesh cache mapping when loaded from one.
+        const uint8_t *encodedVertexData() const;
+
+        void computeBounds();
+
+        // Picks the index width for upload. Returns VK_INDEX_TYPE_UINT16 with shortIndices filled
+        // when every sub mesh spans at most 64K vertices, otherwise VK_INDEX_TYPE_UINT32 and a single
+        // sub mesh over indexData().
+        VkIndexType buildIndices(std::vector<uint16_t> &shortIndices, std::vector<K3SubMesh> &subMeshes) const;
+
+        // Indices to upload, pointed to by data. A builder loaded from the mesh cache reuses the
+        // width and 16-bit copy stored there, otherwise this runs buildIndices.
+        VkIndexType getUploadIndices(std::vector<uint16_t> &shortIndices, std::vector<K3SubMesh> &subMeshes, const void *&data) const;
+
+        // Geometry views. These point into the mesh cache mapping when the builder was loaded
+        // from one, otherwise into vertices/indices.
+        const K3Vertex *vertexData() const;
+
+        uint32_t vertexCount() const;
+
+        const uint32_t *indexData() const;
+
+        uint32_t indexCount() const;
+
+        bool isMapped() const { return m_mappedFile != nullptr; }
+
+        // Host bytes held by the builder, including the mesh cache mapping it reads from.
+        size_t getMemoryUsage() const;
+
+        // The tinyobj reader K3ObjParser falls back to, and is checked against.
+        static void loadObjWithTinyObj(const std::string &filePath, K3ObjData &data);
+
+        static K3Vertex assembleVertex(const K3ObjData &data, const K3ObjCorner &corner);
+
+        private:
+
+            void parseObj(const std::string &filePath);
+
+            std::shared_ptr<K3MappedFile> m_mappedFile = nullptr;
+
+            const K3Vertex *m_mappedVertices = nullptr;
+
+            uint32_t m_mappedVertexCount = 0;
+
+            const uint32_t *m_mappedIndices = nullptr;
+
+            uint32_t m_mappedIndexCount = 0;
+
+            const uint8_t *m_mappedEncodedVertices = nullptr;
+
+            VkIndexType m_mappedIndexType = VK_INDEX_TYPE_UINT32;
+
+            const uint16_t *m_mappedShortIndices = nullptr;
+
+            const K3SubMesh *m_mappedSubMeshes = nullptr;
+
+            uint32_t m_mappedSubMeshCount = 0;
+
+        friend class K3MeshCache;
+
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vulkan/vulkan.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace k3::graphics {
+
+    struct K3Vertex;
+
+    /**
+     * Layout of an encoded vertex stream. Flags of 0 is the plain K3Vertex layout; each flag
+     * swaps one attribute for a compact encoding. Attributes keep their K3Vertex locations and
+     * order, and the color attribute is left out entirely with UNIFORM_COLOR.
+     *
+     *  position  float3 (12)  or QUANTIZED_POSITION  snorm16x4 (8) around a per-mesh centre and scale
+     *  color     float3 (12)  or UNIFORM_COLOR       omitted, supplied per instance
+     *  normal    float3 (12)  or OCTAHEDRAL_NORMAL   snorm16x2 (4)
+     *  uv        float2 (8)   or HALF_UV             half2 (4)
+     */
+    class K3VertexFormat {
+
+        public:
+
+            static constexpr uint32_t QUANTIZED_POSITION = 1u << 0;
+
+            static constexpr uint32_t UNIFORM_COLOR = 1u << 1;
+
+            static constexpr uint32_t OCTAHEDRAL_NORMAL = 1u << 2;
+
+            static constexpr uint32_t HALF_UV = 1u << 3;
+
+            static constexpr uint32_t COMPACT = QUANTIZED_POSITION | UNIFORM_COLOR | OCTAHEDRAL_NORMAL | HALF_UV;
+
+            K3VertexFormat(uint32_t flags = 0);
+
+            uint32_t getFlags() const { return m_flags; }
+
+            bool has(uint32_t flag) const { return (m_flags & flag) != 0; }
+
+            uint32_t getStride() const { return m_stride; }
+
+            std::vector<VkVertexInputBindingDescription> getBindingDescriptions() const;
+
+            std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+
+            // Only the normal and color encodings change the shader, position and uv are
+            // expanded by the vertex fetch. pushConstants picks the variant that reads its instance
+            // from push constants rather than the instance buffer.
+            std::string getVertexShaderPath(bool pushConstants = false) const;
+
+            // Writes one vertex at dst. position is expected already centred and scaled into [-1, 1]
+            // when QUANTIZED_POSITION is set.
+            void encode(const K3Vertex &vertex, uint8_t *dst) const;
+
+            // Inverse of encode, leaving the position in the same normalised space and the color
+            // untouched when UNIFORM_COLOR is set.
+            void decode(const uint8_t *src, K3Vertex &vertex) const;
+
+            static glm::vec2 encodeOctahedral(const glm::vec3 &normal);
+
+            static glm::vec3 decodeOctahedral(const glm::vec2 &encoded);
+
+        private:
+
+            uint32_t m_flags = 0;
+
+            uint32_t m_stride = 0;
+
+            uint32_t m_positionOffset = 0;
+
+            uint32_t m_colorOffset = 0;
+
+            uint32_t m_normalOffset = 0;
+
+            uint32_t m_uvOffset = 0;
+
+    };
+
+}
\ No newline at end of file
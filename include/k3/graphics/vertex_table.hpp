@@ -0,0 +1,52 @@
+#pragma once
+
+#include "k3/logging/log.hpp"
+
+#include "vertex.hpp"
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace k3::graphics {
+
+    /**
+     * Flat open addressing table mapping a K3Vertex to its index in a vertex array. Each slot
+     * packs the 32 bit hash with the vertex index so a probe touches one cache line, and the
+     * table is sized once up front from the corner count so it never rehashes.
+     */
+    class K3VertexTable {
+
+        public:
+
+            // Above this many corners loadModel switches to the parallel sort based path.
+            static constexpr size_t SORTED_DEDUP_THRESHOLD = 4u * 1024u * 1024u;
+
+            K3VertexTable(size_t maxVertexCount);
+
+            // Returns the index of a vertex equal to vertex, or records candidate for it and
+            // returns candidate. vertices is the array the stored indices refer to.
+            uint32_t findOrInsert(const K3Vertex &vertex, uint32_t candidate, const K3Vertex *vertices);
+
+            uint32_t size() const { return m_size; }
+
+            // Bitwise hash over the 44 vertex bytes with -0.0 folded onto 0.0 to agree with operator==.
+            static uint32_t hash(const K3Vertex &vertex);
+
+            // Sort based dedup for very large corner arrays. Produces the same vertices and
+            // indices, in the same first use order, as inserting every corner into the table.
+            static void deduplicateSorted(const std::vector<K3Vertex> &corners, std::vector<K3Vertex> &vertices, std::vector<uint32_t> &indices, K3ThreadPool &pool = K3ThreadPool::shared());
+
+        private:
+
+            static constexpr uint64_t EMPTY_SLOT = ~0ull;
+
+            std::vector<uint64_t> m_slots;
+
+            size_t m_mask = 0;
+
+            uint32_t m_size = 0;
+
+    };
+
+}
\ No newline at end of file
@@ -39,7 +39,7 @@ namespace k3::graphics {
 
             GLFWwindow *getGLFWwindow() const { return m_glfw_window; };
 
-            void createWindowSurface(VkInstance instance, VkSurfaceKHR *surface);
+            void createWindowSurface(VkInstance instance, VkSurfaceKHR *surface, const VkAllocationCallbacks *allocator = nullptr);
 
             void setWindowName(std::string windowName);
 
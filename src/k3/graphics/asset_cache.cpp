@@ -0,0 +1,245 @@
+#include "k3/graphics/asset_cache.hpp"
+#include "k3/graphics/mapped_file.hpp"
+#include "k3/graphics/swapchain.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace k3::graphics {
+
+    K3AssetCache::K3AssetCache(std::shared_ptr<K3ModelLoader> loader, uint64_t budgetBytes) : m_loader {loader}, m_budgetBytes {budgetBytes} {
+        KE_IN("({})", budgetBytes);
+        KE_OUT(KE_NOARG);
+    }
+
+    K3AssetCache::~K3AssetCache() {
+        KE_IN("(): assets:{} retired:{}", m_assets.size(), m_retired.size());
+        std::vector<K3ModelHandle> loading{};
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for(const auto &asset : m_assets) {
+                if(asset.model == nullptr && asset.handle) {
+                    loading.push_back(asset.handle);
+                }
+            }
+        }
+        // Without the lock, the tasks take it in findContent.
+        for(auto &handle : loading) {
+            handle.wait();
+        }
+        m_assetsByPath.clear();
+        m_assetsByContent.clear();
+        m_assets.clear();
+        m_retired.clear();
+        m_loader = nullptr;
+        KE_OUT(KE_NOARG);
+    }
+
+    std::string K3AssetCache::normalisePath(const std::string &filePath) {
+        std::error_code error;
+        std::filesystem::path path = std::filesystem::weakly_canonical(filePath, error);
+        if(error) {
+            path = std::filesystem::path(filePath).lexically_normal();
+        }
+        return path.generic_string();
+    }
+
+    uint64_t K3AssetCache::hashFile(const std::string &filePath) {
+        std::shared_ptr<K3MappedFile> file = K3MappedFile::open(filePath);
+        if(file == nullptr) {
+            return 0;
+        }
+        uint64_t hash = 14695981039346656037ull;
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(file->data());
+        for(size_t i = 0; i < file->size(); i++) {
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string K3AssetCache::makeKey(const std::string &name, uint32_t vertexFormat, uint32_t flags) {
+        return name + "|" + std::to_string(vertexFormat) + "|" + std::to_string(flags);
+    }
+
+    K3ModelHandle K3AssetCache::loadModel(const std::string &filePath, uint32_t vertexFormat, uint32_t flags) {
+        KE_IN("({})", filePath);
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const std::string pathKey = makeKey(normalisePath(filePath), vertexFormat, flags);
+        auto byPath = m_assetsByPath.find(pathKey);
+        if(byPath != m_assetsByPath.end()) {
+            m_hits++;
+            touch(byPath->second);
+            KE_OUT("(): cached");
+            return byPath->second->model != nullptr ? K3ModelHandle{byPath->second->model} : byPath->second->handle;
+        }
+
+        // Hashing reads the whole file, so it is the first step of the load task rather than done here.
+        m_misses++;
+        K3Asset asset{};
+        asset.pathKeys.push_back(pathKey);
+        asset.vertexFormat = vertexFormat;
+        asset.flags = flags;
+        asset.handle = m_loader->load(filePath, vertexFormat, (flags & KEEP_BUILDER) != 0, [this, pathKey, filePath]() {
+            return findContent(pathKey, filePath);
+        });
+        m_assets.push_front(std::move(asset));
+        m_assetsByPath[pathKey] = m_assets.begin();
+
+        KE_OUT("(): loading");
+        return m_assets.front().handle;
+    }
+
+    void K3AssetCache::update() {
+        KE_IN_SPAM(KE_NOARG);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frame++;
+
+        uint64_t totalBytes = 0;
+        for(auto asset = m_assets.begin(); asset != m_assets.end();) {
+            auto current = asset++;
+            if(current->model == nullptr && current->handle.isReady()) {
+                current->model = current->handle.get();
+                // Drop the handle so the cache holds exactly one reference to the model.
+                current->handle = {};
+                if(current->model == nullptr) {
+                    // Failed, forget it so the next request tries again.
+                    evict(current);
+                    continue;
+                }
+                current->deviceBytes = current->model->getDeviceMemorySize();
+                current->hostBytes = current->model->getHostMemorySize();
+            }
+            if(current->model != nullptr && !current->duplicateKey.empty() && !resolveDuplicate(current)) {
+                continue;
+            }
+            totalBytes += current->deviceBytes + current->hostBytes;
+        }
+
+        // Device memory near its budget asks for that much more to go, whatever our own budget says.
+        const uint64_t excessBytes = m_loader->getDevice()->getBudgetExcess();
+        uint64_t freedDeviceBytes = 0;
+
+        // Oldest first, skipping anything still loading or held elsewhere.
+        for(auto asset = m_assets.end(); (totalBytes > m_budgetBytes || freedDeviceBytes < excessBytes) && asset != m_assets.begin();) {
+            auto current = --asset;
+            if(current->model != nullptr && current->model.use_count() == 1) {
+                totalBytes -= current->deviceBytes + current->hostBytes;
+                freedDeviceBytes += current->deviceBytes;
+                KE_DEBUG("Evicting \"{}\" ({} bytes)", current->pathKeys.front(), current->deviceBytes + current->hostBytes);
+                m_retired.emplace_back(m_frame, current->model);
+                m_evictions++;
+                asset = std::next(current);
+                evict(current);
+            }
+        }
+
+        // Frames recorded before the eviction may still reference the buffers.
+        const uint64_t frame = m_frame;
+        m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(), [frame](const auto &retired) {
+            return frame - retired.first >= static_cast<uint64_t>(K3SwapChain::MAX_FRAMES_IN_FLIGHT);
+        }), m_retired.end());
+        KE_OUT_SPAM(KE_NOARG);
+    }
+
+    void K3AssetCache::touch(K3AssetList::iterator asset) {
+        m_assets.splice(m_assets.begin(), m_assets, asset);
+    }
+
+    K3ModelHandle K3AssetCache::findContent(const std::string &pathKey, const std::string &filePath) {
+        const uint64_t hash = hashFile(filePath);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // loadModel still holds the lock until the asset is registered, so it is found here.
+        auto byPath = m_assetsByPath.find(pathKey);
+        if(hash == 0 || byPath == m_assetsByPath.end()) {
+            return {};
+        }
+        const K3AssetList::iterator asset = byPath->second;
+        const std::string contentKey = makeKey(std::to_string(hash), asset->vertexFormat, asset->flags);
+        auto byContent = m_assetsByContent.find(contentKey);
+        if(byContent == m_assetsByContent.end()) {
+            asset->contentKey = contentKey;
+            m_assetsByContent[contentKey] = asset;
+            return {};
+        }
+
+        // A new name for contents already loaded or loading under another path. That asset
+        // registered its key from its own load task, so it was queued before this one.
+        const K3AssetList::iterator original = byContent->second;
+        KE_DEBUG("\"{}\" is a duplicate of \"{}\"", asset->pathKeys.front(), original->pathKeys.front());
+        asset->duplicateKey = contentKey;
+        return original->model != nullptr ? K3ModelHandle{original->model} : original->handle;
+    }
+
+    bool K3AssetCache::resolveDuplicate(K3AssetList::iterator asset) {
+        auto byContent = m_assetsByContent.find(asset->duplicateKey);
+        if(byContent == m_assetsByContent.end()) {
+            // The original failed or was evicted since, so this copy holds the content now.
+            asset->contentKey = asset->duplicateKey;
+            asset->duplicateKey.clear();
+            m_assetsByContent[asset->contentKey] = asset;
+            return true;
+        }
+        const K3AssetList::iterator original = byContent->second;
+        if(original->model == nullptr) {
+            // Finished together and the original is further down the list, fold it next update.
+            return true;
+        }
+        asset->duplicateKey.clear();
+        if(original->model != asset->model) {
+            // The original failed and was reloaded while this copy loaded its own, keep both.
+            return true;
+        }
+
+        // Same model, so nothing retires. Whoever asked for the copy keeps the shared model.
+        for(const auto &pathKey : asset->pathKeys) {
+            original->pathKeys.push_back(pathKey);
+            m_assetsByPath[pathKey] = original;
+        }
+        m_assets.erase(asset);
+        return false;
+    }
+
+    void K3AssetCache::evict(K3AssetList::iterator asset) {
+        for(const auto &pathKey : asset->pathKeys) {
+            m_assetsByPath.erase(pathKey);
+        }
+        if(!asset->contentKey.empty()) {
+            m_assetsByContent.erase(asset->contentKey);
+        }
+        m_assets.erase(asset);
+    }
+
+    void K3AssetCache::setBudget(uint64_t budgetBytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_budgetBytes = budgetBytes;
+    }
+
+    uint64_t K3AssetCache::getBudget() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_budgetBytes;
+    }
+
+    K3AssetCacheStatistics K3AssetCache::getStatistics() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        K3AssetCacheStatistics statistics{};
+        statistics.assetCount = static_cast<uint32_t>(m_assets.size());
+        for(const auto &asset : m_assets) {
+            if(asset.model == nullptr) {
+                statistics.loadingCount++;
+                continue;
+            }
+            if(asset.model.use_count() > 1) {
+                statistics.referencedCount++;
+            }
+            statistics.deviceBytes += asset.deviceBytes;
+            statistics.hostBytes += asset.hostBytes;
+        }
+        statistics.budgetBytes = m_budgetBytes;
+        statistics.hits = m_hits;
+        statistics.misses = m_misses;
+        statistics.evictions = m_evictions;
+        return statistics;
+    }
+
+}
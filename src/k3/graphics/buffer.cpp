@@ -27,7 +27,8 @@ namespace k3::graphics {
             uint32_t instanceCount,
             VkBufferUsageFlags usageFlags,
             VkMemoryPropertyFlags memoryPropertyFlags,
-            VkDeviceSize minOffsetAlignment)
+            VkDeviceSize minOffsetAlignment,
+            K3MemoryCategory category)
             : m_device{device},
             m_vk_instanceSize{instanceSize},
             m_instanceCount{instanceCount},
@@ -35,17 +36,33 @@ namespace k3::graphics {
             m_vk_memoryPropertyFlags{memoryPropertyFlags} {
         m_vk_alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         m_vk_bufferSize = m_vk_alignmentSize * instanceCount;
-        device->createBuffer(m_vk_bufferSize, m_vk_usageFlags, m_vk_memoryPropertyFlags, m_vk_buffer, m_vk_memory);
+        device->createBuffer(m_vk_bufferSize, m_vk_usageFlags, m_vk_memoryPropertyFlags, m_vk_buffer, m_allocation, category);
     }
     
     K3Buffer::~K3Buffer() {
         unmap();
-        vkDestroyBuffer(m_device->getDevice(), m_vk_buffer, nullptr);
-        vkFreeMemory(m_device->getDevice(), m_vk_memory, nullptr);
+        // Stops the defragmenter from swapping the handle from under the destroy.
+        m_device->getAllocator().clearRelocatable(m_allocation);
+        m_device->destroyBuffer(m_vk_buffer, m_allocation);
+    }
+
+    /**
+     * Swap in a relocated copy of the buffer
+     *
+     * @param buffer The new buffer, bound to allocation
+     * @param allocation Memory the contents were copied to
+     */
+    void K3Buffer::relocate(VkBuffer buffer, const K3Allocation &allocation) {
+        if (m_mapped) {
+            m_mapped = static_cast<char *>(allocation.mapped) + (static_cast<char *>(m_mapped) - static_cast<char *>(m_allocation.mapped));
+        }
+        m_vk_buffer = buffer;
+        m_allocation = allocation;
     }
     
     /**
      * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+     * Host visible memory stays mapped by the allocator, so this only points into that mapping.
      *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
@@ -54,18 +71,21 @@ namespace k3::graphics {
      * @return VkResult of the buffer mapping call
      */
     VkResult K3Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(m_vk_buffer && m_vk_memory && "Called map on buffer before create");
-        return vkMapMemory(m_device->getDevice(), m_vk_memory, offset, size, 0, &m_mapped);
+        assert(m_vk_buffer && m_allocation.memory && "Called map on buffer before create");
+        if (m_allocation.mapped == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        m_mapped = static_cast<char *>(m_allocation.mapped) + offset;
+        return VK_SUCCESS;
     }
     
     /**
      * Unmap a mapped memory range
      *
-     * @note Does not return a result as vkUnmapMemory can't fail
+     * @note The allocator owns the mapping, this only forgets the pointer
      */
     void K3Buffer::unmap() {
         if (m_mapped) {
-            vkUnmapMemory(m_device->getDevice(), m_vk_memory);
             m_mapped = nullptr;
         }
     }
@@ -103,12 +123,7 @@ namespace k3::graphics {
      * @return VkResult of the flush call
      */
     VkResult K3Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = m_vk_memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(m_device->getDevice(), 1, &mappedRange);
+        return m_device->getAllocator().flush(m_allocation, size, offset);
     }
     
     /**
@@ -123,12 +138,7 @@ namespace k3::graphics {
      * @return VkResult of the invalidate call
      */
     VkResult K3Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = m_vk_memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(m_device->getDevice(), 1, &mappedRange);
+        return m_device->getAllocator().invalidate(m_allocation, size, offset);
     }
     
     /**
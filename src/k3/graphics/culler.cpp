@@ -0,0 +1,407 @@
+#include "k3/graphics/culler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace k3::graphics {
+
+    K3Culler::K3Culler(std::shared_ptr<K3Device> device) : m_device {device} {
+        KE_IN(KE_NOARG);
+
+        // A throwing constructor never reaches the destructor, so release what was made here.
+        try {
+            createPipelines();
+            createStatisticsBuffer();
+
+            VkSamplerCreateInfo samplerInfo{};
+            samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter = VK_FILTER_NEAREST;
+            samplerInfo.minFilter = VK_FILTER_NEAREST;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+            if(vkCreateSampler(m_device->getDevice(), &samplerInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SAMPLER), &m_sampler) != VK_SUCCESS) {
+                KE_CRITICAL("Failed to create Hi-Z sampler.");
+                throw std::runtime_error("Failed to create Hi-Z sampler.");
+            }
+
+            // A placeholder until a frame has been drawn, the cull pass always binds a pyramid.
+            createHiZ({1, 1});
+        } catch(...) {
+            destroy();
+            throw;
+        }
+
+        KE_OUT(KE_NOARG);
+    }
+
+    K3Culler::~K3Culler() {
+        KE_IN(KE_NOARG);
+        destroy();
+        KE_OUT(KE_NOARG);
+    }
+
+    void K3Culler::destroy() {
+        destroyHiZ();
+        vkDestroySampler(m_device->getDevice(), m_sampler, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SAMPLER));
+        m_sampler = VK_NULL_HANDLE;
+        if(m_statisticsBuffer != VK_NULL_HANDLE) {
+            m_device->destroyBuffer(m_statisticsBuffer, m_statisticsAllocation);
+        }
+        m_cullPipeline = nullptr;
+        m_hizPipeline = nullptr;
+        vkDestroyPipelineLayout(m_device->getDevice(), m_cullPipelineLayout, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+        vkDestroyPipelineLayout(m_device->getDevice(), m_hizPipelineLayout, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+        m_cullPipelineLayout = VK_NULL_HANDLE;
+        m_hizPipelineLayout = VK_NULL_HANDLE;
+        m_cullSets.clear();
+        m_cullPool = nullptr;
+        m_hizPool = nullptr;
+        m_cullSetLayout = nullptr;
+        m_hizSetLayout = nullptr;
+    }
+
+    void K3Culler::createPipelines() {
+        KE_IN(KE_NOARG);
+
+        m_cullSetLayout = K3DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+        m_hizSetLayout = K3DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+
+        m_cullPool = K3DescriptorPool::Builder(m_device)
+            .setMaxSets(K3SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, K3SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * K3SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, K3SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+        // Level sets for the largest pyramid a 16K image needs, plus the depth sets.
+        const uint32_t hizSets = 16 + K3SwapChain::MAX_FRAMES_IN_FLIGHT;
+        m_hizPool = K3DescriptorPool::Builder(m_device)
+            .setMaxSets(hizSets)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, hizSets)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, hizSets)
+            .build();
+
+        m_cullSets.resize(K3SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for(VkDescriptorSet &set : m_cullSets) {
+            if(!m_cullPool->allocateDescriptor(m_cullSetLayout->getDescriptorSetLayout(), set)) {
+                throw std::runtime_error("failed to allocate cull descriptor set!");
+            }
+        }
+
+        VkDescriptorSetLayout cullSetLayout = m_cullSetLayout->getDescriptorSetLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+        if(vkCreatePipelineLayout(m_device->getDevice(), &pipelineLayoutInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &m_cullPipelineLayout) != VK_SUCCESS) {
+            KE_CRITICAL("Failed to create cull pipeline layout.");
+            throw std::runtime_error("Failed to create cull pipeline layout.");
+        }
+
+        VkDescriptorSetLayout hizSetLayout = m_hizSetLayout->getDescriptorSetLayout();
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(K3HiZPush);
+        pipelineLayoutInfo.pSetLayouts = &hizSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if(vkCreatePipelineLayout(m_device->getDevice(), &pipelineLayoutInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &m_hizPipelineLayout) != VK_SUCCESS) {
+            KE_CRITICAL("Failed to create Hi-Z pipeline layout.");
+            throw std::runtime_error("Failed to create Hi-Z pipeline layout.");
+        }
+
+        m_cullPipeline = std::make_unique<K3Pipeline>(m_device, "./shaders/cull.comp.spv", m_cullPipelineLayout);
+        m_hizPipeline = std::make_unique<K3Pipeline>(m_device, "./shaders/hiz.comp.spv", m_hizPipelineLayout);
+
+        KE_OUT(KE_NOARG);
+    }
+
+    void K3Culler::createStatisticsBuffer() {
+        KE_IN(KE_NOARG);
+        const VkDeviceSize alignment = std::max<VkDeviceSize>(m_device->m_vk_properties.limits.minStorageBufferOffsetAlignment, 1);
+        m_statisticsStride = (sizeof(K3CullStatistics) + alignment - 1) / alignment * alignment;
+        m_device->createBuffer(m_statisticsStride * K3SwapChain::MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_statisticsBuffer, m_statisticsAllocation);
+        if(m_statisticsAllocation.mapped == nullptr) {
+            KE_CRITICAL("failed to map cull statistics!");
+            throw std::runtime_error("failed to map cull statistics!");
+        }
+        KE_OUT("(): stride:{}", m_statisticsStride);
+    }
+
+    void K3Culler::createHiZ(VkExtent2D extent) {
+        KE_IN("({}, {})", extent.width, extent.height);
+        if(m_hizImage != VK_NULL_HANDLE) {
+            // Frames in flight may still sample the old pyramid.
+            std::lock_guard<std::mutex> lock(m_device->getQueueMutex());
+            vkDeviceWaitIdle(m_device->getDevice());
+            destroyHiZ();
+        }
+
+        uint32_t levels = 1;
+        while((std::max(extent.width, extent.height) >> levels) > 0) {
+            levels++;
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = levels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        m_device->createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_hizImage, m_hizAllocation, K3MemoryCategory::DEPTH);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_hizImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+        if(vkCreateImageView(m_device->getDevice(), &viewInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &m_hizView) != VK_SUCCESS) {
+            KE_CRITICAL("failed to create Hi-Z image view!");
+            throw std::runtime_error("failed to create Hi-Z image view!");
+        }
+        m_hizLevelViews.resize(levels);
+        for(uint32_t level = 0; level < levels; level++) {
+            viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+            if(vkCreateImageView(m_device->getDevice(), &viewInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &m_hizLevelViews[level]) != VK_SUCCESS) {
+                KE_CRITICAL("failed to create Hi-Z image view!");
+                throw std::runtime_error("failed to create Hi-Z image view!");
+            }
+        }
+
+        m_hizDepthSets.resize(K3SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for(VkDescriptorSet &set : m_hizDepthSets) {
+            if(!m_hizPool->allocateDescriptor(m_hizSetLayout->getDescriptorSetLayout(), set)) {
+                throw std::runtime_error("failed to allocate Hi-Z descriptor set!");
+            }
+        }
+        m_hizLevelSets.assign(levels, VK_NULL_HANDLE);
+        for(uint32_t level = 1; level < levels; level++) {
+            VkDescriptorImageInfo sourceInfo{m_sampler, m_hizLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+            VkDescriptorImageInfo destinationInfo{VK_NULL_HANDLE, m_hizLevelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+            if(!K3DescriptorWriter(*m_hizSetLayout, *m_hizPool).writeImage(0, &sourceInfo).writeImage(1, &destinationInfo).build(m_hizLevelSets[level])) {
+                throw std::runtime_error("failed to allocate Hi-Z descriptor set!");
+            }
+        }
+
+        m_hizExtent = extent;
+        m_hizInitialized = false;
+        m_hizValid = false;
+        KE_OUT("(): levels:{}", levels);
+    }
+
+    void K3Culler::destroyHiZ() {
+        for(VkImageView view : m_hizLevelViews) {
+            vkDestroyImageView(m_device->getDevice(), view, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+        }
+        m_hizLevelViews.clear();
+        vkDestroyImageView(m_device->getDevice(), m_hizView, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+        m_hizView = VK_NULL_HANDLE;
+        if(m_hizImage != VK_NULL_HANDLE) {
+            m_device->destroyImage(m_hizImage, m_hizAllocation);
+        }
+        m_hizDepthSets.clear();
+        m_hizLevelSets.clear();
+        if(m_hizPool != nullptr) {
+            m_hizPool->resetPool();
+        }
+    }
+
+    void K3Culler::buildHiZ(VkCommandBuffer commandBuffer, int frameIndex, VkImage depthImage, VkImageView depthImageView, VkExtent2D extent) {
+        if(extent.width != m_hizExtent.width || extent.height != m_hizExtent.height) {
+            createHiZ(extent);
+        }
+        const uint32_t levels = static_cast<uint32_t>(m_hizLevelViews.size());
+
+        // Depth writes of the last frame before reading it, and earlier cull reads of the
+        // pyramid before overwriting it.
+        VkImageMemoryBarrier barriers[2]{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = depthImage;
+        barriers[0].subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+        barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].oldLayout = m_hizInitialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].image = m_hizImage;
+        barriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+        m_hizInitialized = true;
+
+        // The frame's fence has been waited on, so its depth set is free to rewrite.
+        VkDescriptorImageInfo depthInfo{m_sampler, depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo levelInfo{VK_NULL_HANDLE, m_hizLevelViews[0], VK_IMAGE_LAYOUT_GENERAL};
+        K3DescriptorWriter(*m_hizSetLayout, *m_hizPool)
+            .writeImage(0, &depthInfo)
+            .writeImage(1, &levelInfo)
+            .overwrite(m_hizDepthSets[frameIndex]);
+
+        m_hizPipeline->bind(commandBuffer);
+        glm::ivec2 sourceSize{static_cast<int>(extent.width), static_cast<int>(extent.height)};
+        for(uint32_t level = 0; level < levels; level++) {
+            K3HiZPush push{};
+            push.sourceSize = sourceSize;
+            // Mip sizes round down, the shader folds the odd row or column into the edge texels.
+            push.destinationSize = level == 0 ? sourceSize : glm::max(sourceSize / 2, glm::ivec2(1));
+            push.copy = level == 0 ? 1 : 0;
+            if(level > 0) {
+                VkImageMemoryBarrier levelBarrier{};
+                levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+                levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+                levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                levelBarrier.image = m_hizImage;
+                levelBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1, 0, 1};
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+            }
+            VkDescriptorSet set = level == 0 ? m_hizDepthSets[frameIndex] : m_hizLevelSets[level];
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_hizPipelineLayout, 0, 1, &set, 0, nullptr);
+            vkCmdPushConstants(commandBuffer, m_hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(K3HiZPush), &push);
+            vkCmdDispatch(commandBuffer, (push.destinationSize.x + HIZ_WORKGROUP_SIZE - 1) / HIZ_WORKGROUP_SIZE,
+                (push.destinationSize.y + HIZ_WORKGROUP_SIZE - 1) / HIZ_WORKGROUP_SIZE, 1);
+            sourceSize = push.destinationSize;
+        }
+
+        // The last level for the cull pass, and the depth image back for this frame's render
+        // pass, which must not clear it before the reads are done.
+        barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, levels - 1, 1, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 2, barriers);
+        m_hizValid = true;
+    }
+
+    bool K3Culler::cull(VkCommandBuffer commandBuffer, int frameIndex, K3FrameAllocator &frameAllocator, const glm::mat4 &projectionView,
+            const K3FrameAllocation &objects, const K3FrameAllocation &instances, const K3FrameAllocation &visibleInstances,
+            const K3FrameAllocation &commands, uint32_t objectCount) {
+        K3CullParams params{};
+        params.projectionView = projectionView;
+        const std::array<glm::vec4, 6> planes = extractFrustumPlanes(projectionView);
+        std::copy(planes.begin(), planes.end(), params.planes);
+        params.hizSize = glm::vec2(static_cast<float>(m_hizExtent.width), static_cast<float>(m_hizExtent.height));
+        params.objectCount = objectCount;
+        params.occlusion = m_occlusion && m_hizValid ? 1 : 0;
+        params.hizLevels = static_cast<uint32_t>(m_hizLevelViews.size());
+        K3FrameAllocation paramsAllocation = frameAllocator.push(&params, sizeof(K3CullParams));
+        if(paramsAllocation.mapped == nullptr) {
+            KE_WARN("No frame memory for the cull parameters.");
+            return false;
+        }
+
+        // The frame's fence has been waited on, so the slot holds its last results.
+        const VkDeviceSize statisticsOffset = m_statisticsStride * frameIndex;
+        if(m_statisticsPending[frameIndex]) {
+            m_device->getAllocator().invalidate(m_statisticsAllocation, sizeof(K3CullStatistics), statisticsOffset);
+            std::memcpy(&m_statistics, static_cast<char *>(m_statisticsAllocation.mapped) + statisticsOffset, sizeof(K3CullStatistics));
+        }
+        m_statisticsPending[frameIndex] = true;
+
+        if(!m_hizInitialized) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = m_hizImage;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, static_cast<uint32_t>(m_hizLevelViews.size()), 0, 1};
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            m_hizInitialized = true;
+        }
+
+        VkDescriptorBufferInfo paramsInfo = paramsAllocation.descriptorInfo();
+        VkDescriptorBufferInfo objectsInfo = objects.descriptorInfo();
+        VkDescriptorBufferInfo instancesInfo = instances.descriptorInfo();
+        VkDescriptorBufferInfo visibleInfo = visibleInstances.descriptorInfo();
+        VkDescriptorBufferInfo commandsInfo = commands.descriptorInfo();
+        VkDescriptorBufferInfo statisticsInfo{m_statisticsBuffer, statisticsOffset, sizeof(K3CullStatistics)};
+        VkDescriptorImageInfo hizInfo{m_sampler, m_hizView, VK_IMAGE_LAYOUT_GENERAL};
+        K3DescriptorWriter(*m_cullSetLayout, *m_cullPool)
+            .writeBuffer(0, &paramsInfo)
+            .writeBuffer(1, &objectsInfo)
+            .writeBuffer(2, &instancesInfo)
+            .writeBuffer(3, &visibleInfo)
+            .writeBuffer(4, &commandsInfo)
+            .writeBuffer(5, &statisticsInfo)
+            .writeImage(6, &hizInfo)
+            .overwrite(m_cullSets[frameIndex]);
+
+        vkCmdFillBuffer(commandBuffer, m_statisticsBuffer, statisticsOffset, sizeof(K3CullStatistics), 0);
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        m_cullPipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1, &m_cullSets[frameIndex], 0, nullptr);
+        vkCmdDispatch(commandBuffer, (objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+        // Draws read the counts and instances, the host reads the statistics after the fence.
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        return true;
+    }
+
+    std::array<glm::vec4, 6> K3Culler::extractFrustumPlanes(const glm::mat4 &projectionView) {
+        // Rows of the matrix, glm is column major. Depth is [0, 1], so near is row 2 alone.
+        const glm::vec4 row0{projectionView[0][0], projectionView[1][0], projectionView[2][0], projectionView[3][0]};
+        const glm::vec4 row1{projectionView[0][1], projectionView[1][1], projectionView[2][1], projectionView[3][1]};
+        const glm::vec4 row2{projectionView[0][2], projectionView[1][2], projectionView[2][2], projectionView[3][2]};
+        const glm::vec4 row3{projectionView[0][3], projectionView[1][3], projectionView[2][3], projectionView[3][3]};
+        std::array<glm::vec4, 6> planes{row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2};
+        for(glm::vec4 &plane : planes) {
+            const float length = glm::length(glm::vec3(plane));
+            if(length > 0.f) {
+                plane /= length;
+            }
+        }
+        return planes;
+    }
+
+}
@@ -0,0 +1,101 @@
+#include "k3/graphics/defragmenter.hpp"
+
+#include <vector>
+
+namespace k3::graphics {
+
+    K3Defragmenter::K3Defragmenter(std::shared_ptr<K3Device> device, VkDeviceSize frameBudget) : m_device {device}, m_frameBudget {frameBudget} {
+        KE_IN("({})", frameBudget);
+        const K3GeometryPool &geometryPool = m_device->getGeometryPool();
+        KE_INFO("Defragmentation leaves the geometry pool alone, its {} MB vertex and {} MB index ranges are reused but never compacted.",
+            geometryPool.getVertexPoolSize() >> 20, geometryPool.getIndexPoolSize() >> 20);
+        KE_OUT(KE_NOARG);
+    }
+
+    K3Defragmenter::~K3Defragmenter() {
+        KE_IN(KE_NOARG);
+        releaseRetired(~0ull);
+        m_device->getAllocator().abortDefragmentation();
+        KE_OUT("(): moved {} bytes in {} buffers", m_movedBytes, m_moveCount);
+    }
+
+    void K3Defragmenter::releaseRetired(uint64_t frame) {
+        while(!m_retired.empty() && m_retired.front().frame <= frame) {
+            K3RetiredBuffer &retired = m_retired.front();
+            m_device->destroyBuffer(retired.buffer, retired.allocation);
+            m_retired.pop_front();
+        }
+    }
+
+    void K3Defragmenter::update(VkCommandBuffer commandBuffer) {
+        m_frame++;
+        // The fence just waited on covers the frame MAX_FRAMES_IN_FLIGHT ago and everything before it.
+        if(m_frame > K3SwapChain::MAX_FRAMES_IN_FLIGHT) {
+            releaseRetired(m_frame - K3SwapChain::MAX_FRAMES_IN_FLIGHT);
+        }
+        if(m_frameBudget == 0 || m_frame < m_retryFrame) {
+            return;
+        }
+
+        K3MemoryAllocator &allocator = m_device->getAllocator();
+        const std::vector<K3Relocatable> plan = allocator.planDefragmentation(m_frameBudget);
+        if(plan.empty()) {
+            return;
+        }
+
+        // Uploads copied on this queue, and last frame's moves, finish writing before the copies read.
+        VkMemoryBarrier uploadBarrier{};
+        uploadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        uploadBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+
+        bool copied = false;
+        for(const K3Relocatable &relocatable : plan) {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = relocatable.bufferSize;
+            bufferInfo.usage = relocatable.usage;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            if(vkCreateBuffer(m_device->getDevice(), &bufferInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_BUFFER), &buffer) != VK_SUCCESS) {
+                KE_WARN("Could not create a buffer to defragment into.");
+                break;
+            }
+            K3Allocation allocation = allocator.allocateForRelocation(buffer, relocatable.allocation);
+            if(allocation.memory == VK_NULL_HANDLE) {
+                // The free space of the other blocks is too splintered to take the rest.
+                KE_DEBUG("No room to move {} bytes, leaving the block for {} frames.", relocatable.allocation.size, RETRY_FRAMES);
+                vkDestroyBuffer(m_device->getDevice(), buffer, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_BUFFER));
+                allocator.abortDefragmentation();
+                m_retryFrame = m_frame + RETRY_FRAMES;
+                break;
+            }
+            if(!allocator.commitRelocation(relocatable.allocation, buffer, allocation)) {
+                // The owner freed it after it was planned.
+                m_device->destroyBuffer(buffer, allocation);
+                continue;
+            }
+            VkBufferCopy region{};
+            region.size = relocatable.bufferSize;
+            vkCmdCopyBuffer(commandBuffer, relocatable.buffer, buffer, 1, &region);
+            m_retired.push_back({relocatable.buffer, relocatable.allocation, m_frame});
+            m_movedBytes += relocatable.allocation.size;
+            m_moveCount++;
+            copied = true;
+        }
+        if(!copied) {
+            return;
+        }
+
+        // Draws later in the frame read the copies through the owners' new handles.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+}
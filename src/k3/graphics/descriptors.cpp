@@ -33,13 +33,13 @@ namespace k3::graphics {
         descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
-        if (vkCreateDescriptorSetLayout(m_device->getDevice(), &descriptorSetLayoutInfo, nullptr, &m_vk_descriptorSetLayout) != VK_SUCCESS) {
+        if (vkCreateDescriptorSetLayout(m_device->getDevice(), &descriptorSetLayoutInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &m_vk_descriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor set layout!");
         }
     }
  
     K3DescriptorSetLayout::~K3DescriptorSetLayout() {
-        vkDestroyDescriptorSetLayout(m_device->getDevice(), m_vk_descriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(m_device->getDevice(), m_vk_descriptorSetLayout, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
     }
 
     /*****************************************************************************************/
@@ -73,13 +73,13 @@ namespace k3::graphics {
         descriptorPoolInfo.maxSets = maxSets;
         descriptorPoolInfo.flags = poolFlags;
         
-        if (vkCreateDescriptorPool(m_device->getDevice(), &descriptorPoolInfo, nullptr, &m_vk_descriptorPool) != VK_SUCCESS) {
+        if (vkCreateDescriptorPool(m_device->getDevice(), &descriptorPoolInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &m_vk_descriptorPool) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create descriptor pool!");
         }
     }
         
     K3DescriptorPool::~K3DescriptorPool() {
-        vkDestroyDescriptorPool(m_device->getDevice(), m_vk_descriptorPool, nullptr);
+        vkDestroyDescriptorPool(m_device->getDevice(), m_vk_descriptorPool, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
     }
     
     bool K3DescriptorPool::allocateDescriptor(const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet &descriptor) const {
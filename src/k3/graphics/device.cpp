@@ -36,7 +36,7 @@ namespace k3::graphics {
         debugUtilCreateInfo.pUserData = nullptr; 
     }
 
-    K3Device::K3Device(std::shared_ptr<K3Window> window) : m_window{window} {
+    K3Device::K3Device(std::shared_ptr<K3Window> window, std::optional<K3GeometryPlacement> geometryPlacement) : m_window{window} {
         KE_IN("(window@<{}>)", fmt::ptr(window));
 
         // Define Available Extensions
@@ -60,7 +60,10 @@ namespace k3::graphics {
         createSurface();
 
         // Define Device Extensions
-        std::vector<std::string> requestDeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        std::vector<std::string> requestDeviceExtensions{};
+        if(!isHeadless()) {
+            requestDeviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
         std::vector<std::string> availableDeviceExtensions = selectGPUDevice(requestDeviceExtensions);
         // If supported, add VK_KHR_portability_subset
         
@@ -70,10 +73,21 @@ namespace k3::graphics {
             KE_DEBUG("Adding \"{}\" to Device Extensions.", VK_KHR_PORTABILITY_SUBSET);
             requestDeviceExtensions.push_back(VK_KHR_PORTABILITY_SUBSET.c_str());
         } 
+        // If supported, add VK_EXT_memory_budget for live heap usage and budgets.
+        if(std::find(availableDeviceExtensions.begin(), availableDeviceExtensions.end(), VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) != availableDeviceExtensions.end()) {
+            KE_DEBUG("Adding \"{}\" to Device Extensions.", VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            requestDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            m_hasMemoryBudget = true;
+        }
         
         createLogicalDevice(requestDeviceExtensions);
+        m_allocator = std::make_unique<K3MemoryAllocator>(m_physicalDevice, m_device, getAllocationCallbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+        selectGeometryPlacement(geometryPlacement);
+        updateMemoryBudget();
         createDescriptorPool();
         createCommandPool();
+        m_stagingRing = std::make_unique<K3StagingRing>(*this);
+        m_geometryPool = std::make_unique<K3GeometryPool>(*this);
 
         KE_OUT(KE_NOARG);
     }
@@ -81,28 +95,36 @@ namespace k3::graphics {
     K3Device::~K3Device() {
         KE_IN(KE_NOARG);
 
+        m_geometryPool = nullptr;
+        m_stagingRing = nullptr;
+
+        for(auto &threadCommandPool : m_threadCommandPools) {
+            vkDestroyCommandPool(m_device, threadCommandPool.second, getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+        }
+        m_threadCommandPools.clear();
         if (m_commandPool != nullptr) {
-            vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+            vkDestroyCommandPool(m_device, m_commandPool, getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL));
             m_commandPool = nullptr;
         }
         if (m_descriptorPool != nullptr) {
-            vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+            vkDestroyDescriptorPool(m_device, m_descriptorPool, getAllocationCallbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
             m_descriptorPool = nullptr;
         }
+        m_allocator = nullptr;
         if (m_device != nullptr) {
-            vkDestroyDevice(m_device, nullptr);
+            vkDestroyDevice(m_device, getAllocationCallbacks(VK_OBJECT_TYPE_DEVICE));
             m_device = nullptr;
         }
         if (enableValidationLayers && m_debugMessenger != nullptr) {
-            DestroyDebugUtilsMessengerEXT(m_instance, m_debugMessenger, nullptr);
+            DestroyDebugUtilsMessengerEXT(m_instance, m_debugMessenger, getAllocationCallbacks(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT));
             m_debugMessenger = nullptr;
         }
         if (m_surface != nullptr) {
-            vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+            vkDestroySurfaceKHR(m_instance, m_surface, getAllocationCallbacks(VK_OBJECT_TYPE_SURFACE_KHR));
             m_surface = nullptr;
         }
         if (m_instance != nullptr) {
-            vkDestroyInstance(m_instance, nullptr);
+            vkDestroyInstance(m_instance, getAllocationCallbacks(VK_OBJECT_TYPE_INSTANCE));
             m_instance = nullptr;
         }
         m_window = nullptr;
@@ -156,14 +178,14 @@ namespace k3::graphics {
             instanceCreateInfo.enabledLayerCount = static_cast<uint32_t>(m_validationLayers.size());
             instanceCreateInfo.ppEnabledLayerNames = m_validationLayers.data();
             KE_DEBUG("Create Instance");
-            if (vkCreateInstance(&instanceCreateInfo, nullptr, &m_instance) != VK_SUCCESS) {
+            if (vkCreateInstance(&instanceCreateInfo, getAllocationCallbacks(VK_OBJECT_TYPE_INSTANCE), &m_instance) != VK_SUCCESS) {
                 KE_CRITICAL("Failed to create instance!");
             }          
         } else {
             instanceCreateInfo.enabledLayerCount = 0;
             instanceCreateInfo.pNext = nullptr;
             KE_DEBUG("Create Instance");
-            if (vkCreateInstance(&instanceCreateInfo, nullptr, &m_instance) != VK_SUCCESS) {
+            if (vkCreateInstance(&instanceCreateInfo, getAllocationCallbacks(VK_OBJECT_TYPE_INSTANCE), &m_instance) != VK_SUCCESS) {
                 KE_CRITICAL("Failed to create instance!");
             }   
         }
@@ -197,10 +219,14 @@ namespace k3::graphics {
 
     std::vector<std::string> K3Device::getRequiredInstanceExtensions() {
         KE_IN(KE_NOARG);
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-        std::vector<std::string> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        // Headless devices never initialise GLFW and need no surface extensions.
+        std::vector<std::string> extensions{};
+        if(!isHeadless()) {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
@@ -250,7 +276,7 @@ namespace k3::graphics {
         }
         VkDebugUtilsMessengerCreateInfoEXT debugUtilCreateInfo;
         populateDebugMessengerCreateInfo(debugUtilCreateInfo);
-        if (CreateDebugUtilsMessengerEXT(m_instance, &debugUtilCreateInfo, nullptr, &m_debugMessenger) != VK_SUCCESS) {
+        if (CreateDebugUtilsMessengerEXT(m_instance, &debugUtilCreateInfo, getAllocationCallbacks(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT), &m_debugMessenger) != VK_SUCCESS) {
             KE_CRITICAL("Failed to set up debug messenger!");
         }
         KE_OUT("(): m_debugMessenger@<{}>", fmt::ptr(&m_debugMessenger));
@@ -258,7 +284,12 @@ namespace k3::graphics {
 
     void K3Device::createSurface() { 
         KE_IN(KE_NOARG);
-        m_window->createWindowSurface(m_instance, &m_surface); 
+        if(isHeadless()) {
+            KE_INFO("Kinetic device is headless, rendering offscreen only.");
+            KE_OUT(KE_NOARG);
+            return;
+        }
+        m_window->createWindowSurface(m_instance, &m_surface, getAllocationCallbacks(VK_OBJECT_TYPE_SURFACE_KHR)); 
         KE_OUT("(): m_surface@<{}>", fmt::ptr(&m_surface));
     }
 
@@ -372,16 +403,30 @@ namespace k3::graphics {
                 indices.graphicsFamilyHasValue = true;
             }
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+            if (m_surface != nullptr) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+            }
             if (queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
             }
-            if (indices.isComplete()) {
+            // Without a surface there is nothing to present to, the graphics family is enough.
+            if (indices.isComplete() || (m_surface == nullptr && indices.graphicsFamilyHasValue)) {
                 break;
             }
             i++;
         }
+        // Prefer a pure copy engine, then any family that can transfer without graphics.
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            const VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (queueFamilies[family].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+                continue;
+            }
+            if (!indices.transferFamilyHasValue || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+                indices.transferFamily = family;
+                indices.transferFamilyHasValue = true;
+            }
+        }
         KE_OUT(KE_NOARG);
         return indices;
     }
@@ -390,7 +435,13 @@ namespace k3::graphics {
         KE_IN(KE_NOARG);
         QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily};
+        if (indices.presentFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.presentFamily);
+        }
+        if (indices.transferFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.transferFamily);
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -405,8 +456,32 @@ namespace k3::graphics {
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+        // Upload completion is tracked with a timeline semaphore (core since 1.2).
+        VkPhysicalDeviceVulkan12Features supportedFeatures12 = {};
+        supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supportedFeatures = {};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = &supportedFeatures12;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+        if (!supportedFeatures12.timelineSemaphore) {
+            KE_CRITICAL("timeline semaphores not supported!");
+            throw std::runtime_error("timeline semaphores not supported!");
+        }
+        VkPhysicalDeviceVulkan12Features features12 = {};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.timelineSemaphore = VK_TRUE;
+
+        // Draw lists batch indirect draws when these are there and fall back to direct draws otherwise.
+        m_hasMultiDrawIndirect = supportedFeatures.features.multiDrawIndirect && supportedFeatures.features.drawIndirectFirstInstance;
+        deviceFeatures.multiDrawIndirect = m_hasMultiDrawIndirect ? VK_TRUE : VK_FALSE;
+        deviceFeatures.drawIndirectFirstInstance = m_hasMultiDrawIndirect ? VK_TRUE : VK_FALSE;
+        m_hasDrawIndirectCount = m_hasMultiDrawIndirect && supportedFeatures12.drawIndirectCount;
+        features12.drawIndirectCount = m_hasDrawIndirectCount ? VK_TRUE : VK_FALSE;
+        KE_INFO("Multi draw indirect: {}, draw indirect count: {}", m_hasMultiDrawIndirect, m_hasDrawIndirectCount);
+
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &features12;
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.pEnabledFeatures = &deviceFeatures;
@@ -423,17 +498,119 @@ namespace k3::graphics {
         } else {
             createInfo.enabledLayerCount = 0;
         }
-        if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_device) != VK_SUCCESS) {
+        if (vkCreateDevice(m_physicalDevice, &createInfo, getAllocationCallbacks(VK_OBJECT_TYPE_DEVICE), &m_device) != VK_SUCCESS) {
             KE_CRITICAL("failed to create logical device!");
         }
 
         m_graphicsFamily = indices.graphicsFamily;
         vkGetDeviceQueue(m_device, m_graphicsFamily, 0, &m_graphicsQueue);
-        m_presentFamily = indices.presentFamily;
-        vkGetDeviceQueue(m_device, m_presentFamily, 0, &m_presentQueue);
+        if (indices.presentFamilyHasValue) {
+            m_presentFamily = indices.presentFamily;
+            vkGetDeviceQueue(m_device, m_presentFamily, 0, &m_presentQueue);
+        }
+        if (indices.transferFamilyHasValue) {
+            m_transferFamily = indices.transferFamily;
+            vkGetDeviceQueue(m_device, m_transferFamily, 0, &m_transferQueue);
+            KE_DEBUG("Using queue family {} for transfers.", m_transferFamily);
+        } else {
+            m_transferFamily = m_graphicsFamily;
+            m_transferQueue = m_graphicsQueue;
+        }
         KE_OUT("(): m_device@<{}>, m_graphicsQueue@<{}>, m_presentQueue@<{}>", fmt::ptr(&m_device), fmt::ptr(&m_graphicsQueue), fmt::ptr(&m_presentQueue));
     }
 
+    /**
+     * Geometry is written once and read every frame, so it belongs in DEVICE_LOCAL memory. When
+     * that memory is also HOST_VISIBLE and the heap is more than the classic 256MB BAR window -
+     * all of memory on UMA devices, all of VRAM with resizable BAR - the CPU writes it in place
+     * and the staging copy is skipped. A requested placement wins over the heuristic, except
+     * DIRECT without any DEVICE_LOCAL and HOST_VISIBLE memory type.
+     */
+    void K3Device::selectGeometryPlacement(std::optional<K3GeometryPlacement> requested) {
+        KE_IN(KE_NOARG);
+        const VkPhysicalDeviceMemoryProperties &memoryProperties = m_allocator->getMemoryProperties();
+        const VkMemoryPropertyFlags direct = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        constexpr VkDeviceSize BAR_WINDOW_SIZE = 256ull << 20;
+
+        VkDeviceSize deviceLocalHeapSize = 0;
+        for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            if(memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                deviceLocalHeapSize = std::max(deviceLocalHeapSize, memoryProperties.memoryHeaps[i].size);
+            }
+        }
+        VkDeviceSize directHeapSize = 0;
+        for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            const VkMemoryType &type = memoryProperties.memoryTypes[i];
+            if((type.propertyFlags & direct) != direct) {
+                continue;
+            }
+            const VkDeviceSize heapSize = memoryProperties.memoryHeaps[type.heapIndex].size;
+            const VkMemoryPropertyFlags coherent = type.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            // Coherent memory saves the flush, so it wins between heaps of the same size.
+            if(heapSize > directHeapSize || (heapSize == directHeapSize && coherent != 0)) {
+                directHeapSize = heapSize;
+                m_directGeometryProperties = direct | coherent;
+            }
+        }
+
+        const bool uma = m_vk_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU || m_vk_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+        const bool resizableBar = directHeapSize > BAR_WINDOW_SIZE && directHeapSize * 2 >= deviceLocalHeapSize;
+        m_geometryPlacement = m_directGeometryProperties != 0 && (uma || resizableBar) ? K3GeometryPlacement::DIRECT : K3GeometryPlacement::STAGED;
+        if(requested == K3GeometryPlacement::DIRECT && m_directGeometryProperties == 0) {
+            KE_WARN("No DEVICE_LOCAL and HOST_VISIBLE memory, geometry stays staged.");
+            m_geometryPlacement = K3GeometryPlacement::STAGED;
+        } else if(requested.has_value()) {
+            m_geometryPlacement = *requested;
+        }
+
+        KE_INFO("Kinetic Geometry Placement: {}{} (uma:{}, host visible device local heap {} MB of {} MB)",
+            m_geometryPlacement == K3GeometryPlacement::DIRECT ? "direct" : "staged", requested.has_value() ? " requested" : "", uma, directHeapSize >> 20, deviceLocalHeapSize >> 20);
+        KE_OUT(KE_NOARG);
+    }
+
+    void K3Device::updateMemoryBudget() {
+        const VkPhysicalDeviceMemoryProperties &memoryProperties = m_allocator->getMemoryProperties();
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        if(m_hasMemoryBudget) {
+            VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+            memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            memoryProperties2.pNext = &budgetProperties;
+            vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties2);
+        }
+
+        m_heapBudgets.resize(memoryProperties.memoryHeapCount);
+        VkDeviceSize excess = 0;
+        for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            K3HeapBudget &heap = m_heapBudgets[i];
+            heap.size = memoryProperties.memoryHeaps[i].size;
+            heap.deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+            heap.engineBytes = m_allocator->getHeapBytes(i);
+            if(m_hasMemoryBudget) {
+                heap.budget = budgetProperties.heapBudget[i];
+                heap.usage = budgetProperties.heapUsage[i];
+            } else {
+                // Without the extension only our own allocations are known, and other processes
+                // get a share of the heap.
+                heap.budget = heap.size * 4 / 5;
+                heap.usage = heap.engineBytes;
+            }
+
+            const VkDeviceSize limit = static_cast<VkDeviceSize>(static_cast<double>(heap.budget) * BUDGET_WARNING_RATIO);
+            const bool pressured = heap.usage > limit;
+            if(pressured && !heap.pressured) {
+                KE_WARN("Memory heap {} at {} MB of its {} MB budget ({} MB ours).", i, heap.usage >> 20, heap.budget >> 20, heap.engineBytes >> 20);
+            } else if(!pressured && heap.pressured) {
+                KE_INFO("Memory heap {} back under budget at {} MB.", i, heap.usage >> 20);
+            }
+            heap.pressured = pressured;
+            if(pressured && heap.deviceLocal) {
+                excess = std::max(excess, heap.usage - limit);
+            }
+        }
+        m_budgetExcess = excess;
+    }
+
     void K3Device::createDescriptorPool() {
         KE_IN(KE_NOARG);
         VkDescriptorPoolSize pool_sizes[] =
@@ -456,7 +633,7 @@ namespace k3::graphics {
         pool_info.maxSets = 1000 * IM_ARRAYSIZE(pool_sizes);
         pool_info.poolSizeCount = (uint32_t)IM_ARRAYSIZE(pool_sizes);
         pool_info.pPoolSizes = pool_sizes;
-        if (vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        if (vkCreateDescriptorPool(m_device, &pool_info, getAllocationCallbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &m_descriptorPool) != VK_SUCCESS) {
             KE_CRITICAL("failed to descriptor pool!");
         }
 
@@ -465,15 +642,38 @@ namespace k3::graphics {
 
     void K3Device::createCommandPool() {
         KE_IN(KE_NOARG);
+        m_commandPool = createCommandPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+        KE_OUT("(): m_commandPool@<{}>", fmt::ptr(&m_commandPool));
+    }
+
+    VkCommandPool K3Device::createCommandPool(VkCommandPoolCreateFlags flags) {
         QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
         VkCommandPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+        poolInfo.flags = flags;
+        VkCommandPool commandPool = nullptr;
+        if (vkCreateCommandPool(m_device, &poolInfo, getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL), &commandPool) != VK_SUCCESS) {
             KE_CRITICAL("failed to create command pool!");
         }
-        KE_OUT("(): m_commandPool@<{}>", fmt::ptr(&m_commandPool));
+        return commandPool;
+    }
+
+    VkCommandPool K3Device::getThreadCommandPool() {
+        // Command pools need external synchronisation, so the render thread keeps m_commandPool
+        // and every other thread gets one of its own.
+        if(std::this_thread::get_id() == m_ownerThread) {
+            return m_commandPool;
+        }
+        std::lock_guard<std::mutex> lock(m_threadCommandPoolMutex);
+        auto found = m_threadCommandPools.find(std::this_thread::get_id());
+        if(found != m_threadCommandPools.end()) {
+            return found->second;
+        }
+        VkCommandPool commandPool = createCommandPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        m_threadCommandPools.emplace(std::this_thread::get_id(), commandPool);
+        KE_DEBUG("Created single time command pool for a loader thread.");
+        return commandPool;
     }
 
     VkFormat K3Device::findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
@@ -493,49 +693,37 @@ namespace k3::graphics {
         throw std::runtime_error("failed to find supported format!");
     }
 
-    void K3Device::createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory) {
+    void K3Device::createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, K3Allocation &imageAllocation,
+        K3MemoryCategory category) {
         KE_IN(KE_NOARG);
-        if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        if (vkCreateImage(m_device, &imageInfo, getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE), &image) != VK_SUCCESS) {
             KE_CRITICAL("failed to create image!");
             throw std::runtime_error("failed to create image!");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(m_device, image, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            KE_CRITICAL("failed to allocate image memory!");
-            throw std::runtime_error("failed to allocate image memory!");
-        }
-
-        if (vkBindImageMemory(m_device, image, imageMemory, 0) != VK_SUCCESS) {
-            KE_CRITICAL("failed to bind image memory!");
-            throw std::runtime_error("failed to bind image memory!");
+        try {
+            imageAllocation = m_allocator->allocateForImage(image, properties, category);
+        } catch(...) {
+            vkDestroyImage(m_device, image, getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE));
+            image = VK_NULL_HANDLE;
+            throw;
         }
         KE_OUT(KE_NOARG);
     }
 
+    void K3Device::destroyImage(VkImage &image, K3Allocation &imageAllocation) {
+        vkDestroyImage(m_device, image, getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE));
+        image = VK_NULL_HANDLE;
+        m_allocator->free(imageAllocation);
+    }
+
     uint32_t K3Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-        KE_IN(KE_NOARG);
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-                KE_OUT(KE_NOARG);
-                return i;
-            }
-        }
-        KE_CRITICAL("failed to find suitable memory type!");
-        throw std::runtime_error("failed to find suitable memory type!");
+        return m_allocator->findMemoryType(typeFilter, properties);
     }
 
 
-    void K3Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+    void K3Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, K3Allocation &bufferAllocation,
+        K3MemoryCategory category) {
         KE_IN(KE_NOARG);
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -543,31 +731,32 @@ namespace k3::graphics {
         bufferInfo.usage = usage;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create vertex buffer!");
+        if (vkCreateBuffer(m_device, &bufferInfo, getAllocationCallbacks(VK_OBJECT_TYPE_BUFFER), &buffer) != VK_SUCCESS) {
+            KE_CRITICAL("failed to create buffer!");
+            throw std::runtime_error("failed to create buffer!");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
+        try {
+            bufferAllocation = m_allocator->allocateForBuffer(buffer, properties, category);
+        } catch(...) {
+            vkDestroyBuffer(m_device, buffer, getAllocationCallbacks(VK_OBJECT_TYPE_BUFFER));
+            buffer = VK_NULL_HANDLE;
+            throw;
         }
+        KE_OUT("(): offset:{} size:{}", bufferAllocation.offset, bufferAllocation.size);
+    }
 
-        vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
-        KE_OUT("(): bufferMemory@<{}>", fmt::ptr(&bufferMemory));
+    void K3Device::destroyBuffer(VkBuffer &buffer, K3Allocation &bufferAllocation) {
+        vkDestroyBuffer(m_device, buffer, getAllocationCallbacks(VK_OBJECT_TYPE_BUFFER));
+        buffer = VK_NULL_HANDLE;
+        m_allocator->free(bufferAllocation);
     }
 
     VkCommandBuffer K3Device::beginSingleTimeCommands() {
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandPool = getThreadCommandPool();
         allocInfo.commandBufferCount = 1;
 
         VkCommandBuffer commandBuffer;
@@ -589,10 +778,20 @@ namespace k3::graphics {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(m_graphicsQueue);
+        // Wait on a fence for just this submission, vkQueueWaitIdle would also wait out any
+        // frame in flight and needs the queue to itself.
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(m_device, &fenceInfo, getAllocationCallbacks(VK_OBJECT_TYPE_FENCE), &fence);
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, fence);
+        }
+        vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(m_device, fence, getAllocationCallbacks(VK_OBJECT_TYPE_FENCE));
 
-        vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+        vkFreeCommandBuffers(m_device, getThreadCommandPool(), 1, &commandBuffer);
     }
 
     void K3Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -606,4 +805,8 @@ namespace k3::graphics {
 
         endSingleTimeCommands(commandBuffer);
     }
+
+    K3UploadToken K3Device::uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset) {
+        return m_stagingRing->upload(dstBuffer, data, size, dstOffset);
+    }
 }
\ No newline at end of file
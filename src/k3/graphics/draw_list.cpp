@@ -0,0 +1,122 @@
+#include "k3/graphics/draw_list.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace k3::graphics {
+
+    K3DrawList::K3DrawList(std::shared_ptr<K3Device> device) : m_device {device} {
+        KE_IN(KE_NOARG);
+        if(m_device->hasMultiDrawIndirect()) {
+            m_maxBatchSize = std::max(m_device->m_vk_properties.limits.maxDrawIndirectCount, 1u);
+        }
+        KE_OUT("(): maxBatchSize:{}", m_maxBatchSize);
+    }
+
+    void K3DrawList::clear() {
+        m_commands.clear();
+        m_batches.clear();
+        m_commandAllocation = K3FrameAllocation{};
+    }
+
+    uint32_t K3DrawList::add(K3Pipeline &pipeline, const K3Model &model, uint32_t lod, uint32_t instanceCount, uint32_t firstInstance) {
+        const uint32_t first = static_cast<uint32_t>(m_commands.size());
+        model.appendDrawCommands(m_commands, lod, instanceCount, firstInstance);
+        for(uint32_t i = first; i < m_commands.size(); i++) {
+            if(m_batches.empty() || m_batches.back().pipeline != &pipeline || m_batches.back().indexType != model.getIndexType()
+                    || m_batches.back().commandCount == m_maxBatchSize) {
+                m_batches.push_back({&pipeline, model.getIndexType(), i, 0});
+            }
+            m_batches.back().commandCount++;
+        }
+        return first;
+    }
+
+    bool K3DrawList::upload(K3FrameAllocator &frameAllocator, bool clearInstanceCounts) {
+        m_commandAllocation = K3FrameAllocation{};
+        if(m_commands.empty() || !m_device->hasMultiDrawIndirect()) {
+            return false;
+        }
+
+        // Commands first so they start on a storage buffer offset.
+        const VkDeviceSize commandBytes = sizeof(VkDrawIndexedIndirectCommand) * m_commands.size();
+        const VkDeviceSize countBytes = sizeof(uint32_t) * m_batches.size();
+        K3FrameAllocation allocation = frameAllocator.allocate(commandBytes + countBytes);
+        if(allocation.mapped == nullptr) {
+            KE_WARN("No frame memory for {} indirect draws, recording them directly.", m_commands.size());
+            return false;
+        }
+        VkDrawIndexedIndirectCommand *commands = static_cast<VkDrawIndexedIndirectCommand *>(allocation.mapped);
+        std::memcpy(commands, m_commands.data(), commandBytes);
+        if(clearInstanceCounts) {
+            for(size_t i = 0; i < m_commands.size(); i++) {
+                commands[i].instanceCount = 0;
+            }
+        }
+        uint32_t *counts = reinterpret_cast<uint32_t *>(static_cast<char *>(allocation.mapped) + commandBytes);
+        for(size_t i = 0; i < m_batches.size(); i++) {
+            counts[i] = m_batches[i].commandCount;
+        }
+
+        m_commandAllocation = allocation;
+        m_commandAllocation.size = commandBytes;
+        m_countOffset = allocation.offset + commandBytes;
+        return true;
+    }
+
+    uint32_t K3DrawList::record(VkCommandBuffer commandBuffer, K3GeometryPool &geometryPool) {
+        if(m_commands.empty()) {
+            return 0;
+        }
+        if(m_commandAllocation.mapped == nullptr) {
+            return recordDirect(commandBuffer, geometryPool);
+        }
+
+        const bool drawIndirectCount = m_device->hasDrawIndirectCount();
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        K3Pipeline *boundPipeline = nullptr;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+        geometryPool.bindVertexBuffer(commandBuffer);
+        for(size_t i = 0; i < m_batches.size(); i++) {
+            const K3DrawBatch &batch = m_batches[i];
+            if(batch.pipeline != boundPipeline) {
+                batch.pipeline->bind(commandBuffer);
+                boundPipeline = batch.pipeline;
+            }
+            if(batch.indexType != boundIndexType) {
+                geometryPool.bindIndexBuffer(commandBuffer, batch.indexType);
+                boundIndexType = batch.indexType;
+            }
+            const VkDeviceSize commandOffset = m_commandAllocation.offset + static_cast<VkDeviceSize>(batch.firstCommand) * stride;
+            if(drawIndirectCount) {
+                vkCmdDrawIndexedIndirectCount(commandBuffer, m_commandAllocation.buffer, commandOffset, m_commandAllocation.buffer,
+                    m_countOffset + sizeof(uint32_t) * i, batch.commandCount, stride);
+            } else {
+                vkCmdDrawIndexedIndirect(commandBuffer, m_commandAllocation.buffer, commandOffset, batch.commandCount, stride);
+            }
+        }
+        return static_cast<uint32_t>(m_batches.size());
+    }
+
+    uint32_t K3DrawList::recordDirect(VkCommandBuffer commandBuffer, K3GeometryPool &geometryPool) {
+        K3Pipeline *boundPipeline = nullptr;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+        geometryPool.bindVertexBuffer(commandBuffer);
+        for(const K3DrawBatch &batch : m_batches) {
+            if(batch.pipeline != boundPipeline) {
+                batch.pipeline->bind(commandBuffer);
+                boundPipeline = batch.pipeline;
+            }
+            if(batch.indexType != boundIndexType) {
+                geometryPool.bindIndexBuffer(commandBuffer, batch.indexType);
+                boundIndexType = batch.indexType;
+            }
+            for(uint32_t i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++) {
+                const VkDrawIndexedIndirectCommand &command = m_commands[i];
+                vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+            }
+        }
+        return static_cast<uint32_t>(m_commands.size());
+    }
+
+}
@@ -0,0 +1,160 @@
+#include "k3/graphics/frame_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace k3::graphics {
+
+    K3FrameAllocator::K3FrameAllocator(std::shared_ptr<K3Device> device, VkDeviceSize frameSize, uint32_t frameCount) : m_device {device}, m_frameCount {frameCount} {
+        KE_IN("({}, {})", frameSize, frameCount);
+        const VkPhysicalDeviceLimits &limits = m_device->m_vk_properties.limits;
+        m_defaultAlignment = std::max<VkDeviceSize>({limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, 1});
+        m_granularity = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, m_defaultAlignment);
+
+        m_frames.resize(m_frameCount);
+        for(std::vector<K3FrameBlock> &blocks : m_frames) {
+            blocks.push_back(createBlock(frameSize));
+        }
+        KE_OUT("(): frameSize:{}, alignment:{}", m_frames[0][0].size, m_defaultAlignment);
+    }
+
+    K3FrameAllocator::~K3FrameAllocator() {
+        KE_IN(KE_NOARG);
+        for(std::vector<K3FrameBlock> &blocks : m_frames) {
+            for(K3FrameBlock &block : blocks) {
+                destroyBlock(block);
+            }
+        }
+        KE_OUT(KE_NOARG);
+    }
+
+    K3FrameAllocator::K3FrameBlock K3FrameAllocator::createBlock(VkDeviceSize size) {
+        K3FrameBlock block{};
+        block.size = (size + m_granularity - 1) / m_granularity * m_granularity;
+        m_device->createBuffer(block.size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, block.buffer, block.allocation, K3MemoryCategory::UNIFORM);
+        if(block.allocation.mapped == nullptr) {
+            destroyBlock(block);
+            KE_CRITICAL("failed to map frame allocator!");
+            throw std::runtime_error("failed to map frame allocator!");
+        }
+        const VkMemoryPropertyFlags properties = m_device->getAllocator().getMemoryProperties().memoryTypes[block.allocation.memoryTypeIndex].propertyFlags;
+        block.coherent = (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+        return block;
+    }
+
+    void K3FrameAllocator::destroyBlock(K3FrameBlock &block) {
+        if(block.buffer != VK_NULL_HANDLE) {
+            m_device->destroyBuffer(block.buffer, block.allocation);
+        }
+    }
+
+    void K3FrameAllocator::beginFrame(uint32_t frameIndex) {
+        assert(frameIndex < m_frameCount && "Frame index out of range");
+        std::lock_guard<std::mutex> lock(m_mutex);
+        VkDeviceSize used = 0;
+        for(const K3FrameBlock &block : m_frames[m_frameIndex]) {
+            used += block.head;
+        }
+        m_peak = std::max(m_peak, used);
+        m_frameIndex = frameIndex;
+
+        // The frame's fence has been waited on, so a chain left by growing can become one block.
+        std::vector<K3FrameBlock> &blocks = m_frames[frameIndex];
+        if(blocks.size() > 1) {
+            VkDeviceSize total = 0;
+            for(K3FrameBlock &block : blocks) {
+                total += block.size;
+            }
+            try {
+                K3FrameBlock merged = createBlock(total);
+                for(K3FrameBlock &block : blocks) {
+                    destroyBlock(block);
+                }
+                blocks.clear();
+                blocks.push_back(merged);
+                KE_DEBUG("Frame {} memory merged into {} bytes", frameIndex, merged.size);
+            } catch(const std::runtime_error &e) {
+                KE_WARN("Frame memory kept in {} blocks ({}).", blocks.size(), e.what());
+            }
+        }
+        for(K3FrameBlock &block : blocks) {
+            block.head = 0;
+        }
+    }
+
+    K3FrameAllocation K3FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+        if(alignment == 0) {
+            alignment = m_defaultAlignment;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<K3FrameBlock> &blocks = m_frames[m_frameIndex];
+        // Offsets are aligned within the block, whose start is aligned for every limit.
+        VkDeviceSize offset = (blocks.back().head + alignment - 1) / alignment * alignment;
+        if(offset + size > blocks.back().size) {
+            try {
+                blocks.push_back(createBlock(std::max(blocks.back().size * 2, size + alignment)));
+            } catch(const std::runtime_error &e) {
+                KE_ERROR("Frame allocator out of memory: {} bytes requested ({})", size, e.what());
+                return {};
+            }
+            KE_DEBUG("Frame {} grew a {} byte block", m_frameIndex, blocks.back().size);
+            offset = 0;
+        }
+
+        K3FrameBlock &block = blocks.back();
+        block.head = offset + size;
+        K3FrameAllocation allocation{};
+        allocation.buffer = block.buffer;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.mapped = static_cast<char *>(block.allocation.mapped) + offset;
+        return allocation;
+    }
+
+    K3FrameAllocation K3FrameAllocator::push(const void *data, VkDeviceSize size, VkDeviceSize alignment) {
+        K3FrameAllocation allocation = allocate(size, alignment);
+        if(allocation.mapped != nullptr) {
+            std::memcpy(allocation.mapped, data, size);
+        }
+        return allocation;
+    }
+
+    void K3FrameAllocator::flush() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // A frame that grew has several blocks, all flushed in one call.
+        m_flushRanges.clear();
+        for(const K3FrameBlock &block : m_frames[m_frameIndex]) {
+            if(!block.coherent && block.head > 0) {
+                m_flushRanges.push_back(m_device->getAllocator().getMappedRange(block.allocation, block.head, 0));
+            }
+        }
+        m_device->getAllocator().flush(m_flushRanges);
+    }
+
+    VkDeviceSize K3FrameAllocator::getFrameSize() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        VkDeviceSize size = 0;
+        for(const K3FrameBlock &block : m_frames[m_frameIndex]) {
+            size += block.size;
+        }
+        return size;
+    }
+
+    VkDeviceSize K3FrameAllocator::getUsedBytes() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        VkDeviceSize used = 0;
+        for(const K3FrameBlock &block : m_frames[m_frameIndex]) {
+            used += block.head;
+        }
+        return used;
+    }
+
+    VkDeviceSize K3FrameAllocator::getPeakBytes() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_peak;
+    }
+
+}
@@ -0,0 +1,118 @@
+#include "k3/graphics/frustum_culler.hpp"
+#include "k3/graphics/culler.hpp"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#   include <arm_neon.h>
+#endif
+
+namespace k3::graphics {
+
+    void K3FrustumCuller::clear() {
+        m_x.clear();
+        m_y.clear();
+        m_z.clear();
+        m_radius.clear();
+        m_count = 0;
+    }
+
+    uint32_t K3FrustumCuller::add(const glm::vec4 &sphere) {
+        // Grow a whole group at a time so the last one can be loaded without a tail loop.
+        if(m_count % LANES == 0) {
+            const size_t padded = static_cast<size_t>(m_count) + LANES;
+            m_x.resize(padded, 0.f);
+            m_y.resize(padded, 0.f);
+            m_z.resize(padded, 0.f);
+            m_radius.resize(padded, 0.f);
+        }
+        m_x[m_count] = sphere.x;
+        m_y[m_count] = sphere.y;
+        m_z[m_count] = sphere.z;
+        m_radius[m_count] = sphere.w;
+        return m_count++;
+    }
+
+    bool K3FrustumCuller::isVisible(const std::array<glm::vec4, 6> &planes, const glm::vec4 &sphere) {
+        const float negativeRadius = -sphere.w;
+        for(const glm::vec4 &plane : planes) {
+            const float distance = plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w;
+            if(distance < negativeRadius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t K3FrustumCuller::cull(const glm::mat4 &projectionView, std::vector<uint8_t> &visibility) const {
+        const std::array<glm::vec4, 6> planes = K3Culler::extractFrustumPlanes(projectionView);
+        visibility.resize(m_count);
+        uint32_t visibleCount = 0;
+
+        // Each group ORs together the lanes that fall behind any plane.
+        for(uint32_t first = 0; first < m_count; first += LANES) {
+            const uint32_t lanes = std::min(LANES, m_count - first);
+            uint32_t outsideMask = 0;
+#if defined(__AVX__)
+            const __m256 x = _mm256_loadu_ps(&m_x[first]);
+            const __m256 y = _mm256_loadu_ps(&m_y[first]);
+            const __m256 z = _mm256_loadu_ps(&m_z[first]);
+            const __m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(&m_radius[first]), _mm256_set1_ps(-0.f));
+            __m256 outside = _mm256_setzero_ps();
+            for(const glm::vec4 &plane : planes) {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), x), _mm256_mul_ps(_mm256_set1_ps(plane.y), y));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), z));
+                distance = _mm256_add_ps(distance, _mm256_set1_ps(plane.w));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+            }
+            outsideMask = static_cast<uint32_t>(_mm256_movemask_ps(outside));
+#elif defined(__SSE2__) || defined(_M_X64)
+            const __m128 x = _mm_loadu_ps(&m_x[first]);
+            const __m128 y = _mm_loadu_ps(&m_y[first]);
+            const __m128 z = _mm_loadu_ps(&m_z[first]);
+            const __m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(&m_radius[first]), _mm_set1_ps(-0.f));
+            __m128 outside = _mm_setzero_ps();
+            for(const glm::vec4 &plane : planes) {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), z));
+                distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+            }
+            outsideMask = static_cast<uint32_t>(_mm_movemask_ps(outside));
+#elif defined(__ARM_NEON)
+            const float32x4_t x = vld1q_f32(&m_x[first]);
+            const float32x4_t y = vld1q_f32(&m_y[first]);
+            const float32x4_t z = vld1q_f32(&m_z[first]);
+            const float32x4_t negativeRadius = vnegq_f32(vld1q_f32(&m_radius[first]));
+            uint32x4_t outside = vdupq_n_u32(0);
+            for(const glm::vec4 &plane : planes) {
+                // Separate multiplies and adds, vmlaq may fuse and disagree with isVisible.
+                float32x4_t distance = vaddq_f32(vmulq_n_f32(x, plane.x), vmulq_n_f32(y, plane.y));
+                distance = vaddq_f32(distance, vmulq_n_f32(z, plane.z));
+                distance = vaddq_f32(distance, vdupq_n_f32(plane.w));
+                outside = vorrq_u32(outside, vcltq_f32(distance, negativeRadius));
+            }
+            outsideMask = (vgetq_lane_u32(outside, 0) & 1u) | (vgetq_lane_u32(outside, 1) & 2u)
+                | (vgetq_lane_u32(outside, 2) & 4u) | (vgetq_lane_u32(outside, 3) & 8u);
+#else
+            for(uint32_t lane = 0; lane < lanes; lane++) {
+                const uint32_t i = first + lane;
+                if(!isVisible(planes, glm::vec4(m_x[i], m_y[i], m_z[i], m_radius[i]))) {
+                    outsideMask |= 1u << lane;
+                }
+            }
+#endif
+            for(uint32_t lane = 0; lane < lanes; lane++) {
+                const uint8_t visible = (outsideMask >> lane) & 1u ? 0 : 1;
+                visibility[first + lane] = visible;
+                visibleCount += visible;
+            }
+        }
+        return visibleCount;
+    }
+
+}
@@ -0,0 +1,191 @@
+#include "k3/graphics/geometry_pool.hpp"
+#include "k3/graphics/device.hpp"
+#include "k3/graphics/swapchain.hpp"
+#include "k3/graphics/upload_batch.hpp"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace k3::graphics {
+
+    K3GeometryPool::K3GeometryPool(K3Device &device, VkDeviceSize vertexPoolSize, VkDeviceSize indexPoolSize) : m_device {device}, m_vertexPoolSize {vertexPoolSize},
+        m_indexPoolSize {indexPoolSize} {
+        KE_IN("({}, {})", vertexPoolSize, indexPoolSize);
+        KE_OUT(KE_NOARG);
+    }
+
+    K3GeometryPool::~K3GeometryPool() {
+        KE_IN(KE_NOARG);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_vertexRanges != nullptr) {
+            for(const K3RetiredRange &retired : m_retired) {
+                m_vertexRanges->free(retired.vertexAllocation);
+                if(retired.indexAllocation != K3TlsfAllocator::INVALID_OFFSET) {
+                    m_indexRanges->free(retired.indexAllocation);
+                }
+            }
+            m_retired.clear();
+            if(!m_vertexRanges->isEmpty() || !m_indexRanges->isEmpty()) {
+                KE_WARN("Geometry pool destroyed with {} vertex and {} index ranges in use.", m_vertexRanges->getAllocationCount(), m_indexRanges->getAllocationCount());
+            }
+        }
+        if(m_vertexBuffer != VK_NULL_HANDLE) {
+            m_device.destroyBuffer(m_vertexBuffer, m_vertexAllocation);
+        }
+        if(m_indexBuffer != VK_NULL_HANDLE) {
+            m_device.destroyBuffer(m_indexBuffer, m_indexAllocation);
+        }
+        KE_OUT(KE_NOARG);
+    }
+
+    void K3GeometryPool::create() {
+        KE_IN(KE_NOARG);
+        const VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        const VkBufferUsageFlags indexUsage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        auto createBuffers = [&](VkMemoryPropertyFlags properties) {
+            m_device.createBuffer(m_vertexPoolSize, vertexUsage, properties, m_vertexBuffer, m_vertexAllocation, K3MemoryCategory::GEOMETRY);
+            m_device.createBuffer(m_indexPoolSize, indexUsage, properties, m_indexBuffer, m_indexAllocation, K3MemoryCategory::GEOMETRY);
+        };
+        auto destroyBuffers = [&]() {
+            if(m_vertexBuffer != VK_NULL_HANDLE) {
+                m_device.destroyBuffer(m_vertexBuffer, m_vertexAllocation);
+            }
+            if(m_indexBuffer != VK_NULL_HANDLE) {
+                m_device.destroyBuffer(m_indexBuffer, m_indexAllocation);
+            }
+        };
+
+        if(m_device.getGeometryPlacement() == K3GeometryPlacement::DIRECT) {
+            try {
+                createBuffers(m_device.getGeometryMemoryProperties());
+                m_direct = m_vertexAllocation.mapped != nullptr && m_indexAllocation.mapped != nullptr;
+            } catch(const std::runtime_error &e) {
+                // The host visible heap can run out well before VRAM does.
+                KE_WARN("Direct geometry pool allocation failed ({}), staging instead.", e.what());
+            }
+            if(!m_direct) {
+                destroyBuffers();
+            }
+        }
+        if(m_vertexBuffer == VK_NULL_HANDLE) {
+            createBuffers(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        m_vertexRanges = std::make_unique<K3TlsfAllocator>(m_vertexPoolSize);
+        m_indexRanges = std::make_unique<K3TlsfAllocator>(m_indexPoolSize);
+        KE_OUT("(): direct:{}", m_direct);
+    }
+
+    K3GeometryRange K3GeometryPool::allocate(uint32_t stride, uint32_t vertexCount, uint32_t indexSize, uint32_t indexCount) {
+        KE_IN("({}, {}, {}, {})", stride, vertexCount, indexSize, indexCount);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_vertexRanges == nullptr) {
+            try {
+                create();
+            } catch(const std::runtime_error &e) {
+                KE_WARN("Geometry pool unavailable ({}), models keep their own buffers.", e.what());
+                m_vertexPoolSize = 0;
+                m_indexPoolSize = 0;
+                m_vertexRanges = std::make_unique<K3TlsfAllocator>(0);
+                m_indexRanges = std::make_unique<K3TlsfAllocator>(0);
+            }
+        }
+
+        K3GeometryRange range{};
+        range.vertexBytes = static_cast<VkDeviceSize>(stride) * vertexCount;
+        range.indexBytes = static_cast<VkDeviceSize>(indexSize) * indexCount;
+        range.indexCount = indexCount;
+        if(m_vertexPoolSize == 0 || range.vertexBytes == 0) {
+            KE_OUT("(): pool unavailable");
+            return {};
+        }
+
+        // Strides needn't be powers of two, so over-allocate and start on the next multiple.
+        const uint64_t vertexAllocation = m_vertexRanges->allocate(range.vertexBytes + stride - 1);
+        if(vertexAllocation == K3TlsfAllocator::INVALID_OFFSET) {
+            KE_OUT("(): vertex pool full");
+            return {};
+        }
+        range.vertexByteOffset = (vertexAllocation + stride - 1) / stride * stride;
+        if(range.vertexByteOffset / stride > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) {
+            m_vertexRanges->free(vertexAllocation);
+            KE_OUT("(): vertex offset out of range");
+            return {};
+        }
+        range.vertexOffset = static_cast<int32_t>(range.vertexByteOffset / stride);
+
+        if(range.indexBytes > 0) {
+            const uint64_t indexAllocation = m_indexRanges->allocate(range.indexBytes, indexSize);
+            if(indexAllocation == K3TlsfAllocator::INVALID_OFFSET) {
+                m_vertexRanges->free(vertexAllocation);
+                KE_OUT("(): index pool full");
+                return {};
+            }
+            range.indexAllocation = indexAllocation;
+            range.indexByteOffset = indexAllocation;
+            range.firstIndex = static_cast<uint32_t>(indexAllocation / indexSize);
+        }
+        range.vertexAllocation = vertexAllocation;
+        KE_OUT("(): vertexOffset:{} firstIndex:{}", range.vertexOffset, range.firstIndex);
+        return range;
+    }
+
+    void K3GeometryPool::free(K3GeometryRange &range) {
+        if(!range.isValid()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_retired.push_back({range.vertexAllocation, range.indexAllocation, m_frame});
+        range = K3GeometryRange{};
+    }
+
+    void K3GeometryPool::beginFrame() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frame++;
+        while(!m_retired.empty() && m_retired.front().frame + K3SwapChain::MAX_FRAMES_IN_FLIGHT <= m_frame) {
+            const K3RetiredRange &retired = m_retired.front();
+            m_vertexRanges->free(retired.vertexAllocation);
+            if(retired.indexAllocation != K3TlsfAllocator::INVALID_OFFSET) {
+                m_indexRanges->free(retired.indexAllocation);
+            }
+            m_retired.pop_front();
+        }
+    }
+
+    void K3GeometryPool::write(K3UploadBatch &batch, const K3GeometryRange &range, const void *vertices, const void *indices) {
+        if(m_direct) {
+            // Host writes before the frame's vkQueueSubmit are visible to it, no copy needed.
+            std::memcpy(static_cast<char *>(m_vertexAllocation.mapped) + range.vertexByteOffset, vertices, range.vertexBytes);
+            m_device.getAllocator().flush(m_vertexAllocation, range.vertexBytes, range.vertexByteOffset);
+            if(range.indexBytes > 0) {
+                std::memcpy(static_cast<char *>(m_indexAllocation.mapped) + range.indexByteOffset, indices, range.indexBytes);
+                m_device.getAllocator().flush(m_indexAllocation, range.indexBytes, range.indexByteOffset);
+            }
+            return;
+        }
+        batch.uploadBuffer(m_vertexBuffer, vertices, range.vertexBytes, range.vertexByteOffset);
+        if(range.indexBytes > 0) {
+            batch.uploadBuffer(m_indexBuffer, indices, range.indexBytes, range.indexByteOffset);
+        }
+    }
+
+    void K3GeometryPool::bindVertexBuffer(VkCommandBuffer commandBuffer) {
+        const VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer, &offset);
+    }
+
+    void K3GeometryPool::bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType) {
+        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, indexType);
+    }
+
+    VkDeviceSize K3GeometryPool::getVertexUsedBytes() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_vertexRanges != nullptr ? m_vertexRanges->getUsedBytes() : 0;
+    }
+
+    VkDeviceSize K3GeometryPool::getIndexUsedBytes() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_indexRanges != nullptr ? m_indexRanges->getUsedBytes() : 0;
+    }
+
+}
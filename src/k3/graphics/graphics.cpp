@@ -13,7 +13,7 @@ namespace k3::graphics  {
         }   
     }
 
-    K3Graphics::K3Graphics(std::shared_ptr<logging::LogManger> logManager, std::shared_ptr<K3Window> window) {
+    K3Graphics::K3Graphics(std::shared_ptr<logging::LogManger> logManager, std::shared_ptr<K3Window> window, std::optional<K3GeometryPlacement> geometryPlacement) {
         KE_INFO("Kinetic Init {}.{}.{}",PROJECT_VER_MAJOR,PROJECT_VER_MINOR,PROJECT_VER_PATCH);
         m_logManger = logManager;
         KE_TRACE("Trace Logging On.");
@@ -22,7 +22,7 @@ namespace k3::graphics  {
         m_window = window;
         m_window->setWindowUserPointer(this);
 
-        m_device = std::make_shared<K3Device>(m_window);
+        m_device = std::make_shared<K3Device>(m_window, geometryPlacement);
 
         KE_INFO("Kinetic has connected to the Vulkan.");
 
@@ -61,55 +61,34 @@ namespace k3::graphics  {
         imguiInit.MinImageCount = minImageCount;
         imguiInit.ImageCount = imageCount;
         imguiInit.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
-        imguiInit.Allocator = nullptr;
+        imguiInit.Allocator = m_device->getAllocationCallbacks(VK_OBJECT_TYPE_UNKNOWN);
         imguiInit.CheckVkResultFn = check_vk_result;
         ImGui_ImplVulkan_Init(&imguiInit, renderPass);
 
         VkResult err;
         // Upload Fonts
         {
-            VkCommandPool commandPool = m_device->getCommandPool();
-            std::vector<VkCommandBuffer> m_commandBuffers;
-            m_commandBuffers.resize(1);
-            VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
-            commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            commandBufferAllocateInfo.commandPool = m_device->getCommandPool();
-            commandBufferAllocateInfo.commandBufferCount = static_cast<uint32_t>(1);    
-            if (vkAllocateCommandBuffers(m_device->getDevice() , &commandBufferAllocateInfo, m_commandBuffers.data()) != VK_SUCCESS) {
-                KE_CRITICAL("Failed to allocate command buffers.");
-                throw std::runtime_error("Failed to allocate command buffers.");
+            // ImGui records its own staging copy and a transition for fragment shader reads, so
+            // the batch goes to the graphics queue rather than the transfer queue.
+            K3StagingRing &stagingRing = m_device->getStagingRing();
+            K3UploadToken token{};
+            {
+                K3UploadBatch batch(stagingRing, K3UploadBatch::Queue::GRAPHICS);
+                ImGui_ImplVulkan_CreateFontsTexture(batch.getCommandBuffer());
+                token = batch.submit();
             }
-            VkCommandBuffer commandBuffer = m_commandBuffers[0];
-            if (vkResetCommandPool(m_device->getDevice(), commandPool, 0) != VK_SUCCESS) {
-                KE_CRITICAL("Failed Reset Command Pool.");
-                throw std::runtime_error("Failed Reset Command Pool.");
-            }
-            VkCommandBufferBeginInfo begin_info = {};
-            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            if (vkBeginCommandBuffer(commandBuffer, &begin_info) != VK_SUCCESS) {
-                KE_CRITICAL("Failed to begin command buffer.");
-                throw std::runtime_error("Failed to begin command buffer.");
-            }
-
-            ImGui_ImplVulkan_CreateFontsTexture(commandBuffer);
-
-            if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-                KE_CRITICAL("Failed to end command buffer.");
-                throw std::runtime_error("Failed to end command buffer.");
-            }
-            VkSubmitInfo end_info = {};
-            end_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            end_info.commandBufferCount = 1;
-            end_info.pCommandBuffers = &commandBuffer;
-
-            if (vkQueueSubmit(m_device->getGraphicsQueue(), 1, &end_info, VK_NULL_HANDLE) != VK_SUCCESS) {
-                KE_CRITICAL("Failed to submit command buffer.");
-                throw std::runtime_error("Failed to submit command buffer.");
-            }
-            vkDeviceWaitIdle(m_device->getDevice());
+            stagingRing.wait(token);
             ImGui_ImplVulkan_DestroyFontUploadObjects();
+
+            // ImGui allocates its own memory, count at least the RGBA font atlas against the budget.
+            unsigned char *pixels = nullptr;
+            int width = 0;
+            int height = 0;
+            ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+            K3MemoryAllocator &allocator = m_device->getAllocator();
+            m_imguiHeapIndex = allocator.getMemoryProperties().memoryTypes[allocator.findMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)].heapIndex;
+            m_imguiBytes = static_cast<int64_t>(width) * height * 4;
+            allocator.trackExternal(K3MemoryCategory::IMGUI, m_imguiHeapIndex, m_imguiBytes);
         }
     
         m_renderSystem = std::make_shared<K3SimpleRenderSystem>(m_device, renderPass);
@@ -123,6 +102,7 @@ namespace k3::graphics  {
         vkDeviceWaitIdle(m_device->getDevice());
 
         ImGui_ImplVulkan_Shutdown();
+        m_device->getAllocator().trackExternal(K3MemoryCategory::IMGUI, m_imguiHeapIndex, -m_imguiBytes);
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
 
@@ -0,0 +1,245 @@
+#include "k3/graphics/host_allocator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace k3::graphics {
+
+    namespace {
+
+        // Sits directly in front of every pointer handed to the driver.
+        struct K3HostAllocationHeader {
+            void *base;
+            size_t size;
+            uint32_t scope;
+            uint32_t objectTypeIndex;
+            uint32_t poolClass;
+        };
+
+        constexpr size_t MIN_ALIGNMENT = alignof(std::max_align_t);
+
+        constexpr uint32_t SCOPE_COUNT = 5;
+
+        constexpr const char *SCOPE_NAMES[SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+
+        constexpr const char *OBJECT_TYPE_NAMES[] = {
+            "unknown", "instance", "physical device", "device", "queue", "semaphore", "command buffer",
+            "fence", "device memory", "buffer", "image", "event", "query pool", "buffer view",
+            "image view", "shader module", "pipeline cache", "pipeline layout", "render pass",
+            "pipeline", "descriptor set layout", "sampler", "descriptor pool", "descriptor set",
+            "framebuffer", "command pool", "other"};
+
+        void addCounters(K3HostAllocationCounters &total, const K3HostAllocationCounters &counters, int64_t sign) {
+            total.liveCount += sign * counters.liveCount;
+            total.liveBytes += sign * counters.liveBytes;
+            total.totalCount += sign * counters.totalCount;
+            total.totalBytes += sign * counters.totalBytes;
+        }
+
+    }
+
+    K3HostAllocator::K3HostAllocator(uint32_t flags) : m_flags {flags} {
+        KE_IN("({})", flags);
+        for(uint32_t i = 0; i < OBJECT_TYPE_COUNT; ++i) {
+            m_contexts[i].allocator = this;
+            m_contexts[i].objectTypeIndex = i;
+            m_callbacks[i].pUserData = &m_contexts[i];
+            m_callbacks[i].pfnAllocation = &K3HostAllocator::allocate;
+            m_callbacks[i].pfnReallocation = &K3HostAllocator::reallocate;
+            m_callbacks[i].pfnFree = &K3HostAllocator::free;
+            m_callbacks[i].pfnInternalAllocation = &K3HostAllocator::internalAllocation;
+            m_callbacks[i].pfnInternalFree = &K3HostAllocator::internalFree;
+        }
+        KE_OUT(KE_NOARG);
+    }
+
+    K3HostAllocator::~K3HostAllocator() {
+        KE_IN(KE_NOARG);
+        const K3HostAllocationStatistics statistics = getStatistics();
+        for(uint32_t i = 0; i < OBJECT_TYPE_COUNT; ++i) {
+            if(statistics.objectTypes[i].liveCount != 0) {
+                KE_WARN("{} host allocations ({} bytes) for {} still alive", statistics.objectTypes[i].liveCount, statistics.objectTypes[i].liveBytes, getObjectTypeName(i));
+            }
+        }
+        for(std::vector<void *> &pool : m_pools) {
+            for(void *block : pool) {
+                std::free(block);
+            }
+            pool.clear();
+        }
+        KE_OUT(KE_NOARG);
+    }
+
+    const VkAllocationCallbacks *K3HostAllocator::getCallbacks(VkObjectType objectType) {
+        const uint32_t index = objectType > VK_OBJECT_TYPE_UNKNOWN && objectType <= VK_OBJECT_TYPE_COMMAND_POOL ? static_cast<uint32_t>(objectType) : OBJECT_TYPE_COUNT - 1;
+        return &m_callbacks[index];
+    }
+
+    K3HostAllocationStatistics K3HostAllocator::getStatistics() const {
+        auto snapshot = [](const K3Counters &counters) {
+            K3HostAllocationCounters result{};
+            result.liveCount = counters.liveCount.load(std::memory_order_relaxed);
+            result.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+            result.totalCount = counters.totalCount.load(std::memory_order_relaxed);
+            result.totalBytes = counters.totalBytes.load(std::memory_order_relaxed);
+            return result;
+        };
+        K3HostAllocationStatistics statistics{};
+        for(uint32_t i = 0; i < SCOPE_COUNT; ++i) {
+            statistics.scopes[i] = snapshot(m_scopeCounters[i]);
+            statistics.internalBytes[i] = m_internalBytes[i].load(std::memory_order_relaxed);
+        }
+        for(uint32_t i = 0; i < OBJECT_TYPE_COUNT; ++i) {
+            statistics.objectTypes[i] = snapshot(m_objectTypeCounters[i]);
+        }
+        statistics.pooledCount = m_pooledCount.load(std::memory_order_relaxed);
+        return statistics;
+    }
+
+    void K3HostAllocator::logChurn([[maybe_unused]] const char *label, const K3HostAllocationStatistics &before, const K3HostAllocationStatistics &after) {
+        std::vector<std::pair<uint32_t, K3HostAllocationCounters>> churn;
+        for(uint32_t i = 0; i < OBJECT_TYPE_COUNT; ++i) {
+            K3HostAllocationCounters delta = after.objectTypes[i];
+            addCounters(delta, before.objectTypes[i], -1);
+            if(delta.totalCount != 0) {
+                churn.emplace_back(i, delta);
+            }
+        }
+        if(churn.empty()) {
+            return;
+        }
+        std::sort(churn.begin(), churn.end(), [](const auto &a, const auto &b) { return a.second.totalCount > b.second.totalCount; });
+
+        K3HostAllocationCounters total{};
+        for(const auto &entry : churn) {
+            addCounters(total, entry.second, 1);
+        }
+        KE_DEBUG("{}: {} host allocations, {} bytes, {} live bytes change", label, total.totalCount, total.totalBytes, static_cast<int64_t>(total.liveBytes));
+        for([[maybe_unused]] const auto &[index, delta] : churn) {
+            KE_DEBUG("  {}: {} allocations, {} bytes, {} live bytes change", getObjectTypeName(index), delta.totalCount, delta.totalBytes, static_cast<int64_t>(delta.liveBytes));
+        }
+        for(uint32_t i = 0; i < SCOPE_COUNT; ++i) {
+            const uint64_t count = after.scopes[i].totalCount - before.scopes[i].totalCount;
+            if(count != 0) {
+                KE_DEBUG("  {} scope: {} allocations, {} bytes", getScopeName(i), count, after.scopes[i].totalBytes - before.scopes[i].totalBytes);
+            }
+        }
+    }
+
+    const char *K3HostAllocator::getScopeName(uint32_t scope) {
+        return scope < SCOPE_COUNT ? SCOPE_NAMES[scope] : "unknown";
+    }
+
+    const char *K3HostAllocator::getObjectTypeName(uint32_t objectTypeIndex) {
+        return objectTypeIndex < OBJECT_TYPE_COUNT ? OBJECT_TYPE_NAMES[objectTypeIndex] : "other";
+    }
+
+    void *VKAPI_CALL K3HostAllocator::allocate(void *userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+        const K3CallbackContext *context = static_cast<const K3CallbackContext *>(userData);
+        return context->allocator->allocate(size, alignment, static_cast<uint32_t>(scope), context->objectTypeIndex);
+    }
+
+    void *VKAPI_CALL K3HostAllocator::reallocate(void *userData, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+        const K3CallbackContext *context = static_cast<const K3CallbackContext *>(userData);
+        if(original == nullptr) {
+            return context->allocator->allocate(size, alignment, static_cast<uint32_t>(scope), context->objectTypeIndex);
+        }
+        if(size == 0) {
+            context->allocator->release(original);
+            return nullptr;
+        }
+        // Keeps the original on failure, as the spec requires.
+        void *memory = context->allocator->allocate(size, alignment, static_cast<uint32_t>(scope), context->objectTypeIndex);
+        if(memory != nullptr) {
+            const K3HostAllocationHeader *header = reinterpret_cast<const K3HostAllocationHeader *>(original) - 1;
+            std::memcpy(memory, original, std::min(size, header->size));
+            context->allocator->release(original);
+        }
+        return memory;
+    }
+
+    void VKAPI_CALL K3HostAllocator::free(void *userData, void *memory) {
+        if(memory != nullptr) {
+            static_cast<const K3CallbackContext *>(userData)->allocator->release(memory);
+        }
+    }
+
+    void VKAPI_CALL K3HostAllocator::internalAllocation(void *userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+        K3HostAllocator *allocator = static_cast<const K3CallbackContext *>(userData)->allocator;
+        allocator->m_internalBytes[std::min<uint32_t>(scope, SCOPE_COUNT - 1)].fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void VKAPI_CALL K3HostAllocator::internalFree(void *userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+        K3HostAllocator *allocator = static_cast<const K3CallbackContext *>(userData)->allocator;
+        allocator->m_internalBytes[std::min<uint32_t>(scope, SCOPE_COUNT - 1)].fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    void *K3HostAllocator::allocate(size_t size, size_t alignment, uint32_t scope, uint32_t objectTypeIndex) {
+        if(size == 0) {
+            return nullptr;
+        }
+        alignment = std::max(alignment, MIN_ALIGNMENT);
+        const size_t blockSize = sizeof(K3HostAllocationHeader) + alignment - 1 + size;
+
+        void *base = nullptr;
+        uint32_t poolClass = NOT_POOLED;
+        if((m_flags & POOLED) != 0) {
+            const auto it = std::lower_bound(POOL_CLASS_SIZES.begin(), POOL_CLASS_SIZES.end(), blockSize);
+            if(it != POOL_CLASS_SIZES.end()) {
+                poolClass = static_cast<uint32_t>(it - POOL_CLASS_SIZES.begin());
+                std::lock_guard<std::mutex> lock(m_poolMutex);
+                std::vector<void *> &pool = m_pools[poolClass];
+                if(!pool.empty()) {
+                    base = pool.back();
+                    pool.pop_back();
+                    m_pooledCount.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+        if(base == nullptr) {
+            base = std::malloc(poolClass == NOT_POOLED ? blockSize : POOL_CLASS_SIZES[poolClass]);
+            if(base == nullptr) {
+                return nullptr;
+            }
+        }
+
+        const uintptr_t address = reinterpret_cast<uintptr_t>(base) + sizeof(K3HostAllocationHeader);
+        void *memory = reinterpret_cast<void *>((address + alignment - 1) / alignment * alignment);
+        K3HostAllocationHeader *header = static_cast<K3HostAllocationHeader *>(memory) - 1;
+        header->base = base;
+        header->size = size;
+        header->scope = std::min<uint32_t>(scope, SCOPE_COUNT - 1);
+        header->objectTypeIndex = objectTypeIndex;
+        header->poolClass = poolClass;
+
+        count(m_scopeCounters[header->scope], static_cast<int64_t>(size), true);
+        count(m_objectTypeCounters[objectTypeIndex], static_cast<int64_t>(size), true);
+        return memory;
+    }
+
+    void K3HostAllocator::release(void *memory) {
+        const K3HostAllocationHeader header = *(static_cast<K3HostAllocationHeader *>(memory) - 1);
+        count(m_scopeCounters[header.scope], -static_cast<int64_t>(header.size), false);
+        count(m_objectTypeCounters[header.objectTypeIndex], -static_cast<int64_t>(header.size), false);
+
+        if(header.poolClass != NOT_POOLED) {
+            std::lock_guard<std::mutex> lock(m_poolMutex);
+            m_pools[header.poolClass].push_back(header.base);
+            return;
+        }
+        std::free(header.base);
+    }
+
+    void K3HostAllocator::count(K3Counters &counters, int64_t bytes, bool allocated) {
+        if(allocated) {
+            counters.liveCount.fetch_add(1, std::memory_order_relaxed);
+            counters.totalCount.fetch_add(1, std::memory_order_relaxed);
+            counters.totalBytes.fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+        } else {
+            counters.liveCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+        counters.liveBytes.fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+    }
+
+}
@@ -0,0 +1,105 @@
+#include "k3/graphics/mapped_file.hpp"
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace k3::graphics {
+
+    std::shared_ptr<K3MappedFile> K3MappedFile::open(const std::string &filePath) {
+        KE_IN("({})", filePath);
+        std::shared_ptr<K3MappedFile> mappedFile{new K3MappedFile(filePath)};
+        if(!mappedFile->map()) {
+            KE_OUT("(): Failed to map \"{}\"", filePath);
+            return nullptr;
+        }
+        KE_OUT("(): Mapped {} bytes of \"{}\"", mappedFile->size(), filePath);
+        return mappedFile;
+    }
+
+    K3MappedFile::K3MappedFile(const std::string &filePath) : m_filePath {filePath} {
+    }
+
+#if defined(_WIN32)
+
+    bool K3MappedFile::map() {
+        HANDLE file = CreateFileA(m_filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        m_fileHandle = file;
+
+        LARGE_INTEGER fileSize;
+        if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            return false;
+        }
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping == nullptr) {
+            return false;
+        }
+        m_mappingHandle = mapping;
+
+        m_data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return m_data != nullptr;
+    }
+
+    K3MappedFile::~K3MappedFile() {
+        if(m_data != nullptr) {
+            UnmapViewOfFile(m_data);
+            m_data = nullptr;
+        }
+        if(m_mappingHandle != nullptr) {
+            CloseHandle(m_mappingHandle);
+            m_mappingHandle = nullptr;
+        }
+        if(m_fileHandle != nullptr) {
+            CloseHandle(m_fileHandle);
+            m_fileHandle = nullptr;
+        }
+    }
+
+#else
+
+    bool K3MappedFile::map() {
+        m_fileDescriptor = ::open(m_filePath.c_str(), O_RDONLY);
+        if(m_fileDescriptor < 0) {
+            return false;
+        }
+
+        struct stat fileStat;
+        if(fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+            return false;
+        }
+        m_size = static_cast<size_t>(fileStat.st_size);
+
+        void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+        if(data == MAP_FAILED) {
+            return false;
+        }
+        m_data = static_cast<const char *>(data);
+        return true;
+    }
+
+    K3MappedFile::~K3MappedFile() {
+        if(m_data != nullptr) {
+            munmap(const_cast<char *>(m_data), m_size);
+            m_data = nullptr;
+        }
+        if(m_fileDescriptor >= 0) {
+            close(m_fileDescriptor);
+            m_fileDescriptor = -1;
+        }
+    }
+
+#endif
+
+}
\ No newline at end of file
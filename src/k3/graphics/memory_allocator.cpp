@@ -0,0 +1,459 @@
+#include "k3/graphics/memory_allocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace k3::graphics {
+
+    K3MemoryAllocator::K3MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *hostAllocator) : m_device {device}, m_hostAllocator {hostAllocator} {
+        KE_IN(KE_NOARG);
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        m_nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+        KE_OUT("(): memoryTypes:{} bufferImageGranularity:{}", m_memoryProperties.memoryTypeCount, properties.limits.bufferImageGranularity);
+    }
+
+    K3MemoryAllocator::~K3MemoryAllocator() {
+        KE_IN(KE_NOARG);
+        for(auto &block : m_blocks) {
+            if(!block->allocator.isEmpty()) {
+                KE_WARN("Memory block of type {} destroyed with {} live allocations.", block->memoryTypeIndex, block->allocator.getAllocationCount());
+            }
+            freeMemory(block->memory, block->allocator.getSize(), block->memoryTypeIndex);
+        }
+        m_blocks.clear();
+        if(m_dedicatedCount > 0) {
+            KE_WARN("{} dedicated allocations still live.", m_dedicatedCount);
+        }
+        KE_OUT(KE_NOARG);
+    }
+
+    uint32_t K3MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+        KE_CRITICAL("failed to find suitable memory type!");
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    K3Allocation K3MemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, K3MemoryCategory category) {
+        KE_IN(KE_NOARG);
+        VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+        requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+        requirementsInfo.buffer = buffer;
+        VkMemoryDedicatedRequirements dedicatedRequirements{};
+        dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 requirements{};
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements.pNext = &dedicatedRequirements;
+        vkGetBufferMemoryRequirements2(m_device, &requirementsInfo, &requirements);
+
+        K3Allocation allocation = allocate(requirements.memoryRequirements, properties, true, dedicatedRequirements.prefersDedicatedAllocation == VK_TRUE, buffer, VK_NULL_HANDLE, category);
+        if (vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            free(allocation);
+            KE_CRITICAL("failed to bind buffer memory!");
+            throw std::runtime_error("failed to bind buffer memory!");
+        }
+        KE_OUT("(): offset:{} size:{}", allocation.offset, allocation.size);
+        return allocation;
+    }
+
+    K3Allocation K3MemoryAllocator::allocateForImage(VkImage image, VkMemoryPropertyFlags properties, K3MemoryCategory category) {
+        KE_IN(KE_NOARG);
+        VkImageMemoryRequirementsInfo2 requirementsInfo{};
+        requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+        requirementsInfo.image = image;
+        VkMemoryDedicatedRequirements dedicatedRequirements{};
+        dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 requirements{};
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements.pNext = &dedicatedRequirements;
+        vkGetImageMemoryRequirements2(m_device, &requirementsInfo, &requirements);
+
+        // Only optimally tiled images are created here (depth attachments), so they go in non linear blocks.
+        K3Allocation allocation = allocate(requirements.memoryRequirements, properties, false, dedicatedRequirements.prefersDedicatedAllocation == VK_TRUE, VK_NULL_HANDLE, image, category);
+        if (vkBindImageMemory(m_device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            free(allocation);
+            KE_CRITICAL("failed to bind image memory!");
+            throw std::runtime_error("failed to bind image memory!");
+        }
+        KE_OUT("(): offset:{} size:{}", allocation.offset, allocation.size);
+        return allocation;
+    }
+
+    K3Allocation K3MemoryAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated, VkBuffer buffer, VkImage image,
+        K3MemoryCategory category) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+        const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+        if(dedicated || requirements.size > blockSize / DEDICATED_FRACTION) {
+            return allocateDedicated(requirements, memoryTypeIndex, buffer, image, category);
+        }
+
+        const VkDeviceSize alignment = getAlignment(requirements, memoryTypeIndex);
+        for(auto &block : m_blocks) {
+            if(block->memoryTypeIndex != memoryTypeIndex || block->linear != linear || block->evacuating) {
+                continue;
+            }
+            const uint64_t offset = block->allocator.allocate(requirements.size, alignment);
+            if(offset != K3TlsfAllocator::INVALID_OFFSET) {
+                return makeAllocation(*block, offset, requirements.size, category);
+            }
+        }
+
+        VkDeviceMemory memory = allocateMemory(blockSize, memoryTypeIndex, VK_NULL_HANDLE, VK_NULL_HANDLE);
+        if(memory == VK_NULL_HANDLE) {
+            KE_WARN("Could not allocate a {} byte block of type {}, falling back to a dedicated allocation.", blockSize, memoryTypeIndex);
+            return allocateDedicated(requirements, memoryTypeIndex, buffer, image, category);
+        }
+        void *mapped = nullptr;
+        if(isHostVisible(memoryTypeIndex) && vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+            mapped = nullptr;
+        }
+        m_blocks.push_back(std::make_unique<K3MemoryBlock>(K3MemoryBlock{memory, mapped, memoryTypeIndex, linear, K3TlsfAllocator{blockSize}}));
+        KE_DEBUG("Allocated {} byte memory block {} of type {}.", blockSize, m_blocks.size(), memoryTypeIndex);
+
+        K3MemoryBlock &block = *m_blocks.back();
+        return makeAllocation(block, block.allocator.allocate(requirements.size, alignment), requirements.size, category);
+    }
+
+    K3Allocation K3MemoryAllocator::makeAllocation(K3MemoryBlock &block, uint64_t offset, VkDeviceSize size, K3MemoryCategory category) {
+        K3Allocation allocation{};
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char *>(block.mapped) + offset : nullptr;
+        allocation.memoryTypeIndex = block.memoryTypeIndex;
+        allocation.block = &block;
+        allocation.category = category;
+        m_categoryBytes[static_cast<size_t>(category)] += allocation.size;
+        return allocation;
+    }
+
+    VkDeviceSize K3MemoryAllocator::getAlignment(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex) const {
+        // Keep non coherent allocations on atom boundaries so flushing one never has to touch a neighbour.
+        VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        if(isHostVisible(memoryTypeIndex) && (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+            alignment = std::max(alignment, m_nonCoherentAtomSize);
+        }
+        return alignment;
+    }
+
+    K3Allocation K3MemoryAllocator::allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image,
+        K3MemoryCategory category) {
+        VkDeviceMemory memory = allocateMemory(requirements.size, memoryTypeIndex, buffer, image);
+        if(memory == VK_NULL_HANDLE) {
+            KE_CRITICAL("failed to allocate device memory!");
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+        K3Allocation allocation{};
+        allocation.memory = memory;
+        allocation.size = requirements.size;
+        allocation.memoryTypeIndex = memoryTypeIndex;
+        allocation.category = category;
+        if(isHostVisible(memoryTypeIndex) && vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) != VK_SUCCESS) {
+            allocation.mapped = nullptr;
+        }
+        m_categoryBytes[static_cast<size_t>(category)] += allocation.size;
+        m_dedicatedCount++;
+        m_dedicatedBytes += requirements.size;
+        KE_DEBUG("Dedicated {} byte allocation of type {}.", requirements.size, memoryTypeIndex);
+        return allocation;
+    }
+
+    VkDeviceMemory K3MemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image) {
+        VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+        dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedInfo.buffer = buffer;
+        dedicatedInfo.image = image;
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.pNext = (buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE) ? &dedicatedInfo : nullptr;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        if (vkAllocateMemory(m_device, &allocInfo, m_hostAllocator, &memory) != VK_SUCCESS) {
+            return VK_NULL_HANDLE;
+        }
+        m_heapBytes[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex] += size;
+        return memory;
+    }
+
+    void K3MemoryAllocator::freeMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex) {
+        vkFreeMemory(m_device, memory, m_hostAllocator);
+        m_heapBytes[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex] -= size;
+    }
+
+    void K3MemoryAllocator::free(K3Allocation &allocation) {
+        if(allocation.memory == VK_NULL_HANDLE) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_categoryBytes[static_cast<size_t>(allocation.category)] -= allocation.size;
+        if(allocation.block == nullptr) {
+            freeMemory(allocation.memory, allocation.size, allocation.memoryTypeIndex);
+            m_dedicatedCount--;
+            m_dedicatedBytes -= allocation.size;
+        } else {
+            K3MemoryBlock *block = allocation.block;
+            block->relocatables.erase(allocation.offset);
+            block->allocator.free(allocation.offset);
+            // Keep one empty block per type around so a free/allocate pattern doesn't thrash
+            // vkAllocateMemory, unless the defragmenter emptied it to give the memory back.
+            if(block->allocator.isEmpty()) {
+                const bool hasSpare = std::any_of(m_blocks.begin(), m_blocks.end(), [block](const auto &other) {
+                    return other.get() != block && other->memoryTypeIndex == block->memoryTypeIndex && other->linear == block->linear && other->allocator.isEmpty();
+                });
+                if(hasSpare || block->evacuating) {
+                    if(block == m_evacuating) {
+                        m_evacuating = nullptr;
+                    }
+                    freeMemory(block->memory, block->allocator.getSize(), block->memoryTypeIndex);
+                    m_blocks.erase(std::find_if(m_blocks.begin(), m_blocks.end(), [block](const auto &other) { return other.get() == block; }));
+                    KE_DEBUG("Released empty memory block, {} left.", m_blocks.size());
+                }
+            }
+        }
+        allocation = K3Allocation{};
+    }
+
+    VkMappedMemoryRange K3MemoryAllocator::getMappedRange(const K3Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) const {
+        const VkDeviceSize memorySize = allocation.block != nullptr ? allocation.block->allocator.getSize() : allocation.size;
+        const VkDeviceSize begin = allocation.offset + offset;
+        const VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+
+        VkMappedMemoryRange mappedRange = {};
+        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        mappedRange.memory = allocation.memory;
+        mappedRange.offset = begin - begin % m_nonCoherentAtomSize;
+        const VkDeviceSize alignedEnd = (end + m_nonCoherentAtomSize - 1) / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+        mappedRange.size = alignedEnd >= memorySize ? VK_WHOLE_SIZE : alignedEnd - mappedRange.offset;
+        return mappedRange;
+    }
+
+    VkResult K3MemoryAllocator::flush(const K3Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+        VkMappedMemoryRange mappedRange = getMappedRange(allocation, size, offset);
+        return vkFlushMappedMemoryRanges(m_device, 1, &mappedRange);
+    }
+
+    VkResult K3MemoryAllocator::flush(const std::vector<VkMappedMemoryRange> &mappedRanges) {
+        if(mappedRanges.empty()) {
+            return VK_SUCCESS;
+        }
+        return vkFlushMappedMemoryRanges(m_device, static_cast<uint32_t>(mappedRanges.size()), mappedRanges.data());
+    }
+
+    VkResult K3MemoryAllocator::invalidate(const K3Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+        VkMappedMemoryRange mappedRange = getMappedRange(allocation, size, offset);
+        return vkInvalidateMappedMemoryRanges(m_device, 1, &mappedRange);
+    }
+
+    VkDeviceSize K3MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const {
+        const VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+        return std::min(BLOCK_SIZE, heapSize / 8);
+    }
+
+    bool K3MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const {
+        return (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    }
+
+    K3MemoryStatistics K3MemoryAllocator::getStatistics() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        K3MemoryStatistics statistics{};
+        uint64_t freeBytes = 0;
+        uint64_t largestFreeBytes = 0;
+        for(const auto &block : m_blocks) {
+            statistics.blockCount++;
+            statistics.allocationCount += block->allocator.getAllocationCount();
+            statistics.blockBytes += block->allocator.getSize();
+            statistics.usedBytes += block->allocator.getUsedBytes();
+            freeBytes += block->allocator.getFreeBytes();
+            largestFreeBytes += block->allocator.getLargestFreeRegion();
+        }
+        statistics.dedicatedCount = m_dedicatedCount;
+        statistics.dedicatedBytes = m_dedicatedBytes;
+        statistics.allocationCount += m_dedicatedCount;
+        statistics.fragmentation = freeBytes > 0 ? 1.f - static_cast<float>(static_cast<double>(largestFreeBytes) / static_cast<double>(freeBytes)) : 0.f;
+        return statistics;
+    }
+
+    void K3MemoryAllocator::trackExternal(K3MemoryCategory category, uint32_t heapIndex, int64_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_categoryBytes[static_cast<size_t>(category)] += static_cast<uint64_t>(bytes);
+        m_heapBytes[heapIndex] += static_cast<uint64_t>(bytes);
+    }
+
+    uint64_t K3MemoryAllocator::getCategoryBytes(K3MemoryCategory category) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_categoryBytes[static_cast<size_t>(category)];
+    }
+
+    uint64_t K3MemoryAllocator::getHeapBytes(uint32_t heapIndex) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_heapBytes[heapIndex];
+    }
+
+    const char *K3MemoryAllocator::getCategoryName(K3MemoryCategory category) {
+        switch(category) {
+            case K3MemoryCategory::GEOMETRY: return "Geometry";
+            case K3MemoryCategory::STAGING: return "Staging";
+            case K3MemoryCategory::UNIFORM: return "Uniforms";
+            case K3MemoryCategory::DEPTH: return "Depth";
+            case K3MemoryCategory::IMGUI: return "ImGui";
+            default: return "Other";
+        }
+    }
+
+    void K3MemoryAllocator::setRelocatable(const K3Allocation &allocation, VkBuffer buffer, VkDeviceSize bufferSize, VkBufferUsageFlags usage,
+        K3RelocationCallback callback, std::function<bool()> isMovable) {
+        if(allocation.block == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        K3Relocatable &relocatable = allocation.block->relocatables[allocation.offset];
+        relocatable.allocation = allocation;
+        relocatable.buffer = buffer;
+        relocatable.bufferSize = bufferSize;
+        relocatable.usage = usage;
+        relocatable.callback = std::move(callback);
+        relocatable.isMovable = std::move(isMovable);
+    }
+
+    void K3MemoryAllocator::clearRelocatable(const K3Allocation &allocation) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(allocation.block != nullptr) {
+            allocation.block->relocatables.erase(allocation.offset);
+        }
+    }
+
+    K3MemoryBlock *K3MemoryAllocator::selectEvacuation(VkDeviceSize maxBytes) const {
+        K3MemoryBlock *selected = nullptr;
+        for(const auto &block : m_blocks) {
+            const K3TlsfAllocator &allocator = block->allocator;
+            // Every allocation has to be able to leave, or the block never empties.
+            if(allocator.isEmpty() || allocator.getUsedBytes() >= allocator.getSize() * SPARSE_BLOCK_RATIO || block->relocatables.size() != allocator.getAllocationCount()) {
+                continue;
+            }
+            if(std::any_of(block->relocatables.begin(), block->relocatables.end(), [maxBytes](const auto &entry) { return entry.second.allocation.size > maxBytes; })) {
+                continue;
+            }
+            uint64_t freeBytes = 0;
+            for(const auto &other : m_blocks) {
+                if(other != block && other->memoryTypeIndex == block->memoryTypeIndex && other->linear == block->linear && !other->allocator.isEmpty()) {
+                    freeBytes += other->allocator.getFreeBytes();
+                }
+            }
+            if(freeBytes >= allocator.getUsedBytes() && (selected == nullptr || allocator.getUsedBytes() < selected->allocator.getUsedBytes())) {
+                selected = block.get();
+            }
+        }
+        return selected;
+    }
+
+    std::vector<K3Relocatable> K3MemoryAllocator::planDefragmentation(VkDeviceSize maxBytes) {
+        std::vector<K3Relocatable> candidates{};
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_evacuating == nullptr) {
+                m_evacuating = selectEvacuation(maxBytes);
+                if(m_evacuating == nullptr) {
+                    return {};
+                }
+                m_evacuating->evacuating = true;
+                KE_DEBUG("Evacuating memory block of type {}, {} of {} bytes used by {} allocations.", m_evacuating->memoryTypeIndex,
+                    m_evacuating->allocator.getUsedBytes(), m_evacuating->allocator.getSize(), m_evacuating->allocator.getAllocationCount());
+            }
+            candidates.reserve(m_evacuating->relocatables.size());
+            for(const auto &[offset, relocatable] : m_evacuating->relocatables) {
+                if(relocatable.allocation.size <= maxBytes) {
+                    candidates.push_back(relocatable);
+                }
+            }
+        }
+
+        // isMovable is owner code and may take its own locks, so it runs without m_mutex. An
+        // owner that frees in between is caught by commitRelocation.
+        std::vector<K3Relocatable> plan{};
+        VkDeviceSize bytes = 0;
+        for(K3Relocatable &relocatable : candidates) {
+            if(bytes + relocatable.allocation.size > maxBytes || (relocatable.isMovable != nullptr && !relocatable.isMovable())) {
+                continue;
+            }
+            bytes += relocatable.allocation.size;
+            plan.push_back(std::move(relocatable));
+        }
+        return plan;
+    }
+
+    K3Allocation K3MemoryAllocator::allocateForRelocation(VkBuffer buffer, const K3Allocation &source) {
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(m_device, buffer, &requirements);
+        if((requirements.memoryTypeBits & (1u << source.memoryTypeIndex)) == 0) {
+            return {};
+        }
+        K3Allocation allocation{};
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const VkDeviceSize alignment = getAlignment(requirements, source.memoryTypeIndex);
+            std::vector<K3MemoryBlock *> blocks{};
+            for(const auto &block : m_blocks) {
+                if(block->memoryTypeIndex == source.memoryTypeIndex && block->linear && !block->evacuating && !block->allocator.isEmpty()) {
+                    blocks.push_back(block.get());
+                }
+            }
+            // Densest first, filling the holes of the fullest blocks keeps the others emptying.
+            std::sort(blocks.begin(), blocks.end(), [](const K3MemoryBlock *a, const K3MemoryBlock *b) { return a->allocator.getUsedBytes() > b->allocator.getUsedBytes(); });
+            for(K3MemoryBlock *block : blocks) {
+                const uint64_t offset = block->allocator.allocate(requirements.size, alignment);
+                if(offset != K3TlsfAllocator::INVALID_OFFSET) {
+                    allocation = makeAllocation(*block, offset, requirements.size, source.category);
+                    break;
+                }
+            }
+        }
+        if(allocation.memory != VK_NULL_HANDLE && vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            KE_ERROR("failed to bind relocated buffer memory!");
+            free(allocation);
+        }
+        return allocation;
+    }
+
+    bool K3MemoryAllocator::commitRelocation(const K3Allocation &source, VkBuffer buffer, const K3Allocation &allocation) {
+        K3RelocationCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // The source block itself may be gone if its last allocation was freed meanwhile.
+            const bool blockAlive = std::any_of(m_blocks.begin(), m_blocks.end(), [&source](const auto &block) { return block.get() == source.block; });
+            if(!blockAlive) {
+                return false;
+            }
+            auto it = source.block->relocatables.find(source.offset);
+            if(it == source.block->relocatables.end()) {
+                return false;
+            }
+            K3Relocatable relocatable = std::move(it->second);
+            source.block->relocatables.erase(it);
+            relocatable.allocation = allocation;
+            relocatable.buffer = buffer;
+            callback = relocatable.callback;
+            allocation.block->relocatables[allocation.offset] = std::move(relocatable);
+        }
+        // Outside m_mutex, the owner may allocate, free or register again from its callback.
+        callback(buffer, allocation);
+        return true;
+    }
+
+    void K3MemoryAllocator::abortDefragmentation() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_evacuating != nullptr) {
+            m_evacuating->evacuating = false;
+            m_evacuating = nullptr;
+        }
+    }
+
+}
@@ -0,0 +1,335 @@
+#include "k3/graphics/mesh_cache.hpp"
+#include "k3/graphics/meshlet.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+namespace k3::graphics {
+
+    static_assert(sizeof(K3Vertex) == 11 * sizeof(float), "K3Vertex must stay tightly packed for the mesh cache");
+    static_assert(sizeof(K3MeshLod) == 3 * sizeof(uint32_t), "K3MeshLod must stay tightly packed for the mesh cache");
+    static_assert(sizeof(K3SubMesh) == 3 * sizeof(uint32_t), "K3SubMesh must stay tightly packed for the mesh cache");
+    static_assert(sizeof(K3Meshlet) == 4 * sizeof(uint32_t), "K3Meshlet must stay tightly packed for the mesh cache");
+    static_assert(sizeof(K3MeshletBounds) == 12 * sizeof(float), "K3MeshletBounds must stay tightly packed for the mesh cache");
+    static_assert(sizeof(K3MeshCacheHeader) % 16 == 0, "K3MeshCacheHeader must keep the vertex array 16 byte aligned");
+
+    namespace {
+
+        uint64_t alignSection(uint64_t offset) {
+            return (offset + 15) & ~static_cast<uint64_t>(15);
+        }
+
+    }
+
+    std::string K3MeshCache::getCachePath(const std::string &sourcePath) {
+        return sourcePath + EXTENSION;
+    }
+
+    bool K3MeshCache::querySource(const std::string &sourcePath, uint64_t &sourceSize, int64_t &sourceTime) {
+        std::error_code error;
+        auto size = std::filesystem::file_size(sourcePath, error);
+        if(error) {
+            return false;
+        }
+        auto time = std::filesystem::last_write_time(sourcePath, error);
+        if(error) {
+            return false;
+        }
+        sourceSize = static_cast<uint64_t>(size);
+        sourceTime = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    bool K3MeshCache::isValidGeometry(const K3MeshCacheHeader &header, const char *data) {
+        // Every cached mesh has at least the full detail level, and each level a whole number of triangles.
+        if(header.lodCount == 0) {
+            return false;
+        }
+        const K3MeshLod *lods = reinterpret_cast<const K3MeshLod *>(data + header.lodOffset);
+        for(uint32_t i = 0; i < header.lodCount; i++) {
+            if(static_cast<uint64_t>(lods[i].firstIndex) + lods[i].indexCount > header.indexCount || lods[i].indexCount % 3 != 0) {
+                return false;
+            }
+        }
+
+        // One pass over the mapping, which the upload reads right after anyway, so a bad index
+        // can't send the GPU or the meshlet builder outside the vertex buffer.
+        const uint32_t *indices = reinterpret_cast<const uint32_t *>(data + header.indexOffset);
+        uint32_t maxIndex = 0;
+        for(uint32_t i = 0; i < header.indexCount; i++) {
+            maxIndex = std::max(maxIndex, indices[i]);
+        }
+        if(header.indexCount > 0 && maxIndex >= header.vertexCount) {
+            return false;
+        }
+
+        const K3SubMesh *subMeshes = reinterpret_cast<const K3SubMesh *>(data + header.subMeshOffset);
+        const uint16_t *shortIndices = reinterpret_cast<const uint16_t *>(data + header.shortIndexOffset);
+        for(uint32_t i = 0; i < header.subMeshCount; i++) {
+            const K3SubMesh &subMesh = subMeshes[i];
+            if(static_cast<uint64_t>(subMesh.firstIndex) + subMesh.indexCount > header.indexCount || subMesh.vertexOffset < 0) {
+                return false;
+            }
+            if(header.indexType != VK_INDEX_TYPE_UINT16) {
+                continue;
+            }
+            for(uint32_t j = subMesh.firstIndex; j < subMesh.firstIndex + subMesh.indexCount; j++) {
+                if(static_cast<uint64_t>(subMesh.vertexOffset) + shortIndices[j] >= header.vertexCount) {
+                    return false;
+                }
+            }
+        }
+
+        const K3Meshlet *meshlets = reinterpret_cast<const K3Meshlet *>(data + header.meshletOffset);
+        const uint32_t *meshletVertices = reinterpret_cast<const uint32_t *>(data + header.meshletVertexOffset);
+        const uint8_t *meshletTriangles = reinterpret_cast<const uint8_t *>(data + header.meshletTriangleOffset);
+        for(uint32_t i = 0; i < header.meshletCount; i++) {
+            const K3Meshlet &meshlet = meshlets[i];
+            if(meshlet.vertexCount > K3MeshletGenerator::MAX_VERTICES || meshlet.triangleCount > K3MeshletGenerator::MAX_TRIANGLES
+                || static_cast<uint64_t>(meshlet.vertexOffset) + meshlet.vertexCount > header.meshletVertexCount
+                || static_cast<uint64_t>(meshlet.triangleOffset) + 3 * meshlet.triangleCount > header.meshletTriangleCount) {
+                return false;
+            }
+            for(uint32_t j = 0; j < 3 * meshlet.triangleCount; j++) {
+                if(meshletTriangles[meshlet.triangleOffset + j] >= meshlet.vertexCount) {
+                    return false;
+                }
+            }
+        }
+        for(uint32_t i = 0; i < header.meshletVertexCount; i++) {
+            if(meshletVertices[i] >= header.vertexCount) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool K3MeshCache::load(const std::string &sourcePath, K3Builder &builder) {
+        KE_IN("({})", sourcePath);
+
+        uint64_t sourceSize = 0;
+        int64_t sourceTime = 0;
+        if(!querySource(sourcePath, sourceSize, sourceTime)) {
+            KE_OUT("(): Source \"{}\" not found", sourcePath);
+            return false;
+        }
+
+        const std::string cachePath = getCachePath(sourcePath);
+        std::error_code error;
+        if(!std::filesystem::exists(cachePath, error)) {
+            KE_OUT("(): No mesh cache at \"{}\"", cachePath);
+            return false;
+        }
+
+        std::shared_ptr<K3MappedFile> mappedFile = K3MappedFile::open(cachePath);
+        if(mappedFile == nullptr || mappedFile->size() < sizeof(K3MeshCacheHeader)) {
+            KE_WARN("Mesh cache \"{}\" could not be mapped.", cachePath);
+            KE_OUT(KE_NOARG);
+            return false;
+        }
+
+        K3MeshCacheHeader header;
+        std::memcpy(&header, mappedFile->data(), sizeof(header));
+
+        if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.vertexStride != sizeof(K3Vertex)) {
+            KE_DEBUG("Mesh cache \"{}\" has an incompatible format (version {}).", cachePath, header.version);
+            KE_OUT(KE_NOARG);
+            return false;
+        }
+        if(header.flags != builder.optimizeFlags || header.formatFlags != builder.vertexFormatFlags || header.indexFlags != builder.indexFlags) {
+            KE_DEBUG("Mesh cache \"{}\" was processed with different flags ({:#x}, {:#x}, {:#x}).", cachePath, header.flags, header.formatFlags, header.indexFlags);
+            KE_OUT(KE_NOARG);
+            return false;
+        }
+        if(header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+            KE_DEBUG("Mesh cache \"{}\" is stale.", cachePath);
+            KE_OUT(KE_NOARG);
+            return false;
+        }
+
+        const uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * sizeof(K3Vertex);
+        const uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t);
+        const uint64_t lodBytes = static_cast<uint64_t>(header.lodCount) * sizeof(K3MeshLod);
+        const uint64_t encodedBytes = static_cast<uint64_t>(header.vertexCount) * header.encodedStride;
+        const uint64_t shortIndexBytes = header.indexType == VK_INDEX_TYPE_UINT16 ? static_cast<uint64_t>(header.indexCount) * sizeof(uint16_t) : 0;
+        const uint64_t subMeshBytes = static_cast<uint64_t>(header.subMeshCount) * sizeof(K3SubMesh);
+        const uint64_t meshletBytes = static_cast<uint64_t>(header.meshletCount) * sizeof(K3Meshlet);
+        const uint64_t meshletBoundsBytes = static_cast<uint64_t>(header.meshletCount) * sizeof(K3MeshletBounds);
+        const uint64_t meshletVertexBytes = static_cast<uint64_t>(header.meshletVertexCount) * sizeof(uint32_t);
+        const uint64_t meshletTriangleBytes = header.meshletTriangleCount;
+        const bool hasValidEncoding = header.encodedStride == 0 || header.encodedStride == K3VertexFormat{header.encodedFormat}.getStride();
+        const bool hasValidIndexType = (header.indexType == VK_INDEX_TYPE_UINT16 || header.indexType == VK_INDEX_TYPE_UINT32) && header.subMeshCount > 0;
+        if(!hasValidEncoding || !hasValidIndexType
+            || header.vertexOffset % 16 != 0 || header.indexOffset % 16 != 0 || header.lodOffset % 16 != 0
+            || header.encodedOffset % 16 != 0 || header.shortIndexOffset % 16 != 0 || header.subMeshOffset % 16 != 0
+            || header.meshletOffset % 16 != 0 || header.meshletBoundsOffset % 16 != 0 || header.meshletVertexOffset % 16 != 0
+            || header.meshletTriangleOffset % 16 != 0
+            || header.vertexOffset + vertexBytes > mappedFile->size() || header.indexOffset + indexBytes > mappedFile->size()
+            || header.lodOffset + lodBytes > mappedFile->size() || header.encodedOffset + encodedBytes > mappedFile->size()
+            || header.shortIndexOffset + shortIndexBytes > mappedFile->size() || header.subMeshOffset + subMeshBytes > mappedFile->size()
+            || header.meshletOffset + meshletBytes > mappedFile->size() || header.meshletBoundsOffset + meshletBoundsBytes > mappedFile->size()
+            || header.meshletVertexOffset + meshletVertexBytes > mappedFile->size() || header.meshletTriangleOffset + meshletTriangleBytes > mappedFile->size()) {
+            KE_WARN("Mesh cache \"{}\" is truncated or corrupt.", cachePath);
+            KE_OUT(KE_NOARG);
+            return false;
+        }
+        if(!isValidGeometry(header, mappedFile->data())) {
+            KE_WARN("Mesh cache \"{}\" has out of range indices or levels of detail.", cachePath);
+            KE_OUT(KE_NOARG);
+            return false;
+        }
+
+        builder.vertices.clear();
+        builder.indices.clear();
+        builder.encodedVertices.clear();
+        builder.lods.resize(header.lodCount);
+        std::memcpy(builder.lods.data(), mappedFile->data() + header.lodOffset, lodBytes);
+        // Small next to the geometry, and K3Model pads the triangles before upload anyway.
+        builder.meshlets.resize(header.meshletCount);
+        std::memcpy(builder.meshlets.data(), mappedFile->data() + header.meshletOffset, meshletBytes);
+        builder.meshletBounds.resize(header.meshletCount);
+        std::memcpy(builder.meshletBounds.data(), mappedFile->data() + header.meshletBoundsOffset, meshletBoundsBytes);
+        builder.meshletVertices.resize(header.meshletVertexCount);
+        std::memcpy(builder.meshletVertices.data(), mappedFile->data() + header.meshletVertexOffset, meshletVertexBytes);
+        builder.meshletTriangles.resize(header.meshletTriangleCount);
+        std::memcpy(builder.meshletTriangles.data(), mappedFile->data() + header.meshletTriangleOffset, meshletTriangleBytes);
+        builder.boundsMin = glm::vec3{header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+        builder.boundsMax = glm::vec3{header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+        builder.vertexFormat = K3VertexFormat{header.encodedFormat};
+        builder.dequantizeOffset = glm::vec3{header.dequantizeOffset[0], header.dequantizeOffset[1], header.dequantizeOffset[2]};
+        builder.dequantizeScale = header.dequantizeScale;
+        builder.uniformColor = glm::vec3{header.uniformColor[0], header.uniformColor[1], header.uniformColor[2]};
+        builder.m_mappedVertices = reinterpret_cast<const K3Vertex *>(mappedFile->data() + header.vertexOffset);
+        builder.m_mappedVertexCount = header.vertexCount;
+        builder.m_mappedIndices = reinterpret_cast<const uint32_t *>(mappedFile->data() + header.indexOffset);
+        builder.m_mappedIndexCount = header.indexCount;
+        builder.m_mappedEncodedVertices = header.encodedStride != 0 ? reinterpret_cast<const uint8_t *>(mappedFile->data() + header.encodedOffset) : nullptr;
+        builder.m_mappedIndexType = static_cast<VkIndexType>(header.indexType);
+        builder.m_mappedShortIndices = shortIndexBytes > 0 ? reinterpret_cast<const uint16_t *>(mappedFile->data() + header.shortIndexOffset) : nullptr;
+        builder.m_mappedSubMeshes = reinterpret_cast<const K3SubMesh *>(mappedFile->data() + header.subMeshOffset);
+        builder.m_mappedSubMeshCount = header.subMeshCount;
+        builder.m_mappedFile = mappedFile;
+
+        KE_OUT("(): vertices:{} indices:{} stride:{} meshlets:{}", header.vertexCount, header.indexCount, header.encodedStride, header.meshletCount);
+        return true;
+    }
+
+    bool K3MeshCache::store(const std::string &sourcePath, const K3Builder &builder) {
+        KE_IN("({})", sourcePath);
+
+        K3MeshCacheHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.vertexStride = sizeof(K3Vertex);
+        header.flags = builder.optimizeFlags;
+        header.formatFlags = builder.vertexFormatFlags;
+        header.indexFlags = builder.indexFlags;
+        header.vertexCount = builder.vertexCount();
+        header.indexCount = builder.indexCount();
+        // Without GENERATE_LODS the full mesh is still written as the one level.
+        const K3MeshLod fullMesh{0, builder.indexCount(), 0.f};
+        const K3MeshLod *lods = builder.lods.empty() ? &fullMesh : builder.lods.data();
+        header.lodCount = builder.lods.empty() ? 1 : static_cast<uint32_t>(builder.lods.size());
+        if(!querySource(sourcePath, header.sourceSize, header.sourceTime)) {
+            KE_OUT("(): Source \"{}\" not found", sourcePath);
+            return false;
+        }
+        if(builder.isEncoded()) {
+            header.encodedFormat = builder.vertexFormat.getFlags();
+            header.encodedStride = builder.vertexFormat.getStride();
+        }
+        // The index width K3Model would otherwise pick again on every load.
+        std::vector<uint16_t> shortIndices{};
+        std::vector<K3SubMesh> subMeshes{};
+        const VkIndexType indexType = builder.buildIndices(shortIndices, subMeshes);
+        header.indexType = static_cast<uint32_t>(indexType);
+        header.subMeshCount = static_cast<uint32_t>(subMeshes.size());
+        header.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+        header.meshletVertexCount = static_cast<uint32_t>(builder.meshletVertices.size());
+        header.meshletTriangleCount = static_cast<uint32_t>(builder.meshletTriangles.size());
+
+        const uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * sizeof(K3Vertex);
+        const uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t);
+        const uint64_t lodBytes = static_cast<uint64_t>(header.lodCount) * sizeof(K3MeshLod);
+        const uint64_t encodedBytes = static_cast<uint64_t>(header.vertexCount) * header.encodedStride;
+        const uint64_t shortIndexBytes = static_cast<uint64_t>(shortIndices.size()) * sizeof(uint16_t);
+        const uint64_t subMeshBytes = static_cast<uint64_t>(header.subMeshCount) * sizeof(K3SubMesh);
+        const uint64_t meshletBytes = static_cast<uint64_t>(header.meshletCount) * sizeof(K3Meshlet);
+        const uint64_t meshletBoundsBytes = static_cast<uint64_t>(header.meshletCount) * sizeof(K3MeshletBounds);
+        const uint64_t meshletVertexBytes = static_cast<uint64_t>(header.meshletVertexCount) * sizeof(uint32_t);
+        const uint64_t meshletTriangleBytes = header.meshletTriangleCount;
+        header.vertexOffset = sizeof(K3MeshCacheHeader);
+        header.indexOffset = alignSection(header.vertexOffset + vertexBytes);
+        header.lodOffset = alignSection(header.indexOffset + indexBytes);
+        header.encodedOffset = alignSection(header.lodOffset + lodBytes);
+        header.shortIndexOffset = alignSection(header.encodedOffset + encodedBytes);
+        header.subMeshOffset = alignSection(header.shortIndexOffset + shortIndexBytes);
+        header.meshletOffset = alignSection(header.subMeshOffset + subMeshBytes);
+        header.meshletBoundsOffset = alignSection(header.meshletOffset + meshletBytes);
+        header.meshletVertexOffset = alignSection(header.meshletBoundsOffset + meshletBoundsBytes);
+        header.meshletTriangleOffset = alignSection(header.meshletVertexOffset + meshletVertexBytes);
+        for(int i = 0; i < 3; i++) {
+            header.boundsMin[i] = builder.boundsMin[i];
+            header.boundsMax[i] = builder.boundsMax[i];
+            header.dequantizeOffset[i] = builder.dequantizeOffset[i];
+            header.uniformColor[i] = builder.uniformColor[i];
+        }
+        header.dequantizeScale = builder.dequantizeScale;
+
+        // Write beside the final name and rename so a reader never maps a partial file.
+        const std::string cachePath = getCachePath(sourcePath);
+        const std::string tempPath = cachePath + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if(!file.is_open()) {
+                KE_WARN("Unable to write mesh cache \"{}\".", cachePath);
+                KE_OUT(KE_NOARG);
+                return false;
+            }
+            // Zero fills up to each section's aligned offset before writing it.
+            uint64_t written = 0;
+            auto writeSection = [&file, &written](uint64_t offset, const void *data, uint64_t bytes) {
+                static const char ZEROS[16]{};
+                file.write(ZEROS, static_cast<std::streamsize>(offset - written));
+                file.write(static_cast<const char *>(data), static_cast<std::streamsize>(bytes));
+                written = offset + bytes;
+            };
+            writeSection(0, &header, sizeof(header));
+            writeSection(header.vertexOffset, builder.vertexData(), vertexBytes);
+            writeSection(header.indexOffset, builder.indexData(), indexBytes);
+            writeSection(header.lodOffset, lods, lodBytes);
+            writeSection(header.encodedOffset, builder.encodedVertexData(), encodedBytes);
+            writeSection(header.shortIndexOffset, shortIndices.data(), shortIndexBytes);
+            writeSection(header.subMeshOffset, subMeshes.data(), subMeshBytes);
+            writeSection(header.meshletOffset, builder.meshlets.data(), meshletBytes);
+            writeSection(header.meshletBoundsOffset, builder.meshletBounds.data(), meshletBoundsBytes);
+            writeSection(header.meshletVertexOffset, builder.meshletVertices.data(), meshletVertexBytes);
+            writeSection(header.meshletTriangleOffset, builder.meshletTriangles.data(), meshletTriangleBytes);
+            if(!file.good()) {
+                KE_WARN("Failed writing mesh cache \"{}\".", cachePath);
+                file.close();
+                std::remove(tempPath.c_str());
+                KE_OUT(KE_NOARG);
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, cachePath, error);
+        if(error) {
+            KE_WARN("Unable to replace mesh cache \"{}\": {}", cachePath, error.message());
+            std::remove(tempPath.c_str());
+            KE_OUT(KE_NOARG);
+            return false;
+        }
+
+        KE_OUT("(): Wrote \"{}\"", cachePath);
+        return true;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "k3/graphics/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace k3::graphics {
+
+    namespace {
+
+        constexpr uint32_t INVALID_VERTEX = ~0u;
+
+        // Post-transform FIFO cache simulation. Misses are counted from the first index to end.
+        class FifoCache {
+
+            public:
+
+                FifoCache(uint32_t vertexCount, uint32_t cacheSize) : m_stamps(vertexCount, 0), m_cacheSize(cacheSize), m_time(cacheSize + 1) {}
+
+                // Returns true if vertex had to be transformed.
+                bool access(uint32_t vertex) {
+                    if(m_time - m_stamps[vertex] > m_cacheSize) {
+                        m_stamps[vertex] = m_time++;
+                        return true;
+                    }
+                    return false;
+                }
+
+                // Pushing cacheSize unseen entries through a FIFO empties it.
+                void flush() {
+                    m_time += m_cacheSize + 1;
+                }
+
+            private:
+
+                std::vector<uint32_t> m_stamps;
+
+                uint32_t m_cacheSize;
+
+                uint32_t m_time;
+
+        };
+
+        uint32_t countMisses(const uint32_t *indices, size_t indexCount, FifoCache &cache) {
+            uint32_t misses = 0;
+            for(size_t i = 0; i < indexCount; i++) {
+                misses += cache.access(indices[i]) ? 1 : 0;
+            }
+            return misses;
+        }
+
+    }
+
+    void K3MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount, std::vector<uint32_t> *clusters) {
+        KE_IN("(indices:{} vertices:{})", indices.size(), vertexCount);
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        if(clusters != nullptr) {
+            clusters->clear();
+        }
+        if(triangleCount == 0) {
+            KE_OUT(KE_NOARG);
+            return;
+        }
+
+        // Vertex to triangle adjacency in CSR form, plus the live (unemitted) triangle count per vertex.
+        std::vector<uint32_t> live(vertexCount, 0);
+        for(uint32_t index : indices) {
+            live[index]++;
+        }
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for(uint32_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] = offsets[v] + live[v];
+        }
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for(uint32_t t = 0; t < triangleCount; t++) {
+                adjacency[cursor[indices[3 * t + 0]]++] = t;
+                adjacency[cursor[indices[3 * t + 1]]++] = t;
+                adjacency[cursor[indices[3 * t + 2]]++] = t;
+            }
+        }
+
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint32_t> deadEnd{};
+        deadEnd.reserve(indices.size());
+        std::vector<uint32_t> candidates{};
+        std::vector<uint32_t> output{};
+        output.reserve(indices.size());
+        const uint32_t cacheSize = CACHE_SIZE;
+        uint32_t timestamp = cacheSize + 1;
+        uint32_t scan = 0;
+
+        // Recently touched vertices first, then the lowest numbered vertex with work left.
+        auto skipDeadEnd = [&]() {
+            while(!deadEnd.empty()) {
+                const uint32_t vertex = deadEnd.back();
+                deadEnd.pop_back();
+                if(live[vertex] > 0) {
+                    return vertex;
+                }
+            }
+            while(scan < vertexCount) {
+                if(live[scan] > 0) {
+                    return scan;
+                }
+                scan++;
+            }
+            return INVALID_VERTEX;
+        };
+
+        uint32_t fanning = skipDeadEnd();
+        if(clusters != nullptr) {
+            clusters->push_back(0);
+        }
+        while(fanning != INVALID_VERTEX) {
+            candidates.clear();
+            for(uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+                const uint32_t t = adjacency[a];
+                if(emitted[t]) {
+                    continue;
+                }
+                for(uint32_t k = 0; k < 3; k++) {
+                    const uint32_t vertex = indices[3 * t + k];
+                    output.push_back(vertex);
+                    deadEnd.push_back(vertex);
+                    candidates.push_back(vertex);
+                    live[vertex]--;
+                    if(timestamp - cacheTime[vertex] > cacheSize) {
+                        cacheTime[vertex] = timestamp++;
+                    }
+                }
+                emitted[t] = 1;
+            }
+
+            // Prefer the oldest candidate whose remaining fan will still hit the cache.
+            uint32_t next = INVALID_VERTEX;
+            int64_t bestPriority = -1;
+            for(uint32_t vertex : candidates) {
+                if(live[vertex] == 0) {
+                    continue;
+                }
+                int64_t priority = 0;
+                if(timestamp - cacheTime[vertex] + 2 * live[vertex] <= cacheSize) {
+                    priority = timestamp - cacheTime[vertex];
+                }
+                if(priority > bestPriority) {
+                    bestPriority = priority;
+                    next = vertex;
+                }
+            }
+            if(next == INVALID_VERTEX) {
+                next = skipDeadEnd();
+                if(next != INVALID_VERTEX && clusters != nullptr) {
+                    clusters->push_back(static_cast<uint32_t>(output.size()));
+                }
+            }
+            fanning = next;
+        }
+
+        indices.swap(output);
+        KE_OUT("(): clusters:{}", clusters != nullptr ? clusters->size() : 0);
+    }
+
+    void K3MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices, const K3Vertex *vertices, uint32_t vertexCount, const std::vector<uint32_t> &clusters, float threshold) {
+        KE_IN("(indices:{} clusters:{})", indices.size(), clusters.size());
+        if(indices.size() < 3 || clusters.empty()) {
+            KE_OUT(KE_NOARG);
+            return;
+        }
+
+        // Split the hard clusters further wherever a cold-started run is already within
+        // threshold of the whole cluster's ACMR, so sorting can't cost more than that.
+        std::vector<uint32_t> boundaries{};
+        FifoCache cache{vertexCount, CACHE_SIZE};
+        for(size_t c = 0; c < clusters.size(); c++) {
+            const uint32_t begin = clusters[c];
+            const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(indices.size());
+            cache.flush();
+            const float clusterAcmr = 3.f * countMisses(indices.data() + begin, end - begin, cache) / (end - begin);
+
+            boundaries.push_back(begin);
+            cache.flush();
+            uint32_t runBegin = begin;
+            uint32_t runMisses = 0;
+            for(uint32_t i = begin; i < end; i += 3) {
+                runMisses += countMisses(indices.data() + i, 3, cache);
+                const uint32_t runEnd = i + 3;
+                if(runEnd < end && 3.f * runMisses / (runEnd - runBegin) <= threshold * clusterAcmr) {
+                    boundaries.push_back(runEnd);
+                    cache.flush();
+                    runBegin = runEnd;
+                    runMisses = 0;
+                }
+            }
+        }
+        boundaries.push_back(static_cast<uint32_t>(indices.size()));
+
+        // Area weighted centroid and normal per cluster, sorted by how far the cluster faces
+        // away from the mesh centre. Outward facing surfaces then draw before what they hide.
+        const size_t clusterCount = boundaries.size() - 1;
+        std::vector<glm::vec3> centroids(clusterCount);
+        std::vector<glm::vec3> normals(clusterCount);
+        glm::vec3 meshCentroid{0.f};
+        float meshArea = 0.f;
+        for(size_t c = 0; c < clusterCount; c++) {
+            glm::vec3 centroid{0.f};
+            glm::vec3 normal{0.f};
+            float area = 0.f;
+            for(uint32_t i = boundaries[c]; i < boundaries[c + 1]; i += 3) {
+                const glm::vec3 &p0 = vertices[indices[i + 0]].position;
+                const glm::vec3 &p1 = vertices[indices[i + 1]].position;
+                const glm::vec3 &p2 = vertices[indices[i + 2]].position;
+                const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+                const float triangleArea = glm::length(cross);
+                centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+                normal += cross;
+                area += triangleArea;
+            }
+            meshCentroid += centroid;
+            meshArea += area;
+            centroids[c] = area > 0.f ? centroid / area : vertices[indices[boundaries[c]]].position;
+            const float normalLength = glm::length(normal);
+            normals[c] = normalLength > 0.f ? normal / normalLength : glm::vec3{0.f};
+        }
+        if(meshArea > 0.f) {
+            meshCentroid /= meshArea;
+        }
+
+        std::vector<float> keys(clusterCount);
+        std::vector<uint32_t> order(clusterCount);
+        for(size_t c = 0; c < clusterCount; c++) {
+            keys[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+            order[c] = static_cast<uint32_t>(c);
+        }
+        std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) {
+            return keys[a] > keys[b];
+        });
+
+        std::vector<uint32_t> output{};
+        output.reserve(indices.size());
+        for(uint32_t c : order) {
+            output.insert(output.end(), indices.begin() + boundaries[c], indices.begin() + boundaries[c + 1]);
+        }
+        indices.swap(output);
+        KE_OUT("(): clusters:{}", clusterCount);
+    }
+
+    uint32_t K3MeshOptimizer::optimizeVertexFetch(std::vector<K3Vertex> &vertices, std::vector<uint32_t> &indices) {
+        KE_IN("(vertices:{} indices:{})", vertices.size(), indices.size());
+        std::vector<uint32_t> remap(vertices.size(), INVALID_VERTEX);
+        std::vector<K3Vertex> output{};
+        output.reserve(vertices.size());
+        for(uint32_t &index : indices) {
+            if(remap[index] == INVALID_VERTEX) {
+                remap[index] = static_cast<uint32_t>(output.size());
+                output.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        if(output.size() != vertices.size()) {
+            KE_DEBUG("Dropped {} unreferenced vertices", vertices.size() - output.size());
+        }
+        vertices.swap(output);
+        KE_OUT("(): vertices:{}", vertices.size());
+        return static_cast<uint32_t>(vertices.size());
+    }
+
+    K3VertexCacheStatistics K3MeshOptimizer::analyzeVertexCache(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+        K3VertexCacheStatistics statistics{};
+        if(indexCount < 3) {
+            return statistics;
+        }
+        FifoCache cache{vertexCount, cacheSize};
+        statistics.vertexTransforms = countMisses(indices, indexCount, cache);
+
+        std::vector<uint8_t> referenced(vertexCount, 0);
+        uint32_t referencedCount = 0;
+        for(size_t i = 0; i < indexCount; i++) {
+            if(!referenced[indices[i]]) {
+                referenced[indices[i]] = 1;
+                referencedCount++;
+            }
+        }
+        statistics.acmr = static_cast<float>(statistics.vertexTransforms) / static_cast<float>(indexCount / 3);
+        statistics.atvr = static_cast<float>(statistics.vertexTransforms) / static_cast<float>(referencedCount);
+        return statistics;
+    }
+
+    void K3MeshOptimizer::optimize(K3Builder &builder) {
+        KE_IN("(flags:{})", builder.optimizeFlags);
+        if(builder.isMapped()) {
+            KE_WARN("Mesh is mapped from the cache and can't be optimized in place.");
+            KE_OUT(KE_NOARG);
+            return;
+        }
+        if(builder.indices.size() % 3 != 0) {
+            KE_WARN("Index count {} is not a triangle list, skipping mesh optimization.", builder.indices.size());
+            KE_OUT(KE_NOARG);
+            return;
+        }
+        auto startTime = std::chrono::high_resolution_clock::now();
+        const K3VertexCacheStatistics before = analyzeVertexCache(builder.indices.data(), builder.indices.size(), builder.vertexCount());
+
+        if(builder.optimizeFlags & K3Builder::OPTIMIZE_VERTEX_CACHE) {
+            std::vector<uint32_t> clusters{};
+            const bool overdraw = (builder.optimizeFlags & K3Builder::OPTIMIZE_OVERDRAW) != 0;
+            optimizeVertexCache(builder.indices, builder.vertexCount(), overdraw ? &clusters : nullptr);
+            if(overdraw) {
+                optimizeOverdraw(builder.indices, builder.vertices.data(), builder.vertexCount(), clusters);
+            }
+        }
+        if(builder.optimizeFlags & K3Builder::OPTIMIZE_VERTEX_FETCH) {
+            optimizeVertexFetch(builder.vertices, builder.indices);
+        }
+
+        const K3VertexCacheStatistics after = analyzeVertexCache(builder.indices.data(), builder.indices.size(), builder.vertexCount());
+        auto elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+        KE_DEBUG("Mesh optimized in {:.2f} ms: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", elapsed, before.acmr, after.acmr, before.atvr, after.atvr);
+        KE_OUT(KE_NOARG);
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include "k3/graphics/mesh_simplifier.hpp"
+#include "k3/graphics/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace k3::graphics {
+
+    namespace {
+
+        // Upper bound on collapse passes, each of which removes a sizeable share of what is left.
+        constexpr uint32_t MAX_PASSES = 64;
+
+        // Sum of squared plane distances, area weighted. evaluate() returns the mean so the
+        // error stays in squared model space units however much has been merged in.
+        struct Quadric {
+
+            double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+
+            double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+
+            double c = 0.0;
+
+            double weight = 0.0;
+
+            void addPlane(const glm::dvec3 &normal, double distance, double area) {
+                a00 += area * normal.x * normal.x;
+                a01 += area * normal.x * normal.y;
+                a02 += area * normal.x * normal.z;
+                a11 += area * normal.y * normal.y;
+                a12 += area * normal.y * normal.z;
+                a22 += area * normal.z * normal.z;
+                b0 += area * normal.x * distance;
+                b1 += area * normal.y * distance;
+                b2 += area * normal.z * distance;
+                c += area * distance * distance;
+                weight += area;
+            }
+
+            void add(const Quadric &other) {
+                a00 += other.a00;
+                a01 += other.a01;
+                a02 += other.a02;
+                a11 += other.a11;
+                a12 += other.a12;
+                a22 += other.a22;
+                b0 += other.b0;
+                b1 += other.b1;
+                b2 += other.b2;
+                c += other.c;
+                weight += other.weight;
+            }
+
+            double evaluate(const glm::vec3 &point) const {
+                const double x = point.x;
+                const double y = point.y;
+                const double z = point.z;
+                const double error = a00 * x * x + a11 * y * y + a22 * z * z
+                    + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                    + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+                return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+            }
+
+        };
+
+        struct Collapse {
+
+            uint32_t from;
+
+            uint32_t to;
+
+            // Ordering cost including the attribute term, and the geometric part alone.
+            double cost;
+
+            double error;
+
+        };
+
+        inline uint64_t edgeKey(uint32_t a, uint32_t b) {
+            return (static_cast<uint64_t>(a) << 32) | b;
+        }
+
+        float attributeDistance(const K3Vertex &a, const K3Vertex &b) {
+            const glm::vec3 normal = a.normal - b.normal;
+            const glm::vec2 uv = a.uv - b.uv;
+            const glm::vec3 color = a.color - b.color;
+            return glm::dot(normal, normal) + glm::dot(uv, uv) + glm::dot(color, color);
+        }
+
+        // Locks vertices on open borders and vertices sharing their position with another vertex,
+        // which are attribute seams that would crack if only one side moved.
+        std::vector<bool> findLockedVertices(const K3Vertex *vertices, uint32_t vertexCount, const uint32_t *indices, size_t indexCount) {
+            std::vector<uint32_t> positionRemap(vertexCount);
+            std::vector<bool> locked(vertexCount, false);
+            std::unordered_map<glm::vec3, uint32_t> firstWithPosition{};
+            firstWithPosition.reserve(vertexCount);
+            for(uint32_t i = 0; i < vertexCount; i++) {
+                auto inserted = firstWithPosition.emplace(vertices[i].position, i);
+                positionRemap[i] = inserted.first->second;
+                if(!inserted.second) {
+                    locked[i] = true;
+                    locked[inserted.first->second] = true;
+                }
+            }
+
+            std::unordered_set<uint64_t> edges{};
+            edges.reserve(indexCount);
+            for(size_t i = 0; i < indexCount; i += 3) {
+                for(int e = 0; e < 3; e++) {
+                    edges.insert(edgeKey(positionRemap[indices[i + e]], positionRemap[indices[i + (e + 1) % 3]]));
+                }
+            }
+            std::vector<bool> border(vertexCount, false);
+            for(size_t i = 0; i < indexCount; i += 3) {
+                for(int e = 0; e < 3; e++) {
+                    const uint32_t a = positionRemap[indices[i + e]];
+                    const uint32_t b = positionRemap[indices[i + (e + 1) % 3]];
+                    if(edges.find(edgeKey(b, a)) == edges.end()) {
+                        border[a] = true;
+                        border[b] = true;
+                    }
+                }
+            }
+            for(uint32_t i = 0; i < vertexCount; i++) {
+                if(border[positionRemap[i]]) {
+                    locked[i] = true;
+                }
+            }
+            return locked;
+        }
+
+        // Moving from onto to must not turn any of the remaining triangles around from over.
+        bool flipsTriangle(const K3Vertex *vertices, const std::vector<uint32_t> &indices, const uint32_t *triangles, uint32_t triangleCount, uint32_t from, uint32_t to) {
+            const glm::vec3 &target = vertices[to].position;
+            for(uint32_t t = 0; t < triangleCount; t++) {
+                const uint32_t *triangle = &indices[3 * static_cast<size_t>(triangles[t])];
+                if(triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+                    continue;
+                }
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for(int k = 0; k < 3; k++) {
+                    before[k] = vertices[triangle[k]].position;
+                    after[k] = triangle[k] == from ? target : before[k];
+                }
+                const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if(glm::dot(normalBefore, normalAfter) <= 0.f) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    }
+
+    float K3MeshSimplifier::simplify(const K3Vertex *vertices, uint32_t vertexCount, const uint32_t *indices, size_t indexCount, size_t targetIndexCount, std::vector<uint32_t> &destination) {
+        KE_IN("(indices:{} target:{})", indexCount, targetIndexCount);
+        destination.assign(indices, indices + indexCount);
+        if(indexCount % 3 != 0 || indexCount <= targetIndexCount) {
+            KE_OUT(KE_NOARG);
+            return 0.f;
+        }
+
+        const std::vector<bool> locked = findLockedVertices(vertices, vertexCount, indices, indexCount);
+
+        glm::vec3 boundsMin = vertices[indices[0]].position;
+        glm::vec3 boundsMax = boundsMin;
+        std::vector<Quadric> quadrics(vertexCount);
+        for(size_t i = 0; i < indexCount; i += 3) {
+            const glm::dvec3 p0{vertices[indices[i + 0]].position};
+            const glm::dvec3 p1{vertices[indices[i + 1]].position};
+            const glm::dvec3 p2{vertices[indices[i + 2]].position};
+            const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+            const double length = glm::length(cross);
+            if(length > 0.0) {
+                const glm::dvec3 normal = cross / length;
+                const double distance = -glm::dot(normal, p0);
+                for(int k = 0; k < 3; k++) {
+                    quadrics[indices[i + k]].addPlane(normal, distance, length * 0.5);
+                }
+            }
+            for(int k = 0; k < 3; k++) {
+                boundsMin = glm::min(boundsMin, vertices[indices[i + k]].position);
+                boundsMax = glm::max(boundsMax, vertices[indices[i + k]].position);
+            }
+        }
+        const double attributeScale = std::pow(static_cast<double>(ATTRIBUTE_WEIGHT) * glm::length(boundsMax - boundsMin), 2.0);
+
+        double maxError = 0.0;
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+        std::vector<uint32_t> vertexTriangles{};
+        std::vector<Collapse> collapses{};
+        std::vector<bool> touched(vertexCount);
+        std::vector<uint32_t> remap(vertexCount);
+        for(uint32_t pass = 0; pass < MAX_PASSES && destination.size() > targetIndexCount; pass++) {
+            const uint32_t triangleCount = static_cast<uint32_t>(destination.size() / 3);
+
+            // Vertex to triangle adjacency for the flip test.
+            std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+            for(uint32_t index : destination) {
+                triangleOffsets[index + 1]++;
+            }
+            for(uint32_t i = 0; i < vertexCount; i++) {
+                triangleOffsets[i + 1] += triangleOffsets[i];
+            }
+            vertexTriangles.resize(destination.size());
+            std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for(uint32_t t = 0; t < triangleCount; t++) {
+                for(int k = 0; k < 3; k++) {
+                    vertexTriangles[fill[destination[3 * t + k]]++] = t;
+                }
+            }
+
+            // Interior edges show up once from each side, a < b keeps one of the two.
+            collapses.clear();
+            for(uint32_t t = 0; t < triangleCount; t++) {
+                for(int k = 0; k < 3; k++) {
+                    const uint32_t a = destination[3 * t + k];
+                    const uint32_t b = destination[3 * t + (k + 1) % 3];
+                    if(a >= b || (locked[a] && locked[b])) {
+                        continue;
+                    }
+                    Quadric merged = quadrics[a];
+                    merged.add(quadrics[b]);
+                    const double attribute = attributeScale * attributeDistance(vertices[a], vertices[b]);
+                    const double errorAB = locked[a] ? std::numeric_limits<double>::infinity() : merged.evaluate(vertices[b].position);
+                    const double errorBA = locked[b] ? std::numeric_limits<double>::infinity() : merged.evaluate(vertices[a].position);
+                    if(errorAB <= errorBA) {
+                        collapses.push_back({a, b, errorAB + attribute, errorAB});
+                    } else {
+                        collapses.push_back({b, a, errorBA + attribute, errorBA});
+                    }
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &l, const Collapse &r) {
+                return l.cost < r.cost;
+            });
+
+            // Each collapse removes about two triangles. Everything around a collapsed vertex is
+            // frozen for the rest of the pass so the flip tests stay valid.
+            const uint32_t removeTarget = static_cast<uint32_t>((destination.size() - targetIndexCount) / 3);
+            uint32_t removed = 0;
+            uint32_t applied = 0;
+            std::fill(touched.begin(), touched.end(), false);
+            for(uint32_t i = 0; i < vertexCount; i++) {
+                remap[i] = i;
+            }
+            for(const auto &collapse : collapses) {
+                if(removed >= removeTarget) {
+                    break;
+                }
+                if(touched[collapse.from] || touched[collapse.to]) {
+                    continue;
+                }
+                const uint32_t *triangles = &vertexTriangles[triangleOffsets[collapse.from]];
+                const uint32_t count = triangleOffsets[collapse.from + 1] - triangleOffsets[collapse.from];
+                if(flipsTriangle(vertices, destination, triangles, count, collapse.from, collapse.to)) {
+                    continue;
+                }
+
+                remap[collapse.from] = collapse.to;
+                for(uint32_t t = 0; t < count; t++) {
+                    const uint32_t *triangle = &destination[3 * static_cast<size_t>(triangles[t])];
+                    touched[triangle[0]] = true;
+                    touched[triangle[1]] = true;
+                    touched[triangle[2]] = true;
+                    if(triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                        removed++;
+                    }
+                }
+                quadrics[collapse.to].add(quadrics[collapse.from]);
+                maxError = std::max(maxError, collapse.error);
+                applied++;
+            }
+            if(applied == 0) {
+                break;
+            }
+
+            size_t write = 0;
+            for(size_t i = 0; i < destination.size(); i += 3) {
+                const uint32_t a = remap[destination[i + 0]];
+                const uint32_t b = remap[destination[i + 1]];
+                const uint32_t c = remap[destination[i + 2]];
+                if(a != b && b != c && a != c) {
+                    destination[write++] = a;
+                    destination[write++] = b;
+                    destination[write++] = c;
+                }
+            }
+            destination.resize(write);
+        }
+
+        const float error = static_cast<float>(std::sqrt(maxError));
+        KE_OUT("(): indices:{} error:{}", destination.size(), error);
+        return error;
+    }
+
+    void K3MeshSimplifier::generateLods(K3Builder &builder) {
+        KE_IN(KE_NOARG);
+        builder.lods.clear();
+        if(builder.isMapped()) {
+            KE_WARN("Mesh is mapped from the cache and can't be simplified in place.");
+            KE_OUT(KE_NOARG);
+            return;
+        }
+        const uint32_t baseIndexCount = static_cast<uint32_t>(builder.indices.size());
+        builder.lods.push_back({0, baseIndexCount, 0.f});
+        if(baseIndexCount % 3 != 0 || baseIndexCount / 3 < MIN_LOD_TRIANGLES) {
+            KE_OUT("(): Single level");
+            return;
+        }
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        // Every level starts from the full mesh so its error is measured against the original.
+        const std::vector<uint32_t> base(builder.indices);
+        size_t previousCount = baseIndexCount;
+        float previousError = 0.f;
+        float ratio = 1.f;
+        std::vector<uint32_t> lod{};
+        for(uint32_t level = 1; level < LOD_COUNT; level++) {
+            ratio *= LOD_RATIO;
+            const size_t target = static_cast<size_t>(baseIndexCount / 3 * ratio) * 3;
+            const float error = simplify(builder.vertices.data(), builder.vertexCount(), base.data(), base.size(), target, lod);
+            if(lod.empty() || lod.size() * 10 > previousCount * 9) {
+                KE_DEBUG("LOD {} only reached {} of {} indices, stopping the chain", level, lod.size(), target);
+                break;
+            }
+            K3MeshOptimizer::optimizeVertexCache(lod, builder.vertexCount());
+
+            previousError = std::max(previousError, error);
+            previousCount = lod.size();
+            builder.lods.push_back({static_cast<uint32_t>(builder.indices.size()), static_cast<uint32_t>(lod.size()), previousError});
+            builder.indices.insert(builder.indices.end(), lod.begin(), lod.end());
+        }
+
+        auto elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+        for(size_t i = 1; i < builder.lods.size(); i++) {
+            KE_DEBUG("LOD {}: {} triangles, error {}", i, builder.lods[i].indexCount / 3, builder.lods[i].error);
+        }
+        KE_OUT("(): {} levels in {:.2f} ms", builder.lods.size(), elapsed);
+    }
+
+}
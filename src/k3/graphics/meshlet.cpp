@@ -0,0 +1,294 @@
+#include "k3/graphics/meshlet.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace k3::graphics {
+
+    namespace {
+
+        constexpr uint32_t INVALID_TRIANGLE = ~0u;
+
+        constexpr uint8_t NOT_IN_MESHLET = 0xff;
+
+        // Meshlets whose triangles spread further than this from the average normal can't be
+        // rejected by their cone often enough to be worth testing.
+        constexpr float MIN_CONE_SPREAD = 0.1f;
+
+        // Unconnected triangles only join a meshlet when they face about the same way, so the
+        // fallback doesn't cost the normal cone.
+        constexpr float MIN_FALLBACK_ALIGNMENT = 0.7f;
+
+    }
+
+    void K3MeshletGenerator::build(const K3Vertex *vertices, uint32_t vertexCount, const uint32_t *indices, size_t indexCount,
+        std::vector<K3Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles) {
+        KE_IN("(indices:{} vertices:{})", indexCount, vertexCount);
+        static_assert(MAX_VERTICES < NOT_IN_MESHLET, "Local vertex indices must fit a uint8_t");
+        meshlets.clear();
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+        if(triangleCount == 0) {
+            KE_OUT(KE_NOARG);
+            return;
+        }
+
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+        for(size_t i = 0; i < 3 * static_cast<size_t>(triangleCount); i++) {
+            triangleOffsets[indices[i] + 1]++;
+        }
+        for(uint32_t i = 0; i < vertexCount; i++) {
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        }
+        std::vector<uint32_t> vertexTriangles(3 * static_cast<size_t>(triangleCount));
+        {
+            std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for(uint32_t t = 0; t < triangleCount; t++) {
+                for(int k = 0; k < 3; k++) {
+                    vertexTriangles[fill[indices[3 * t + k]]++] = t;
+                }
+            }
+        }
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint8_t> slots(vertexCount, NOT_IN_MESHLET);
+        std::vector<uint32_t> current{};
+        std::vector<uint8_t> currentTriangles{};
+        glm::vec3 positionSum{0.f};
+        glm::vec3 normalSum{0.f};
+
+        auto triangleNormal = [&](uint32_t t) {
+            const glm::vec3 &p0 = vertices[indices[3 * t]].position;
+            const glm::vec3 normal = glm::cross(vertices[indices[3 * t + 1]].position - p0, vertices[indices[3 * t + 2]].position - p0);
+            const float length = glm::length(normal);
+            return length > 0.f ? normal / length : glm::vec3{0.f};
+        };
+        auto triangleCentre = [&](uint32_t t) {
+            return (vertices[indices[3 * t]].position + vertices[indices[3 * t + 1]].position + vertices[indices[3 * t + 2]].position) / 3.f;
+        };
+        auto countNewVertices = [&](uint32_t t) {
+            const uint32_t a = indices[3 * t];
+            const uint32_t b = indices[3 * t + 1];
+            const uint32_t c = indices[3 * t + 2];
+            uint32_t count = slots[a] == NOT_IN_MESHLET ? 1 : 0;
+            count += (slots[b] == NOT_IN_MESHLET && b != a) ? 1 : 0;
+            count += (slots[c] == NOT_IN_MESHLET && c != a && c != b) ? 1 : 0;
+            return count;
+        };
+        auto flush = [&]() {
+            if(currentTriangles.empty()) {
+                return;
+            }
+            meshlets.push_back({
+                static_cast<uint32_t>(meshletVertices.size()),
+                static_cast<uint32_t>(meshletTriangles.size()),
+                static_cast<uint32_t>(current.size()),
+                static_cast<uint32_t>(currentTriangles.size() / 3),
+            });
+            for(uint32_t vertex : current) {
+                slots[vertex] = NOT_IN_MESHLET;
+            }
+            meshletVertices.insert(meshletVertices.end(), current.begin(), current.end());
+            meshletTriangles.insert(meshletTriangles.end(), currentTriangles.begin(), currentTriangles.end());
+            current.clear();
+            currentTriangles.clear();
+            positionSum = glm::vec3{0.f};
+            normalSum = glm::vec3{0.f};
+        };
+
+        uint32_t scan = 0;
+        uint32_t emittedCount = 0;
+        while(emittedCount < triangleCount) {
+            uint32_t best = INVALID_TRIANGLE;
+            uint32_t bestNew = 4;
+            float bestDistance = std::numeric_limits<float>::max();
+            if(!current.empty()) {
+                const glm::vec3 centre = positionSum / static_cast<float>(current.size());
+                for(uint32_t vertex : current) {
+                    for(uint32_t i = triangleOffsets[vertex]; i < triangleOffsets[vertex + 1]; i++) {
+                        const uint32_t t = vertexTriangles[i];
+                        if(emitted[t]) {
+                            continue;
+                        }
+                        const uint32_t added = countNewVertices(t);
+                        if(current.size() + added > MAX_VERTICES || added > bestNew) {
+                            continue;
+                        }
+                        const glm::vec3 offset = triangleCentre(t) - centre;
+                        const float distance = glm::dot(offset, offset);
+                        if(added < bestNew || distance < bestDistance) {
+                            best = t;
+                            bestNew = added;
+                            bestDistance = distance;
+                        }
+                    }
+                }
+                // Nothing connected fits, so try the next triangle in draw order. The index buffer
+                // is cache optimised and stays close by even where vertices aren't shared.
+                if(best == INVALID_TRIANGLE) {
+                    while(emitted[scan]) {
+                        scan++;
+                    }
+                    const float sumLength = glm::length(normalSum);
+                    const bool aligned = sumLength > 0.f && glm::dot(triangleNormal(scan), normalSum / sumLength) >= MIN_FALLBACK_ALIGNMENT;
+                    if(aligned && current.size() + countNewVertices(scan) <= MAX_VERTICES) {
+                        best = scan;
+                    }
+                }
+                if(best == INVALID_TRIANGLE) {
+                    flush();
+                    continue;
+                }
+            } else {
+                while(emitted[scan]) {
+                    scan++;
+                }
+                best = scan;
+            }
+
+            for(int k = 0; k < 3; k++) {
+                const uint32_t vertex = indices[3 * best + k];
+                if(slots[vertex] == NOT_IN_MESHLET) {
+                    slots[vertex] = static_cast<uint8_t>(current.size());
+                    current.push_back(vertex);
+                    positionSum += vertices[vertex].position;
+                }
+                currentTriangles.push_back(slots[vertex]);
+            }
+            normalSum += triangleNormal(best);
+            emitted[best] = true;
+            emittedCount++;
+
+            if(currentTriangles.size() == 3 * MAX_TRIANGLES) {
+                flush();
+            }
+        }
+        flush();
+
+        KE_OUT("(): meshlets:{}", meshlets.size());
+    }
+
+    K3MeshletBounds K3MeshletGenerator::computeBounds(const K3Vertex *vertices, const K3Meshlet &meshlet, const uint32_t *meshletVertices, const uint8_t *meshletTriangles) {
+        K3MeshletBounds bounds{};
+        if(meshlet.vertexCount == 0) {
+            return bounds;
+        }
+        const uint32_t *local = meshletVertices + meshlet.vertexOffset;
+        auto position = [&](uint32_t i) -> const glm::vec3 & {
+            return vertices[local[i]].position;
+        };
+
+        // Ritter: span the two far points found from an arbitrary start, then grow to cover the rest.
+        auto farthestFrom = [&](const glm::vec3 &from) {
+            uint32_t farthest = 0;
+            float farthestDistance = -1.f;
+            for(uint32_t i = 0; i < meshlet.vertexCount; i++) {
+                const glm::vec3 offset = position(i) - from;
+                const float distance = glm::dot(offset, offset);
+                if(distance > farthestDistance) {
+                    farthest = i;
+                    farthestDistance = distance;
+                }
+            }
+            return farthest;
+        };
+        const glm::vec3 a = position(farthestFrom(position(0)));
+        const glm::vec3 b = position(farthestFrom(a));
+        glm::vec3 center = (a + b) * 0.5f;
+        float radius = glm::length(b - a) * 0.5f;
+        for(uint32_t i = 0; i < meshlet.vertexCount; i++) {
+            const float distance = glm::length(position(i) - center);
+            if(distance > radius) {
+                const float grown = (radius + distance) * 0.5f;
+                center += (position(i) - center) * ((grown - radius) / distance);
+                radius = grown;
+            }
+        }
+        bounds.sphere = glm::vec4{center.x, center.y, center.z, radius};
+        bounds.coneApex = glm::vec4{center.x, center.y, center.z, 0.f};
+
+        const uint8_t *triangles = meshletTriangles + meshlet.triangleOffset;
+        std::vector<glm::vec3> normals{};
+        std::vector<glm::vec3> corners{};
+        normals.reserve(meshlet.triangleCount);
+        corners.reserve(meshlet.triangleCount);
+        glm::vec3 normalSum{0.f};
+        for(uint32_t t = 0; t < meshlet.triangleCount; t++) {
+            const glm::vec3 &p0 = position(triangles[3 * t]);
+            const glm::vec3 normal = glm::cross(position(triangles[3 * t + 1]) - p0, position(triangles[3 * t + 2]) - p0);
+            const float length = glm::length(normal);
+            if(length > 0.f) {
+                normals.push_back(normal / length);
+                corners.push_back(p0);
+                normalSum += normals.back();
+            }
+        }
+        const float sumLength = glm::length(normalSum);
+        if(normals.empty() || sumLength == 0.f) {
+            return bounds;
+        }
+        const glm::vec3 axis = normalSum / sumLength;
+        float minDot = 1.f;
+        for(const auto &normal : normals) {
+            minDot = std::min(minDot, glm::dot(axis, normal));
+        }
+        if(minDot <= MIN_CONE_SPREAD) {
+            return bounds;
+        }
+
+        // Slide the apex back along the axis until it is behind every triangle plane.
+        float maxT = 0.f;
+        for(size_t i = 0; i < normals.size(); i++) {
+            const float t = glm::dot(center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+            maxT = std::max(maxT, t);
+        }
+        const glm::vec3 apex = center - axis * maxT;
+        bounds.coneApex = glm::vec4{apex.x, apex.y, apex.z, 0.f};
+        bounds.coneAxis = glm::vec4{axis.x, axis.y, axis.z, std::sqrt(1.f - minDot * minDot)};
+        return bounds;
+    }
+
+    K3MeshletStatistics K3MeshletGenerator::analyze(const std::vector<K3Meshlet> &meshlets, const std::vector<K3MeshletBounds> &bounds) {
+        K3MeshletStatistics statistics{};
+        statistics.meshletCount = static_cast<uint32_t>(meshlets.size());
+        if(meshlets.empty()) {
+            return statistics;
+        }
+        uint64_t vertexTotal = 0;
+        uint64_t triangleTotal = 0;
+        for(const auto &meshlet : meshlets) {
+            vertexTotal += meshlet.vertexCount;
+            triangleTotal += meshlet.triangleCount;
+        }
+        uint32_t conable = 0;
+        for(const auto &bound : bounds) {
+            conable += bound.coneAxis.w < 1.f ? 1 : 0;
+        }
+        statistics.averageVertices = static_cast<float>(vertexTotal) / meshlets.size();
+        statistics.averageTriangles = static_cast<float>(triangleTotal) / meshlets.size();
+        statistics.conableRatio = static_cast<float>(conable) / meshlets.size();
+        return statistics;
+    }
+
+    void K3MeshletGenerator::generate(K3Builder &builder) {
+        KE_IN(KE_NOARG);
+        auto startTime = std::chrono::high_resolution_clock::now();
+        const uint32_t indexCount = builder.lods.empty() ? builder.indexCount() : builder.lods[0].indexCount;
+        build(builder.vertexData(), builder.vertexCount(), builder.indexData(), indexCount, builder.meshlets, builder.meshletVertices, builder.meshletTriangles);
+
+        builder.meshletBounds.resize(builder.meshlets.size());
+        for(size_t i = 0; i < builder.meshlets.size(); i++) {
+            builder.meshletBounds[i] = computeBounds(builder.vertexData(), builder.meshlets[i], builder.meshletVertices.data(), builder.meshletTriangles.data());
+        }
+
+        const K3MeshletStatistics statistics = analyze(builder.meshlets, builder.meshletBounds);
+        auto elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+        KE_DEBUG("{} meshlets in {:.2f} ms: {:.1f} vertices and {:.1f} triangles on average, {:.0f}% with a usable normal cone",
+            statistics.meshletCount, elapsed, statistics.averageVertices, statistics.averageTriangles, statistics.conableRatio * 100.f);
+        KE_OUT(KE_NOARG);
+    }
+
+}
@@ -1,19 +1,94 @@
 #include "k3/graphics/model.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
 
 namespace k3::graphics {
 
-    K3Model::K3Model(std::shared_ptr<K3Device> device, const K3Builder &builder) : m_device {device}, m_builder {builder} {
+    namespace {
+
+        // Calls emit(firstIndex, indexCount, vertexOffset) for the part of each sub mesh that falls
+        // inside level's index range.
+        template<typename Emit>
+        void forEachLodRange(const std::vector<K3SubMesh> &subMeshes, const K3MeshLod &level, Emit &&emit) {
+            const uint32_t levelEnd = level.firstIndex + level.indexCount;
+            for(const auto &subMesh : subMeshes) {
+                const uint32_t first = std::max(subMesh.firstIndex, level.firstIndex);
+                const uint32_t end = std::min(subMesh.firstIndex + subMesh.indexCount, levelEnd);
+                if(first < end) {
+                    emit(first, end - first, subMesh.vertexOffset);
+                }
+            }
+        }
+
+    }
+
+    K3Model::K3Model(std::shared_ptr<K3Device> device, const K3Builder &builder, bool keepBuilder, K3UploadBatch *batch) : m_device {device}, m_boundsMin {builder.boundsMin}, m_boundsMax {builder.boundsMax} {
         KE_IN(KE_NOARG);
 
-        createVertexBuffers(builder.vertices);
-        if(builder.indices.size() > 0) {
+        std::unique_ptr<K3UploadBatch> ownBatch = nullptr;
+        if(batch == nullptr) {
+            ownBatch = std::make_unique<K3UploadBatch>(m_device->getStagingRing());
+            batch = ownBatch.get();
+        }
+
+        const void *vertices = builder.vertexData();
+        uint32_t vertexSize = sizeof(K3Vertex);
+        if(builder.isEncoded()) {
+            m_vertexFormat = builder.vertexFormat;
+            m_uniformColor = builder.uniformColor;
+            const float scale = builder.dequantizeScale;
+            const glm::vec3 &offset = builder.dequantizeOffset;
+            m_dequantizeMatrix = glm::mat4{
+                {scale, 0.f, 0.f, 0.f},
+                {0.f, scale, 0.f, 0.f},
+                {0.f, 0.f, scale, 0.f},
+                {offset.x, offset.y, offset.z, 1.f},
+            };
+            vertices = builder.encodedVertexData();
+            vertexSize = m_vertexFormat.getStride();
+        }
+        if(builder.indexCount() > 0) {
             m_hasIndexBuffer = true;
         }
+        std::vector<uint16_t> shortIndices{};
+        const void *indices = nullptr;
+        uint32_t indexSize = 0;
         if(m_hasIndexBuffer) {
-            createIndexBuffers(builder.indices);
+            m_lods = builder.lods;
+            if(m_lods.empty()) {
+                m_lods.push_back({0, builder.indexCount(), 0.f});
+            }
+            m_indexType = builder.getUploadIndices(shortIndices, m_subMeshes, indices);
+            indexSize = m_indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        }
+
+        // Shares the device's geometry pool when it has room, own buffers otherwise.
+        K3GeometryPool &geometryPool = m_device->getGeometryPool();
+        m_geometryRange = geometryPool.allocate(vertexSize, builder.vertexCount(), indexSize, m_hasIndexBuffer ? builder.indexCount() : 0);
+        if(m_geometryRange.isValid()) {
+            m_vertexCount = builder.vertexCount();
+            m_indexCount = builder.indexCount();
+            geometryPool.write(*batch, m_geometryRange, vertices, indices);
+        } else {
+            createVertexBuffers(*batch, vertices, vertexSize, builder.vertexCount());
+            if(m_hasIndexBuffer) {
+                createIndexBuffers(*batch, indices, indexSize, builder.indexCount());
+            }
+        }
+        if(!builder.meshlets.empty()) {
+            createMeshletBuffers(*batch, builder);
+        }
+        if(keepBuilder) {
+            m_builder = std::make_unique<const K3Builder>(builder);
+        }
+        // Every buffer goes out in one submit, a shared batch is submitted by its owner.
+        if(ownBatch != nullptr) {
+            setUploadToken(ownBatch->submit());
+        } else {
+            m_uploadToken = K3UploadToken{K3UploadToken::PENDING};
         }
 
         KE_OUT(KE_NOARG);
@@ -23,104 +98,182 @@ namespace k3::graphics {
         KE_IN(KE_NOARG);
 
         if(m_device != nullptr) {
+            m_device->getGeometryPool().free(m_geometryRange);
             m_device = nullptr;
         }
         
         KE_OUT(KE_NOARG);
     }
 
-    std::unique_ptr<K3Model> K3Model::createModelFromFile(std::shared_ptr<K3Device> device, const std::string &filePath) {
+    std::unique_ptr<K3Model> K3Model::createModelFromFile(std::shared_ptr<K3Device> device, const std::string &filePath, uint32_t vertexFormat) {
         KE_IN(KE_NOARG);
+        K3Builder builder = prepareBuilder(filePath, vertexFormat);
+        KE_OUT(KE_NOARG);
+        return std::make_unique<K3Model>(device, builder);
+    }
+
+    K3Builder K3Model::prepareBuilder(const std::string &filePath, uint32_t vertexFormat) {
+        KE_IN("({})", filePath);
         K3Builder builder{};
+        // Encoded as part of the load, so a mesh cache hit uploads the stored stream as is.
+        builder.vertexFormatFlags = vertexFormat;
         builder.loadModel(filePath);
-        KE_DEBUG("Vertex Count: {}", builder.vertices.size());
+        KE_DEBUG("Vertex Count: {}", builder.vertexCount());
         KE_OUT(KE_NOARG);
-        return std::make_unique<K3Model>(device, builder);
+        return builder;
     }
 
-    void K3Model::createVertexBuffers(const std::vector<K3Vertex> &vertices) {
+    void K3Model::createVertexBuffers(K3UploadBatch &batch, const void *vertices, uint32_t vertexSize, uint32_t vertexCount) {
         KE_IN(KE_NOARG);
 
-        m_vertexCount = static_cast<uint32_t>(vertices.size());
+        m_vertexCount = vertexCount;
         assert(m_vertexCount >= 3 && "Vertex Count Must Be At Least 3");
-        
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
-        uint32_t vertexSize = sizeof(vertices[0]);
-
-        K3Buffer stagingBuffer {
-            m_device,
-            vertexSize,
-            m_vertexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) vertices.data());
-
-        m_vertexBuffer = std::make_unique<K3Buffer>(
-            m_device,
-            vertexSize,
-            m_vertexCount,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-        );
-
-        m_device->copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+
+        m_vertexBuffer = createGeometryBuffer(batch, vertices, vertexSize, m_vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
         KE_OUT(KE_NOARG);
     }
 
-    void K3Model::createIndexBuffers(const std::vector<uint32_t> &indices) {
-        KE_IN(KE_NOARG);
+    void K3Model::createIndexBuffers(K3UploadBatch &batch, const void *indices, uint32_t indexSize, uint32_t indexCount) {
+        KE_IN("({}, {})", indexSize, indexCount);
         
-        m_indexCount = static_cast<uint32_t>(indices.size());
-        VkDeviceSize bufferSize = sizeof(indices[0]) * m_indexCount;
-        uint32_t indexSize = sizeof(indices[0]);
-
-        K3Buffer stagingBuffer {
-            m_device,
-            indexSize,
-            m_indexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) indices.data());
-
-        m_indexBuffer = std::make_unique<K3Buffer>(
-            m_device,
-            indexSize,
-            m_indexCount,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-        );
-
-        m_device->copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
+        m_indexCount = indexCount;
+        m_indexBuffer = createGeometryBuffer(batch, indices, indexSize, m_indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
 
         KE_OUT(KE_NOARG);
     }    
     
+    void K3Model::createMeshletBuffers(K3UploadBatch &batch, const K3Builder &builder) {
+        KE_IN(KE_NOARG);
+
+        m_meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+        m_meshletBuffer = createGeometryBuffer(batch, builder.meshlets.data(), sizeof(K3Meshlet), m_meshletCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        m_meshletBoundsBuffer = createGeometryBuffer(batch, builder.meshletBounds.data(), sizeof(K3MeshletBounds), m_meshletCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        m_meshletVertexBuffer = createGeometryBuffer(batch, builder.meshletVertices.data(), sizeof(uint32_t), static_cast<uint32_t>(builder.meshletVertices.size()), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+        // Storage buffers are addressed in 32-bit words, so pad the byte indices out to one.
+        std::vector<uint8_t> triangles(builder.meshletTriangles);
+        triangles.resize((triangles.size() + 3) & ~static_cast<size_t>(3), 0);
+        m_meshletTriangleBuffer = createGeometryBuffer(batch, triangles.data(), sizeof(uint32_t), static_cast<uint32_t>(triangles.size() / 4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+        KE_OUT("(): meshlets:{}", m_meshletCount);
+    }
+
+    std::unique_ptr<K3Buffer> K3Model::createGeometryBuffer(K3UploadBatch &batch, const void *data, uint32_t elementSize, uint32_t elementCount, VkBufferUsageFlags usage) {
+        KE_IN("({}, {})", elementSize, elementCount);
+        const VkDeviceSize size = static_cast<VkDeviceSize>(elementSize) * elementCount;
+        // Transfer source as well so the defragmenter can copy it elsewhere.
+        usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        if(m_device->getGeometryPlacement() == K3GeometryPlacement::DIRECT) {
+            std::unique_ptr<K3Buffer> buffer = nullptr;
+            try {
+                buffer = std::make_unique<K3Buffer>(m_device, elementSize, elementCount, usage, m_device->getGeometryMemoryProperties(), 1, K3MemoryCategory::GEOMETRY);
+            } catch(const std::runtime_error &e) {
+                // The host visible heap can run out well before VRAM does.
+                KE_WARN("Direct geometry allocation failed ({}), staging instead.", e.what());
+            }
+            if(buffer != nullptr && buffer->map() == VK_SUCCESS) {
+                // Host writes before the frame's vkQueueSubmit are visible to it, no copy needed.
+                std::memcpy(buffer->getMappedMemory(), data, size);
+                buffer->flush(size);
+                buffer->unmap();
+                KE_OUT("(): direct");
+                return buffer;
+            }
+        }
+
+        auto buffer = std::make_unique<K3Buffer>(m_device, elementSize, elementCount, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, K3MemoryCategory::GEOMETRY);
+        batch.uploadBuffer(buffer->getBuffer(), data, size);
+
+        KE_OUT("(): staged");
+        return buffer;
+    }
+
+    void K3Model::setUploadToken(K3UploadToken token) {
+        m_uploadToken = token;
+        registerRelocations();
+    }
+
+    void K3Model::registerRelocations() {
+        K3MemoryAllocator &allocator = m_device->getAllocator();
+        // Pooled vertices and indices have no buffer of their own to move, see K3Defragmenter.
+        if(isPooled()) {
+            KE_DEBUG("Geometry is pooled, only the meshlet buffers are relocatable.");
+        }
+        for(K3Buffer *buffer : {m_vertexBuffer.get(), m_indexBuffer.get(), m_meshletBuffer.get(),
+                m_meshletBoundsBuffer.get(), m_meshletVertexBuffer.get(), m_meshletTriangleBuffer.get()}) {
+            if(buffer == nullptr) {
+                continue;
+            }
+            // Runs on the render thread as a frame begins, before anything records draws with it.
+            auto relocated = [this, buffer](VkBuffer newBuffer, const K3Allocation &allocation) {
+                buffer->relocate(newBuffer, allocation);
+                m_relocationCount++;
+            };
+            // Until the graphics queue has acquired the upload the contents may not be there yet.
+            allocator.setRelocatable(buffer->getAllocation(), buffer->getBuffer(), buffer->getBufferSize(), buffer->getUsageFlags(), relocated,
+                [this]() { return isResident(); });
+        }
+    }
+
+    VkDeviceSize K3Model::getDeviceMemorySize() const {
+        VkDeviceSize bytes = m_geometryRange.vertexBytes + m_geometryRange.indexBytes;
+        for(const K3Buffer *buffer : {m_vertexBuffer.get(), m_indexBuffer.get(), m_meshletBuffer.get(),
+                m_meshletBoundsBuffer.get(), m_meshletVertexBuffer.get(), m_meshletTriangleBuffer.get()}) {
+            if(buffer != nullptr) {
+                bytes += buffer->getBufferSize();
+            }
+        }
+        return bytes;
+    }
+
+    size_t K3Model::getHostMemorySize() const {
+        size_t bytes = sizeof(K3Model) + m_subMeshes.capacity() * sizeof(K3SubMesh) + m_lods.capacity() * sizeof(K3MeshLod);
+        if(m_builder != nullptr) {
+            bytes += sizeof(K3Builder) + m_builder->getMemoryUsage();
+        }
+        return bytes;
+    }
+
     void K3Model::bind(VkCommandBuffer commandBuffer) {
         KE_IN_SPAM(KE_NOARG);
+        if(isPooled()) {
+            K3GeometryPool &geometryPool = m_device->getGeometryPool();
+            geometryPool.bindVertexBuffer(commandBuffer);
+            if(m_hasIndexBuffer) {
+                geometryPool.bindIndexBuffer(commandBuffer, m_indexType);
+            }
+            KE_OUT_SPAM(KE_NOARG);
+            return;
+        }
         VkBuffer buffers[] = {m_vertexBuffer->getBuffer()};
         VkDeviceSize offsets[] = {0};
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
         if(m_hasIndexBuffer) {
-            vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getBuffer(), 0, m_indexType);
         }
         KE_OUT_SPAM(KE_NOARG);
     }
 
-    void K3Model::draw(VkCommandBuffer commandBuffer) {
-        KE_IN_SPAM(KE_NOARG);
+    void K3Model::draw(VkCommandBuffer commandBuffer, uint32_t lod, uint32_t instanceCount, uint32_t firstInstance) {
+        KE_IN_SPAM("({}, {}, {})", lod, instanceCount, firstInstance);
         if(m_hasIndexBuffer) {
-            vkCmdDrawIndexed(commandBuffer, m_indexCount, 1, 0, 0, 0);
+            const K3MeshLod &level = m_lods[std::min(lod, static_cast<uint32_t>(m_lods.size()) - 1)];
+            forEachLodRange(m_subMeshes, level, [&](uint32_t firstIndex, uint32_t indexCount, int32_t vertexOffset) {
+                vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, m_geometryRange.firstIndex + firstIndex, m_geometryRange.vertexOffset + vertexOffset, firstInstance);
+            });
         } else {
-            vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+            vkCmdDraw(commandBuffer, m_vertexCount, instanceCount, static_cast<uint32_t>(m_geometryRange.vertexOffset), firstInstance);
         }
         KE_OUT_SPAM(KE_NOARG);
     }
 
+    void K3Model::appendDrawCommands(std::vector<VkDrawIndexedIndirectCommand> &commands, uint32_t lod, uint32_t instanceCount, uint32_t firstInstance) const {
+        assert(m_hasIndexBuffer && "Indirect draws need an index buffer");
+        const K3MeshLod &level = m_lods[std::min(lod, static_cast<uint32_t>(m_lods.size()) - 1)];
+        forEachLodRange(m_subMeshes, level, [&](uint32_t firstIndex, uint32_t indexCount, int32_t vertexOffset) {
+            commands.push_back({indexCount, instanceCount, m_geometryRange.firstIndex + firstIndex, m_geometryRange.vertexOffset + vertexOffset, firstInstance});
+        });
+    }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,130 @@
+#include "k3/graphics/model_loader.hpp"
+
+#include <chrono>
+#include <exception>
+
+namespace k3::graphics {
+
+    std::shared_ptr<K3Model> K3ModelHandle::get() {
+        if(m_model == nullptr && isReady()) {
+            return resolve();
+        }
+        return m_model;
+    }
+
+    std::shared_ptr<K3Model> K3ModelHandle::wait() {
+        if(m_model == nullptr && m_future.valid()) {
+            return resolve();
+        }
+        return m_model;
+    }
+
+    bool K3ModelHandle::isReady() const {
+        if(m_model != nullptr) {
+            return true;
+        }
+        return m_future.valid() && m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    std::shared_ptr<K3Model> K3ModelHandle::resolve() {
+        try {
+            m_model = m_future.get();
+        } catch(const std::exception &e) {
+            KE_ERROR("Model failed to load: {}", e.what());
+        }
+        m_future = {};
+        return m_model;
+    }
+
+    K3ModelLoader::K3ModelLoader(std::shared_ptr<K3Device> device, uint32_t workerCount) : m_device {device}, m_workers {workerCount} {
+        KE_IN(KE_NOARG);
+        KE_OUT("(): {} workers", m_workers.getThreadCount());
+    }
+
+    K3ModelLoader::~K3ModelLoader() {
+        KE_IN("(): {} pending", m_pendingCount.load());
+        // m_workers joins first and drains its queue into m_uploader, which then drains too.
+        KE_OUT(KE_NOARG);
+    }
+
+    K3ModelHandle K3ModelLoader::load(const std::string &filePath, uint32_t vertexFormat, bool keepBuilder, K3Deduplicate deduplicate) {
+        KE_IN("({})", filePath);
+        auto promise = std::make_shared<std::promise<std::shared_ptr<K3Model>>>();
+        K3ModelHandle handle{promise->get_future().share()};
+        m_pendingCount++;
+
+        // The workers may block on K3ThreadPool::shared() while parsing, so they can't be that pool.
+        m_workers.submit([this, promise, filePath, vertexFormat, keepBuilder, deduplicate]() {
+            if(deduplicate != nullptr) {
+                // The handle is an earlier load, so waiting on it here can't stall the workers.
+                K3ModelHandle existing = deduplicate();
+                std::shared_ptr<K3Model> model = existing ? existing.wait() : nullptr;
+                if(model != nullptr) {
+                    KE_DEBUG("Model \"{}\" shares an already loaded model", filePath);
+                    promise->set_value(model);
+                    m_pendingCount--;
+                    return;
+                }
+            }
+            std::shared_ptr<K3Builder> builder = nullptr;
+            try {
+                builder = std::make_shared<K3Builder>(K3Model::prepareBuilder(filePath, vertexFormat));
+            } catch(...) {
+                promise->set_exception(std::current_exception());
+                m_pendingCount--;
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_readyMutex);
+                m_readyUploads.push_back({promise, builder, filePath, keepBuilder});
+            }
+            // Whichever task runs first takes every model ready by then, the rest find nothing.
+            m_uploader.submit([this]() { uploadReady(); });
+        });
+
+        KE_OUT(KE_NOARG);
+        return handle;
+    }
+
+    void K3ModelLoader::uploadReady() {
+        std::vector<K3PendingUpload> uploads{};
+        {
+            std::lock_guard<std::mutex> lock(m_readyMutex);
+            uploads.swap(m_readyUploads);
+        }
+        if(uploads.empty()) {
+            return;
+        }
+        KE_IN("(): {} models", uploads.size());
+
+        const K3HostAllocationStatistics hostBefore = m_device->getHostAllocator().getStatistics();
+        std::vector<std::shared_ptr<K3Model>> models(uploads.size(), nullptr);
+        K3UploadToken token{};
+        {
+            K3UploadBatch batch(m_device->getStagingRing());
+            for(size_t i = 0; i < uploads.size(); i++) {
+                try {
+                    models[i] = std::make_shared<K3Model>(m_device, *uploads[i].builder, uploads[i].keepBuilder, &batch);
+                } catch(...) {
+                    uploads[i].promise->set_exception(std::current_exception());
+                }
+                // The copies are staged, the CPU geometry is not needed any more.
+                uploads[i].builder = nullptr;
+            }
+            token = batch.submit();
+        }
+
+        for(size_t i = 0; i < uploads.size(); i++) {
+            if(models[i] != nullptr) {
+                models[i]->setUploadToken(token);
+                uploads[i].promise->set_value(models[i]);
+                KE_DEBUG("Model \"{}\" ready", uploads[i].filePath);
+            }
+            m_pendingCount--;
+        }
+        // Shared with any other thread creating objects meanwhile, good enough to spot churn.
+        K3HostAllocator::logChurn("Model upload", hostBefore, m_device->getHostAllocator().getStatistics());
+        KE_OUT("(): token:{}", token.value);
+    }
+
+}
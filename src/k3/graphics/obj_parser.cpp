@@ -0,0 +1,431 @@
+#include "k3/graphics/obj_parser.hpp"
+#include "k3/graphics/mapped_file.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace k3::graphics {
+
+    namespace {
+
+        enum ObjAttribute {
+            OBJ_POSITION = 0,
+            OBJ_TEXCOORD = 1,
+            OBJ_NORMAL = 2,
+        };
+
+        struct ObjChunk {
+            const char *begin = nullptr;
+            const char *end = nullptr;
+            std::vector<float> positions{};
+            std::vector<float> colors{};
+            std::vector<float> normals{};
+            std::vector<float> texcoords{};
+            std::vector<K3ObjCorner> polygonCorners{};
+            std::vector<uint8_t> polygonSizes{};
+            // Slots (corner * 3 + attribute) holding negative OBJ indices, stored relative to the chunk start.
+            std::vector<uint32_t> relativeSlots{};
+            uint32_t triangleCount = 0;
+            bool supported = true;
+        };
+
+        inline int32_t &cornerField(K3ObjCorner &corner, uint32_t attribute) {
+            switch(attribute) {
+                case OBJ_TEXCOORD: return corner.texcoord;
+                case OBJ_NORMAL: return corner.normal;
+                default: return corner.position;
+            }
+        }
+
+        inline bool isBlank(char c) {
+            return c == ' ' || c == '\t';
+        }
+
+        inline bool isDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        inline const char *skipBlank(const char *p, const char *end) {
+            while(p < end && isBlank(*p)) {
+                p++;
+            }
+            return p;
+        }
+
+        inline const char *tokenEnd(const char *p, const char *end) {
+            while(p < end && !isBlank(*p) && *p != '\r') {
+                p++;
+            }
+            return p;
+        }
+
+        // tinyobj parseReal: an unparsable token yields the default but still consumes the token.
+        inline bool parseReal(const char *&p, const char *end, float &value, double defaultValue) {
+            p = skipBlank(p, end);
+            const char *tokenStop = tokenEnd(p, end);
+            double result = defaultValue;
+            bool parsed = K3ObjParser::parseDouble(p, tokenStop, result);
+            value = static_cast<float>(result);
+            p = tokenStop;
+            return parsed;
+        }
+
+        // atoi semantics, stopping at '/' so face triples can be walked in place.
+        inline int32_t parseIndex(const char *&p, const char *end) {
+            bool negative = false;
+            if(p < end && (*p == '+' || *p == '-')) {
+                negative = *p == '-';
+                p++;
+            }
+            int32_t value = 0;
+            while(p < end && isDigit(*p)) {
+                value = value * 10 + (*p - '0');
+                p++;
+            }
+            while(p < end && *p != '/' && !isBlank(*p) && *p != '\r') {
+                p++;
+            }
+            return negative ? -value : value;
+        }
+
+        // Converts a raw OBJ index to zero based. Returns false for index 0, which OBJ forbids.
+        inline bool storeIndex(ObjChunk &chunk, int32_t raw, uint32_t localCount, uint32_t slot, int32_t &out) {
+            if(raw > 0) {
+                out = raw - 1;
+                return true;
+            }
+            if(raw < 0) {
+                out = static_cast<int32_t>(localCount) + raw;
+                chunk.relativeSlots.push_back(slot);
+                return true;
+            }
+            return false;
+        }
+
+        void parseFace(ObjChunk &chunk, const char *p, const char *end) {
+            const uint32_t positionCount = static_cast<uint32_t>(chunk.positions.size() / 3);
+            const uint32_t texcoordCount = static_cast<uint32_t>(chunk.texcoords.size() / 2);
+            const uint32_t normalCount = static_cast<uint32_t>(chunk.normals.size() / 3);
+
+            uint32_t cornerCount = 0;
+            p = skipBlank(p, end);
+            while(p < end && *p != '\r') {
+                const uint32_t cornerIndex = static_cast<uint32_t>(chunk.polygonCorners.size());
+                K3ObjCorner corner{-1, -1, -1};
+
+                int32_t raw = parseIndex(p, end);
+                if(!storeIndex(chunk, raw, positionCount, cornerIndex * 3 + OBJ_POSITION, corner.position)) {
+                    chunk.supported = false;
+                    return;
+                }
+                if(p < end && *p == '/') {
+                    p++;
+                    if(p < end && *p == '/') {
+                        p++;
+                        raw = parseIndex(p, end);
+                        if(!storeIndex(chunk, raw, normalCount, cornerIndex * 3 + OBJ_NORMAL, corner.normal)) {
+                            chunk.supported = false;
+                            return;
+                        }
+                    } else {
+                        raw = parseIndex(p, end);
+                        if(!storeIndex(chunk, raw, texcoordCount, cornerIndex * 3 + OBJ_TEXCOORD, corner.texcoord)) {
+                            chunk.supported = false;
+                            return;
+                        }
+                        if(p < end && *p == '/') {
+                            p++;
+                            raw = parseIndex(p, end);
+                            if(!storeIndex(chunk, raw, normalCount, cornerIndex * 3 + OBJ_NORMAL, corner.normal)) {
+                                chunk.supported = false;
+                                return;
+                            }
+                        }
+                    }
+                }
+                chunk.polygonCorners.push_back(corner);
+                cornerCount++;
+                p = skipBlank(tokenEnd(p, end), end);
+            }
+
+            if(cornerCount > 4) {
+                // tinyobj ear-clips these; let it handle the whole file so output stays identical.
+                chunk.supported = false;
+                return;
+            }
+            if(cornerCount < 3) {
+                chunk.polygonCorners.resize(chunk.polygonCorners.size() - cornerCount);
+                while(!chunk.relativeSlots.empty() && chunk.relativeSlots.back() / 3 >= chunk.polygonCorners.size()) {
+                    chunk.relativeSlots.pop_back();
+                }
+                return;
+            }
+            chunk.polygonSizes.push_back(static_cast<uint8_t>(cornerCount));
+            chunk.triangleCount += cornerCount - 2;
+        }
+
+        void parseChunk(ObjChunk &chunk) {
+            const char *p = chunk.begin;
+            const char *end = chunk.end;
+            while(p < end && chunk.supported) {
+                const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+                if(lineEnd == nullptr) {
+                    lineEnd = end;
+                }
+                const char *token = skipBlank(p, lineEnd);
+                const size_t length = static_cast<size_t>(lineEnd - token);
+
+                if(length >= 2 && token[0] == 'v' && isBlank(token[1])) {
+                    token += 2;
+                    float x, y, z, r, g, b;
+                    parseReal(token, lineEnd, x, 0.0);
+                    parseReal(token, lineEnd, y, 0.0);
+                    parseReal(token, lineEnd, z, 0.0);
+                    const bool hasColor = parseReal(token, lineEnd, r, 1.0) && parseReal(token, lineEnd, g, 1.0) && parseReal(token, lineEnd, b, 1.0);
+                    if(!hasColor) {
+                        r = g = b = 1.f;
+                    }
+                    chunk.positions.insert(chunk.positions.end(), {x, y, z});
+                    chunk.colors.insert(chunk.colors.end(), {r, g, b});
+                } else if(length >= 3 && token[0] == 'v' && token[1] == 'n' && isBlank(token[2])) {
+                    token += 3;
+                    float x, y, z;
+                    parseReal(token, lineEnd, x, 0.0);
+                    parseReal(token, lineEnd, y, 0.0);
+                    parseReal(token, lineEnd, z, 0.0);
+                    chunk.normals.insert(chunk.normals.end(), {x, y, z});
+                } else if(length >= 3 && token[0] == 'v' && token[1] == 't' && isBlank(token[2])) {
+                    token += 3;
+                    float u, v;
+                    parseReal(token, lineEnd, u, 0.0);
+                    parseReal(token, lineEnd, v, 0.0);
+                    chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+                } else if(length >= 2 && token[0] == 'f' && isBlank(token[1])) {
+                    parseFace(chunk, token + 2, lineEnd);
+                }
+
+                p = lineEnd < end ? lineEnd + 1 : end;
+            }
+        }
+
+        // Appends the triangles of one polygon using tinyobj's shortest diagonal rule for quads.
+        inline void emitPolygon(const K3ObjCorner *polygon, uint8_t size, const std::vector<float> &positions, K3ObjCorner *&out) {
+            if(size == 3) {
+                *out++ = polygon[0];
+                *out++ = polygon[1];
+                *out++ = polygon[2];
+                return;
+            }
+            const float *v0 = &positions[3 * static_cast<size_t>(polygon[0].position)];
+            const float *v1 = &positions[3 * static_cast<size_t>(polygon[1].position)];
+            const float *v2 = &positions[3 * static_cast<size_t>(polygon[2].position)];
+            const float *v3 = &positions[3 * static_cast<size_t>(polygon[3].position)];
+            const float e02x = v2[0] - v0[0], e02y = v2[1] - v0[1], e02z = v2[2] - v0[2];
+            const float e13x = v3[0] - v1[0], e13y = v3[1] - v1[1], e13z = v3[2] - v1[2];
+            const float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+            const float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+            if(sqr02 < sqr13) {
+                *out++ = polygon[0]; *out++ = polygon[1]; *out++ = polygon[2];
+                *out++ = polygon[0]; *out++ = polygon[2]; *out++ = polygon[3];
+            } else {
+                *out++ = polygon[0]; *out++ = polygon[1]; *out++ = polygon[3];
+                *out++ = polygon[1]; *out++ = polygon[2]; *out++ = polygon[3];
+            }
+        }
+
+        template <typename T>
+        inline void copyInto(std::vector<T> &destination, size_t offset, const std::vector<T> &source) {
+            if(!source.empty()) {
+                std::memcpy(destination.data() + offset, source.data(), source.size() * sizeof(T));
+            }
+        }
+
+    }
+
+    bool K3ObjParser::parseDouble(const char *begin, const char *end, double &result) {
+        if(begin >= end) {
+            return false;
+        }
+        double mantissa = 0.0;
+        int exponent = 0;
+        bool negative = false;
+        const char *p = begin;
+
+        if(*p == '+' || *p == '-') {
+            negative = *p == '-';
+            p++;
+        } else if(!isDigit(*p) && *p != '.') {
+            return false;
+        }
+
+        // Integer part. A leading '.' skips straight to the fraction like tinyobj.
+        if(p < end && *p != '.') {
+            int read = 0;
+            while(p < end && isDigit(*p)) {
+                mantissa = mantissa * 10 + static_cast<int>(*p - '0');
+                p++;
+                read++;
+            }
+            if(read == 0) {
+                return false;
+            }
+        }
+
+        if(p < end && *p == '.') {
+            static const double POW_LUT[] = {1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001};
+            const int lutEntries = sizeof(POW_LUT) / sizeof(POW_LUT[0]);
+            p++;
+            int read = 1;
+            while(p < end && isDigit(*p)) {
+                mantissa += static_cast<int>(*p - '0') * (read < lutEntries ? POW_LUT[read] : std::pow(10.0, -read));
+                read++;
+                p++;
+            }
+        }
+
+        if(p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            bool negativeExponent = false;
+            if(p < end && (*p == '+' || *p == '-')) {
+                negativeExponent = *p == '-';
+                p++;
+            } else if(p >= end || !isDigit(*p)) {
+                return false;
+            }
+            int read = 0;
+            while(p < end && isDigit(*p)) {
+                if(exponent > 2147483647 / 10) {
+                    return false;
+                }
+                exponent = exponent * 10 + static_cast<int>(*p - '0');
+                p++;
+                read++;
+            }
+            if(read == 0) {
+                return false;
+            }
+            exponent = negativeExponent ? -exponent : exponent;
+        }
+
+        result = (negative ? -1 : 1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+        return true;
+    }
+
+    bool K3ObjParser::parse(const std::string &filePath, K3ObjData &data, K3ThreadPool &pool) {
+        KE_IN("({})", filePath);
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        std::shared_ptr<K3MappedFile> mappedFile = K3MappedFile::open(filePath);
+        if(mappedFile == nullptr) {
+            KE_OUT("(): Unable to map \"{}\"", filePath);
+            return false;
+        }
+
+        // Split into roughly equal chunks, each starting at the beginning of a line.
+        const char *fileBegin = mappedFile->data();
+        const char *fileEnd = fileBegin + mappedFile->size();
+        const size_t chunkLimit = std::max<size_t>(1, mappedFile->size() / MIN_CHUNK_BYTES);
+        const size_t chunkCount = std::min<size_t>(chunkLimit, pool.getThreadCount() * 4);
+        const size_t chunkBytes = mappedFile->size() / chunkCount;
+
+        std::vector<ObjChunk> chunks{};
+        chunks.reserve(chunkCount);
+        const char *chunkBegin = fileBegin;
+        for(size_t i = 0; i < chunkCount && chunkBegin < fileEnd; i++) {
+            const char *chunkEnd = fileEnd;
+            if(i + 1 < chunkCount) {
+                const char *split = std::max(chunkBegin, fileBegin + (i + 1) * chunkBytes);
+                const char *newline = split < fileEnd ? static_cast<const char *>(std::memchr(split, '\n', static_cast<size_t>(fileEnd - split))) : nullptr;
+                chunkEnd = newline != nullptr ? newline + 1 : fileEnd;
+            }
+            ObjChunk chunk{};
+            chunk.begin = chunkBegin;
+            chunk.end = chunkEnd;
+            chunks.push_back(std::move(chunk));
+            chunkBegin = chunkEnd;
+        }
+
+        pool.parallelFor(static_cast<uint32_t>(chunks.size()), [&chunks](uint32_t i) {
+            parseChunk(chunks[i]);
+        });
+
+        // Prefix sums give every chunk its global attribute bases and output offsets.
+        std::vector<size_t> positionBase(chunks.size() + 1, 0);
+        std::vector<size_t> normalBase(chunks.size() + 1, 0);
+        std::vector<size_t> texcoordBase(chunks.size() + 1, 0);
+        std::vector<size_t> cornerBase(chunks.size() + 1, 0);
+        for(size_t i = 0; i < chunks.size(); i++) {
+            if(!chunks[i].supported) {
+                KE_OUT("(): \"{}\" needs the tinyobj path", filePath);
+                return false;
+            }
+            positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+            normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+            texcoordBase[i + 1] = texcoordBase[i] + chunks[i].texcoords.size();
+            cornerBase[i + 1] = cornerBase[i] + chunks[i].triangleCount * 3;
+        }
+
+        const int64_t totals[3] = {
+            static_cast<int64_t>(positionBase.back() / 3),
+            static_cast<int64_t>(texcoordBase.back() / 2),
+            static_cast<int64_t>(normalBase.back() / 3),
+        };
+
+        data.positions.resize(positionBase.back());
+        data.colors.resize(positionBase.back());
+        data.normals.resize(normalBase.back());
+        data.texcoords.resize(texcoordBase.back());
+        data.corners.resize(cornerBase.back());
+
+        // Resolve relative indices and validate ranges per chunk.
+        std::vector<char> valid(chunks.size(), 1);
+        pool.parallelFor(static_cast<uint32_t>(chunks.size()), [&](uint32_t i) {
+            ObjChunk &chunk = chunks[i];
+            const int64_t bases[3] = {
+                static_cast<int64_t>(positionBase[i] / 3),
+                static_cast<int64_t>(texcoordBase[i] / 2),
+                static_cast<int64_t>(normalBase[i] / 3),
+            };
+            for(uint32_t slot : chunk.relativeSlots) {
+                int32_t &value = cornerField(chunk.polygonCorners[slot / 3], slot % 3);
+                value = static_cast<int32_t>(value + bases[slot % 3]);
+            }
+            for(const auto &corner : chunk.polygonCorners) {
+                if(corner.position < 0 || corner.position >= totals[OBJ_POSITION]
+                    || corner.texcoord < -1 || corner.texcoord >= totals[OBJ_TEXCOORD]
+                    || corner.normal < -1 || corner.normal >= totals[OBJ_NORMAL]) {
+                    valid[i] = 0;
+                    return;
+                }
+            }
+            copyInto(data.positions, positionBase[i], chunk.positions);
+            copyInto(data.colors, positionBase[i], chunk.colors);
+            copyInto(data.normals, normalBase[i], chunk.normals);
+            copyInto(data.texcoords, texcoordBase[i], chunk.texcoords);
+        });
+        for(size_t i = 0; i < chunks.size(); i++) {
+            if(!valid[i]) {
+                KE_OUT("(): \"{}\" has out of range face indices", filePath);
+                return false;
+            }
+        }
+
+        // Triangulation needs merged positions for the quad diagonal test.
+        pool.parallelFor(static_cast<uint32_t>(chunks.size()), [&](uint32_t i) {
+            const ObjChunk &chunk = chunks[i];
+            K3ObjCorner *out = data.corners.data() + cornerBase[i];
+            const K3ObjCorner *polygon = chunk.polygonCorners.data();
+            for(uint8_t size : chunk.polygonSizes) {
+                emitPolygon(polygon, size, data.positions, out);
+                polygon += size;
+            }
+        });
+
+        auto elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+        KE_DEBUG("Parsed \"{}\" ({} bytes) in {} chunks on {} threads: {:.2f} ms", filePath, mappedFile->size(), chunks.size(), pool.getThreadCount(), elapsed);
+        KE_OUT("(): positions:{} corners:{}", totals[OBJ_POSITION], data.corners.size());
+        return true;
+    }
+
+}
\ No newline at end of file
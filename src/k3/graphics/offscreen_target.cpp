@@ -0,0 +1,209 @@
+#include "k3/graphics/offscreen_target.hpp"
+
+#include <array>
+#include <stdexcept>
+
+namespace k3::graphics {
+
+    K3OffscreenTarget::K3OffscreenTarget(std::shared_ptr<K3Device> device, VkExtent2D extent) : m_device {device}, m_extent {extent} {
+        KE_IN("({}x{})", extent.width, extent.height);
+
+        m_depthFormat = m_device->findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+            VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+        createRenderPass();
+        createImages();
+        createFramebuffer();
+
+        KE_OUT(KE_NOARG);
+    }
+
+    K3OffscreenTarget::~K3OffscreenTarget() {
+        KE_IN(KE_NOARG);
+
+        VkDevice device = m_device->getDevice();
+        if(m_framebuffer != VK_NULL_HANDLE) {
+            vkDestroyFramebuffer(device, m_framebuffer, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+        }
+        if(m_depthImageView != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, m_depthImageView, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+        }
+        if(m_depthImage != VK_NULL_HANDLE) {
+            m_device->destroyImage(m_depthImage, m_depthAllocation);
+        }
+        if(m_colorImageView != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, m_colorImageView, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+        }
+        if(m_colorImage != VK_NULL_HANDLE) {
+            m_device->destroyImage(m_colorImage, m_colorAllocation);
+        }
+        if(m_renderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(device, m_renderPass, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_RENDER_PASS));
+        }
+        m_device = nullptr;
+
+        KE_OUT(KE_NOARG);
+    }
+
+    void K3OffscreenTarget::createRenderPass() {
+        KE_IN(KE_NOARG);
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = m_depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        // Left for a copy out rather than presented.
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = COLOR_FORMAT;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentRef{};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.srcAccessMask = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstSubpass = 0;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+
+        if(vkCreateRenderPass(m_device->getDevice(), &renderPassInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_RENDER_PASS), &m_renderPass) != VK_SUCCESS) {
+            KE_CRITICAL("failed to create offscreen render pass!");
+            throw std::runtime_error("failed to create offscreen render pass!");
+        }
+        KE_OUT("(): m_renderPass@<{}>", fmt::ptr(&m_renderPass));
+    }
+
+    void K3OffscreenTarget::createImages() {
+        KE_IN(KE_NOARG);
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = m_extent.width;
+        imageInfo.extent.height = m_extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        imageInfo.format = COLOR_FORMAT;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        m_device->createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_colorImage, m_colorAllocation);
+        m_colorImageView = createImageView(m_colorImage, COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        // Sampled by the Hi-Z build, as the swap chain's depth images are.
+        imageInfo.format = m_depthFormat;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        m_device->createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthAllocation, K3MemoryCategory::DEPTH);
+        m_depthImageView = createImageView(m_depthImage, m_depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+        KE_OUT(KE_NOARG);
+    }
+
+    VkImageView K3OffscreenTarget::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = aspectMask;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        VkImageView imageView = VK_NULL_HANDLE;
+        if(vkCreateImageView(m_device->getDevice(), &viewInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &imageView) != VK_SUCCESS) {
+            KE_CRITICAL("failed to create offscreen image view!");
+            throw std::runtime_error("failed to create offscreen image view!");
+        }
+        return imageView;
+    }
+
+    void K3OffscreenTarget::createFramebuffer() {
+        KE_IN(KE_NOARG);
+        std::array<VkImageView, 2> attachments = {m_colorImageView, m_depthImageView};
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = m_renderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
+        framebufferInfo.width = m_extent.width;
+        framebufferInfo.height = m_extent.height;
+        framebufferInfo.layers = 1;
+
+        if(vkCreateFramebuffer(m_device->getDevice(), &framebufferInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &m_framebuffer) != VK_SUCCESS) {
+            KE_CRITICAL("failed to create offscreen framebuffer!");
+            throw std::runtime_error("failed to create offscreen framebuffer!");
+        }
+        KE_OUT("(): m_framebuffer@<{}>", fmt::ptr(&m_framebuffer));
+    }
+
+    void K3OffscreenTarget::beginRenderPass(VkCommandBuffer commandBuffer) {
+        VkRenderPassBeginInfo renderPassBeginInfo{};
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.renderPass = m_renderPass;
+        renderPassBeginInfo.framebuffer = m_framebuffer;
+        renderPassBeginInfo.renderArea.offset = {0, 0};
+        renderPassBeginInfo.renderArea.extent = m_extent;
+
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = {0.2f, 0.2f, 0.2f, 1.0f};
+        clearValues[1].depthStencil = {1.0f, 0};
+        renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassBeginInfo.pClearValues = clearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(m_extent.width);
+        viewport.height = static_cast<float>(m_extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{{0, 0}, m_extent};
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+
+    void K3OffscreenTarget::endRenderPass(VkCommandBuffer commandBuffer) {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+}
@@ -1,5 +1,7 @@
 #include "k3/graphics/pipeline.hpp"
 
+#include <cassert>
+
 namespace k3::graphics {
 
     K3Pipeline::K3Pipeline(std::shared_ptr<K3Device> device, const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& pipelineConfigInfo) : m_device {device} {
@@ -10,12 +12,22 @@ namespace k3::graphics {
         KE_OUT(KE_NOARG); 
     }
 
+    K3Pipeline::K3Pipeline(std::shared_ptr<K3Device> device, const std::string& compFilePath, VkPipelineLayout pipelineLayout) : m_device {device},
+        m_bindPoint {VK_PIPELINE_BIND_POINT_COMPUTE} {
+        KE_IN(KE_NOARG);
+
+        createComputePipeline(compFilePath, pipelineLayout);
+
+        KE_OUT(KE_NOARG);
+    }
+
     K3Pipeline::~K3Pipeline() {
         KE_IN(KE_NOARG); 
 
-        vkDestroyShaderModule(m_device->getDevice() , m_vertexShaderModule, nullptr);
-        vkDestroyShaderModule(m_device->getDevice() , m_fragmentShaderModule, nullptr);
-        vkDestroyPipeline(m_device->getDevice() , m_graphicsPipeline, nullptr);
+        vkDestroyShaderModule(m_device->getDevice() , m_vertexShaderModule, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+        vkDestroyShaderModule(m_device->getDevice() , m_fragmentShaderModule, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+        vkDestroyShaderModule(m_device->getDevice() , m_computeShaderModule, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+        vkDestroyPipeline(m_device->getDevice() , m_pipeline, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE));
 
         KE_OUT(KE_NOARG); 
     }
@@ -70,8 +82,8 @@ namespace k3::graphics {
         shaderStages[1].pNext = nullptr;
         shaderStages[1].pSpecializationInfo = nullptr;
 
-        auto bindingDescriptions = K3Vertex::getBindingDescriptions();
-        auto attributeDescription = K3Vertex::getAttributeDescriptions();
+        auto &bindingDescriptions = pipelineConfigInfo.bindingDescriptions;
+        auto &attributeDescription = pipelineConfigInfo.attributeDescriptions;
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -101,13 +113,37 @@ namespace k3::graphics {
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
         KE_TRACE("Creating graphics pipeline.");
-        if(vkCreateGraphicsPipelines(m_device->getDevice() , VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+        if(vkCreateGraphicsPipelines(m_device->getDevice() , VK_NULL_HANDLE, 1, &pipelineInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE), &m_pipeline) != VK_SUCCESS) {
             KE_CRITICAL("Failed to create graphics pipeline.");
             throw std::runtime_error("Failed to create graphics pipeline.");
         }
         KE_OUT(KE_NOARG);
     }
 
+    void K3Pipeline::createComputePipeline(const std::string& compFilePath, VkPipelineLayout pipelineLayout) {
+        KE_IN("({})", compFilePath);
+        assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+        auto compCode = readFile(compFilePath);
+        createShaderModule(compCode, &m_computeShaderModule);
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = m_computeShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        if(vkCreateComputePipelines(m_device->getDevice() , VK_NULL_HANDLE, 1, &pipelineInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE), &m_pipeline) != VK_SUCCESS) {
+            KE_CRITICAL("Failed to create compute pipeline.");
+            throw std::runtime_error("Failed to create compute pipeline.");
+        }
+        KE_OUT(KE_NOARG);
+    }
+
     void K3Pipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
         KE_IN(KE_NOARG);
         VkShaderModuleCreateInfo createShaderModuleInfo{};
@@ -115,7 +151,7 @@ namespace k3::graphics {
         createShaderModuleInfo.codeSize = code.size();
         createShaderModuleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
-        if(vkCreateShaderModule(m_device->getDevice() , &createShaderModuleInfo, nullptr, shaderModule) != VK_SUCCESS) {
+        if(vkCreateShaderModule(m_device->getDevice() , &createShaderModuleInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SHADER_MODULE), shaderModule) != VK_SUCCESS) {
             throw std::runtime_error("Failed to Create Shader Module");
         }
         KE_OUT(KE_NOARG);
@@ -123,7 +159,7 @@ namespace k3::graphics {
 
     void K3Pipeline::bind(VkCommandBuffer commandBuffer) {
         //KE_IN(KE_NOARG);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+        vkCmdBindPipeline(commandBuffer, m_bindPoint, m_pipeline);
         //KE_OUT(KE_NOARG);
     }
 
@@ -196,6 +232,9 @@ namespace k3::graphics {
         configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
         configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
         configInfo.dynamicStateInfo.flags = 0;
+
+        configInfo.bindingDescriptions = K3Vertex::getBindingDescriptions();
+        configInfo.attributeDescriptions = K3Vertex::getAttributeDescriptions();
         
         KE_OUT(KE_NOARG);
     }
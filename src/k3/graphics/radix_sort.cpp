@@ -0,0 +1,66 @@
+#include "k3/graphics/radix_sort.hpp"
+
+#include <utility>
+
+namespace k3::graphics {
+
+    void K3RadixSorter::sort(std::vector<K3SortEntry> &entries) {
+        m_passCount = 0;
+        const size_t count = entries.size();
+        if(count < 2) {
+            return;
+        }
+        if(count < INSERTION_THRESHOLD) {
+            for(size_t i = 1; i < count; i++) {
+                const K3SortEntry entry = entries[i];
+                size_t j = i;
+                while(j > 0 && entries[j - 1].key > entry.key) {
+                    entries[j] = entries[j - 1];
+                    j--;
+                }
+                entries[j] = entry;
+            }
+            return;
+        }
+
+        for(auto &histogram : m_histograms) {
+            histogram.fill(0);
+        }
+        for(const K3SortEntry &entry : entries) {
+            for(uint32_t digit = 0; digit < DIGIT_COUNT; digit++) {
+                m_histograms[digit][(entry.key >> (digit * DIGIT_BITS)) & (BUCKET_COUNT - 1)]++;
+            }
+        }
+
+        m_scratch.resize(count);
+        K3SortEntry *source = entries.data();
+        K3SortEntry *destination = m_scratch.data();
+        for(uint32_t digit = 0; digit < DIGIT_COUNT; digit++) {
+            // Every key has the same digit here, the pass would leave the order as it is.
+            std::array<uint32_t, BUCKET_COUNT> &histogram = m_histograms[digit];
+            const uint32_t shift = digit * DIGIT_BITS;
+            if(histogram[(source[0].key >> shift) & (BUCKET_COUNT - 1)] == count) {
+                continue;
+            }
+
+            // Counts become each bucket's first output slot.
+            uint32_t offset = 0;
+            for(uint32_t &bucket : histogram) {
+                const uint32_t bucketCount = bucket;
+                bucket = offset;
+                offset += bucketCount;
+            }
+            for(size_t i = 0; i < count; i++) {
+                destination[histogram[(source[i].key >> shift) & (BUCKET_COUNT - 1)]++] = source[i];
+            }
+            std::swap(source, destination);
+            m_passCount++;
+        }
+
+        // An odd number of passes leaves the result in the scratch array.
+        if(source != entries.data()) {
+            entries.swap(m_scratch);
+        }
+    }
+
+}
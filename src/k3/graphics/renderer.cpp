@@ -7,6 +7,8 @@ namespace k3::graphics  {
         
         recreateSwapChain();
         createCommandBuffers();
+        m_frameAllocator = std::make_unique<K3FrameAllocator>(m_device);
+        m_defragmenter = std::make_unique<K3Defragmenter>(m_device);
 
         KE_OUT(KE_NOARG);
     }
@@ -15,6 +17,8 @@ namespace k3::graphics  {
         KE_IN(KE_NOARG);
 
         freeCommandBuffers();
+        m_defragmenter = nullptr;
+        m_frameAllocator = nullptr;
         if(m_swapChain != nullptr) {
             m_swapChain = nullptr;
         }
@@ -31,6 +35,7 @@ namespace k3::graphics  {
     VkCommandBuffer K3Renderer::beginFrame() {
         //KE_IN(KE_NOARG);
         assert(!m_isFrameStarted && "Cant call beginFrame while in progress.");
+        m_device->updateMemoryBudget();
 
         auto result = m_swapChain->acquireNextImage(&m_currentImageIndex);
         if(result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -42,6 +47,9 @@ namespace k3::graphics  {
             throw std::runtime_error("Failed to aquire swapchain!");
         }
         m_isFrameStarted = true;
+        // acquireNextImage waited on this frame's fence, so the GPU is done with its region.
+        m_frameAllocator->beginFrame(m_currentFrameIndex);
+        m_device->getGeometryPool().beginFrame();
         auto commandBuffer = getCurrentCommandBuffer();
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -50,6 +58,9 @@ namespace k3::graphics  {
             KE_CRITICAL("Failed to begin recording command buffer!");
             throw std::runtime_error("Failed to begin recording command buffer!");
         }
+        // Take ownership of uploads finished on the transfer queue before anything draws with them.
+        m_uploadWaitValue = m_device->getStagingRing().acquireUploads(commandBuffer);
+        m_defragmenter->update(commandBuffer);
         //KE_OUT(KE_NOARG);
         return commandBuffer;
     }
@@ -57,11 +68,14 @@ namespace k3::graphics  {
     void K3Renderer::endFrame() {
         assert(m_isFrameStarted && "Cant call endFrame while frame is not in progress.");
         auto commandBuffer = getCurrentCommandBuffer();
+        m_frameAllocator->flush();
         if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
             KE_CRITICAL("Failed to record comand buffer!");
             throw std::runtime_error("Failed to record comand buffer!");
         }
-        auto result = m_swapChain->submitCommandBuffers(&commandBuffer, &m_currentImageIndex);
+        auto result = m_swapChain->submitCommandBuffers(&commandBuffer, &m_currentImageIndex, m_uploadWaitValue);
+        m_previousImageIndex = m_currentImageIndex;
+        m_hasPreviousDepth = true;
         if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_window->wasWindowResized()) {
             if(m_window->wasWindowResized()) {
                 KE_DEBUG("Window Resize Triggering Swapchain Recreation");
@@ -142,12 +156,17 @@ namespace k3::graphics  {
 
     void K3Renderer::recreateSwapChain() {
         KE_IN(KE_NOARG);
+        m_hasPreviousDepth = false;
         auto extent = m_window->getExtent();
         while (extent.width == 0 || extent.height == 0) {
             extent = m_window->getExtent();
             glfwWaitEvents();
         }
-        vkDeviceWaitIdle(m_device->getDevice() );
+        {
+            std::lock_guard<std::mutex> lock(m_device->getQueueMutex());
+            vkDeviceWaitIdle(m_device->getDevice() );
+        }
+        const K3HostAllocationStatistics hostBefore = m_device->getHostAllocator().getStatistics();
         KE_DEBUG("Make new m_swapChain");
         if (m_swapChain == nullptr) {
             m_swapChain = std::make_unique<K3SwapChain>(m_device, extent);
@@ -159,6 +178,7 @@ namespace k3::graphics  {
             m_swapChain = std::move(newSwapChain);
         }
         KE_TRACE("Swapchain Created m_swapChain@<{}>.", fmt::ptr(&m_swapChain));
+        K3HostAllocator::logChurn("Swapchain recreation", hostBefore, m_device->getHostAllocator().getStatistics());
         KE_OUT(KE_NOARG);
     }
 
@@ -1,2 +1,11 @@
 glslc simple_shader.vert -o simple_shader.vert.spv
+glslc -DOCTAHEDRAL_NORMAL simple_shader.vert -o simple_shader_oct.vert.spv
+glslc -DUNIFORM_COLOR simple_shader.vert -o simple_shader_uniform.vert.spv
+glslc -DOCTAHEDRAL_NORMAL -DUNIFORM_COLOR simple_shader.vert -o simple_shader_oct_uniform.vert.spv
+glslc -DPUSH_CONSTANTS simple_shader.vert -o simple_shader_push.vert.spv
+glslc -DPUSH_CONSTANTS -DOCTAHEDRAL_NORMAL simple_shader.vert -o simple_shader_oct_push.vert.spv
+glslc -DPUSH_CONSTANTS -DUNIFORM_COLOR simple_shader.vert -o simple_shader_uniform_push.vert.spv
+glslc -DPUSH_CONSTANTS -DOCTAHEDRAL_NORMAL -DUNIFORM_COLOR simple_shader.vert -o simple_shader_oct_uniform_push.vert.spv
 glslc simple_shader.frag -o simple_shader.frag.spv
+glslc cull.comp -o cull.comp.spv
+glslc hiz.comp -o hiz.comp.spv
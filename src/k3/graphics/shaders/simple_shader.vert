@@ -1,26 +1,67 @@
 #version 450
 
+// Variants are compiled with -D, see compileShaders.sh and K3VertexFormat.
+// Quantised positions and half uvs are expanded by the vertex fetch and need no variant.
 layout(location = 0) in vec3 position;
+#ifndef UNIFORM_COLOR
 layout(location = 1) in vec3 color;
+#endif
+#ifdef OCTAHEDRAL_NORMAL
+layout(location = 2) in vec2 octNormal;
+#else
 layout(location = 2) in vec3 normal;
+#endif
 layout(location = 3) in vec2 uv;
 
 layout(location = 0) out vec3 fragColor;
 
-layout(push_constant) uniform Push {
+// K3InstanceData, one per instance of every draw in the pass; firstInstance selects the group.
+struct Instance {
   mat4 transform;
   mat4 normalMatrix;
+};
+
+#ifdef PUSH_CONSTANTS
+// Per object draws push their own instance instead.
+layout(push_constant) uniform Push {
+  Instance instance;
 } push;
+#else
+layout(std430, set = 0, binding = 0) readonly buffer Instances {
+  Instance instances[];
+};
+#endif
 
 const vec4 DIRECTION_TO_LIGHT = normalize(vec4(-1.0, -3.0, -1.0, 0));
 const float AMBIENT = 0.03;
 
+#ifdef OCTAHEDRAL_NORMAL
+vec3 decodeOctahedral(vec2 e) {
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+#endif
+
 void main() {
-  gl_Position = push.transform * vec4(position, 1.0);
+#ifdef PUSH_CONSTANTS
+  Instance instance = push.instance;
+#else
+  Instance instance = instances[gl_InstanceIndex];
+#endif
+#ifdef OCTAHEDRAL_NORMAL
+  vec3 normal = decodeOctahedral(octNormal);
+#endif
+#ifdef UNIFORM_COLOR
+  vec3 color = instance.normalMatrix[3].xyz;
+#endif
+  gl_Position = instance.transform * vec4(position, 1.0);
   
-  //vec4 normalWorldSpace = vec4(normalize(mat3(push.normalMatrix) * normal), 0);
+  //vec4 normalWorldSpace = vec4(normalize(mat3(instance.normalMatrix) * normal), 0);
 
-  vec4 normalWorldSpace = normalize(push.transform * vec4(normal,0));
+  vec4 normalWorldSpace = normalize(instance.transform * vec4(normal,0));
 
   float lightIntensity = AMBIENT + max(dot(normalWorldSpace, DIRECTION_TO_LIGHT), 0);
 
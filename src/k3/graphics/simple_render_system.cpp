@@ -1,17 +1,30 @@
 #include "k3/graphics/simple_render_system.hpp"
+#include "k3/graphics/swapchain.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
 
 namespace k3::graphics  {
 
-    struct SimplePushConstantData {
-        glm::mat4 transform{1.f};
-        glm::mat4 normalMatrix{1.f};
-    };
+    // Above any K3VertexFormat flag, keys the push constant variant of a pipeline.
+    static constexpr uint32_t PER_OBJECT_PIPELINE = 1u << 31;
 
-    K3SimpleRenderSystem::K3SimpleRenderSystem(std::shared_ptr<K3Device> device, VkRenderPass renderPass) : m_device {device} {
+    K3SimpleRenderSystem::K3SimpleRenderSystem(std::shared_ptr<K3Device> device, VkRenderPass renderPass) : m_device {device}, m_renderPass {renderPass} {
         KE_IN(KE_NOARG);
 
+        createDescriptorSets();
         createPipelineLayout();
-        createPipeline(renderPass);
+        m_drawList = std::make_unique<K3DrawList>(m_device);
+        if(m_device->hasMultiDrawIndirect()) {
+            try {
+                m_culler = std::make_unique<K3Culler>(m_device);
+            } catch(const std::runtime_error &e) {
+                KE_WARN("GPU culling unavailable ({}), drawing every instance.", e.what());
+            }
+        }
+        getPipeline(K3VertexFormat{});
 
         KE_OUT(KE_NOARG);
     }
@@ -19,10 +32,13 @@ namespace k3::graphics  {
     K3SimpleRenderSystem::~K3SimpleRenderSystem() {
         KE_IN(KE_NOARG);
   
-        if(m_pipeline != nullptr) {
-            m_pipeline = nullptr;
-        }
-        vkDestroyPipelineLayout(m_device->getDevice() , m_pipelineLayout, nullptr);
+        m_culler = nullptr;
+        m_drawList = nullptr;
+        m_pipelines.clear();
+        vkDestroyPipelineLayout(m_device->getDevice() , m_pipelineLayout, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+        m_instanceSets.clear();
+        m_descriptorPool = nullptr;
+        m_instanceSetLayout = nullptr;
     
         if(m_device != nullptr) {
             m_device = nullptr;
@@ -31,16 +47,48 @@ namespace k3::graphics  {
         KE_OUT(KE_NOARG);
     }
 
-   void K3SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
-        KE_IN(KE_NOARG);
+   K3Pipeline &K3SimpleRenderSystem::getPipeline(const K3VertexFormat &vertexFormat, bool perObject) {
+        const uint32_t key = vertexFormat.getFlags() | (perObject ? PER_OBJECT_PIPELINE : 0);
+        auto found = m_pipelines.find(key);
+        if(found != m_pipelines.end()) {
+            return *found->second;
+        }
+
+        KE_IN("({:#x})", key);
         assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
         PipelineConfigInfo pipelineConfig{};
         K3Pipeline::defaultPipelineConfigInfo(pipelineConfig);
-        pipelineConfig.renderPass = renderPass;
+        pipelineConfig.renderPass = m_renderPass;
         pipelineConfig.pipelineLayout = m_pipelineLayout;
+        pipelineConfig.bindingDescriptions = vertexFormat.getBindingDescriptions();
+        pipelineConfig.attributeDescriptions = vertexFormat.getAttributeDescriptions();
+
+        auto pipeline = std::make_unique<K3Pipeline>(m_device, vertexFormat.getVertexShaderPath(perObject), "./shaders/simple_shader.frag.spv", pipelineConfig);
+        K3Pipeline &result = *pipeline;
+        m_pipelines.emplace(key, std::move(pipeline));
 
-        m_pipeline = std::make_unique<K3Pipeline>(m_device, "./shaders/simple_shader.vert.spv", "./shaders/simple_shader.frag.spv", pipelineConfig);
+        KE_OUT(KE_NOARG);
+        return result;
+    }
+
+    void K3SimpleRenderSystem::createDescriptorSets() {
+        KE_IN(KE_NOARG);
+
+        m_instanceSetLayout = K3DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+        m_descriptorPool = K3DescriptorPool::Builder(m_device)
+            .setMaxSets(K3SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, K3SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+
+        m_instanceSets.resize(K3SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for(VkDescriptorSet &set : m_instanceSets) {
+            if(!m_descriptorPool->allocateDescriptor(m_instanceSetLayout->getDescriptorSetLayout(), set)) {
+                throw std::runtime_error("failed to allocate instance descriptor set!");
+            }
+        }
 
         KE_OUT(KE_NOARG);
     }
@@ -48,41 +96,302 @@ namespace k3::graphics  {
     void K3SimpleRenderSystem::createPipelineLayout() {
         KE_IN(KE_NOARG);
 
+        VkDescriptorSetLayout setLayout = m_instanceSetLayout->getDescriptorSetLayout();
+
+        // Only the per object pipelines read it, 128 bytes is the most every device guarantees.
         VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(SimplePushConstantData);
+        pushConstantRange.size = sizeof(K3InstanceData);
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pSetLayouts = nullptr;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
         pipelineLayoutInfo.pushConstantRangeCount = 1;
         pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-        if(vkCreatePipelineLayout(m_device->getDevice() , &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        if(vkCreatePipelineLayout(m_device->getDevice() , &pipelineLayoutInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &m_pipelineLayout) != VK_SUCCESS) {
             KE_CRITICAL("Failed to create pipeline layout.");
         }
         
         KE_OUT("(): m_pipelineLayout@<{}>", fmt::ptr(&m_pipelineLayout));
     }
 
-    void K3SimpleRenderSystem::renderGameObjects(k3::graphics::K3FrameInfo& frameInfo, std::vector<K3GameObject>& m_gameObjects) {
-        m_pipeline->bind(frameInfo.commandBuffer);
+    void K3SimpleRenderSystem::prepareGameObjects(K3FrameInfo &frameInfo, std::vector<K3GameObject> &gameObjects) {
+        const auto start = std::chrono::steady_clock::now();
+        collectGameObjects(frameInfo, gameObjects);
+        m_recordTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
 
+    void K3SimpleRenderSystem::collectGameObjects(K3FrameInfo &frameInfo, std::vector<K3GameObject> &gameObjects) {
         auto projectionView = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+        const glm::mat4 &view = frameInfo.camera.getView();
+
+        m_prepared = false;
+        m_drawCount = 0;
+        m_instanceCount = 0;
+        m_frustumVisibleCount = 0;
+        m_frustumCulledCount = 0;
+        m_sortTime = 0.f;
+        m_drawItems.clear();
+        m_directGroups.clear();
+        m_drawList->clear();
+        m_frustumCuller.clear();
+        for(auto& gameObject: gameObjects) {
+            // Still loading (or failed to), or its uploads are still on the transfer queue.
+            std::shared_ptr<K3Model> model = gameObject.model.get();
+            if(model == nullptr || !model->isResident()) {
+                continue;
+            }
+            const glm::mat4 modelMatrix = gameObject.transform.mat4();
+            const glm::vec3 &scale = gameObject.transform.scale;
+            const float maxScale = std::max(std::abs(scale.x), std::max(std::abs(scale.y), std::abs(scale.z)));
+            const glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(model->getBoundsCenter(), 1.f));
+            const glm::vec4 sphere(center, model->getBoundsRadius() * maxScale);
+            // The handle keeps the model alive for the rest of the pass.
+            m_drawItems.push_back({model.get(), 0, model->getVertexFormat().getFlags(), &gameObject, modelMatrix, sphere});
+            m_frustumCuller.add(sphere);
+        }
+
+        // LODs are only selected for what survives.
+        if(m_frustumCulling && !m_drawItems.empty()) {
+            m_frustumVisibleCount = m_frustumCuller.cull(projectionView, m_visibility);
+            m_frustumCulledCount = static_cast<uint32_t>(m_drawItems.size()) - m_frustumVisibleCount;
+            size_t kept = 0;
+            for(size_t i = 0; i < m_drawItems.size(); i++) {
+                if(m_visibility[i] != 0) {
+                    m_drawItems[kept++] = m_drawItems[i];
+                }
+            }
+            m_drawItems.resize(kept);
+        } else {
+            m_frustumVisibleCount = static_cast<uint32_t>(m_drawItems.size());
+        }
+        if(m_drawItems.empty()) {
+            return;
+        }
+        if(m_perObject) {
+            // No sort keys and no instance data, renderPerObject pushes each object as it draws it.
+            for(K3DrawItem &item : m_drawItems) {
+                item.lod = selectLod(frameInfo, view * item.modelMatrix, *item.model, item.gameObject->transform.scale);
+            }
+            m_instanceCount = static_cast<uint32_t>(m_drawItems.size());
+            m_prepared = true;
+            return;
+        }
+        const auto sortStart = std::chrono::steady_clock::now();
+        m_sortEntries.resize(m_drawItems.size());
+        m_modelIds.clear();
+        const K3Model *lastModel = nullptr;
+        uint32_t lastModelId = 0;
+        for(size_t i = 0; i < m_drawItems.size(); i++) {
+            K3DrawItem &item = m_drawItems[i];
+            const glm::mat4 modelView = view * item.modelMatrix;
+            item.lod = selectLod(frameInfo, modelView, *item.model, item.gameObject->transform.scale);
+            // Objects of one model tend to sit together in the list, so skip the lookup for runs.
+            if(item.model != lastModel) {
+                lastModel = item.model;
+                lastModelId = m_modelIds.emplace(item.model, static_cast<uint32_t>(m_modelIds.size())).first->second;
+            }
+            // Nothing blends yet and there are no materials, so both stay at their defaults.
+            const float viewDepth = (view * glm::vec4(glm::vec3(item.sphere), 1.f)).z;
+            m_sortEntries[i] = {K3SortKey::make(K3DrawPass::SOLID, item.pipelineKey, 0, lastModelId, item.lod, viewDepth), static_cast<uint32_t>(i)};
+        }
+
+        // Neighbouring items with the same model and LOD become one draw, pipelines change least.
+        m_sorter.sort(m_sortEntries);
+        m_sortedItems.resize(m_drawItems.size());
+        for(size_t i = 0; i < m_sortEntries.size(); i++) {
+            m_sortedItems[i] = m_drawItems[m_sortEntries[i].index];
+        }
+        m_drawItems.swap(m_sortedItems);
+        m_sortTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - sortStart).count();
+
+        const VkDeviceSize instanceBytes = sizeof(K3InstanceData) * m_drawItems.size();
+        K3FrameAllocation instances = frameInfo.frameAllocator.allocate(instanceBytes);
+        if(instances.mapped == nullptr) {
+            KE_WARN("No frame memory for {} instances, skipping the pass.", m_drawItems.size());
+            return;
+        }
+
+        // Culled instances are compacted into a second block the vertex shader reads instead.
+        bool culling = m_culling && m_indirect && m_culler != nullptr;
+        K3FrameAllocation objects{};
+        K3FrameAllocation visibleInstances{};
+        if(culling) {
+            objects = frameInfo.frameAllocator.allocate(sizeof(K3CullObject) * m_drawItems.size());
+            visibleInstances = frameInfo.frameAllocator.allocate(instanceBytes);
+            if(objects.mapped == nullptr || visibleInstances.mapped == nullptr) {
+                KE_WARN("No frame memory to cull {} instances, drawing all of them.", m_drawItems.size());
+                culling = false;
+            }
+        }
+
+        K3InstanceData *instanceData = static_cast<K3InstanceData *>(instances.mapped);
+        K3CullObject *cullObjects = static_cast<K3CullObject *>(objects.mapped);
+        for(size_t i = 0; i < m_drawItems.size(); i++) {
+            const K3DrawItem &item = m_drawItems[i];
+            K3InstanceData &instance = instanceData[i];
+            instance.transform = projectionView * item.modelMatrix * item.model->getDequantizeMatrix();
+            instance.normalMatrix = item.gameObject->transform.normalMatrix();
+            instance.normalMatrix[3] = glm::vec4(item.model->getUniformColor(), 1.f);
+            if(culling) {
+                cullObjects[i] = K3CullObject{};
+                cullObjects[i].sphere = item.sphere;
+            }
+        }
+
+        for(size_t first = 0; first < m_drawItems.size();) {
+            K3Model *model = m_drawItems[first].model;
+            const uint32_t lod = m_drawItems[first].lod;
+            size_t end = first + 1;
+            while(end < m_drawItems.size() && m_drawItems[end].model == model && m_drawItems[end].lod == lod) {
+                end++;
+            }
+
+            const uint32_t instanceCount = static_cast<uint32_t>(end - first);
+            if(m_indirect && model->isPooled() && model->hasIndexBuffer()) {
+                const uint32_t firstCommand = m_drawList->add(getPipeline(model->getVertexFormat()), *model, lod, instanceCount, static_cast<uint32_t>(first));
+                if(culling) {
+                    for(size_t i = first; i < end; i++) {
+                        cullObjects[i].firstCommand = firstCommand;
+                        cullObjects[i].commandCount = m_drawList->getCommandCount() - firstCommand;
+                    }
+                }
+            } else {
+                m_directGroups.push_back({model, lod, static_cast<uint32_t>(first), instanceCount});
+            }
+            first = end;
+        }
+        m_instanceCount = static_cast<uint32_t>(m_drawItems.size());
+
+        // Without multiDrawIndirect (or frame memory) the draw list records its CPU copy of the
+        // commands, which the cull pass can't reach.
+        if(!m_drawList->upload(frameInfo.frameAllocator, culling)) {
+            culling = false;
+        }
+
+        K3FrameAllocation boundInstances = instances;
+        if(culling) {
+            if(m_culler->isOcclusion() && frameInfo.previousDepthImage != VK_NULL_HANDLE) {
+                m_culler->buildHiZ(frameInfo.commandBuffer, frameInfo.frameIndex, frameInfo.previousDepthImage, frameInfo.previousDepthImageView, frameInfo.extent);
+            }
+            if(m_culler->cull(frameInfo.commandBuffer, frameInfo.frameIndex, frameInfo.frameAllocator, projectionView, objects, instances, visibleInstances,
+                    m_drawList->getCommandAllocation(), m_instanceCount)) {
+                boundInstances = visibleInstances;
+            } else {
+                // The uploaded commands count no instances, start again from full ones.
+                m_drawList->upload(frameInfo.frameAllocator);
+            }
+        }
+
+        // The frame's fence has been waited on, so its set is free to point at the new data.
+        VkDescriptorBufferInfo bufferInfo = boundInstances.descriptorInfo();
+        K3DescriptorWriter(*m_instanceSetLayout, *m_descriptorPool)
+            .writeBuffer(0, &bufferInfo)
+            .overwrite(m_instanceSets[frameInfo.frameIndex]);
+        m_prepared = true;
+    }
+
+    void K3SimpleRenderSystem::renderGameObjects(K3FrameInfo &frameInfo) {
+        if(!m_prepared) {
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        if(m_perObject) {
+            renderPerObject(frameInfo);
+            m_recordTime += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return;
+        }
+
+        VkDescriptorSet &instanceSet = m_instanceSets[frameInfo.frameIndex];
+        vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &instanceSet, 0, nullptr);
+
+        K3Pipeline *boundPipeline = nullptr;
+        // Pooled models share one vertex buffer and one index buffer, rebound only after a model
+        // with its own buffers or when the index type changes.
+        bool poolBound = false;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+        K3GeometryPool &geometryPool = m_device->getGeometryPool();
+        for(const K3DrawGroup &group : m_directGroups) {
+            K3Model *model = group.model;
+            K3Pipeline &pipeline = getPipeline(model->getVertexFormat());
+            if(&pipeline != boundPipeline) {
+                pipeline.bind(frameInfo.commandBuffer);
+                boundPipeline = &pipeline;
+            }
+
+            if(model->isPooled()) {
+                if(!poolBound) {
+                    geometryPool.bindVertexBuffer(frameInfo.commandBuffer);
+                    poolBound = true;
+                }
+                if(model->hasIndexBuffer() && model->getIndexType() != boundIndexType) {
+                    geometryPool.bindIndexBuffer(frameInfo.commandBuffer, model->getIndexType());
+                    boundIndexType = model->getIndexType();
+                }
+            } else {
+                model->bind(frameInfo.commandBuffer);
+                poolBound = false;
+                boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+            }
+            model->draw(frameInfo.commandBuffer, group.lod, group.instanceCount, group.firstInstance);
+            m_drawCount++;
+        }
+        m_drawCount += m_drawList->record(frameInfo.commandBuffer, geometryPool);
+
+        m_recordTime += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
 
-        for(auto& gameObject: m_gameObjects) {
-            
-            SimplePushConstantData push{};
-            auto modelMatrix = gameObject.transform.mat4();
-            push.transform = projectionView * gameObject.transform.mat4();
-            push.normalMatrix = gameObject.transform.normalMatrix();
+    void K3SimpleRenderSystem::renderPerObject(K3FrameInfo &frameInfo) {
+        const glm::mat4 projectionView = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+        K3Pipeline *boundPipeline = nullptr;
+        for(const K3DrawItem &item : m_drawItems) {
+            K3Pipeline &pipeline = getPipeline(item.model->getVertexFormat(), true);
+            if(&pipeline != boundPipeline) {
+                pipeline.bind(frameInfo.commandBuffer);
+                boundPipeline = &pipeline;
+            }
+
+            K3InstanceData push{};
+            push.transform = projectionView * item.modelMatrix * item.model->getDequantizeMatrix();
+            push.normalMatrix = item.gameObject->transform.normalMatrix();
+            push.normalMatrix[3] = glm::vec4(item.model->getUniformColor(), 1.f);
+            vkCmdPushConstants(frameInfo.commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(K3InstanceData), &push);
+            item.model->bind(frameInfo.commandBuffer);
+            item.model->draw(frameInfo.commandBuffer, item.lod, 1, 0);
+            m_drawCount++;
+        }
+    }
+
+    uint32_t K3SimpleRenderSystem::selectLod(const K3FrameInfo &frameInfo, const glm::mat4 &modelView, const K3Model &model, const glm::vec3 &scale) const {
+        if(model.getLodCount() <= 1) {
+            return 0;
+        }
+
+        // Pixels per world unit at the nearest point of the bounding sphere. Perspective projections
+        // shrink with distance, orthographic ones (w row 0 0 0 1) don't.
+        const glm::mat4 &projection = frameInfo.camera.getProjection();
+        const float maxScale = std::max(std::abs(scale.x), std::max(std::abs(scale.y), std::abs(scale.z)));
+        float pixelsPerUnit = std::abs(projection[1][1]) * 0.5f * static_cast<float>(frameInfo.extent.height);
+        if(projection[3][3] == 0.f) {
+            const glm::vec3 center = glm::vec3(modelView * glm::vec4(model.getBoundsCenter(), 1.f));
+            const float distance = glm::length(center) - model.getBoundsRadius() * maxScale;
+            if(distance <= 0.f) {
+                return 0;
+            }
+            pixelsPerUnit /= distance;
+        }
 
-            vkCmdPushConstants(frameInfo.commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
-            gameObject.model->bind(frameInfo.commandBuffer);
-            gameObject.model->draw(frameInfo.commandBuffer);
+        uint32_t lod = 0;
+        for(uint32_t i = 1; i < model.getLodCount(); i++) {
+            if(model.getLod(i).error * maxScale * pixelsPerUnit > LOD_PIXEL_ERROR) {
+                break;
+            }
+            lod = i;
         }
+        return lod;
     }
 
 }
\ No newline at end of file
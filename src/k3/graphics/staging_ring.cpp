@@ -0,0 +1,323 @@
+#include "k3/graphics/staging_ring.hpp"
+#include "k3/graphics/device.hpp"
+#include "k3/graphics/upload_batch.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace k3::graphics {
+
+    K3StagingRing::K3StagingRing(K3Device &device, VkDeviceSize size) : m_device {device}, m_size {size} {
+        KE_IN("({})", size);
+        m_device.createBuffer(m_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_buffer, m_allocation,
+            K3MemoryCategory::STAGING);
+        if(m_allocation.mapped == nullptr) {
+            KE_CRITICAL("failed to map staging ring!");
+            throw std::runtime_error("failed to map staging ring!");
+        }
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = m_device.getTransferFamily();
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        if (vkCreateCommandPool(m_device.getDevice(), &poolInfo, m_device.getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL), &m_commandPool) != VK_SUCCESS) {
+            KE_CRITICAL("failed to create staging command pool!");
+            throw std::runtime_error("failed to create staging command pool!");
+        }
+        m_graphicsCommandPool = m_commandPool;
+        if(m_device.hasDedicatedTransferQueue()) {
+            poolInfo.queueFamilyIndex = m_device.getGraphicsFamily();
+            if (vkCreateCommandPool(m_device.getDevice(), &poolInfo, m_device.getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL), &m_graphicsCommandPool) != VK_SUCCESS) {
+                KE_CRITICAL("failed to create staging command pool!");
+                throw std::runtime_error("failed to create staging command pool!");
+            }
+        }
+
+        VkSemaphoreTypeCreateInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        timelineInfo.initialValue = 0;
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &timelineInfo;
+        if (vkCreateSemaphore(m_device.getDevice(), &semaphoreInfo, m_device.getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE), &m_timeline) != VK_SUCCESS) {
+            KE_CRITICAL("failed to create staging timeline semaphore!");
+            throw std::runtime_error("failed to create staging timeline semaphore!");
+        }
+        KE_OUT("(): transferFamily:{}", m_device.getTransferFamily());
+    }
+
+    K3StagingRing::~K3StagingRing() {
+        KE_IN(KE_NOARG);
+        waitIdle();
+        vkDestroySemaphore(m_device.getDevice(), m_timeline, m_device.getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE));
+        // Destroying the pool frees its command buffers.
+        if(m_graphicsCommandPool != m_commandPool) {
+            vkDestroyCommandPool(m_device.getDevice(), m_graphicsCommandPool, m_device.getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+        }
+        vkDestroyCommandPool(m_device.getDevice(), m_commandPool, m_device.getAllocationCallbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+        m_freeCommandBuffers.clear();
+        m_freeGraphicsCommandBuffers.clear();
+        m_device.destroyBuffer(m_buffer, m_allocation);
+        KE_OUT(KE_NOARG);
+    }
+
+    K3UploadToken K3StagingRing::upload(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset) {
+        KE_IN("({}, {})", size, dstOffset);
+        K3UploadBatch batch(*this);
+        batch.uploadBuffer(dstBuffer, data, size, dstOffset);
+        const K3UploadToken token = batch.submit();
+        KE_OUT("(): token:{}", token.value);
+        return token;
+    }
+
+    bool K3StagingRing::isComplete(K3UploadToken token) const {
+        if(token.value == K3UploadToken::PENDING) {
+            return false;
+        }
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(m_device.getDevice(), m_timeline, &value);
+        return token.value <= value;
+    }
+
+    void K3StagingRing::wait(K3UploadToken token) const {
+        assert(token.value != K3UploadToken::PENDING && "Waiting on an upload that was never submitted");
+        if(token.value == 0) {
+            return;
+        }
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &m_timeline;
+        waitInfo.pValues = &token.value;
+        vkWaitSemaphores(m_device.getDevice(), &waitInfo, UINT64_MAX);
+    }
+
+    uint64_t K3StagingRing::acquireUploads(VkCommandBuffer commandBuffer) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_pendingAcquires.empty()) {
+            return 0;
+        }
+        uint64_t waitValue = 0;
+        for(const auto &pending : m_pendingAcquires) {
+            waitValue = std::max(waitValue, pending.value);
+        }
+        recordTransfers(commandBuffer, m_pendingAcquires, m_device.getTransferFamily(), m_device.getGraphicsFamily(), false, CONSUMER_STAGES, CONSUMER_STAGES);
+        m_pendingAcquires.clear();
+        // Everything submitted so far is either acquired now or never needed to be.
+        m_acquiredValue = m_nextValue - 1;
+        return waitValue;
+    }
+
+    bool K3StagingRing::reserve(VkDeviceSize size, VkDeviceSize &offset) {
+        assert(size <= m_size && "Staging chunk larger than the ring");
+        std::unique_lock<std::mutex> lock(m_mutex);
+        retire();
+        for(;;) {
+            if(m_ranges.empty()) {
+                m_head = 0;
+                offset = 0;
+                break;
+            }
+            const VkDeviceSize head = (m_head + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+            const VkDeviceSize tail = m_ranges.front().begin;
+            if(m_head > tail) {
+                // Free space is [head, size) and, wrapping round, [0, tail).
+                if(head + size <= m_size) {
+                    offset = head;
+                    break;
+                }
+                if(size <= tail) {
+                    offset = 0;
+                    break;
+                }
+            } else if(m_head < tail && head + size <= tail) {
+                offset = head;
+                break;
+            }
+            const uint64_t oldest = m_ranges.front().value;
+            if(oldest == K3UploadToken::PENDING) {
+                // The oldest range is the open batch's own, waiting would never end.
+                return false;
+            }
+            // Wait without the lock, the render thread takes it in acquireUploads every frame.
+            // Another thread may have moved the ring on meanwhile, so look again afterwards.
+            lock.unlock();
+            wait({oldest});
+            lock.lock();
+            retire();
+        }
+        m_ranges.push_back({offset, offset + size, K3UploadToken::PENDING});
+        m_head = offset + size;
+        return true;
+    }
+
+    VkCommandBuffer K3StagingRing::beginCommandBuffer(bool graphics) {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            retire();
+            auto &freeCommandBuffers = graphics ? m_freeGraphicsCommandBuffers : m_freeCommandBuffers;
+            if(!freeCommandBuffers.empty()) {
+                commandBuffer = freeCommandBuffers.back();
+                freeCommandBuffers.pop_back();
+            }
+        }
+        if(commandBuffer != VK_NULL_HANDLE) {
+            vkResetCommandBuffer(commandBuffer, 0);
+        } else {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = graphics ? m_graphicsCommandPool : m_commandPool;
+            allocInfo.commandBufferCount = 1;
+            vkAllocateCommandBuffers(m_device.getDevice(), &allocInfo, &commandBuffer);
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        return commandBuffer;
+    }
+
+    uint64_t K3StagingRing::submit(VkCommandBuffer commandBuffer, bool graphics, std::vector<K3OwnershipTransfer> &releases) {
+        const bool dedicated = m_device.hasDedicatedTransferQueue();
+        if(!releases.empty()) {
+            // Release half of the ownership transfers, acquireUploads records the other half.
+            recordTransfers(commandBuffer, releases, m_device.getTransferFamily(), m_device.getGraphicsFamily(), true,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        } else {
+            // Same queue family as rendering, so order the copies before any later use on it.
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        vkEndCommandBuffer(commandBuffer);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint64_t value = m_nextValue++;
+
+        // Timeline values have to be signalled in increasing order. Submits to one queue are, but
+        // switching between the transfer and the graphics queue needs a wait on the previous value.
+        const uint64_t waitValue = value - 1;
+        const bool waitPrevious = dedicated && value > 1 && graphics != m_lastSubmitGraphics;
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = waitPrevious ? 1 : 0;
+        timelineInfo.pWaitSemaphoreValues = &waitValue;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &value;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = waitPrevious ? 1 : 0;
+        submitInfo.pWaitSemaphores = &m_timeline;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_timeline;
+        {
+            std::lock_guard<std::mutex> queueLock(m_device.getQueueMutex());
+            vkQueueSubmit(graphics ? m_device.getGraphicsQueue() : m_device.getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+        }
+        m_lastSubmitGraphics = graphics;
+        ++m_submitCount;
+
+        // The open batch's ranges are the newest ones.
+        for(auto range = m_ranges.rbegin(); range != m_ranges.rend() && range->value == K3UploadToken::PENDING; ++range) {
+            range->value = value;
+        }
+        m_commandBuffersInFlight.push_back({commandBuffer, graphics, value});
+
+        for(auto &release : releases) {
+            release.value = value;
+            m_pendingAcquires.push_back(release);
+        }
+        releases.clear();
+        if(m_pendingAcquires.empty()) {
+            m_acquiredValue = value;
+        }
+        return value;
+    }
+
+    void K3StagingRing::retire() {
+        if(m_commandBuffersInFlight.empty()) {
+            return;
+        }
+        uint64_t completed = 0;
+        vkGetSemaphoreCounterValue(m_device.getDevice(), m_timeline, &completed);
+        while(!m_commandBuffersInFlight.empty() && m_commandBuffersInFlight.front().value <= completed) {
+            const auto &inFlight = m_commandBuffersInFlight.front();
+            (inFlight.graphics ? m_freeGraphicsCommandBuffers : m_freeCommandBuffers).push_back(inFlight.commandBuffer);
+            m_commandBuffersInFlight.pop_front();
+        }
+        while(!m_ranges.empty() && m_ranges.front().value <= completed) {
+            m_ranges.pop_front();
+        }
+    }
+
+    void K3StagingRing::recordTransfers(VkCommandBuffer commandBuffer, const std::vector<K3OwnershipTransfer> &transfers, uint32_t srcFamily, uint32_t dstFamily,
+        bool release, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages) {
+        std::vector<VkBufferMemoryBarrier> bufferBarriers{};
+        std::vector<VkImageMemoryBarrier> imageBarriers{};
+        for(const auto &transfer : transfers) {
+            if(transfer.image != VK_NULL_HANDLE) {
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+                barrier.dstAccessMask = release ? 0 : VK_ACCESS_SHADER_READ_BIT;
+                barrier.oldLayout = transfer.oldLayout;
+                barrier.newLayout = transfer.newLayout;
+                barrier.srcQueueFamilyIndex = srcFamily;
+                barrier.dstQueueFamilyIndex = dstFamily;
+                barrier.image = transfer.image;
+                barrier.subresourceRange = transfer.subresourceRange;
+                imageBarriers.push_back(barrier);
+            } else {
+                VkBufferMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+                barrier.dstAccessMask = release ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+                barrier.srcQueueFamilyIndex = srcFamily;
+                barrier.dstQueueFamilyIndex = dstFamily;
+                barrier.buffer = transfer.buffer;
+                barrier.offset = transfer.offset;
+                barrier.size = transfer.size;
+                bufferBarriers.push_back(barrier);
+            }
+        }
+        vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+            static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    }
+
+    void K3StagingRing::waitIdle() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        retire();
+        while(!m_commandBuffersInFlight.empty()) {
+            const uint64_t newest = m_commandBuffersInFlight.back().value;
+            lock.unlock();
+            wait({newest});
+            lock.lock();
+            retire();
+        }
+    }
+
+    VkDeviceSize K3StagingRing::getPendingBytes() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        VkDeviceSize pending = 0;
+        for(const auto &range : m_ranges) {
+            pending += range.end - range.begin;
+        }
+        return pending;
+    }
+
+}
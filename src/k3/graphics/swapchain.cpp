@@ -43,33 +43,32 @@ namespace k3::graphics {
         KE_IN(KE_NOARG);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroySemaphore(m_device->getDevice(), m_renderFinishedSemaphores[i], nullptr);
-            vkDestroySemaphore(m_device->getDevice(), m_imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(m_device->getDevice(), m_inFlightFences[i], nullptr);
+            vkDestroySemaphore(m_device->getDevice(), m_renderFinishedSemaphores[i], m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE));
+            vkDestroySemaphore(m_device->getDevice(), m_imageAvailableSemaphores[i], m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE));
+            vkDestroyFence(m_device->getDevice(), m_inFlightFences[i], m_device->getAllocationCallbacks(VK_OBJECT_TYPE_FENCE));
         }
 
         for (auto framebuffer : m_swapChainFramebuffers) {
-            vkDestroyFramebuffer(m_device->getDevice(), framebuffer, nullptr);
+            vkDestroyFramebuffer(m_device->getDevice(), framebuffer, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
         }
 
         for (int i = 0; i < m_depthImages.size(); i++) {
-            vkDestroyImageView(m_device->getDevice(), m_depthImageViews[i], nullptr);
-            vkDestroyImage(m_device->getDevice(), m_depthImages[i], nullptr);
-            vkFreeMemory(m_device->getDevice(), m_depthImageMemorys[i], nullptr);
+            vkDestroyImageView(m_device->getDevice(), m_depthImageViews[i], m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+            m_device->destroyImage(m_depthImages[i], m_depthImageAllocations[i]);
         }
 
         if(m_renderPass != nullptr) {
-            vkDestroyRenderPass(m_device->getDevice(), m_renderPass, nullptr);
+            vkDestroyRenderPass(m_device->getDevice(), m_renderPass, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_RENDER_PASS));
             m_renderPass = nullptr;
         }
 
         for (auto imageView : m_swapChainImageViews) {
-            vkDestroyImageView(m_device->getDevice(), imageView, nullptr);
+            vkDestroyImageView(m_device->getDevice(), imageView, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
         }
         m_swapChainImageViews.clear();
 
         if (m_swapChain != nullptr) {
-            vkDestroySwapchainKHR(m_device->getDevice(), m_swapChain, nullptr);
+            vkDestroySwapchainKHR(m_device->getDevice(), m_swapChain, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
             m_swapChain = nullptr;
         }
 
@@ -137,7 +136,7 @@ namespace k3::graphics {
         }
         
 
-        if (vkCreateSwapchainKHR(m_device->getDevice(), &createInfo, nullptr, &m_swapChain) != VK_SUCCESS) {
+        if (vkCreateSwapchainKHR(m_device->getDevice(), &createInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR), &m_swapChain) != VK_SUCCESS) {
             KE_CRITICAL("failed to create swap chain!");
         }
 
@@ -214,7 +213,7 @@ namespace k3::graphics {
             viewInfo.subresourceRange.levelCount = 1;
             viewInfo.subresourceRange.baseArrayLayer = 0;
             viewInfo.subresourceRange.layerCount = 1;
-            if (vkCreateImageView(m_device->getDevice(), &viewInfo, nullptr, &m_swapChainImageViews[i]) != VK_SUCCESS) {
+            if (vkCreateImageView(m_device->getDevice(), &viewInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &m_swapChainImageViews[i]) != VK_SUCCESS) {
                 KE_ERROR("failed to create texture image view!");
             }
         }
@@ -227,7 +226,7 @@ namespace k3::graphics {
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
         depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -275,7 +274,7 @@ namespace k3::graphics {
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
-        if (vkCreateRenderPass(m_device->getDevice(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+        if (vkCreateRenderPass(m_device->getDevice(), &renderPassInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_RENDER_PASS), &m_renderPass) != VK_SUCCESS) {
             KE_CRITICAL("failed to create render pass!");
         }
         KE_OUT("(): m_renderPass@<{}>", fmt::ptr(&m_renderPass));
@@ -285,7 +284,7 @@ namespace k3::graphics {
         KE_IN(KE_NOARG);
         VkFormat format = m_device->findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
         VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
         KE_OUT(KE_NOARG);
         return format;
     }
@@ -297,7 +296,7 @@ namespace k3::graphics {
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
         m_depthImages.resize(imageCount());
-        m_depthImageMemorys.resize(imageCount());
+        m_depthImageAllocations.resize(imageCount());
         m_depthImageViews.resize(imageCount());
 
         for (int i = 0; i < m_depthImages.size(); i++) {
@@ -312,12 +311,13 @@ namespace k3::graphics {
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            // Sampled by the Hi-Z build of the next frame.
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
 
-            m_device->createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImages[i], m_depthImageMemorys[i]);
+            m_device->createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImages[i], m_depthImageAllocations[i], K3MemoryCategory::DEPTH);
 
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -330,12 +330,12 @@ namespace k3::graphics {
             viewInfo.subresourceRange.baseArrayLayer = 0;
             viewInfo.subresourceRange.layerCount = 1;
 
-            if (vkCreateImageView(m_device->getDevice(), &viewInfo, nullptr, &m_depthImageViews[i]) != VK_SUCCESS) {
+            if (vkCreateImageView(m_device->getDevice(), &viewInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &m_depthImageViews[i]) != VK_SUCCESS) {
                 KE_CRITICAL("failed to create texture image view!");
                 throw std::runtime_error("failed to create texture image view!");
             }
         }
-        KE_OUT("(): m_depthImages[{}]@<{}>, m_depthImageMemorys[{}]@<{}>", m_depthImages.size(), fmt::ptr(&m_depthImages), m_depthImageMemorys.size(), fmt::ptr(&m_depthImageMemorys));
+        KE_OUT("(): m_depthImages[{}]@<{}>, m_depthImageAllocations[{}]@<{}>", m_depthImages.size(), fmt::ptr(&m_depthImages), m_depthImageAllocations.size(), fmt::ptr(&m_depthImageAllocations));
     }
 
     void K3SwapChain::createFramebuffers() {
@@ -354,7 +354,7 @@ namespace k3::graphics {
             framebufferInfo.height = swapChainExtent.height;
             framebufferInfo.layers = 1;
 
-            if (vkCreateFramebuffer(m_device->getDevice(), &framebufferInfo, nullptr, &m_swapChainFramebuffers[i]) != VK_SUCCESS) {
+            if (vkCreateFramebuffer(m_device->getDevice(), &framebufferInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &m_swapChainFramebuffers[i]) != VK_SUCCESS) {
                 KE_CRITICAL("failed to create framebuffer!");
                 throw std::runtime_error("failed to create framebuffer!");
             }
@@ -377,9 +377,9 @@ namespace k3::graphics {
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            if (vkCreateSemaphore(m_device->getDevice() , &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(m_device->getDevice() , &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(m_device->getDevice() , &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS) {
+            if (vkCreateSemaphore(m_device->getDevice() , &semaphoreInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE), &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateSemaphore(m_device->getDevice() , &semaphoreInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_SEMAPHORE), &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(m_device->getDevice() , &fenceInfo, m_device->getAllocationCallbacks(VK_OBJECT_TYPE_FENCE), &m_inFlightFences[i]) != VK_SUCCESS) {
                 KE_CRITICAL("failed to create synchronization objects for a frame!");
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
@@ -396,7 +396,7 @@ namespace k3::graphics {
         return result;
     }
 
-    VkResult K3SwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex) {
+    VkResult K3SwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex, uint64_t uploadWaitValue) {
         if (m_imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
             vkWaitForFences(m_device->getDevice() , 1, &m_imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
         }
@@ -405,12 +405,22 @@ namespace k3::graphics {
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
+        VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame], m_device->getStagingRing().getTimelineSemaphore()};
+        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, K3StagingRing::CONSUMER_STAGES};
+        submitInfo.waitSemaphoreCount = uploadWaitValue > 0 ? 2 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
+        // The binary image semaphore ignores its value.
+        uint64_t waitValues[] = {0, uploadWaitValue};
+        VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        if (uploadWaitValue > 0) {
+            submitInfo.pNext = &timelineInfo;
+        }
+
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
 
@@ -419,6 +429,7 @@ namespace k3::graphics {
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         vkResetFences(m_device->getDevice() , 1, &m_inFlightFences[m_currentFrame]);
+        std::unique_lock<std::mutex> queueLock(m_device->getQueueMutex());
         if (vkQueueSubmit(m_device->getGraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) !=
             VK_SUCCESS) {
             throw std::runtime_error("failed to submit draw command buffer!");
@@ -437,6 +448,7 @@ namespace k3::graphics {
         presentInfo.pImageIndices = imageIndex;
 
         auto result = vkQueuePresentKHR(m_device->presentQueue(), &presentInfo);
+        queueLock.unlock();
 
         m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
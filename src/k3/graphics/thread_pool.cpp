@@ -0,0 +1,75 @@
+#include "k3/graphics/thread_pool.hpp"
+
+#include <algorithm>
+
+namespace k3::graphics {
+
+    K3ThreadPool::K3ThreadPool(uint32_t threadCount) {
+        KE_IN("({})", threadCount);
+        if(threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        m_workers.reserve(threadCount);
+        for(uint32_t i = 0; i < threadCount; i++) {
+            m_workers.emplace_back(&K3ThreadPool::workerLoop, this);
+        }
+        KE_OUT("(): {} workers", threadCount);
+    }
+
+    K3ThreadPool::~K3ThreadPool() {
+        KE_IN(KE_NOARG);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_condition.notify_all();
+        for(auto &worker : m_workers) {
+            if(worker.joinable()) {
+                worker.join();
+            }
+        }
+        KE_OUT(KE_NOARG);
+    }
+
+    K3ThreadPool &K3ThreadPool::shared() {
+        static K3ThreadPool instance;
+        return instance;
+    }
+
+    void K3ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)> &function) {
+        if(count == 0) {
+            return;
+        }
+        if(count == 1) {
+            function(0);
+            return;
+        }
+        std::vector<std::future<void>> futures;
+        futures.reserve(count - 1);
+        for(uint32_t i = 1; i < count; i++) {
+            futures.push_back(submit([&function, i]() { function(i); }));
+        }
+        // The calling thread takes the first slice rather than idling.
+        function(0);
+        for(auto &future : futures) {
+            future.get();
+        }
+    }
+
+    void K3ThreadPool::workerLoop() {
+        while(true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+                if(m_stopping && m_tasks.empty()) {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+}
\ No newline at end of file
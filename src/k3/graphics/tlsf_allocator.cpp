@@ -0,0 +1,283 @@
+#include "k3/graphics/tlsf_allocator.hpp"
+
+#include <bit>
+#include <cassert>
+
+namespace k3::graphics {
+
+    K3TlsfAllocator::K3TlsfAllocator(uint64_t size) : m_size {size} {
+        for(auto &freeList : m_freeLists) {
+            for(auto &head : freeList) {
+                head = NONE;
+            }
+        }
+        if(size > 0) {
+            uint32_t region = createRegion();
+            m_regions[region].size = size;
+            insertFree(region);
+        }
+    }
+
+    void K3TlsfAllocator::mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel) {
+        if(size < SECOND_LEVEL_COUNT) {
+            firstLevel = 0;
+            secondLevel = static_cast<uint32_t>(size);
+            return;
+        }
+        const uint32_t topBit = static_cast<uint32_t>(std::bit_width(size)) - 1;
+        firstLevel = topBit - SECOND_LEVEL_BITS + 1;
+        secondLevel = static_cast<uint32_t>(size >> (topBit - SECOND_LEVEL_BITS)) - SECOND_LEVEL_COUNT;
+    }
+
+    uint32_t K3TlsfAllocator::findFree(uint64_t size) const {
+        // Round up to the next class boundary so any region in the class found is big enough.
+        if(size >= SECOND_LEVEL_COUNT) {
+            const uint64_t classWidth = 1ull << (std::bit_width(size) - 1 - SECOND_LEVEL_BITS);
+            if(size > ~0ull - classWidth) {
+                return NONE;
+            }
+            size += classWidth - 1;
+        }
+        uint32_t firstLevel;
+        uint32_t secondLevel;
+        mapping(size, firstLevel, secondLevel);
+
+        uint32_t secondLevelMap = m_secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+        if(secondLevelMap == 0) {
+            const uint64_t firstLevelMap = firstLevel + 1 < 64 ? m_firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+            if(firstLevelMap == 0) {
+                return NONE;
+            }
+            firstLevel = static_cast<uint32_t>(std::countr_zero(firstLevelMap));
+            secondLevelMap = m_secondLevelBitmaps[firstLevel];
+        }
+        secondLevel = static_cast<uint32_t>(std::countr_zero(secondLevelMap));
+        return m_freeLists[firstLevel][secondLevel];
+    }
+
+    uint64_t K3TlsfAllocator::allocate(uint64_t size, uint64_t alignment) {
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+        if(size == 0) {
+            size = 1;
+        }
+
+        // Most offsets handed out are already aligned, so only search for the padded size if the
+        // first candidate can't take the alignment.
+        uint32_t region = findFree(size);
+        if(region != NONE) {
+            const K3Region &candidate = m_regions[region];
+            const uint64_t alignedOffset = (candidate.offset + alignment - 1) & ~(alignment - 1);
+            if(alignedOffset - candidate.offset + size > candidate.size) {
+                region = alignment > 1 ? findFree(size + alignment - 1) : NONE;
+            }
+        }
+        if(region == NONE) {
+            return INVALID_OFFSET;
+        }
+
+        removeFree(region);
+        const uint64_t padding = ((m_regions[region].offset + alignment - 1) & ~(alignment - 1)) - m_regions[region].offset;
+        if(padding > 0) {
+            // Give the padding back as a free region in front of the allocation.
+            split(region, padding);
+            const uint32_t front = region;
+            region = m_regions[front].nextPhysical;
+            removeFree(region);
+            insertFree(front);
+        }
+        if(m_regions[region].size > size) {
+            split(region, size);
+        }
+
+        K3Region &allocated = m_regions[region];
+        allocated.free = false;
+        m_usedBytes += allocated.size;
+        m_allocations.emplace(allocated.offset, region);
+        return allocated.offset;
+    }
+
+    void K3TlsfAllocator::free(uint64_t offset) {
+        auto allocation = m_allocations.find(offset);
+        assert(allocation != m_allocations.end() && "Freeing an offset that was not allocated");
+        if(allocation == m_allocations.end()) {
+            return;
+        }
+        uint32_t region = allocation->second;
+        m_allocations.erase(allocation);
+        m_usedBytes -= m_regions[region].size;
+
+        const uint32_t next = m_regions[region].nextPhysical;
+        if(next != NONE && m_regions[next].free) {
+            removeFree(next);
+            merge(region, next);
+        }
+        const uint32_t previous = m_regions[region].previousPhysical;
+        if(previous != NONE && m_regions[previous].free) {
+            removeFree(previous);
+            merge(previous, region);
+            region = previous;
+        }
+        insertFree(region);
+    }
+
+    uint64_t K3TlsfAllocator::getLargestFreeRegion() const {
+        if(m_firstLevelBitmap == 0) {
+            return 0;
+        }
+        // Only the top non-empty class can hold the largest region, and it is unsorted.
+        const uint32_t firstLevel = static_cast<uint32_t>(std::bit_width(m_firstLevelBitmap)) - 1;
+        const uint32_t secondLevel = static_cast<uint32_t>(std::bit_width(m_secondLevelBitmaps[firstLevel])) - 1;
+        uint64_t largest = 0;
+        for(uint32_t region = m_freeLists[firstLevel][secondLevel]; region != NONE; region = m_regions[region].nextFree) {
+            largest = std::max(largest, m_regions[region].size);
+        }
+        return largest;
+    }
+
+    float K3TlsfAllocator::getFragmentation() const {
+        const uint64_t freeBytes = getFreeBytes();
+        if(freeBytes == 0) {
+            return 0.f;
+        }
+        return 1.f - static_cast<float>(static_cast<double>(getLargestFreeRegion()) / static_cast<double>(freeBytes));
+    }
+
+    bool K3TlsfAllocator::validate() const {
+        uint64_t expectedOffset = 0;
+        uint64_t usedBytes = 0;
+        uint32_t freeRegions = 0;
+        uint32_t previous = NONE;
+        uint32_t region = m_regions.empty() ? NONE : 0;
+        // Region 0 always starts the physical chain, it is only ever split from the back.
+        while(region != NONE) {
+            const K3Region &current = m_regions[region];
+            if(current.offset != expectedOffset || current.previousPhysical != previous || current.size == 0) {
+                return false;
+            }
+            if(current.free) {
+                if(previous != NONE && m_regions[previous].free) {
+                    return false;
+                }
+                freeRegions++;
+            } else {
+                auto allocation = m_allocations.find(current.offset);
+                if(allocation == m_allocations.end() || allocation->second != region) {
+                    return false;
+                }
+                usedBytes += current.size;
+            }
+            expectedOffset += current.size;
+            previous = region;
+            region = current.nextPhysical;
+        }
+
+        uint32_t listedRegions = 0;
+        for(uint32_t firstLevel = 0; firstLevel < FIRST_LEVEL_COUNT; firstLevel++) {
+            for(uint32_t secondLevel = 0; secondLevel < SECOND_LEVEL_COUNT; secondLevel++) {
+                const bool listed = m_freeLists[firstLevel][secondLevel] != NONE;
+                if(listed != (((m_secondLevelBitmaps[firstLevel] >> secondLevel) & 1u) != 0)) {
+                    return false;
+                }
+                for(uint32_t free = m_freeLists[firstLevel][secondLevel]; free != NONE; free = m_regions[free].nextFree) {
+                    uint32_t regionFirstLevel;
+                    uint32_t regionSecondLevel;
+                    mapping(m_regions[free].size, regionFirstLevel, regionSecondLevel);
+                    if(!m_regions[free].free || regionFirstLevel != firstLevel || regionSecondLevel != secondLevel) {
+                        return false;
+                    }
+                    listedRegions++;
+                }
+            }
+            if((m_secondLevelBitmaps[firstLevel] != 0) != (((m_firstLevelBitmap >> firstLevel) & 1ull) != 0)) {
+                return false;
+            }
+        }
+
+        return expectedOffset == m_size && usedBytes == m_usedBytes && freeRegions == m_freeRegionCount && listedRegions == freeRegions
+            && m_allocations.size() + freeRegions + m_unusedRegions.size() == m_regions.size();
+    }
+
+    void K3TlsfAllocator::insertFree(uint32_t region) {
+        K3Region &current = m_regions[region];
+        uint32_t firstLevel;
+        uint32_t secondLevel;
+        mapping(current.size, firstLevel, secondLevel);
+        current.free = true;
+        current.previousFree = NONE;
+        current.nextFree = m_freeLists[firstLevel][secondLevel];
+        if(current.nextFree != NONE) {
+            m_regions[current.nextFree].previousFree = region;
+        }
+        m_freeLists[firstLevel][secondLevel] = region;
+        m_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+        m_firstLevelBitmap |= 1ull << firstLevel;
+        m_freeRegionCount++;
+    }
+
+    void K3TlsfAllocator::removeFree(uint32_t region) {
+        K3Region &current = m_regions[region];
+        uint32_t firstLevel;
+        uint32_t secondLevel;
+        mapping(current.size, firstLevel, secondLevel);
+        if(current.previousFree != NONE) {
+            m_regions[current.previousFree].nextFree = current.nextFree;
+        } else {
+            m_freeLists[firstLevel][secondLevel] = current.nextFree;
+            if(current.nextFree == NONE) {
+                m_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+                if(m_secondLevelBitmaps[firstLevel] == 0) {
+                    m_firstLevelBitmap &= ~(1ull << firstLevel);
+                }
+            }
+        }
+        if(current.nextFree != NONE) {
+            m_regions[current.nextFree].previousFree = current.previousFree;
+        }
+        current.free = false;
+        current.previousFree = NONE;
+        current.nextFree = NONE;
+        m_freeRegionCount--;
+    }
+
+    void K3TlsfAllocator::split(uint32_t region, uint64_t size) {
+        // createRegion may grow m_regions, so index rather than hold references across it.
+        const uint32_t back = createRegion();
+        m_regions[back].offset = m_regions[region].offset + size;
+        m_regions[back].size = m_regions[region].size - size;
+        m_regions[back].previousPhysical = region;
+        m_regions[back].nextPhysical = m_regions[region].nextPhysical;
+        if(m_regions[back].nextPhysical != NONE) {
+            m_regions[m_regions[back].nextPhysical].previousPhysical = back;
+        }
+        m_regions[region].size = size;
+        m_regions[region].nextPhysical = back;
+        insertFree(back);
+    }
+
+    void K3TlsfAllocator::merge(uint32_t region, uint32_t next) {
+        K3Region &current = m_regions[region];
+        current.size += m_regions[next].size;
+        current.nextPhysical = m_regions[next].nextPhysical;
+        if(current.nextPhysical != NONE) {
+            m_regions[current.nextPhysical].previousPhysical = region;
+        }
+        releaseRegion(next);
+    }
+
+    uint32_t K3TlsfAllocator::createRegion() {
+        if(!m_unusedRegions.empty()) {
+            const uint32_t region = m_unusedRegions.back();
+            m_unusedRegions.pop_back();
+            m_regions[region] = K3Region{};
+            return region;
+        }
+        m_regions.emplace_back();
+        return static_cast<uint32_t>(m_regions.size() - 1);
+    }
+
+    void K3TlsfAllocator::releaseRegion(uint32_t region) {
+        m_regions[region] = K3Region{};
+        m_unusedRegions.push_back(region);
+    }
+
+}
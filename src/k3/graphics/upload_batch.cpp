@@ -0,0 +1,163 @@
+#include "k3/graphics/upload_batch.hpp"
+#include "k3/graphics/device.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace k3::graphics {
+
+    K3UploadBatch::K3UploadBatch(K3StagingRing &ring, Queue queue) : m_ring {ring}, m_lock {ring.m_batchMutex} {
+        m_graphics = queue == Queue::GRAPHICS;
+        m_transferOwnership = !m_graphics && m_ring.m_device.hasDedicatedTransferQueue();
+    }
+
+    K3UploadBatch::~K3UploadBatch() {
+        submit();
+    }
+
+    void K3UploadBatch::uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset) {
+        const K3UploadRegion region{data, size, dstOffset};
+        uploadBuffer(dstBuffer, &region, 1);
+    }
+
+    void K3UploadBatch::uploadBuffer(VkBuffer dstBuffer, const K3UploadRegion *regions, uint32_t regionCount) {
+        KE_IN("({})", regionCount);
+        std::vector<VkBufferCopy> copies{};
+        copies.reserve(regionCount);
+        const auto recordCopies = [&]() {
+            if(!copies.empty()) {
+                vkCmdCopyBuffer(getCommandBuffer(), m_ring.m_buffer, dstBuffer, static_cast<uint32_t>(copies.size()), copies.data());
+                copies.clear();
+            }
+        };
+
+        const VkDeviceSize chunkSize = std::min(K3StagingRing::CHUNK_SIZE, m_ring.getSize());
+        for(uint32_t i = 0; i < regionCount; i++) {
+            const K3UploadRegion &region = regions[i];
+            const char *source = static_cast<const char *>(region.data);
+            for(VkDeviceSize done = 0; done < region.size;) {
+                const VkDeviceSize chunk = std::min(chunkSize, region.size - done);
+                VkDeviceSize srcOffset = 0;
+                if(!stage(source + done, chunk, srcOffset)) {
+                    // The ring holds nothing but this batch, send what is recorded to make room.
+                    recordCopies();
+                    submit();
+                    [[maybe_unused]] const bool staged = stage(source + done, chunk, srcOffset);
+                    assert(staged && "Staging ring still full after submit");
+                }
+                copies.push_back({srcOffset, region.dstOffset + done, chunk});
+                release(dstBuffer, region.dstOffset + done, chunk);
+                done += chunk;
+            }
+        }
+        recordCopies();
+        KE_OUT(KE_NOARG);
+    }
+
+    void K3UploadBatch::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy *regions, uint32_t regionCount) {
+        vkCmdCopyBuffer(getCommandBuffer(), srcBuffer, dstBuffer, regionCount, regions);
+        for(uint32_t i = 0; i < regionCount; i++) {
+            release(dstBuffer, regions[i].dstOffset, regions[i].size);
+        }
+    }
+
+    void K3UploadBatch::uploadImage(VkImage image, VkImageAspectFlags aspectMask, const void *data, VkDeviceSize size, VkExtent3D extent, uint32_t layerCount,
+        VkImageLayout finalLayout) {
+        KE_IN("({}, {}x{}x{}, {})", size, extent.width, extent.height, extent.depth, layerCount);
+        VkDeviceSize srcOffset = 0;
+        if(!stage(data, size, srcOffset)) {
+            submit();
+            [[maybe_unused]] const bool staged = stage(data, size, srcOffset);
+            assert(staged && "Staging ring still full after submit");
+        }
+        VkCommandBuffer commandBuffer = getCommandBuffer();
+
+        VkImageSubresourceRange subresourceRange{};
+        subresourceRange.aspectMask = aspectMask;
+        subresourceRange.baseMipLevel = 0;
+        subresourceRange.levelCount = 1;
+        subresourceRange.baseArrayLayer = 0;
+        subresourceRange.layerCount = layerCount;
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = subresourceRange;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = srcOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = aspectMask;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = layerCount;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = extent;
+        vkCmdCopyBufferToImage(commandBuffer, m_ring.m_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        if(m_transferOwnership) {
+            // The layout change happens as part of the queue family transfer.
+            K3StagingRing::K3OwnershipTransfer transfer{};
+            transfer.image = image;
+            transfer.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            transfer.newLayout = finalLayout;
+            transfer.subresourceRange = subresourceRange;
+            m_releases.push_back(transfer);
+        } else {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = finalLayout;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, K3StagingRing::CONSUMER_STAGES, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+        KE_OUT(KE_NOARG);
+    }
+
+    VkCommandBuffer K3UploadBatch::getCommandBuffer() {
+        if(m_commandBuffer == VK_NULL_HANDLE) {
+            m_commandBuffer = m_ring.beginCommandBuffer(m_graphics);
+        }
+        return m_commandBuffer;
+    }
+
+    K3UploadToken K3UploadBatch::submit() {
+        if(m_commandBuffer == VK_NULL_HANDLE) {
+            return m_token;
+        }
+        m_token.value = m_ring.submit(m_commandBuffer, m_graphics, m_releases);
+        m_commandBuffer = VK_NULL_HANDLE;
+        KE_DEBUG("token:{}", m_token.value);
+        return m_token;
+    }
+
+    bool K3UploadBatch::stage(const void *data, VkDeviceSize size, VkDeviceSize &offset) {
+        // Begin recording first, so whatever is staged always has a submit to claim it.
+        getCommandBuffer();
+        if(!m_ring.reserve(size, offset)) {
+            return false;
+        }
+        std::memcpy(static_cast<char *>(m_ring.m_allocation.mapped) + offset, data, size);
+        return true;
+    }
+
+    void K3UploadBatch::release(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+        if(!m_transferOwnership) {
+            return;
+        }
+        K3StagingRing::K3OwnershipTransfer transfer{};
+        transfer.buffer = buffer;
+        transfer.offset = offset;
+        transfer.size = size;
+        m_releases.push_back(transfer);
+    }
+
+}
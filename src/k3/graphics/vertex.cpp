@@ -1,23 +1,22 @@
 #include "k3/graphics/vertex.hpp"
+#include "k3/graphics/mesh_cache.hpp"
+#include "k3/graphics/mesh_optimizer.hpp"
+#include "k3/graphics/mesh_simplifier.hpp"
+#include "k3/graphics/meshlet.hpp"
+#include "k3/graphics/obj_parser.hpp"
+#include "k3/graphics/vertex_table.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 
 
-namespace std {
-    template <>
-    struct hash<k3::graphics::K3Vertex> {
-        size_t operator()(k3::graphics::K3Vertex const &vertex) const {
-            size_t seed = 0;
-            k3::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-            return seed;
-        }
-    };
-}
-
 namespace k3::graphics {
 
     std::vector<VkVertexInputBindingDescription> K3Vertex::getBindingDescriptions() {
@@ -43,6 +42,297 @@ namespace k3::graphics {
     }
 
     void K3Builder::loadModel(const std::string &filePath) {
+        KE_IN("({})", filePath);
+
+        if(K3MeshCache::load(filePath, *this)) {
+            KE_OUT("(): Loaded \"{}\" from mesh cache", filePath);
+            return;
+        }
+
+        parseObj(filePath);
+        K3MeshOptimizer::optimize(*this);
+        if(optimizeFlags & GENERATE_LODS) {
+            K3MeshSimplifier::generateLods(*this);
+        }
+        if(optimizeFlags & GENERATE_MESHLETS) {
+            K3MeshletGenerator::generate(*this);
+        }
+        computeBounds();
+        if(vertexFormatFlags != 0) {
+            encode(vertexFormatFlags);
+        }
+        K3MeshCache::store(filePath, *this);
+
+        KE_OUT(KE_NOARG);
+    }
+
+    void K3Builder::computeBounds() {
+        const K3Vertex *data = vertexData();
+        const uint32_t count = vertexCount();
+        if(count == 0) {
+            boundsMin = glm::vec3{0.f};
+            boundsMax = glm::vec3{0.f};
+            return;
+        }
+        boundsMin = data[0].position;
+        boundsMax = data[0].position;
+        for(uint32_t i = 1; i < count; i++) {
+            boundsMin = glm::min(boundsMin, data[i].position);
+            boundsMax = glm::max(boundsMax, data[i].position);
+        }
+    }
+
+    void K3Builder::encode(uint32_t formatFlags) {
+        KE_IN("({:#x})", formatFlags);
+        const K3Vertex *data = vertexData();
+        const uint32_t count = vertexCount();
+        encodedVertices.clear();
+        m_mappedEncodedVertices = nullptr;
+        if(count == 0) {
+            vertexFormat = K3VertexFormat{};
+            KE_OUT(KE_NOARG);
+            return;
+        }
+
+        // Half floats keep 11 significant bits, so uvs past [-2, 2] start to lose sub-texel precision.
+        const float HALF_UV_TOLERANCE = 1.f / 2048.f;
+        uniformColor = data[0].color;
+        for(uint32_t i = 0; i < count; i++) {
+            if((formatFlags & K3VertexFormat::UNIFORM_COLOR) && data[i].color != uniformColor) {
+                KE_DEBUG("Vertex colors differ, keeping the color attribute");
+                formatFlags &= ~K3VertexFormat::UNIFORM_COLOR;
+            }
+            if(formatFlags & K3VertexFormat::HALF_UV) {
+                const float errorU = std::abs(glm::unpackHalf1x16(glm::packHalf1x16(data[i].uv.x)) - data[i].uv.x);
+                const float errorV = std::abs(glm::unpackHalf1x16(glm::packHalf1x16(data[i].uv.y)) - data[i].uv.y);
+                if(errorU > HALF_UV_TOLERANCE || errorV > HALF_UV_TOLERANCE) {
+                    KE_DEBUG("UV ({}, {}) does not fit a half float, keeping float uvs", data[i].uv.x, data[i].uv.y);
+                    formatFlags &= ~K3VertexFormat::HALF_UV;
+                }
+            }
+        }
+
+        // One scale for all axes keeps the dequantize transform free of shear for the normals.
+        computeBounds();
+        dequantizeOffset = glm::vec3{0.f};
+        dequantizeScale = 1.f;
+        if(formatFlags & K3VertexFormat::QUANTIZED_POSITION) {
+            const glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+            dequantizeOffset = (boundsMin + boundsMax) * 0.5f;
+            dequantizeScale = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+            if(dequantizeScale <= 0.f) {
+                dequantizeScale = 1.f;
+            }
+        }
+
+        vertexFormat = K3VertexFormat{formatFlags};
+        const uint32_t stride = vertexFormat.getStride();
+        encodedVertices.resize(static_cast<size_t>(stride) * count);
+
+        float maxPositionError = 0.f;
+        float maxNormalAngle = 0.f;
+        float maxUvError = 0.f;
+        for(uint32_t i = 0; i < count; i++) {
+            K3Vertex vertex = data[i];
+            vertex.position = (vertex.position - dequantizeOffset) / dequantizeScale;
+            uint8_t *encoded = encodedVertices.data() + static_cast<size_t>(stride) * i;
+            vertexFormat.encode(vertex, encoded);
+
+            K3Vertex decoded = data[i];
+            vertexFormat.decode(encoded, decoded);
+            const glm::vec3 positionError = glm::abs(dequantizeOffset + decoded.position * dequantizeScale - data[i].position);
+            maxPositionError = std::max(maxPositionError, std::max(positionError.x, std::max(positionError.y, positionError.z)));
+            const float normalLength = glm::length(data[i].normal);
+            if(normalLength > 0.f) {
+                // atan2 rather than acos, which can't resolve angles this small in float.
+                const glm::vec3 original = data[i].normal / normalLength;
+                const float angle = std::atan2(glm::length(glm::cross(decoded.normal, original)), glm::dot(decoded.normal, original));
+                maxNormalAngle = std::max(maxNormalAngle, angle);
+            }
+            const glm::vec2 uvError = glm::abs(decoded.uv - data[i].uv);
+            maxUvError = std::max(maxUvError, std::max(uvError.x, uvError.y));
+        }
+
+        // Expected worst cases: half a snorm16 step per axis, under a hundredth of a degree for
+        // snorm16 octahedral normals, and the half float tolerance checked above.
+        const float positionBound = (formatFlags & K3VertexFormat::QUANTIZED_POSITION) ? dequantizeScale / 32767.f : 0.f;
+        const float normalErrorDegrees = glm::degrees(maxNormalAngle);
+        KE_DEBUG("Encoded {} vertices as {:#x}: {} -> {} bytes ({:.2f}x), max error position {} normal {:.4f} deg uv {}",
+            count, formatFlags, static_cast<size_t>(count) * sizeof(K3Vertex), encodedVertices.size(),
+            static_cast<float>(sizeof(K3Vertex)) / stride, maxPositionError, normalErrorDegrees, maxUvError);
+        if(maxPositionError > positionBound + 1e-6f * dequantizeScale || normalErrorDegrees > 0.02f || maxUvError > HALF_UV_TOLERANCE) {
+            KE_WARN("Vertex encoding {:#x} exceeded its round trip error bounds.", formatFlags);
+        }
+
+        KE_OUT("(): stride:{}", stride);
+    }
+
+    VkIndexType K3Builder::buildIndices(std::vector<uint16_t> &shortIndices, std::vector<K3SubMesh> &subMeshes) const {
+        KE_IN("({:#x})", indexFlags);
+        const uint32_t SHORT_INDEX_RANGE = 1u << 16;
+        const uint32_t *data = indexData();
+        const uint32_t count = indexCount();
+        shortIndices.clear();
+        subMeshes.clear();
+
+        if((indexFlags & SHORT_INDICES) && vertexCount() <= SHORT_INDEX_RANGE) {
+            subMeshes.push_back({0, count, 0});
+        } else if((indexFlags & SHORT_INDICES) && (indexFlags & SPLIT_SHORT_INDICES)) {
+            // Triangles are cut into runs in draw order. After OPTIMIZE_VERTEX_FETCH vertices are
+            // numbered by first use, so each run references a narrow window of the vertex buffer.
+            bool split = true;
+            uint32_t first = 0;
+            uint32_t low = 0;
+            uint32_t high = 0;
+            for(uint32_t i = 0; i + 3 <= count; i += 3) {
+                const uint32_t triangleLow = std::min(data[i], std::min(data[i + 1], data[i + 2]));
+                const uint32_t triangleHigh = std::max(data[i], std::max(data[i + 1], data[i + 2]));
+                if(triangleHigh - triangleLow >= SHORT_INDEX_RANGE) {
+                    split = false;
+                    break;
+                }
+                if(i == first) {
+                    low = triangleLow;
+                    high = triangleHigh;
+                } else if(std::max(high, triangleHigh) - std::min(low, triangleLow) >= SHORT_INDEX_RANGE) {
+                    subMeshes.push_back({first, i - first, static_cast<int32_t>(low)});
+                    first = i;
+                    low = triangleLow;
+                    high = triangleHigh;
+                } else {
+                    low = std::min(low, triangleLow);
+                    high = std::max(high, triangleHigh);
+                }
+            }
+            if(split && first < count) {
+                subMeshes.push_back({first, count - first, static_cast<int32_t>(low)});
+            }
+
+            // Every sub mesh is another draw, so a badly ordered mesh stays on 32-bit indices.
+            const size_t maxSubMeshes = 2 * (vertexCount() / SHORT_INDEX_RANGE + 1);
+            if(!split || subMeshes.size() > maxSubMeshes) {
+                KE_DEBUG("Vertex references too scattered for 16-bit sub meshes, keeping 32-bit indices");
+                subMeshes.clear();
+            }
+        }
+
+        if(subMeshes.empty()) {
+            subMeshes.push_back({0, count, 0});
+            KE_OUT("(): 32-bit");
+            return VK_INDEX_TYPE_UINT32;
+        }
+
+        shortIndices.resize(count);
+        for(const auto &subMesh : subMeshes) {
+            const uint32_t base = static_cast<uint32_t>(subMesh.vertexOffset);
+            for(uint32_t i = subMesh.firstIndex; i < subMesh.firstIndex + subMesh.indexCount; i++) {
+                shortIndices[i] = static_cast<uint16_t>(data[i] - base);
+            }
+        }
+        KE_OUT("(): 16-bit subMeshes:{}", subMeshes.size());
+        return VK_INDEX_TYPE_UINT16;
+    }
+
+    VkIndexType K3Builder::getUploadIndices(std::vector<uint16_t> &shortIndices, std::vector<K3SubMesh> &subMeshes, const void *&data) const {
+        if(m_mappedFile != nullptr && m_mappedSubMeshCount > 0) {
+            subMeshes.assign(m_mappedSubMeshes, m_mappedSubMeshes + m_mappedSubMeshCount);
+            data = m_mappedIndexType == VK_INDEX_TYPE_UINT16 ? static_cast<const void *>(m_mappedShortIndices) : indexData();
+            return m_mappedIndexType;
+        }
+        const VkIndexType indexType = buildIndices(shortIndices, subMeshes);
+        data = indexType == VK_INDEX_TYPE_UINT16 ? static_cast<const void *>(shortIndices.data()) : indexData();
+        return indexType;
+    }
+
+    const uint8_t *K3Builder::encodedVertexData() const {
+        return m_mappedEncodedVertices != nullptr ? m_mappedEncodedVertices : encodedVertices.data();
+    }
+
+    const K3Vertex *K3Builder::vertexData() const {
+        return m_mappedFile != nullptr ? m_mappedVertices : vertices.data();
+    }
+
+    uint32_t K3Builder::vertexCount() const {
+        return m_mappedFile != nullptr ? m_mappedVertexCount : static_cast<uint32_t>(vertices.size());
+    }
+
+    const uint32_t *K3Builder::indexData() const {
+        return m_mappedFile != nullptr ? m_mappedIndices : indices.data();
+    }
+
+    uint32_t K3Builder::indexCount() const {
+        return m_mappedFile != nullptr ? m_mappedIndexCount : static_cast<uint32_t>(indices.size());
+    }
+
+    size_t K3Builder::getMemoryUsage() const {
+        size_t bytes = vertices.capacity() * sizeof(K3Vertex) + indices.capacity() * sizeof(uint32_t)
+            + lods.capacity() * sizeof(K3MeshLod) + meshlets.capacity() * sizeof(K3Meshlet)
+            + meshletVertices.capacity() * sizeof(uint32_t) + meshletTriangles.capacity()
+            + meshletBounds.capacity() * sizeof(K3MeshletBounds) + encodedVertices.capacity();
+        if(m_mappedFile != nullptr) {
+            bytes += m_mappedFile->size();
+        }
+        return bytes;
+    }
+
+    void K3Builder::parseObj(const std::string &filePath) {
+        KE_IN("({})", filePath);
+        K3ObjData data{};
+        if(!K3ObjParser::parse(filePath, data)) {
+            KE_DEBUG("Falling back to tinyobj for \"{}\"", filePath);
+            loadObjWithTinyObj(filePath, data);
+        }
+
+        m_mappedFile = nullptr;
+        m_mappedVertices = nullptr;
+        m_mappedVertexCount = 0;
+        m_mappedIndices = nullptr;
+        m_mappedIndexCount = 0;
+        m_mappedEncodedVertices = nullptr;
+        m_mappedShortIndices = nullptr;
+        m_mappedSubMeshes = nullptr;
+        m_mappedSubMeshCount = 0;
+        vertices.clear();
+        indices.clear();
+        lods.clear();
+        meshlets.clear();
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        meshletBounds.clear();
+        encodedVertices.clear();
+
+        const size_t cornerCount = data.corners.size();
+        if(cornerCount >= K3VertexTable::SORTED_DEDUP_THRESHOLD) {
+            K3ThreadPool &pool = K3ThreadPool::shared();
+            std::vector<K3Vertex> corners(cornerCount);
+            pool.parallelFor(pool.getThreadCount(), [&](uint32_t part) {
+                const size_t begin = cornerCount * part / pool.getThreadCount();
+                const size_t end = cornerCount * (part + 1) / pool.getThreadCount();
+                for(size_t i = begin; i < end; i++) {
+                    corners[i] = assembleVertex(data, data.corners[i]);
+                }
+            });
+            K3VertexTable::deduplicateSorted(corners, vertices, indices, pool);
+        } else {
+            K3VertexTable uniqueVertices{cornerCount};
+            indices.reserve(cornerCount);
+
+            for(const auto &corner : data.corners) {
+                K3Vertex vertex = assembleVertex(data, corner);
+
+                const uint32_t candidate = static_cast<uint32_t>(vertices.size());
+                const uint32_t index = uniqueVertices.findOrInsert(vertex, candidate, vertices.data());
+                if(index == candidate) {
+                    vertices.push_back(vertex);
+                }
+
+                indices.push_back(index);
+            }
+        }
+        KE_OUT("(): vertices:{} indices:{}", vertices.size(), indices.size());
+    }
+
+    void K3Builder::loadObjWithTinyObj(const std::string &filePath, K3ObjData &data) {
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
@@ -53,56 +343,55 @@ namespace k3::graphics {
             KE_CRITICAL("{} {}", warn, err);
         }
 
-        vertices.clear();
-        indices.clear();
-
-        std::unordered_map<K3Vertex, uint32_t> uniqueVertices {};
-
+        data.positions = std::move(attrib.vertices);
+        data.colors = std::move(attrib.colors);
+        data.normals = std::move(attrib.normals);
+        data.texcoords = std::move(attrib.texcoords);
+        data.corners.clear();
         for(const auto &shape : shapes) {
             for(const auto &index : shape.mesh.indices) {
-                K3Vertex vertex{};
-
-                if(index.vertex_index >= 0) {
-                    vertex.position = {
-                        attrib.vertices[3 * index.vertex_index + 0],
-                        attrib.vertices[3 * index.vertex_index + 1],
-                        attrib.vertices[3 * index.vertex_index + 2],
-                    };
-
-                    auto colorIndex = 3 * index.vertex_index + 2;
-                    if(colorIndex < attrib.colors.size()) {
-                        vertex.color = {
-                            attrib.colors[colorIndex - 2],
-                            attrib.colors[colorIndex - 1],
-                            attrib.colors[colorIndex - 0],
-                        };
-                    } else {
-                        vertex.color = {1.f, 1.f, 1.f};
-                    }
-                }
-
-                if(index.normal_index >= 0) {
-                    vertex.normal = {
-                        attrib.normals[3 * index.normal_index + 0],
-                        attrib.normals[3 * index.normal_index + 1],
-                        attrib.normals[3 * index.normal_index + 2],
-                    };
-                }
+                data.corners.push_back({index.vertex_index, index.texcoord_index, index.normal_index});
+            }
+        }
+    }
 
-                if(index.texcoord_index >= 0) {
-                    vertex.uv = {
-                        attrib.texcoords[2 * index.texcoord_index + 0],
-                        attrib.texcoords[2 * index.texcoord_index + 1],
-                    };
-                }
+    K3Vertex K3Builder::assembleVertex(const K3ObjData &data, const K3ObjCorner &corner) {
+        K3Vertex vertex{};
 
-                if(uniqueVertices.count(vertex) == 0) {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                    vertices.push_back(vertex);
-                } 
+        if(corner.position >= 0) {
+            vertex.position = {
+                data.positions[3 * corner.position + 0],
+                data.positions[3 * corner.position + 1],
+                data.positions[3 * corner.position + 2],
+            };
 
-                indices.push_back(uniqueVertices[vertex]);
+            auto colorIndex = 3 * static_cast<size_t>(corner.position) + 2;
+            if(colorIndex < data.colors.size()) {
+                vertex.color = {
+                    data.colors[colorIndex - 2],
+                    data.colors[colorIndex - 1],
+                    data.colors[colorIndex - 0],
+                };
+            } else {
+                vertex.color = {1.f, 1.f, 1.f};
             }
         }
+
+        if(corner.normal >= 0) {
+            vertex.normal = {
+                data.normals[3 * corner.normal + 0],
+                data.normals[3 * corner.normal + 1],
+                data.normals[3 * corner.normal + 2],
+            };
+        }
+
+        if(corner.texcoord >= 0) {
+            vertex.uv = {
+                data.texcoords[2 * corner.texcoord + 0],
+                data.texcoords[2 * corner.texcoord + 1],
+            };
+        }
+
+        return vertex;
     }
 }
\ No newline at end of file
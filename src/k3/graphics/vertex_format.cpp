@@ -0,0 +1,190 @@
+#include "k3/graphics/vertex_format.hpp"
+#include "k3/graphics/vertex.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace k3::graphics {
+
+    namespace {
+
+        inline int16_t toSnorm16(float value) {
+            return static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * 32767.f));
+        }
+
+        inline float fromSnorm16(int16_t value) {
+            return std::max(static_cast<float>(value) / 32767.f, -1.f);
+        }
+
+        inline float signNotZero(float value) {
+            return value >= 0.f ? 1.f : -1.f;
+        }
+
+        template <typename T>
+        inline void store(uint8_t *dst, const T &value) {
+            std::memcpy(dst, &value, sizeof(T));
+        }
+
+        template <typename T>
+        inline T load(const uint8_t *src) {
+            T value;
+            std::memcpy(&value, src, sizeof(T));
+            return value;
+        }
+
+    }
+
+    K3VertexFormat::K3VertexFormat(uint32_t flags) : m_flags {flags} {
+        uint32_t offset = 0;
+        m_positionOffset = offset;
+        offset += has(QUANTIZED_POSITION) ? 4 * sizeof(int16_t) : 3 * sizeof(float);
+        m_colorOffset = offset;
+        offset += has(UNIFORM_COLOR) ? 0 : 3 * sizeof(float);
+        m_normalOffset = offset;
+        offset += has(OCTAHEDRAL_NORMAL) ? 2 * sizeof(int16_t) : 3 * sizeof(float);
+        m_uvOffset = offset;
+        offset += has(HALF_UV) ? 2 * sizeof(uint16_t) : 2 * sizeof(float);
+        m_stride = offset;
+    }
+
+    std::vector<VkVertexInputBindingDescription> K3VertexFormat::getBindingDescriptions() const {
+        KE_IN("({:#x})", m_flags);
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = m_stride;
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        KE_OUT(KE_NOARG);
+        return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> K3VertexFormat::getAttributeDescriptions() const {
+        KE_IN("({:#x})", m_flags);
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+        attributeDescriptions.push_back({0, 0, has(QUANTIZED_POSITION) ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT, m_positionOffset});
+        if(!has(UNIFORM_COLOR)) {
+            attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, m_colorOffset});
+        }
+        attributeDescriptions.push_back({2, 0, has(OCTAHEDRAL_NORMAL) ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT, m_normalOffset});
+        attributeDescriptions.push_back({3, 0, has(HALF_UV) ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT, m_uvOffset});
+        KE_OUT(KE_NOARG);
+        return attributeDescriptions;
+    }
+
+    std::string K3VertexFormat::getVertexShaderPath(bool pushConstants) const {
+        std::string path = "./shaders/simple_shader";
+        if(has(OCTAHEDRAL_NORMAL)) {
+            path += "_oct";
+        }
+        if(has(UNIFORM_COLOR)) {
+            path += "_uniform";
+        }
+        if(pushConstants) {
+            path += "_push";
+        }
+        return path + ".vert.spv";
+    }
+
+    glm::vec2 K3VertexFormat::encodeOctahedral(const glm::vec3 &normal) {
+        const float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if(l1 == 0.f) {
+            return glm::vec2{0.f};
+        }
+        glm::vec2 encoded{normal.x / l1, normal.y / l1};
+        if(normal.z < 0.f) {
+            encoded = glm::vec2{
+                (1.f - std::abs(encoded.y)) * signNotZero(encoded.x),
+                (1.f - std::abs(encoded.x)) * signNotZero(encoded.y),
+            };
+        }
+        return encoded;
+    }
+
+    glm::vec3 K3VertexFormat::decodeOctahedral(const glm::vec2 &encoded) {
+        glm::vec3 normal{encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y)};
+        if(normal.z < 0.f) {
+            normal.x = (1.f - std::abs(encoded.y)) * signNotZero(encoded.x);
+            normal.y = (1.f - std::abs(encoded.x)) * signNotZero(encoded.y);
+        }
+        return glm::normalize(normal);
+    }
+
+    void K3VertexFormat::encode(const K3Vertex &vertex, uint8_t *dst) const {
+        if(has(QUANTIZED_POSITION)) {
+            const int16_t position[4] = {toSnorm16(vertex.position.x), toSnorm16(vertex.position.y), toSnorm16(vertex.position.z), 0};
+            store(dst + m_positionOffset, position);
+        } else {
+            store(dst + m_positionOffset, vertex.position);
+        }
+
+        if(!has(UNIFORM_COLOR)) {
+            store(dst + m_colorOffset, vertex.color);
+        }
+
+        if(has(OCTAHEDRAL_NORMAL)) {
+            // Rounding each component on its own is not always closest, so try the four
+            // neighbouring codes and keep the one that decodes nearest the input.
+            const glm::vec2 encoded = encodeOctahedral(vertex.normal);
+            const float length = glm::length(vertex.normal);
+            int16_t best[2] = {toSnorm16(encoded.x), toSnorm16(encoded.y)};
+            if(length > 0.f) {
+                const glm::vec3 target = vertex.normal / length;
+                float bestDot = -2.f;
+                const float fx = std::floor(std::clamp(encoded.x, -1.f, 1.f) * 32767.f);
+                const float fy = std::floor(std::clamp(encoded.y, -1.f, 1.f) * 32767.f);
+                for(int i = 0; i < 4; i++) {
+                    const float qx = std::clamp(fx + (i & 1), -32767.f, 32767.f);
+                    const float qy = std::clamp(fy + (i >> 1), -32767.f, 32767.f);
+                    const float d = glm::dot(decodeOctahedral(glm::vec2{qx / 32767.f, qy / 32767.f}), target);
+                    if(d > bestDot) {
+                        bestDot = d;
+                        best[0] = static_cast<int16_t>(qx);
+                        best[1] = static_cast<int16_t>(qy);
+                    }
+                }
+            }
+            store(dst + m_normalOffset, best);
+        } else {
+            store(dst + m_normalOffset, vertex.normal);
+        }
+
+        if(has(HALF_UV)) {
+            const uint16_t uv[2] = {glm::packHalf1x16(vertex.uv.x), glm::packHalf1x16(vertex.uv.y)};
+            store(dst + m_uvOffset, uv);
+        } else {
+            store(dst + m_uvOffset, vertex.uv);
+        }
+    }
+
+    void K3VertexFormat::decode(const uint8_t *src, K3Vertex &vertex) const {
+        if(has(QUANTIZED_POSITION)) {
+            const auto position = load<std::array<int16_t, 4>>(src + m_positionOffset);
+            vertex.position = glm::vec3{fromSnorm16(position[0]), fromSnorm16(position[1]), fromSnorm16(position[2])};
+        } else {
+            vertex.position = load<glm::vec3>(src + m_positionOffset);
+        }
+
+        if(!has(UNIFORM_COLOR)) {
+            vertex.color = load<glm::vec3>(src + m_colorOffset);
+        }
+
+        if(has(OCTAHEDRAL_NORMAL)) {
+            const auto normal = load<std::array<int16_t, 2>>(src + m_normalOffset);
+            vertex.normal = decodeOctahedral(glm::vec2{fromSnorm16(normal[0]), fromSnorm16(normal[1])});
+        } else {
+            vertex.normal = load<glm::vec3>(src + m_normalOffset);
+        }
+
+        if(has(HALF_UV)) {
+            const auto uv = load<std::array<uint16_t, 2>>(src + m_uvOffset);
+            vertex.uv = glm::vec2{glm::unpackHalf1x16(uv[0]), glm::unpackHalf1x16(uv[1])};
+        } else {
+            vertex.uv = load<glm::vec2>(src + m_uvOffset);
+        }
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "k3/graphics/vertex_table.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE4_2__)
+#   include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#   include <arm_acle.h>
+#endif
+
+namespace k3::graphics {
+
+    namespace {
+
+        constexpr size_t VERTEX_WORDS = sizeof(K3Vertex) / sizeof(uint32_t);
+
+        static_assert(sizeof(K3Vertex) == VERTEX_WORDS * sizeof(uint32_t), "K3Vertex must be a whole number of 32 bit words");
+
+        // Copies the vertex bits with -0.0 folded onto 0.0 so equal vertices have equal bits.
+        inline void canonicalWords(const K3Vertex &vertex, uint32_t (&words)[VERTEX_WORDS + 1]) {
+            std::memcpy(words, &vertex, sizeof(K3Vertex));
+            for(size_t i = 0; i < VERTEX_WORDS; i++) {
+                if((words[i] & 0x7fffffffu) == 0) {
+                    words[i] = 0;
+                }
+            }
+            words[VERTEX_WORDS] = 0;
+        }
+
+        inline int compareCanonical(const K3Vertex &a, const K3Vertex &b) {
+            uint32_t wordsA[VERTEX_WORDS + 1];
+            uint32_t wordsB[VERTEX_WORDS + 1];
+            canonicalWords(a, wordsA);
+            canonicalWords(b, wordsB);
+            return std::memcmp(wordsA, wordsB, sizeof(K3Vertex));
+        }
+
+        struct SortKey {
+            uint32_t hash;
+            uint32_t corner;
+        };
+
+        struct Range {
+            size_t begin;
+            size_t end;
+        };
+
+        std::vector<Range> splitRanges(size_t count, size_t parts) {
+            parts = std::max<size_t>(1, std::min(parts, count));
+            std::vector<Range> ranges(parts);
+            for(size_t i = 0; i < parts; i++) {
+                ranges[i] = {count * i / parts, count * (i + 1) / parts};
+            }
+            return ranges;
+        }
+
+    }
+
+    K3VertexTable::K3VertexTable(size_t maxVertexCount) {
+        size_t capacity = 16;
+        while(capacity < maxVertexCount * 2) {
+            capacity <<= 1;
+        }
+        m_slots.assign(capacity, EMPTY_SLOT);
+        m_mask = capacity - 1;
+    }
+
+    uint32_t K3VertexTable::hash(const K3Vertex &vertex) {
+        uint32_t words[VERTEX_WORDS + 1];
+        canonicalWords(vertex, words);
+        uint64_t pairs[(VERTEX_WORDS + 1) / 2];
+        std::memcpy(pairs, words, sizeof(pairs));
+
+#if defined(__SSE4_2__)
+        uint64_t crc = 0;
+        for(uint64_t pair : pairs) {
+            crc = _mm_crc32_u64(crc, pair);
+        }
+        return static_cast<uint32_t>((crc * 0x9e3779b97f4a7c15ull) >> 32);
+#elif defined(__ARM_FEATURE_CRC32)
+        uint32_t crc = 0;
+        for(uint64_t pair : pairs) {
+            crc = __crc32cd(crc, pair);
+        }
+        return static_cast<uint32_t>((crc * 0x9e3779b97f4a7c15ull) >> 32);
+#else
+        uint64_t h = 0x9e3779b97f4a7c15ull;
+        for(uint64_t pair : pairs) {
+            h = (h ^ pair) * 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 31;
+        }
+        h *= 0x94d049bb133111ebull;
+        return static_cast<uint32_t>(h >> 32);
+#endif
+    }
+
+    uint32_t K3VertexTable::findOrInsert(const K3Vertex &vertex, uint32_t candidate, const K3Vertex *vertices) {
+        const uint32_t vertexHash = hash(vertex);
+        size_t slot = vertexHash & m_mask;
+        while(true) {
+            const uint64_t entry = m_slots[slot];
+            if(entry == EMPTY_SLOT) {
+                assert(m_size * 2 <= m_mask && "K3VertexTable sized too small");
+                m_slots[slot] = (static_cast<uint64_t>(vertexHash) << 32) | candidate;
+                m_size++;
+                return candidate;
+            }
+            if(static_cast<uint32_t>(entry >> 32) == vertexHash && vertices[static_cast<uint32_t>(entry)] == vertex) {
+                return static_cast<uint32_t>(entry);
+            }
+            slot = (slot + 1) & m_mask;
+        }
+    }
+
+    void K3VertexTable::deduplicateSorted(const std::vector<K3Vertex> &corners, std::vector<K3Vertex> &vertices, std::vector<uint32_t> &indices, K3ThreadPool &pool) {
+        KE_IN("(corners:{})", corners.size());
+        const size_t count = corners.size();
+        vertices.clear();
+        indices.clear();
+        if(count == 0) {
+            KE_OUT(KE_NOARG);
+            return;
+        }
+        const std::vector<Range> ranges = splitRanges(count, pool.getThreadCount() * 2);
+        const uint32_t rangeCount = static_cast<uint32_t>(ranges.size());
+
+        auto less = [&corners](const SortKey &a, const SortKey &b) {
+            if(a.hash != b.hash) {
+                return a.hash < b.hash;
+            }
+            const int order = compareCanonical(corners[a.corner], corners[b.corner]);
+            if(order != 0) {
+                return order < 0;
+            }
+            return a.corner < b.corner;
+        };
+        auto sameVertex = [&corners](const SortKey &a, const SortKey &b) {
+            return a.hash == b.hash && corners[a.corner] == corners[b.corner];
+        };
+
+        // Hash and sort each range, then merge sorted runs pairwise until one remains.
+        std::vector<SortKey> keys(count);
+        pool.parallelFor(rangeCount, [&](uint32_t r) {
+            for(size_t i = ranges[r].begin; i < ranges[r].end; i++) {
+                keys[i] = {hash(corners[i]), static_cast<uint32_t>(i)};
+            }
+            std::sort(keys.begin() + ranges[r].begin, keys.begin() + ranges[r].end, less);
+        });
+
+        std::vector<SortKey> scratch(count);
+        std::vector<Range> runs = ranges;
+        while(runs.size() > 1) {
+            std::vector<Range> merged((runs.size() + 1) / 2);
+            pool.parallelFor(static_cast<uint32_t>(merged.size()), [&](uint32_t m) {
+                const Range &left = runs[2 * m];
+                if(2 * m + 1 < runs.size()) {
+                    const Range &right = runs[2 * m + 1];
+                    std::merge(keys.begin() + left.begin, keys.begin() + left.end, keys.begin() + right.begin, keys.begin() + right.end, scratch.begin() + left.begin, less);
+                    merged[m] = {left.begin, right.end};
+                } else {
+                    std::copy(keys.begin() + left.begin, keys.begin() + left.end, scratch.begin() + left.begin);
+                    merged[m] = left;
+                }
+            });
+            keys.swap(scratch);
+            runs.swap(merged);
+        }
+
+        // Equal vertices are now adjacent with the lowest corner first. Point every corner at
+        // that first corner, starting each range on a run boundary.
+        std::vector<uint32_t> representative(count);
+        pool.parallelFor(rangeCount, [&](uint32_t r) {
+            size_t i = ranges[r].begin;
+            while(i > 0 && i < ranges[r].end && sameVertex(keys[i - 1], keys[i])) {
+                i++;
+            }
+            if(i >= ranges[r].end) {
+                return;
+            }
+            uint32_t first = 0;
+            for(; i < count; i++) {
+                if(i == 0 || !sameVertex(keys[i - 1], keys[i])) {
+                    if(i >= ranges[r].end) {
+                        break;
+                    }
+                    first = keys[i].corner;
+                }
+                representative[keys[i].corner] = first;
+            }
+        });
+
+        // Number the first corners in corner order, which is the order the table would insert them.
+        std::vector<uint32_t> rangeFirsts(rangeCount + 1, 0);
+        pool.parallelFor(rangeCount, [&](uint32_t r) {
+            uint32_t firsts = 0;
+            for(size_t i = ranges[r].begin; i < ranges[r].end; i++) {
+                firsts += representative[i] == i ? 1 : 0;
+            }
+            rangeFirsts[r + 1] = firsts;
+        });
+        for(uint32_t r = 0; r < rangeCount; r++) {
+            rangeFirsts[r + 1] += rangeFirsts[r];
+        }
+
+        std::vector<uint32_t> remap(count);
+        vertices.resize(rangeFirsts.back());
+        pool.parallelFor(rangeCount, [&](uint32_t r) {
+            uint32_t next = rangeFirsts[r];
+            for(size_t i = ranges[r].begin; i < ranges[r].end; i++) {
+                if(representative[i] == i) {
+                    remap[i] = next;
+                    vertices[next] = corners[i];
+                    next++;
+                }
+            }
+        });
+
+        indices.resize(count);
+        pool.parallelFor(rangeCount, [&](uint32_t r) {
+            for(size_t i = ranges[r].begin; i < ranges[r].end; i++) {
+                indices[i] = remap[representative[i]];
+            }
+        });
+
+        KE_OUT("(): vertices:{}", vertices.size());
+    }
+
+}
\ No newline at end of file
@@ -31,9 +31,9 @@ namespace k3::graphics {
         KE_OUT(KE_NOARG);
     }
 
-    void K3Window::createWindowSurface(VkInstance instance, VkSurfaceKHR *surface) {
+    void K3Window::createWindowSurface(VkInstance instance, VkSurfaceKHR *surface, const VkAllocationCallbacks *allocator) {
         KE_IN(KE_NOARG);
-        if(glfwCreateWindowSurface(instance, m_glfw_window, nullptr, surface) != VK_SUCCESS) {
+        if(glfwCreateWindowSurface(instance, m_glfw_window, allocator, surface) != VK_SUCCESS) {
             KE_CRITICAL("Failed to Create Window Surface");
             throw std::runtime_error("Failed to Create Window Surface");
         }
@@ -9,6 +9,8 @@
 #include "k3/graphics/camera.hpp"
 #include "k3/graphics/frame_info.hpp"
 #include "k3/graphics/game_object.hpp"
+#include "k3/graphics/model_loader.hpp"
+#include "k3/graphics/asset_cache.hpp"
 
 #include "k3/controller/movement_controller.hpp"
 #include "k3/controller/window_behavior_controller.hpp"
@@ -18,6 +20,8 @@
 #include <array>
 #include <chrono>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -34,20 +38,20 @@ std::shared_ptr<k3::graphics::K3Window> m_window = nullptr;
 
 std::shared_ptr<k3::graphics::K3Graphics> m_graphics = nullptr;
 
-std::vector<k3::graphics::K3GameObject> m_gameObjects;
+std::shared_ptr<k3::graphics::K3ModelLoader> m_modelLoader = nullptr;
+
+std::shared_ptr<k3::graphics::K3AssetCache> m_assetCache = nullptr;
 
+std::vector<k3::graphics::K3GameObject> m_gameObjects;
 
-struct GlobalUbo {
-    glm::mat4 projectionView {1.f};
-    glm::vec3 lightDirection = glm::normalize(glm::vec3{1.f,-3.f,-1.f});
-};
 
 void loadGameObjects() {
     KE_IN(KE_NOARG);
 
     glm::vec3 offset{};
 
-    std::shared_ptr<k3::graphics::K3Model> model = k3::graphics::K3Model::createModelFromFile(m_graphics->getDevice(), "models/tea.obj");
+    // Drawn from the first frame its buffers are ready.
+    k3::graphics::K3ModelHandle model = m_assetCache->loadModel("models/tea.obj");
 
     k3::graphics::K3GameObject gameObject = k3::graphics::K3GameObject::createGameObject("teapot");
     gameObject.model = model;
@@ -59,7 +63,23 @@ void loadGameObjects() {
     KE_OUT(KE_NOARG);
 }
 
-void init() {
+// --geometry=staged|direct forces a geometry placement, so both upload paths can be run on one device.
+std::optional<k3::graphics::K3GeometryPlacement> parseGeometryPlacement(int argc, char *argv[]) {
+    std::optional<k3::graphics::K3GeometryPlacement> placement = std::nullopt;
+    for(int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if(arg == "--geometry=staged") {
+            placement = k3::graphics::K3GeometryPlacement::STAGED;
+        } else if(arg == "--geometry=direct") {
+            placement = k3::graphics::K3GeometryPlacement::DIRECT;
+        } else {
+            KE_WARN("Ignoring unknown argument \"{}\".", arg);
+        }
+    }
+    return placement;
+}
+
+void init(int argc, char *argv[]) {
     k3::logging::LogManger::getInstance().initialise();
 
     const uint32_t WIDTH = 800;
@@ -67,7 +87,10 @@ void init() {
     const std::string WINDOW_NAME = "K3 Activated!";
     m_window = std::make_shared<k3::graphics::K3Window>(WIDTH, HEIGHT, WINDOW_NAME);
 
-    m_graphics = std::make_shared<k3::graphics::K3Graphics>(m_logManger, m_window);
+    m_graphics = std::make_shared<k3::graphics::K3Graphics>(m_logManger, m_window, parseGeometryPlacement(argc, argv));
+
+    m_modelLoader = std::make_shared<k3::graphics::K3ModelLoader>(m_graphics->getDevice());
+    m_assetCache = std::make_shared<k3::graphics::K3AssetCache>(m_modelLoader);
 
     loadGameObjects();
 }
@@ -75,6 +98,15 @@ void init() {
 void shutdown() {
     KE_INFO("Kinetic Shutting Down.");
 
+    if(m_assetCache != nullptr) {
+        m_assetCache = nullptr;
+    }
+
+    // Finishes any uploads still in flight before the device goes away.
+    if(m_modelLoader != nullptr) {
+        m_modelLoader = nullptr;
+    }
+
     if(!m_gameObjects.empty()) {
         m_gameObjects.clear();
     }
@@ -109,16 +141,6 @@ void run() {
     auto renderer = m_graphics->getRenderer();
     auto renderSystem = m_graphics->getRenderSystem();
 
-    k3::graphics::K3Buffer globalUboBuffer {
-        m_graphics->getDevice(),
-        sizeof(GlobalUbo),
-        k3::graphics::K3SwapChain::MAX_FRAMES_IN_FLIGHT,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-        device->m_vk_properties.limits.minUniformBufferOffsetAlignment
-    };
-    globalUboBuffer.map();
-
     k3::graphics::K3Camera camera{};
     camera.setViewTarget(glm::vec3(-20.f,-2.0f, 2.0f), glm::vec3(0.0f, 0.f, 1.5f));
 
@@ -194,21 +216,50 @@ void run() {
                 frameTime,
                 commandBuffer,
                 camera,
+                renderer->getSwapChainExtent(),
+                renderer->getFrameAllocator(),
+                renderer->getPreviousDepthImage(),
+                renderer->getPreviousDepthImageView(),
             };
 
-            // Update
-            GlobalUbo ubo{};
-            ubo.projectionView = camera.getProjection() * camera.getView();
-            globalUboBuffer.writeToBuffer(&ubo, frameIndex);
-            globalUboBuffer.flushIndex(frameIndex);
-
             // Render
+            renderSystem->prepareGameObjects(frameInfo, m_gameObjects);
             renderer->beginSwapChainRenderPass(commandBuffer);
-            renderSystem->renderGameObjects(frameInfo, m_gameObjects);
+            renderSystem->renderGameObjects(frameInfo);
             m_graphics->beginGUIFrameRender(commandBuffer, frameTime);
 
             ImGuiIO& io = ImGui::GetIO(); (void)io;
             ImGui::Text("Average Render %.2f ms (%d fps)", avgRenderTime, fps);
+            ImGui::Text("%u draws for %u instances, recorded in %.3f ms (sorted in %.3f ms)", renderSystem->getDrawCount(), renderSystem->getInstanceCount(),
+                renderSystem->getRecordTime(), renderSystem->getSortTime());
+            bool indirectDraws = renderSystem->isIndirect();
+            if(ImGui::Checkbox("Indirect draws", &indirectDraws)) {
+                renderSystem->setIndirect(indirectDraws);
+            }
+            ImGui::SameLine();
+            bool perObjectDraws = renderSystem->isPerObject();
+            if(ImGui::Checkbox("Per object draws (baseline)", &perObjectDraws)) {
+                renderSystem->setPerObject(perObjectDraws);
+            }
+            bool frustumCulling = renderSystem->isFrustumCulling();
+            if(ImGui::Checkbox("CPU frustum culling", &frustumCulling)) {
+                renderSystem->setFrustumCulling(frustumCulling);
+            }
+            ImGui::SameLine();
+            ImGui::Text("visible %u, culled %u", renderSystem->getFrustumVisibleCount(), renderSystem->getFrustumCulledCount());
+            if(k3::graphics::K3Culler *culler = renderSystem->getCuller()) {
+                bool culling = renderSystem->isCulling();
+                if(ImGui::Checkbox("GPU culling", &culling)) {
+                    renderSystem->setCulling(culling);
+                }
+                ImGui::SameLine();
+                bool occlusion = culler->isOcclusion();
+                if(ImGui::Checkbox("Occlusion", &occlusion)) {
+                    culler->setOcclusion(occlusion);
+                }
+                const k3::graphics::K3CullStatistics &cullStatistics = culler->getStatistics();
+                ImGui::Text("Visible %u, frustum culled %u, occlusion culled %u", cullStatistics.visible, cullStatistics.frustumCulled, cullStatistics.occlusionCulled);
+            }
             ImGui::PlotLines("Times", frameTimeStore, IM_ARRAYSIZE(frameTimeStore), ((currentFrameTime+1>=FRAME_TIME_SIZE) ? 0 : currentFrameTime+1));
             ImGui::Separator();
             ImGui::TextColored(ImVec4(0,0.6,0.8,1), "Mouse Settings");
@@ -217,20 +268,66 @@ void run() {
             ImGui::Separator();
             ImGui::TextColored(ImVec4(0,0.6,0.8,1), "Control Settings");
             ImGui::SliderFloat("Walk Speed", &cameraController.moveSpeed, 1.f, 20.0f, "%.4f");
+            ImGui::Separator();
+            ImGui::TextColored(ImVec4(0,0.6,0.8,1), "Assets");
+            k3::graphics::K3AssetCacheStatistics assetStatistics = m_assetCache->getStatistics();
+            ImGui::Text("Models %u (%u loading, %u in use)", assetStatistics.assetCount, assetStatistics.loadingCount, assetStatistics.referencedCount);
+            ImGui::Text("GPU %.2f MB, CPU %.2f MB of %.0f MB", assetStatistics.deviceBytes / 1048576.0, assetStatistics.hostBytes / 1048576.0, assetStatistics.budgetBytes / 1048576.0);
+            ImGui::ProgressBar(assetStatistics.budgetBytes > 0 ? static_cast<float>(assetStatistics.deviceBytes + assetStatistics.hostBytes) / assetStatistics.budgetBytes : 0.f);
+            ImGui::Text("Hits %llu, misses %llu, evictions %llu", (unsigned long long) assetStatistics.hits, (unsigned long long) assetStatistics.misses, (unsigned long long) assetStatistics.evictions);
+            ImGui::Separator();
+            ImGui::TextColored(ImVec4(0,0.6,0.8,1), "Device Memory");
+            k3::graphics::K3MemoryStatistics memoryStatistics = device->getAllocator().getStatistics();
+            ImGui::Text("Blocks %u (%.1f MB), dedicated %u (%.1f MB)", memoryStatistics.blockCount, memoryStatistics.blockBytes / 1048576.0, memoryStatistics.dedicatedCount, memoryStatistics.dedicatedBytes / 1048576.0);
+            ImGui::Text("Allocations %u, used %.2f MB, fragmentation %.0f%%", memoryStatistics.allocationCount, memoryStatistics.usedBytes / 1048576.0, memoryStatistics.fragmentation * 100.f);
+            for(uint32_t i = 0; i < device->getHeapBudgets().size(); i++) {
+                const k3::graphics::K3HeapBudget &heap = device->getHeapBudgets()[i];
+                ImGui::Text("Heap %u%s %.0f MB of %.0f MB budget (ours %.0f MB)", i, heap.deviceLocal ? " (device)" : "", heap.usage / 1048576.0, heap.budget / 1048576.0, heap.engineBytes / 1048576.0);
+                ImGui::ProgressBar(heap.budget > 0 ? static_cast<float>(static_cast<double>(heap.usage) / heap.budget) : 0.f);
+            }
+            if(!device->hasMemoryBudgetExtension()) {
+                ImGui::TextDisabled("No VK_EXT_memory_budget, usage is ours only.");
+            }
+            for(uint32_t i = 0; i < static_cast<uint32_t>(k3::graphics::K3MemoryCategory::COUNT); i++) {
+                const auto category = static_cast<k3::graphics::K3MemoryCategory>(i);
+                ImGui::Text("%s %.2f MB", k3::graphics::K3MemoryAllocator::getCategoryName(category), device->getAllocator().getCategoryBytes(category) / 1048576.0);
+            }
+            const k3::graphics::K3HostAllocationStatistics hostStatistics = device->getHostAllocator().getStatistics();
+            uint64_t hostLiveBytes = 0;
+            uint64_t hostTotalCount = 0;
+            for(const k3::graphics::K3HostAllocationCounters &scope : hostStatistics.scopes) {
+                hostLiveBytes += scope.liveBytes;
+                hostTotalCount += scope.totalCount;
+            }
+            ImGui::Text("Host %.1f KB live, %llu allocations, %llu pooled", hostLiveBytes / 1024.0, (unsigned long long) hostTotalCount, (unsigned long long) hostStatistics.pooledCount);
+            k3::graphics::K3Defragmenter &defragmenter = renderer->getDefragmenter();
+            ImGui::Text("Defragmented %.1f MB in %u moves, %zu retiring", defragmenter.getMovedBytes() / 1048576.0, defragmenter.getMoveCount(), defragmenter.getRetiredCount());
+            k3::graphics::K3GeometryPool &geometryPool = device->getGeometryPool();
+            ImGui::Text("Geometry pool %.1f / %.0f MB vertices, %.1f / %.0f MB indices", geometryPool.getVertexUsedBytes() / 1048576.0, geometryPool.getVertexPoolSize() / 1048576.0,
+                geometryPool.getIndexUsedBytes() / 1048576.0, geometryPool.getIndexPoolSize() / 1048576.0);
+            k3::graphics::K3StagingRing &stagingRing = device->getStagingRing();
+            ImGui::Text("Staging %.2f MB in flight, %llu upload submits", stagingRing.getPendingBytes() / 1048576.0, (unsigned long long) stagingRing.getSubmitCount());
+            k3::graphics::K3FrameAllocator &frameAllocator = renderer->getFrameAllocator();
+            ImGui::Text("Frame data %.1f KB, peak %.1f KB of %.0f KB", frameAllocator.getUsedBytes() / 1024.0, frameAllocator.getPeakBytes() / 1024.0, frameAllocator.getFrameSize() / 1024.0);
+            ImGui::Text("Geometry %s", device->getGeometryPlacement() == k3::graphics::K3GeometryPlacement::DIRECT ? "written in place" : "staged to device local");
             m_graphics->endGUIFrameRender(commandBuffer, frameTime);
 
             renderer->endSwapChainRenderPass(commandBuffer);
             renderer->endFrame();
+            m_assetCache->update();
             KE_TRACE_SPAM("Exit Frame {}", frameCounter);
         }
         frameCounter++;
     }
-    vkDeviceWaitIdle(device->getDevice());
+    {
+        std::lock_guard<std::mutex> queueLock(device->getQueueMutex());
+        vkDeviceWaitIdle(device->getDevice());
+    }
     KE_INFO("Vulkan Device Idle. Exiting.");
 }
 
-int main() {
-    init();
+int main(int argc, char *argv[]) {
+    init(argc, argv);
     std::exception_ptr eptr = nullptr;
     try {
         run();
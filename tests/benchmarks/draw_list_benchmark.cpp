@@ -0,0 +1,125 @@
+#include "test.hpp"
+
+#include "k3/graphics/camera.hpp"
+#include "k3/graphics/device.hpp"
+#include "k3/graphics/frame_allocator.hpp"
+#include "k3/graphics/frame_info.hpp"
+#include "k3/graphics/game_object.hpp"
+#include "k3/graphics/model.hpp"
+#include "k3/graphics/offscreen_target.hpp"
+#include "k3/graphics/simple_render_system.hpp"
+#include "k3/graphics/swapchain.hpp"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace k3::graphics {
+
+    namespace {
+
+        struct K3DrawMode {
+            const char *name;
+            bool perObject;
+            bool indirect;
+        };
+
+    }
+
+    // Prints the CPU time to collect and record 100k objects of the shipped models through
+    // K3SimpleRenderSystem, with the per object push constant loop, instanced vkCmdDrawIndexed per
+    // group and the indirect K3DrawList. Needs no window, so it runs on lavapipe in CI. The command
+    // buffers are recorded but never submitted, only the draw counts are checked.
+    K3_TEST(draw_list_benchmark) {
+        constexpr uint32_t OBJECT_COUNT = 100000;
+        constexpr uint32_t ROW_LENGTH = 400;
+        constexpr uint32_t REPEATS = 10;
+
+        auto device = std::make_shared<K3Device>(nullptr);
+        K3_CHECK(device->isHeadless());
+        {
+            K3OffscreenTarget target{device, {1280, 720}};
+            K3FrameAllocator frameAllocator{device};
+
+            std::vector<std::shared_ptr<K3Model>> models{};
+            for(const auto &model : tests::getShippedModels()) {
+                models.push_back(std::shared_ptr<K3Model>(K3Model::createModelFromFile(device, tests::getModelPath(model))));
+            }
+            // What the renderer does at the start of a frame, so staged models count as resident.
+            device->getStagingRing().waitIdle();
+            VkCommandBuffer acquireBuffer = device->beginSingleTimeCommands();
+            device->getStagingRing().acquireUploads(acquireBuffer);
+            device->endSingleTimeCommands(acquireBuffer);
+
+            std::vector<K3GameObject> gameObjects{};
+            gameObjects.reserve(OBJECT_COUNT);
+            for(uint32_t i = 0; i < OBJECT_COUNT; i++) {
+                K3GameObject gameObject = K3GameObject::createGameObject();
+                gameObject.model = models[i % models.size()];
+                gameObject.transform.translation = glm::vec3{2.f * static_cast<float>(i % ROW_LENGTH) - ROW_LENGTH, 0.f, 2.f * static_cast<float>(i / ROW_LENGTH)};
+                gameObject.transform.scale = glm::vec3{0.5f};
+                gameObjects.push_back(std::move(gameObject));
+            }
+
+            K3Camera camera{};
+            camera.setPerspectiveProjection(glm::pi<float>() / 4.f, 1280.f / 720.f, 0.1f, 1000.f);
+            camera.setViewTarget(glm::vec3{0.f, -20.f, -20.f}, glm::vec3{0.f, 0.f, 200.f});
+
+            // Every object is recorded, so the modes differ only in how they are drawn.
+            K3SimpleRenderSystem renderSystem{device, target.getRenderPass()};
+            renderSystem.setFrustumCulling(false);
+            renderSystem.setCulling(false);
+
+            VkCommandBufferAllocateInfo allocateInfo{};
+            allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocateInfo.commandPool = device->getCommandPool();
+            allocateInfo.commandBufferCount = 1;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            K3_CHECK(vkAllocateCommandBuffers(device->getDevice(), &allocateInfo, &commandBuffer) == VK_SUCCESS);
+
+            uint32_t frameIndex = 0;
+            const auto record = [&]() {
+                frameAllocator.beginFrame(frameIndex);
+                K3FrameInfo frameInfo{static_cast<int>(frameIndex), 0.f, commandBuffer, camera, target.getExtent(), frameAllocator, VK_NULL_HANDLE, VK_NULL_HANDLE};
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                K3_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo) == VK_SUCCESS);
+                renderSystem.prepareGameObjects(frameInfo, gameObjects);
+                target.beginRenderPass(commandBuffer);
+                renderSystem.renderGameObjects(frameInfo);
+                target.endRenderPass(commandBuffer);
+                K3_CHECK(vkEndCommandBuffer(commandBuffer) == VK_SUCCESS);
+                frameAllocator.flush();
+                frameIndex = (frameIndex + 1) % K3SwapChain::MAX_FRAMES_IN_FLIGHT;
+            };
+
+            const K3DrawMode modes[] = {
+                {"per object push constants", true, false},
+                {"instanced vkCmdDrawIndexed", false, false},
+                {"indirect K3DrawList", false, true},
+            };
+            for(const K3DrawMode &mode : modes) {
+                renderSystem.setPerObject(mode.perObject);
+                renderSystem.setIndirect(mode.indirect);
+                // Creates the pipelines and grows the frame memory outside the timing.
+                record();
+                record();
+
+                float recordTime = 0.f;
+                const double frameTime = tests::measureMilliseconds([&]() {
+                    record();
+                    recordTime += renderSystem.getRecordTime();
+                }, REPEATS);
+                K3_CHECK(renderSystem.getInstanceCount() == OBJECT_COUNT);
+                K3_CHECK(mode.perObject ? renderSystem.getDrawCount() >= OBJECT_COUNT : renderSystem.getDrawCount() < OBJECT_COUNT);
+                std::cout << "draw_list_benchmark: " << OBJECT_COUNT << " objects, " << mode.name << ", " << renderSystem.getDrawCount() << " draws, recorded in "
+                    << recordTime / REPEATS << " ms (" << frameTime << " ms with begin and end)" << std::endl;
+            }
+
+            vkFreeCommandBuffers(device->getDevice(), device->getCommandPool(), 1, &commandBuffer);
+        }
+    }
+
+}
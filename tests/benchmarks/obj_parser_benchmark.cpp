@@ -0,0 +1,106 @@
+#include "test.hpp"
+#include "reference.hpp"
+
+#include "k3/graphics/obj_parser.hpp"
+#include "k3/graphics/thread_pool.hpp"
+#include "k3/graphics/vertex.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace k3::graphics {
+
+    namespace {
+
+        // Removes the file when the benchmark ends, failed checks included.
+        struct K3TemporaryFile {
+            std::string path;
+
+            ~K3TemporaryFile() {
+                std::error_code error{};
+                std::filesystem::remove(path, error);
+            }
+        };
+
+    }
+
+    // A grid of quads with positions, uvs and normals, rows of COLUMNS vertices until the file
+    // passes targetBytes.
+    static void writeSyntheticObj(const std::string &path, size_t targetBytes) {
+        constexpr uint32_t COLUMNS = 1000;
+        std::string text{};
+        text.reserve(targetBytes + (1u << 20));
+        char line[256];
+        uint32_t rows = 0;
+        for(; text.size() < targetBytes || rows < 2; rows++) {
+            for(uint32_t column = 0; column < COLUMNS; column++) {
+                const float x = column * 0.01f;
+                const float z = rows * 0.01f;
+                const float y = 0.05f * static_cast<float>((column * 7 + rows * 13) % 17) - 0.4f;
+                int length = std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                    x, y, -z, column / static_cast<float>(COLUMNS), (rows % 1024) / 1024.f, 0.f, 1.f, 0.f);
+                text.append(line, static_cast<size_t>(length));
+            }
+            if(rows == 0) {
+                continue;
+            }
+            // Quads between this row and the last, which the parser splits into two triangles.
+            for(uint32_t column = 0; column + 1 < COLUMNS; column++) {
+                const uint32_t a = (rows - 1) * COLUMNS + column + 1;
+                const uint32_t b = a + 1;
+                const uint32_t c = a + COLUMNS + 1;
+                const uint32_t d = a + COLUMNS;
+                int length = std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c, d, d, d);
+                text.append(line, static_cast<size_t>(length));
+            }
+        }
+        std::ofstream file(path, std::ios::binary);
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+        K3_CHECK(file.good());
+    }
+
+    // Prints the time to parse the shipped models and a synthetic 100 MB OBJ with tinyobj and with
+    // K3ObjParser on 1, 2, 4 ... hardware threads. Only the results are checked, timings depend on
+    // the machine and the build type.
+    K3_TEST(obj_parser_benchmark) {
+        for(const auto &model : tests::getShippedModels()) {
+            const std::string path = tests::getModelPath(model);
+            K3ObjData data{};
+            const double tinyObjTime = tests::measureMilliseconds([&]() { K3Builder::loadObjWithTinyObj(path, data); }, 5);
+            const double parserTime = tests::measureMilliseconds([&]() { K3_CHECK(K3ObjParser::parse(path, data)); }, 5);
+            std::cout << "obj_parser_benchmark: " << model << " tinyobj " << tinyObjTime << " ms, K3ObjParser " << parserTime << " ms" << std::endl;
+        }
+
+        const K3TemporaryFile file{(std::filesystem::temp_directory_path() / "k3_obj_parser_benchmark.obj").string()};
+        writeSyntheticObj(file.path, 100ull << 20);
+        const auto fileBytes = std::filesystem::file_size(file.path);
+
+        K3ObjData reference{};
+        const double tinyObjTime = tests::measureMilliseconds([&]() { K3Builder::loadObjWithTinyObj(file.path, reference); });
+        std::cout << "obj_parser_benchmark: " << (fileBytes >> 20) << " MB synthetic OBJ, tinyobj " << tinyObjTime << " ms" << std::endl;
+
+        const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<uint32_t> threadCounts{};
+        for(uint32_t threads = 1; threads < hardwareThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(hardwareThreads);
+        for(uint32_t threads : threadCounts) {
+            K3ThreadPool pool(threads);
+            K3ObjData data{};
+            bool parsed = false;
+            const double parserTime = tests::measureMilliseconds([&]() { parsed = K3ObjParser::parse(file.path, data, pool); });
+            K3_CHECK(parsed);
+            K3_CHECK(tests::isSameObjData(data, reference));
+            std::cout << "obj_parser_benchmark: K3ObjParser on " << threads << " threads " << parserTime << " ms ("
+                << tinyObjTime / parserTime << "x tinyobj)" << std::endl;
+        }
+    }
+
+}
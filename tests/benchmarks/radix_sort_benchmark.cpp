@@ -0,0 +1,42 @@
+#include "test.hpp"
+#include "reference.hpp"
+
+#include "k3/graphics/radix_sort.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace k3::graphics {
+
+    // Prints the 100k key timing against std::sort and std::stable_sort. Only the order is checked,
+    // timings depend on the machine and the build type.
+    K3_TEST(radix_sort_benchmark) {
+        constexpr size_t COUNT = 100000;
+        constexpr uint32_t REPEATS = 20;
+        const std::vector<K3SortEntry> input = tests::getRandomEntries(COUNT, ~0ull, 100);
+        const auto compare = [](const K3SortEntry &a, const K3SortEntry &b) { return a.key < b.key; };
+
+        K3RadixSorter sorter{};
+        std::vector<K3SortEntry> entries{};
+        const double radixTime = tests::measureMilliseconds([&]() {
+            entries = input;
+            sorter.sort(entries);
+        }, REPEATS);
+        K3_CHECK(tests::isSameOrder(entries, tests::getStableSorted(input)));
+
+        const double sortTime = tests::measureMilliseconds([&]() {
+            entries = input;
+            std::sort(entries.begin(), entries.end(), compare);
+        }, REPEATS);
+        const double stableSortTime = tests::measureMilliseconds([&]() {
+            entries = input;
+            std::stable_sort(entries.begin(), entries.end(), compare);
+        }, REPEATS);
+
+        std::cout << "radix_sort_benchmark: " << COUNT << " keys, K3RadixSorter " << radixTime << " ms, std::sort " << sortTime
+            << " ms, std::stable_sort " << stableSortTime << " ms" << std::endl;
+    }
+
+
+}
@@ -0,0 +1,35 @@
+#include "test.hpp"
+#include "reference.hpp"
+
+#include "k3/graphics/thread_pool.hpp"
+#include "k3/graphics/vertex.hpp"
+#include "k3/graphics/vertex_table.hpp"
+
+#include <iostream>
+#include <vector>
+
+namespace k3::graphics {
+
+    // Prints the time to deduplicate 3M corners over 500K vertices, about the ratio of a closed
+    // triangle mesh, with std::unordered_map, K3VertexTable and deduplicateSorted. Only the
+    // results are checked, timings depend on the machine and the build type.
+    K3_TEST(vertex_table_benchmark) {
+        const std::vector<K3Vertex> corners = tests::getRandomCorners(3000000, 500000, 4);
+        std::vector<K3Vertex> mapVertices{};
+        std::vector<uint32_t> mapIndices{};
+        const double mapTime = tests::measureMilliseconds([&]() { tests::deduplicateWithMap(corners, mapVertices, mapIndices); }, 3);
+
+        std::vector<K3Vertex> vertices{};
+        std::vector<uint32_t> indices{};
+        const double tableTime = tests::measureMilliseconds([&]() { tests::deduplicateWithTable(corners, vertices, indices); }, 3);
+        K3_CHECK(indices == mapIndices && vertices.size() == mapVertices.size());
+
+        const double sortedTime = tests::measureMilliseconds([&]() { K3VertexTable::deduplicateSorted(corners, vertices, indices); }, 3);
+        K3_CHECK(indices == mapIndices && vertices.size() == mapVertices.size());
+
+        std::cout << "vertex_table_benchmark: " << corners.size() << " corners, " << mapVertices.size() << " vertices, std::unordered_map "
+            << mapTime << " ms, K3VertexTable " << tableTime << " ms, deduplicateSorted on " << K3ThreadPool::shared().getThreadCount()
+            << " threads " << sortedTime << " ms" << std::endl;
+    }
+
+}
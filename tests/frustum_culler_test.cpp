@@ -0,0 +1,74 @@
+#include "test.hpp"
+
+#include "k3/graphics/frustum_culler.hpp"
+#include "k3/graphics/culler.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <random>
+#include <vector>
+
+namespace k3::graphics {
+
+    // cull() takes the AVX, SSE2 or NEON path the build targets, so this checks that one lane for
+    // lane against the scalar isVisible, across partial groups at the end of the arrays.
+    static void checkAgainstScalar(const glm::mat4 &projectionView, uint32_t seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(-40.f, 40.f);
+        std::uniform_real_distribution<float> radius(0.f, 4.f);
+        const std::array<glm::vec4, 6> planes = K3Culler::extractFrustumPlanes(projectionView);
+
+        K3FrustumCuller culler{};
+        std::vector<uint8_t> visibility{};
+        for(uint32_t count : {0u, 1u, 3u, 4u, 5u, 7u, 8u, 9u, 15u, 16u, 17u, 1000u, 1003u}) {
+            culler.clear();
+            std::vector<glm::vec4> spheres{};
+            for(uint32_t i = 0; i < count; i++) {
+                spheres.emplace_back(position(random), position(random), position(random), radius(random));
+                K3_CHECK(culler.add(spheres.back()) == i);
+            }
+            K3_CHECK(culler.size() == count);
+
+            const uint32_t visibleCount = culler.cull(projectionView, visibility);
+            K3_CHECK(visibility.size() == count);
+            uint32_t expectedCount = 0;
+            for(uint32_t i = 0; i < count; i++) {
+                const bool expected = K3FrustumCuller::isVisible(planes, spheres[i]);
+                K3_CHECK(visibility[i] == (expected ? 1 : 0));
+                expectedCount += expected ? 1 : 0;
+            }
+            K3_CHECK(visibleCount == expectedCount);
+        }
+    }
+
+    K3_TEST(frustum_culler_perspective) {
+        const glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 50.f);
+        const glm::mat4 view = glm::lookAt(glm::vec3{3.f, 2.f, -10.f}, glm::vec3{0.f}, glm::vec3{0.f, 1.f, 0.f});
+        checkAgainstScalar(projection * view, 1);
+    }
+
+    K3_TEST(frustum_culler_orthographic) {
+        checkAgainstScalar(glm::ortho(-20.f, 20.f, -10.f, 10.f, 0.f, 30.f), 2);
+    }
+
+    K3_TEST(frustum_culler_known_spheres) {
+        const glm::mat4 projectionView = glm::ortho(-1.f, 1.f, -1.f, 1.f, 0.f, 10.f);
+        K3FrustumCuller culler{};
+        culler.add({0.f, 0.f, -5.f, 0.5f});
+        // Outside each side but for its radius, then outside by more than it.
+        culler.add({1.4f, 0.f, -5.f, 0.5f});
+        culler.add({3.f, 0.f, -5.f, 0.5f});
+        culler.add({0.f, -1.4f, -5.f, 0.5f});
+        culler.add({0.f, -3.f, -5.f, 0.5f});
+        culler.add({0.f, 0.f, 0.4f, 0.5f});
+        culler.add({0.f, 0.f, 3.f, 0.5f});
+        culler.add({0.f, 0.f, -10.4f, 0.5f});
+        culler.add({0.f, 0.f, -13.f, 0.5f});
+
+        std::vector<uint8_t> visibility{};
+        K3_CHECK(culler.cull(projectionView, visibility) == 5);
+        const std::vector<uint8_t> expected{1, 1, 0, 1, 0, 1, 0, 1, 0};
+        K3_CHECK(visibility == expected);
+    }
+
+}
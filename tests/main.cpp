@@ -0,0 +1,45 @@
+#include "test.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+namespace k3::tests {
+
+    std::vector<K3TestCase> &getTestCases() {
+        static std::vector<K3TestCase> testCases{};
+        return testCases;
+    }
+
+    void fail(const char *file, int line, const char *expression) {
+        throw K3TestFailure(std::string(file) + ":" + std::to_string(line) + ": K3_CHECK(" + expression + ") failed");
+    }
+
+}
+
+int main(int argc, char *argv[]) {
+    const std::string filter = argc > 1 ? argv[1] : "";
+    uint32_t runCount = 0;
+    uint32_t failCount = 0;
+    for(const auto &testCase : k3::tests::getTestCases()) {
+        if(std::string(testCase.name).rfind(filter, 0) != 0) {
+            continue;
+        }
+        runCount++;
+        try {
+            testCase.function();
+            std::cout << "[pass] " << testCase.name << std::endl;
+        } catch(const std::exception &e) {
+            failCount++;
+            std::cout << "[fail] " << testCase.name << ": " << e.what() << std::endl;
+        }
+    }
+    if(runCount == 0) {
+        std::cout << "No tests match \"" << filter << "\"." << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << runCount - failCount << " of " << runCount << " tests passed." << std::endl;
+    return failCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,100 @@
+#include "test.hpp"
+
+#include "k3/graphics/vertex.hpp"
+#include "k3/graphics/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace k3::graphics {
+
+    using K3Triangle = std::array<uint32_t, 3>;
+
+    // The shipped model as parsed, before any optimizer pass.
+    static K3Builder loadUnoptimized(const std::string &name) {
+        K3Builder builder{};
+        builder.optimizeFlags = 0;
+        builder.loadModel(tests::getModelPath(name));
+        if(builder.isMapped()) {
+            builder.vertices.assign(builder.vertexData(), builder.vertexData() + builder.vertexCount());
+            builder.indices.assign(builder.indexData(), builder.indexData() + builder.indexCount());
+        }
+        K3_CHECK(!builder.indices.empty() && builder.indices.size() % 3 == 0);
+        return builder;
+    }
+
+    // Triangles rotated to start at their smallest index, which keeps the winding, then sorted.
+    static std::vector<K3Triangle> getTriangleSet(const std::vector<uint32_t> &indices) {
+        std::vector<K3Triangle> triangles{};
+        for(size_t i = 0; i + 2 < indices.size(); i += 3) {
+            K3Triangle triangle{indices[i], indices[i + 1], indices[i + 2]};
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    static float getAcmr(const std::vector<uint32_t> &indices, uint32_t vertexCount) {
+        return K3MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertexCount).acmr;
+    }
+
+    K3_TEST(mesh_optimizer_vertex_cache) {
+        for(const auto &model : tests::getShippedModels()) {
+            const K3Builder builder = loadUnoptimized(model);
+            const uint32_t vertexCount = builder.vertexCount();
+            std::vector<uint32_t> indices = builder.indices;
+            std::vector<uint32_t> clusters{};
+            K3MeshOptimizer::optimizeVertexCache(indices, vertexCount, &clusters);
+
+            K3_CHECK(getTriangleSet(indices) == getTriangleSet(builder.indices));
+            K3_CHECK(getAcmr(indices, vertexCount) < getAcmr(builder.indices, vertexCount));
+            // Clusters start at triangle boundaries, in order, the first at 0.
+            K3_CHECK(!clusters.empty() && clusters.front() == 0);
+            for(size_t i = 0; i < clusters.size(); i++) {
+                K3_CHECK(clusters[i] % 3 == 0 && clusters[i] < indices.size());
+                K3_CHECK(i == 0 || clusters[i - 1] < clusters[i]);
+            }
+        }
+    }
+
+    K3_TEST(mesh_optimizer_overdraw) {
+        constexpr float THRESHOLD = 1.05f;
+        for(const auto &model : tests::getShippedModels()) {
+            const K3Builder builder = loadUnoptimized(model);
+            const uint32_t vertexCount = builder.vertexCount();
+            std::vector<uint32_t> indices = builder.indices;
+            std::vector<uint32_t> clusters{};
+            K3MeshOptimizer::optimizeVertexCache(indices, vertexCount, &clusters);
+            const float cacheAcmr = getAcmr(indices, vertexCount);
+            K3MeshOptimizer::optimizeOverdraw(indices, builder.vertices.data(), vertexCount, clusters, THRESHOLD);
+
+            K3_CHECK(getTriangleSet(indices) == getTriangleSet(builder.indices));
+            K3_CHECK(getAcmr(indices, vertexCount) <= cacheAcmr * THRESHOLD);
+        }
+    }
+
+    K3_TEST(mesh_optimizer_vertex_fetch) {
+        for(const auto &model : tests::getShippedModels()) {
+            const K3Builder builder = loadUnoptimized(model);
+            std::vector<K3Vertex> vertices = builder.vertices;
+            std::vector<uint32_t> indices = builder.indices;
+            const uint32_t vertexCount = K3MeshOptimizer::optimizeVertexFetch(vertices, indices);
+
+            K3_CHECK(vertexCount == vertices.size() && vertexCount <= builder.vertices.size());
+            K3_CHECK(indices.size() == builder.indices.size());
+            // Same corners in the same order, renumbered so vertices appear in first use order.
+            uint32_t nextVertex = 0;
+            for(size_t i = 0; i < indices.size(); i++) {
+                K3_CHECK(vertices[indices[i]] == builder.vertices[builder.indices[i]]);
+                K3_CHECK(indices[i] <= nextVertex);
+                if(indices[i] == nextVertex) {
+                    nextVertex++;
+                }
+            }
+            K3_CHECK(nextVertex == vertexCount);
+        }
+    }
+
+}
@@ -0,0 +1,86 @@
+#include "test.hpp"
+
+#include "k3/graphics/vertex.hpp"
+#include "k3/graphics/meshlet.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace k3::graphics {
+
+    using K3Triangle = std::array<uint32_t, 3>;
+
+    // Rotated to start at the smallest index, which keeps the winding.
+    static K3Triangle getCanonical(uint32_t a, uint32_t b, uint32_t c) {
+        K3Triangle triangle{a, b, c};
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        return triangle;
+    }
+
+    K3_TEST(meshlet_shipped_models) {
+        for(const auto &model : tests::getShippedModels()) {
+            K3Builder builder{};
+            // GENERATE_MESHLETS is on by default, so a second run checks the meshlets read back from the mesh cache.
+            builder.loadModel(tests::getModelPath(model));
+            const K3Vertex *vertices = builder.vertexData();
+            const uint32_t indexCount = builder.lods.empty() ? builder.indexCount() : builder.lods[0].indexCount;
+            K3_CHECK(!builder.meshlets.empty());
+            K3_CHECK(builder.meshletBounds.size() == builder.meshlets.size());
+
+            std::vector<K3Triangle> covered{};
+            for(size_t m = 0; m < builder.meshlets.size(); m++) {
+                const K3Meshlet &meshlet = builder.meshlets[m];
+                const K3MeshletBounds &bounds = builder.meshletBounds[m];
+                K3_CHECK(meshlet.vertexCount > 0 && meshlet.vertexCount <= K3MeshletGenerator::MAX_VERTICES);
+                K3_CHECK(meshlet.triangleCount > 0 && meshlet.triangleCount <= K3MeshletGenerator::MAX_TRIANGLES);
+                K3_CHECK(meshlet.vertexOffset + meshlet.vertexCount <= builder.meshletVertices.size());
+                K3_CHECK(meshlet.triangleOffset + 3 * meshlet.triangleCount <= builder.meshletTriangles.size());
+                const uint32_t *local = builder.meshletVertices.data() + meshlet.vertexOffset;
+                const uint8_t *triangles = builder.meshletTriangles.data() + meshlet.triangleOffset;
+
+                // Every vertex inside the sphere, give or take float rounding.
+                const glm::vec3 center{bounds.sphere};
+                const float radius = bounds.sphere.w;
+                for(uint32_t i = 0; i < meshlet.vertexCount; i++) {
+                    K3_CHECK(local[i] < builder.vertexCount());
+                    K3_CHECK(glm::length(vertices[local[i]].position - center) <= radius * (1.f + 1e-5f) + 1e-6f);
+                }
+
+                // A usable cone holds every triangle normal and its apex is behind every triangle.
+                const bool hasCone = bounds.coneAxis.w < 1.f;
+                const glm::vec3 axis{bounds.coneAxis};
+                const glm::vec3 apex{bounds.coneApex};
+                const float minDot = std::sqrt(std::max(0.f, 1.f - bounds.coneAxis.w * bounds.coneAxis.w));
+                for(uint32_t t = 0; t < meshlet.triangleCount; t++) {
+                    const uint8_t *triangle = triangles + 3 * t;
+                    K3_CHECK(triangle[0] < meshlet.vertexCount && triangle[1] < meshlet.vertexCount && triangle[2] < meshlet.vertexCount);
+                    covered.push_back(getCanonical(local[triangle[0]], local[triangle[1]], local[triangle[2]]));
+                    if(!hasCone) {
+                        continue;
+                    }
+                    const glm::vec3 &p0 = vertices[local[triangle[0]]].position;
+                    const glm::vec3 normal = glm::cross(vertices[local[triangle[1]]].position - p0, vertices[local[triangle[2]]].position - p0);
+                    const float length = glm::length(normal);
+                    if(length == 0.f) {
+                        continue;
+                    }
+                    K3_CHECK(glm::dot(axis, normal / length) >= minDot - 1e-4f);
+                    K3_CHECK(glm::dot(apex - p0, normal / length) <= 1e-4f * std::max(std::max(radius, glm::length(center)), 1.f));
+                }
+            }
+
+            // Together the meshlets hold every triangle of the full detail level exactly once.
+            std::vector<K3Triangle> expected{};
+            const uint32_t *indices = builder.indexData();
+            for(uint32_t i = 0; i + 2 < indexCount; i += 3) {
+                expected.push_back(getCanonical(indices[i], indices[i + 1], indices[i + 2]));
+            }
+            std::sort(covered.begin(), covered.end());
+            std::sort(expected.begin(), expected.end());
+            K3_CHECK(covered == expected);
+        }
+    }
+
+}
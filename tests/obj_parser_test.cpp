@@ -0,0 +1,47 @@
+#include "test.hpp"
+#include "reference.hpp"
+
+#include "k3/graphics/obj_parser.hpp"
+#include "k3/graphics/vertex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace k3::graphics {
+
+    K3_TEST(obj_parser_matches_tinyobj) {
+        for(const auto &model : tests::getShippedModels()) {
+            const std::string path = tests::getModelPath(model);
+            K3ObjData parsed{};
+            K3_CHECK(K3ObjParser::parse(path, parsed));
+            K3ObjData reference{};
+            K3Builder::loadObjWithTinyObj(path, reference);
+            K3_CHECK(!reference.corners.empty());
+            K3_CHECK(tests::isSameObjData(parsed, reference));
+
+            // The vertices and indices loadModel built before the parser, from tinyobj and an
+            // unordered_map in first use order.
+            std::vector<K3Vertex> referenceVertices{};
+            std::vector<uint32_t> referenceIndices{};
+            std::unordered_map<K3Vertex, uint32_t, tests::K3VertexHash> uniqueVertices{};
+            for(const auto &corner : reference.corners) {
+                const K3Vertex vertex = K3Builder::assembleVertex(reference, corner);
+                auto [entry, inserted] = uniqueVertices.emplace(vertex, static_cast<uint32_t>(referenceVertices.size()));
+                if(inserted) {
+                    referenceVertices.push_back(vertex);
+                }
+                referenceIndices.push_back(entry->second);
+            }
+
+            K3Builder builder{};
+            builder.optimizeFlags = 0;
+            builder.loadModel(path);
+            K3_CHECK(builder.vertexCount() == referenceVertices.size() && builder.indexCount() == referenceIndices.size());
+            K3_CHECK(std::memcmp(builder.vertexData(), referenceVertices.data(), referenceVertices.size() * sizeof(K3Vertex)) == 0);
+            K3_CHECK(std::equal(referenceIndices.begin(), referenceIndices.end(), builder.indexData()));
+        }
+    }
+
+}
@@ -0,0 +1,76 @@
+#include "test.hpp"
+#include "reference.hpp"
+
+#include "k3/graphics/radix_sort.hpp"
+
+#include <vector>
+
+namespace k3::graphics {
+
+    K3_TEST(radix_sort_empty_and_single) {
+        K3RadixSorter sorter{};
+        std::vector<K3SortEntry> entries{};
+        sorter.sort(entries);
+        K3_CHECK(entries.empty() && sorter.getPassCount() == 0);
+
+        entries.push_back({42, 7});
+        sorter.sort(entries);
+        K3_CHECK(entries.size() == 1 && entries[0].key == 42 && entries[0].index == 7);
+        K3_CHECK(sorter.getPassCount() == 0);
+    }
+
+    K3_TEST(radix_sort_stable) {
+        K3RadixSorter sorter{};
+        // Around the insertion sort threshold, and with few distinct keys so most are equal.
+        for(size_t count : {2ul, 17ul, 63ul, 64ul, 65ul, 1000ul, 40000ul}) {
+            for(uint64_t keyMask : {0x7ull, 0xff00000000000003ull, ~0ull}) {
+                std::vector<K3SortEntry> entries = tests::getRandomEntries(count, keyMask, static_cast<uint32_t>(count));
+                const std::vector<K3SortEntry> expected = tests::getStableSorted(entries);
+                sorter.sort(entries);
+                K3_CHECK(tests::isSameOrder(entries, expected));
+            }
+        }
+    }
+
+    K3_TEST(radix_sort_skipped_digits) {
+        K3RadixSorter sorter{};
+
+        // Only digits 3 and 6 vary, the other six passes are skipped.
+        std::vector<K3SortEntry> entries = tests::getRandomEntries(5000, 0x00ff0000ff000000ull, 3);
+        for(auto &entry : entries) {
+            entry.key |= 0x1100000000000022ull;
+        }
+        std::vector<K3SortEntry> expected = tests::getStableSorted(entries);
+        sorter.sort(entries);
+        K3_CHECK(tests::isSameOrder(entries, expected));
+        K3_CHECK(sorter.getPassCount() == 2);
+
+        // An odd pass count leaves the result in the scratch array before the swap back.
+        entries = tests::getRandomEntries(5000, 0x0000ff0000000000ull, 4);
+        expected = tests::getStableSorted(entries);
+        sorter.sort(entries);
+        K3_CHECK(tests::isSameOrder(entries, expected));
+        K3_CHECK(sorter.getPassCount() == 1);
+
+        // Every key equal, nothing moves.
+        entries = tests::getRandomEntries(5000, 0, 5);
+        sorter.sort(entries);
+        K3_CHECK(sorter.getPassCount() == 0);
+        for(size_t i = 0; i < entries.size(); i++) {
+            K3_CHECK(entries[i].index == i);
+        }
+    }
+
+    K3_TEST(radix_sort_scratch_reuse) {
+        // One sorter across growing and shrinking frames, as K3SimpleRenderSystem uses it.
+        K3RadixSorter sorter{};
+        uint32_t seed = 10;
+        for(size_t count : {3000ul, 100ul, 20000ul, 70ul, 20000ul, 5ul, 9000ul}) {
+            std::vector<K3SortEntry> entries = tests::getRandomEntries(count, ~0ull, seed++);
+            const std::vector<K3SortEntry> expected = tests::getStableSorted(entries);
+            sorter.sort(entries);
+            K3_CHECK(tests::isSameOrder(entries, expected));
+        }
+    }
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "test.hpp"
+
+#include "k3/graphics/obj_parser.hpp"
+#include "k3/graphics/radix_sort.hpp"
+#include "k3/graphics/vertex.hpp"
+#include "k3/graphics/vertex_table.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Reference results the unit tests and the benchmarks both check against.
+namespace k3::tests {
+
+    inline bool isSameBits(const std::vector<float> &a, const std::vector<float> &b) {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+    }
+
+    // Bit for bit the same attributes and the same corners.
+    inline bool isSameObjData(const graphics::K3ObjData &a, const graphics::K3ObjData &b) {
+        return isSameBits(a.positions, b.positions) && isSameBits(a.colors, b.colors) && isSameBits(a.normals, b.normals)
+            && isSameBits(a.texcoords, b.texcoords) && a.corners.size() == b.corners.size()
+            && std::equal(a.corners.begin(), a.corners.end(), b.corners.begin(), [](const graphics::K3ObjCorner &x, const graphics::K3ObjCorner &y) {
+                return x.position == y.position && x.texcoord == y.texcoord && x.normal == y.normal;
+            });
+    }
+
+    // The hash loadModel used before K3VertexTable.
+    struct K3VertexHash {
+        size_t operator()(const graphics::K3Vertex &vertex) const {
+            size_t seed = 0;
+            hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+            return seed;
+        }
+    };
+
+    // The table path of loadModel, one findOrInsert per corner.
+    inline void deduplicateWithTable(const std::vector<graphics::K3Vertex> &corners, std::vector<graphics::K3Vertex> &vertices, std::vector<uint32_t> &indices) {
+        vertices.clear();
+        indices.clear();
+        graphics::K3VertexTable table{corners.size()};
+        for(const graphics::K3Vertex &corner : corners) {
+            const uint32_t candidate = static_cast<uint32_t>(vertices.size());
+            const uint32_t index = table.findOrInsert(corner, candidate, vertices.data());
+            if(index == candidate) {
+                vertices.push_back(corner);
+            }
+            indices.push_back(index);
+        }
+        K3_CHECK(table.size() == vertices.size());
+    }
+
+    // What loadModel did before K3VertexTable, vertices in first use order.
+    inline void deduplicateWithMap(const std::vector<graphics::K3Vertex> &corners, std::vector<graphics::K3Vertex> &vertices, std::vector<uint32_t> &indices) {
+        vertices.clear();
+        indices.clear();
+        std::unordered_map<graphics::K3Vertex, uint32_t, K3VertexHash> uniqueVertices{};
+        for(const graphics::K3Vertex &corner : corners) {
+            auto [entry, inserted] = uniqueVertices.emplace(corner, static_cast<uint32_t>(vertices.size()));
+            if(inserted) {
+                vertices.push_back(corner);
+            }
+            indices.push_back(entry->second);
+        }
+    }
+
+    // count corners drawn from uniqueCount random vertices, some differing only in the sign of a zero.
+    inline std::vector<graphics::K3Vertex> getRandomCorners(size_t count, size_t uniqueCount, uint32_t seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+        std::vector<graphics::K3Vertex> unique(uniqueCount);
+        for(size_t i = 0; i < uniqueCount; i++) {
+            graphics::K3Vertex &vertex = unique[i];
+            vertex.position = glm::vec3{unit(random), unit(random), unit(random)};
+            vertex.color = glm::vec3{1.f};
+            vertex.normal = i % 5 == 0 ? glm::vec3{0.f, 1.f, 0.f} : glm::vec3{unit(random), unit(random), unit(random)};
+            vertex.uv = glm::vec2{unit(random), i % 7 == 0 ? 0.f : unit(random)};
+        }
+        std::uniform_int_distribution<size_t> pick(0, uniqueCount - 1);
+        std::vector<graphics::K3Vertex> corners(count);
+        for(size_t i = 0; i < count; i++) {
+            corners[i] = unique[pick(random)];
+            if(i % 3 == 0) {
+                // -0.0 == 0.0, so these must still fold onto the same vertex.
+                corners[i].normal.x = corners[i].normal.x == 0.f ? -0.f : corners[i].normal.x;
+                corners[i].uv.y = corners[i].uv.y == 0.f ? -0.f : corners[i].uv.y;
+            }
+        }
+        return corners;
+    }
+
+    // Random keys under keyMask, indexed in input order so stability can be checked.
+    inline std::vector<graphics::K3SortEntry> getRandomEntries(size_t count, uint64_t keyMask, uint32_t seed) {
+        std::mt19937_64 random(seed);
+        std::vector<graphics::K3SortEntry> entries(count);
+        for(size_t i = 0; i < count; i++) {
+            entries[i] = {random() & keyMask, static_cast<uint32_t>(i)};
+        }
+        return entries;
+    }
+
+    inline std::vector<graphics::K3SortEntry> getStableSorted(std::vector<graphics::K3SortEntry> entries) {
+        std::stable_sort(entries.begin(), entries.end(), [](const graphics::K3SortEntry &a, const graphics::K3SortEntry &b) { return a.key < b.key; });
+        return entries;
+    }
+
+    // Same keys and, for equal keys, the same indices in the same order as std::stable_sort.
+    inline bool isSameOrder(const std::vector<graphics::K3SortEntry> &a, const std::vector<graphics::K3SortEntry> &b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+            [](const graphics::K3SortEntry &x, const graphics::K3SortEntry &y) { return x.key == y.key && x.index == y.index; });
+    }
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace k3::tests {
+
+    struct K3TestCase {
+        const char *name;
+        void (*function)();
+    };
+
+    // Every K3_TEST in the executable, in static initialisation order.
+    std::vector<K3TestCase> &getTestCases();
+
+    struct K3TestRegistrar {
+        K3TestRegistrar(const char *name, void (*function)()) {
+            getTestCases().push_back({name, function});
+        }
+    };
+
+    class K3TestFailure : public std::runtime_error {
+        public:
+            K3TestFailure(const std::string &message) : std::runtime_error {message} {}
+    };
+
+    [[noreturn]] void fail(const char *file, int line, const char *expression);
+
+    // The models shipped in models/, as copied into the build tree so mesh caches land there.
+    inline const std::vector<std::string> &getShippedModels() {
+        static const std::vector<std::string> models{"tea.obj", "smooth_vase.obj", "viking_room.obj"};
+        return models;
+    }
+
+    inline std::string getModelPath(const std::string &name) {
+        return std::string(K3_MODELS_DIR) + "/" + name;
+    }
+
+    // Average wall time of function over repeats runs, for the benchmark cases that print timings.
+    template<typename Function>
+    double measureMilliseconds(Function &&function, uint32_t repeats = 1) {
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        for(uint32_t i = 0; i < repeats; i++) {
+            function();
+        }
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count() / repeats;
+    }
+
+}
+
+// Defines and registers a test. k3_tests runs every test whose name starts with its argument.
+#define K3_TEST(name) \
+    static void name(); \
+    static const k3::tests::K3TestRegistrar name##Registrar{#name, name}; \
+    static void name()
+
+// Unlike assert, still checks in release builds.
+#define K3_CHECK(expression) \
+    do { if(!(expression)) { k3::tests::fail(__FILE__, __LINE__, #expression); } } while(false)
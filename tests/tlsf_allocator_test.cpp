@@ -0,0 +1,126 @@
+#include "test.hpp"
+
+#include "k3/graphics/tlsf_allocator.hpp"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace k3::graphics {
+
+    K3_TEST(tlsf_allocate_free) {
+        K3TlsfAllocator allocator(1024);
+        K3_CHECK(allocator.validate());
+        const uint64_t a = allocator.allocate(100);
+        const uint64_t b = allocator.allocate(200);
+        const uint64_t c = allocator.allocate(300);
+        K3_CHECK(a != K3TlsfAllocator::INVALID_OFFSET && b != K3TlsfAllocator::INVALID_OFFSET && c != K3TlsfAllocator::INVALID_OFFSET);
+        K3_CHECK(allocator.getUsedBytes() == 600);
+        K3_CHECK(allocator.getAllocationCount() == 3);
+        K3_CHECK(allocator.validate());
+
+        // A request bigger than what is left fails without touching the allocator.
+        K3_CHECK(allocator.allocate(1024) == K3TlsfAllocator::INVALID_OFFSET);
+        K3_CHECK(allocator.getUsedBytes() == 600);
+
+        allocator.free(b);
+        allocator.free(a);
+        allocator.free(c);
+        K3_CHECK(allocator.isEmpty());
+        K3_CHECK(allocator.getUsedBytes() == 0);
+        K3_CHECK(allocator.getFreeRegionCount() == 1);
+        K3_CHECK(allocator.getLargestFreeRegion() == 1024);
+        K3_CHECK(allocator.validate());
+    }
+
+    K3_TEST(tlsf_exact_fit) {
+        K3TlsfAllocator allocator(768);
+        const uint64_t a = allocator.allocate(256);
+        const uint64_t b = allocator.allocate(256);
+        const uint64_t c = allocator.allocate(256);
+        K3_CHECK(a != K3TlsfAllocator::INVALID_OFFSET && b != K3TlsfAllocator::INVALID_OFFSET && c != K3TlsfAllocator::INVALID_OFFSET);
+        K3_CHECK(allocator.getFreeBytes() == 0);
+        K3_CHECK(allocator.getFreeRegionCount() == 0);
+        K3_CHECK(allocator.allocate(1) == K3TlsfAllocator::INVALID_OFFSET);
+        K3_CHECK(allocator.validate());
+    }
+
+    K3_TEST(tlsf_alignment) {
+        K3TlsfAllocator allocator(1 << 20);
+        // Knock the head off alignment so every following request needs padding.
+        K3_CHECK(allocator.allocate(1) == 0);
+        for(uint64_t alignment = 2; alignment <= 4096; alignment <<= 1) {
+            const uint64_t offset = allocator.allocate(alignment / 2 + 1, alignment);
+            K3_CHECK(offset != K3TlsfAllocator::INVALID_OFFSET);
+            K3_CHECK(offset % alignment == 0);
+            K3_CHECK(allocator.validate());
+        }
+        // The padding went back on the free lists rather than into the allocations.
+        K3_CHECK(allocator.getFreeRegionCount() > 1);
+        K3_CHECK(allocator.getUsedBytes() + allocator.getFreeBytes() == allocator.getSize());
+    }
+
+    K3_TEST(tlsf_merging) {
+        K3TlsfAllocator allocator(768);
+        const uint64_t a = allocator.allocate(256);
+        const uint64_t b = allocator.allocate(256);
+        const uint64_t c = allocator.allocate(256);
+
+        // Neither freed region touches the other.
+        allocator.free(a);
+        allocator.free(c);
+        K3_CHECK(allocator.getFreeRegionCount() == 2);
+        K3_CHECK(allocator.getLargestFreeRegion() == 256);
+        K3_CHECK(allocator.getFragmentation() > 0.f);
+        K3_CHECK(allocator.allocate(512) == K3TlsfAllocator::INVALID_OFFSET);
+        K3_CHECK(allocator.validate());
+
+        // Freeing the middle folds both neighbours into one region.
+        allocator.free(b);
+        K3_CHECK(allocator.getFreeRegionCount() == 1);
+        K3_CHECK(allocator.getLargestFreeRegion() == 768);
+        K3_CHECK(allocator.getFragmentation() == 0.f);
+        K3_CHECK(allocator.allocate(768) == 0);
+        K3_CHECK(allocator.validate());
+    }
+
+    K3_TEST(tlsf_random) {
+        constexpr uint64_t SIZE = 1 << 20;
+        K3TlsfAllocator allocator(SIZE);
+        std::mt19937 random(1234);
+        std::vector<std::pair<uint64_t, uint64_t>> live{};
+        for(uint32_t step = 0; step < 4000; step++) {
+            if(live.empty() || random() % 3 != 0) {
+                const uint64_t size = 1 + random() % 4096;
+                const uint64_t alignment = 1ull << (random() % 9);
+                const uint64_t offset = allocator.allocate(size, alignment);
+                if(offset == K3TlsfAllocator::INVALID_OFFSET) {
+                    continue;
+                }
+                K3_CHECK(offset % alignment == 0 && offset + size <= SIZE);
+                live.emplace_back(offset, size);
+            } else {
+                const size_t index = random() % live.size();
+                allocator.free(live[index].first);
+                live[index] = live.back();
+                live.pop_back();
+            }
+            if(step % 64 == 0) {
+                K3_CHECK(allocator.validate());
+                std::vector<std::pair<uint64_t, uint64_t>> sorted = live;
+                std::sort(sorted.begin(), sorted.end());
+                for(size_t i = 1; i < sorted.size(); i++) {
+                    K3_CHECK(sorted[i - 1].first + sorted[i - 1].second <= sorted[i].first);
+                }
+            }
+        }
+        for(const auto &allocation : live) {
+            allocator.free(allocation.first);
+        }
+        K3_CHECK(allocator.isEmpty());
+        K3_CHECK(allocator.getFreeRegionCount() == 1);
+        K3_CHECK(allocator.validate());
+    }
+
+}
@@ -0,0 +1,167 @@
+#include "test.hpp"
+
+#include "k3/graphics/vertex.hpp"
+#include "k3/graphics/vertex_format.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace k3::graphics {
+
+    // Worst case of the snorm16 octahedral encoding is about 0.0074 degrees, found by brute force.
+    constexpr float NORMAL_BOUND_DEGREES = 0.01f;
+
+    // Half floats keep 11 significant bits, the same tolerance K3Builder::encode keeps HALF_UV to.
+    constexpr float HALF_UV_BOUND = 1.f / 2048.f;
+
+    static float getAngleDegrees(const glm::vec3 &a, const glm::vec3 &b) {
+        return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+    }
+
+    static std::vector<K3Vertex> getRandomVertices(uint32_t count, uint32_t seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+        std::uniform_real_distribution<float> uv(0.f, 1.f);
+        std::vector<K3Vertex> vertices(count);
+        for(auto &vertex : vertices) {
+            // An off centre box, longest along x, so offset and scale both matter.
+            vertex.position = glm::vec3{1.f + 4.f * unit(random), 10.5f + 0.5f * unit(random), 0.5f * unit(random)};
+            vertex.color = glm::vec3{0.8f, 0.4f, 0.2f};
+            glm::vec3 normal{unit(random), unit(random), unit(random)};
+            vertex.normal = glm::length(normal) > 0.f ? glm::normalize(normal) : glm::vec3{0.f, 0.f, 1.f};
+            vertex.uv = glm::vec2{uv(random), uv(random)};
+        }
+        return vertices;
+    }
+
+    static std::vector<K3Vertex> decodeAll(const K3Builder &builder) {
+        const uint32_t stride = builder.vertexFormat.getStride();
+        K3_CHECK(builder.encodedVertices.size() == static_cast<size_t>(stride) * builder.vertexCount());
+        std::vector<K3Vertex> decoded(builder.vertexData(), builder.vertexData() + builder.vertexCount());
+        for(size_t i = 0; i < decoded.size(); i++) {
+            builder.vertexFormat.decode(builder.encodedVertices.data() + stride * i, decoded[i]);
+        }
+        return decoded;
+    }
+
+    K3_TEST(vertex_format_quantized_position) {
+        K3Builder builder{};
+        builder.vertices = getRandomVertices(10000, 1);
+        // The bounding box corners land exactly on the ends of the snorm16 range.
+        builder.vertices[0].position = glm::vec3{-3.f, 10.f, -0.5f};
+        builder.vertices[1].position = glm::vec3{5.f, 11.f, 0.5f};
+        builder.encode(K3VertexFormat::QUANTIZED_POSITION);
+
+        K3_CHECK(builder.vertexFormat.getFlags() == K3VertexFormat::QUANTIZED_POSITION);
+        K3_CHECK(builder.vertexFormat.getStride() == 8 + 12 + 12 + 8);
+        K3_CHECK(builder.dequantizeScale == 4.f);
+        K3_CHECK(builder.dequantizeOffset == glm::vec3(1.f, 10.5f, 0.f));
+
+        // Half a snorm16 step of the scale, plus float rounding of the offset and scale.
+        const float bound = builder.dequantizeScale / 65534.f + 4.f * std::numeric_limits<float>::epsilon() * 11.f;
+        const std::vector<K3Vertex> decoded = decodeAll(builder);
+        for(size_t i = 0; i < decoded.size(); i++) {
+            const glm::vec3 position = builder.dequantizeOffset + decoded[i].position * builder.dequantizeScale;
+            const glm::vec3 error = glm::abs(position - builder.vertices[i].position);
+            K3_CHECK(std::max(error.x, std::max(error.y, error.z)) <= bound);
+            // Everything else passes through unchanged.
+            K3_CHECK(decoded[i].normal == builder.vertices[i].normal && decoded[i].uv == builder.vertices[i].uv);
+        }
+    }
+
+    K3_TEST(vertex_format_octahedral_normal) {
+        std::vector<glm::vec3> normals{
+            // The poles, where the fold meets itself.
+            {0.f, 0.f, 1.f}, {0.f, 0.f, -1.f},
+            {1.f, 0.f, 0.f}, {-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, -1.f, 0.f},
+            // Just either side of the fold at z = 0, and next to the lower pole.
+            {0.5f, 0.5f, 1e-5f}, {0.5f, -0.5f, -1e-5f}, {-0.5f, 0.5f, -1e-5f}, {-0.5f, -0.5f, 1e-5f},
+            {1e-4f, 1e-4f, -1.f}, {-1e-4f, 1e-4f, -1.f}, {1e-4f, -1e-4f, -1.f},
+            {0.7f, 0.f, -0.7f}, {0.f, -0.7f, -0.7f}, {1.f, 1.f, -1.f}, {-1.f, -1.f, -1.f}, {1.f, -1.f, 1.f},
+        };
+        std::mt19937 random(2);
+        std::normal_distribution<float> gaussian{};
+        while(normals.size() < 100000) {
+            const glm::vec3 normal{gaussian(random), gaussian(random), gaussian(random)};
+            if(glm::length(normal) > 1e-3f) {
+                normals.push_back(normal);
+            }
+        }
+
+        const K3VertexFormat format{K3VertexFormat::OCTAHEDRAL_NORMAL};
+        K3_CHECK(format.getStride() == 12 + 12 + 4 + 8);
+        std::vector<uint8_t> encoded(format.getStride());
+        for(const glm::vec3 &input : normals) {
+            const glm::vec3 normal = glm::normalize(input);
+
+            // The mapping itself is exact up to float rounding.
+            const glm::vec2 octahedral = K3VertexFormat::encodeOctahedral(normal);
+            K3_CHECK(std::abs(octahedral.x) + std::abs(octahedral.y) <= 1.f + 1e-6f);
+            K3_CHECK(getAngleDegrees(K3VertexFormat::decodeOctahedral(octahedral), normal) < 1e-3f);
+
+            K3Vertex vertex{};
+            vertex.normal = input;
+            format.encode(vertex, encoded.data());
+            K3Vertex decoded{};
+            format.decode(encoded.data(), decoded);
+            K3_CHECK(getAngleDegrees(decoded.normal, normal) <= NORMAL_BOUND_DEGREES);
+        }
+    }
+
+    K3_TEST(vertex_format_half_uv) {
+        K3Builder builder{};
+        builder.vertices = getRandomVertices(10000, 3);
+        // Tiled uvs up to the edge of where half floats stay within tolerance.
+        builder.vertices[0].uv = glm::vec2{-2.f, 2.f};
+        builder.vertices[1].uv = glm::vec2{1.9999f, -1.9999f};
+        builder.encode(K3VertexFormat::HALF_UV);
+
+        K3_CHECK(builder.vertexFormat.getFlags() == K3VertexFormat::HALF_UV);
+        K3_CHECK(builder.vertexFormat.getStride() == 12 + 12 + 12 + 4);
+        const std::vector<K3Vertex> decoded = decodeAll(builder);
+        for(size_t i = 0; i < decoded.size(); i++) {
+            const glm::vec2 error = glm::abs(decoded[i].uv - builder.vertices[i].uv);
+            K3_CHECK(error.x <= HALF_UV_BOUND && error.y <= HALF_UV_BOUND);
+            K3_CHECK(decoded[i].position == builder.vertices[i].position);
+        }
+
+        // A uv half floats can't hold within tolerance keeps the float layout.
+        builder.vertices[2].uv = glm::vec2{1000.3f, 0.f};
+        K3_CHECK(std::abs(glm::unpackHalf1x16(glm::packHalf1x16(1000.3f)) - 1000.3f) > HALF_UV_BOUND);
+        builder.encode(K3VertexFormat::HALF_UV | K3VertexFormat::OCTAHEDRAL_NORMAL);
+        K3_CHECK(builder.vertexFormat.getFlags() == K3VertexFormat::OCTAHEDRAL_NORMAL);
+        K3_CHECK(builder.vertexFormat.getStride() == 12 + 12 + 4 + 8);
+        const std::vector<K3Vertex> floatDecoded = decodeAll(builder);
+        for(size_t i = 0; i < floatDecoded.size(); i++) {
+            K3_CHECK(floatDecoded[i].uv == builder.vertices[i].uv);
+        }
+    }
+
+    K3_TEST(vertex_format_uniform_color) {
+        K3Builder builder{};
+        builder.vertices = getRandomVertices(1000, 4);
+        builder.encode(K3VertexFormat::COMPACT);
+        K3_CHECK(builder.vertexFormat.getFlags() == K3VertexFormat::COMPACT);
+        K3_CHECK(builder.vertexFormat.getStride() == 8 + 4 + 4);
+        K3_CHECK(builder.uniformColor == glm::vec3(0.8f, 0.4f, 0.2f));
+
+        // One differing vertex drops UNIFORM_COLOR and only that flag, and colors survive exactly.
+        builder.vertices[500].color = glm::vec3{0.f, 1.f, 0.f};
+        builder.encode(K3VertexFormat::COMPACT);
+        K3_CHECK(builder.vertexFormat.getFlags() == (K3VertexFormat::COMPACT & ~K3VertexFormat::UNIFORM_COLOR));
+        K3_CHECK(builder.vertexFormat.getStride() == 8 + 12 + 4 + 4);
+        const uint32_t stride = builder.vertexFormat.getStride();
+        for(size_t i = 0; i < builder.vertices.size(); i++) {
+            K3Vertex decoded{};
+            decoded.color = glm::vec3{-1.f};
+            builder.vertexFormat.decode(builder.encodedVertices.data() + stride * i, decoded);
+            K3_CHECK(decoded.color == builder.vertices[i].color);
+        }
+    }
+
+}
@@ -0,0 +1,60 @@
+#include "test.hpp"
+#include "reference.hpp"
+
+#include "k3/graphics/obj_parser.hpp"
+#include "k3/graphics/thread_pool.hpp"
+#include "k3/graphics/vertex.hpp"
+#include "k3/graphics/vertex_table.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace k3::graphics {
+
+    // The table and sorted paths give the same vertices in first use order and the same index
+    // stream as std::unordered_map did, and every index leads back to a vertex equal to its corner.
+    static void checkPathsAgree(const std::vector<K3Vertex> &corners) {
+        std::vector<K3Vertex> tableVertices{};
+        std::vector<uint32_t> tableIndices{};
+        tests::deduplicateWithTable(corners, tableVertices, tableIndices);
+        K3_CHECK(tableIndices.size() == corners.size());
+        for(size_t i = 0; i < corners.size(); i++) {
+            K3_CHECK(tableVertices[tableIndices[i]] == corners[i]);
+        }
+        std::vector<K3Vertex> mapVertices{};
+        std::vector<uint32_t> mapIndices{};
+        tests::deduplicateWithMap(corners, mapVertices, mapIndices);
+        K3_CHECK(mapIndices == tableIndices && mapVertices.size() == tableVertices.size());
+
+        // Pool sizes that put the range boundaries in different places.
+        for(uint32_t threads : {1u, 3u, std::max(1u, std::thread::hardware_concurrency())}) {
+            K3ThreadPool pool(threads);
+            std::vector<K3Vertex> sortedVertices{};
+            std::vector<uint32_t> sortedIndices{};
+            K3VertexTable::deduplicateSorted(corners, sortedVertices, sortedIndices, pool);
+            K3_CHECK(sortedIndices == tableIndices);
+            K3_CHECK(sortedVertices.size() == tableVertices.size());
+            K3_CHECK(std::equal(sortedVertices.begin(), sortedVertices.end(), tableVertices.begin()));
+        }
+    }
+
+    K3_TEST(vertex_table_shipped_models) {
+        for(const auto &model : tests::getShippedModels()) {
+            K3ObjData data{};
+            K3_CHECK(K3ObjParser::parse(tests::getModelPath(model), data));
+            std::vector<K3Vertex> corners(data.corners.size());
+            for(size_t i = 0; i < corners.size(); i++) {
+                corners[i] = K3Builder::assembleVertex(data, data.corners[i]);
+            }
+            checkPathsAgree(corners);
+        }
+    }
+
+    K3_TEST(vertex_table_random_corners) {
+        checkPathsAgree(tests::getRandomCorners(1, 1, 1));
+        checkPathsAgree(tests::getRandomCorners(1000, 10, 2));
+        checkPathsAgree(tests::getRandomCorners(200000, 40000, 3));
+    }
+
+}